@@ -27,8 +27,8 @@ include(SharedLibraries)
 
 set(INCLUDES arpa/inet.h fcntl.h inttypes.h limits.h netdb.h
     netinet/in.h stddef.h stdlib.h string.h sys/mman.h
-    sys/resource.h sys/rusage.h sys/socket.h sys/statvfs.h sys/time.h
-    syslog.h unistd.h stdbool.h isa-l/erasure_code.h
+    sys/resource.h sys/rusage.h sys/sendfile.h sys/socket.h sys/statvfs.h sys/time.h
+    syslog.h unistd.h stdbool.h isa-l/erasure_code.h linux/io_uring.h
 )
 
 if(CMAKE_SYSTEM_NAME STREQUAL "FreeBSD")
@@ -70,7 +70,7 @@ if(NOT MINGW)
 endif()
 check_functions("${REQUIRED_FUNCTIONS}" TRUE)
 
-set(OPTIONAL_FUNCTIONS strerror perror pread pwrite readv writev getrusage
+set(OPTIONAL_FUNCTIONS strerror perror pread preadv pwrite readv writev getrusage
   setitimer posix_fadvise fallocate)
 check_functions("${OPTIONAL_FUNCTIONS}" false)
 
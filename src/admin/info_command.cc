@@ -19,12 +19,15 @@
 #include "common/platform.h"
 #include "admin/info_command.h"
 
+#include <iomanip>
 #include <iostream>
 
 #include "common/human_readable_format.h"
 #include "common/lizardfs_statistics.h"
 #include "common/lizardfs_version.h"
 #include "common/server_connection.h"
+#include "protocol/cltoma.h"
+#include "protocol/matocl.h"
 
 std::string InfoCommand::name() const {
 	return "info";
@@ -41,6 +44,28 @@ void InfoCommand::usage() const {
 	std::cerr << "    Prints statistics concerning the LizardFS installation.\n";
 }
 
+void InfoCommand::printHashTablesInfo(ServerConnection& connection) const {
+	auto request = cltoma::hashTablesInfo::build(true);
+	auto response = connection.sendAndReceive(request, LIZ_MATOCL_HASH_TABLES_INFO);
+	std::vector<HashTableStatistics> tables;
+	matocl::hashTablesInfo::deserialize(response, tables);
+	for (const auto& table : tables) {
+		double averageChain = table.usedBuckets > 0
+				? double(table.elements) / table.usedBuckets : 0.0;
+		std::cout << "Hash table " << table.name << ":\t"
+				<< table.elements << " elements, "
+				<< table.buckets << " buckets, "
+				<< table.usedBuckets << " used, "
+				<< std::fixed << std::setprecision(2) << averageChain
+				<< " average chain length";
+		if (table.memoryUsage > 0 && table.elements > 0) {
+			std::cout << ", " << convertToIec(table.memoryUsage) << "B memory, "
+					<< table.memoryUsage / table.elements << " bytes per element";
+		}
+		std::cout << std::endl;
+	}
+}
+
 void InfoCommand::run(const Options& options) const {
 	if (options.arguments().size() != 2) {
 		throw WrongUsageException("Expected <master ip> and <master port> for " + name());
@@ -83,5 +108,8 @@ void InfoCommand::run(const Options& options) const {
 				<< "Chunks:\t" << info.chunks << '\n'
 				<< "Chunk copies:\t" << info.chunkCopies << '\n'
 				<< "Regular copies (deprecated):\t" << info.chunkCopies << std::endl;
+		if (info.version >= kHashTablesInfoVersion) {
+			printHashTablesInfo(connection);
+		}
 	}
 }
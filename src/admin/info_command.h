@@ -21,6 +21,7 @@
 #include "common/platform.h"
 
 #include "admin/lizardfs_admin_command.h"
+#include "common/server_connection.h"
 
 class InfoCommand : public LizardFsProbeCommand {
 public:
@@ -28,4 +29,7 @@ public:
 	virtual SupportedOptions supportedOptions() const;
 	virtual void usage() const;
 	virtual void run(const Options& options) const;
+
+private:
+	void printHashTablesInfo(ServerConnection& connection) const;
 };
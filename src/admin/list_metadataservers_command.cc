@@ -88,7 +88,7 @@ void ListMetadataserversCommand::run(const Options& options) const {
 	std::reverse(shadowsList.begin(), shadowsList.end());
 	int server = 1;
 	for (const auto& e : shadowsList) {
-		MetadataserverStatus s{"unknown", "unknown", 0};
+		MetadataserverStatus s{"unknown", "unknown", 0, "unknown", 0, 0};
 		std::string hostname;
 		// If information about MATOCL_SERV_PORT used by shadows isn't available we cannot query it
 		// for its hostname, metaversion etc.
@@ -48,23 +48,32 @@ void MetadataserverStatusCommand::run(const Options& options) const {
 
 	if (options.isSet(kPorcelainMode)) {
 		std::cout << s.personality << "\t" << s.serverStatus << "\t"
-				<< s.metadataVersion << std::endl;
+				<< s.metadataVersion << "\t" << s.metadataDump << "\t"
+				<< s.changesBehind << "\t" << s.secondsBehind << std::endl;
 	} else {
 		std::cout << "     personality: " << s.personality << std::endl;
 		std::cout << "   server status: " << s.serverStatus << std::endl;
 		std::cout << "metadata version: " << s.metadataVersion << std::endl;
+		std::cout << "   metadata dump: " << s.metadataDump << std::endl;
+		std::cout << " replication lag: " << s.changesBehind << " changes, "
+				<< s.secondsBehind << " seconds" << std::endl;
 	}
 }
 
 MetadataserverStatus MetadataserverStatusCommand::getStatus(ServerConnection& connection) {
 	std::vector<uint8_t> request;
-	request = cltoma::metadataserverStatus::build(1);
+	request = cltoma::metadataserverStatus::build(1, true);
 	auto response = connection.sendAndReceive(request, LIZ_MATOCL_METADATASERVER_STATUS);
 
 	uint32_t messageId;
 	uint8_t status;
 	uint64_t metadataVersion;
-	matocl::metadataserverStatus::deserialize(response, messageId, status, metadataVersion);
+	uint8_t dumpStage;
+	uint8_t dumpProgress;
+	uint64_t changesBehind;
+	uint32_t secondsBehind;
+	matocl::metadataserverStatus::deserialize(response, messageId, status, metadataVersion,
+			dumpStage, dumpProgress, changesBehind, secondsBehind);
 
 	std::string personality, serverStatus;
 	switch (status) {
@@ -84,5 +93,26 @@ MetadataserverStatus MetadataserverStatusCommand::getStatus(ServerConnection& co
 		personality = "<unknown>";
 		serverStatus = "<unknown>";
 	}
-	return MetadataserverStatus{personality, serverStatus, metadataVersion};
+	std::string metadataDump;
+	switch (dumpStage) {
+	case LIZ_METADATA_DUMP_NOT_RUNNING:
+		metadataDump = "idle";
+		break;
+	case LIZ_METADATA_DUMP_STARTED:
+		metadataDump = "started";
+		break;
+	case LIZ_METADATA_DUMP_LOADING:
+		metadataDump = "loading " + std::to_string(dumpProgress) + "%";
+		break;
+	case LIZ_METADATA_DUMP_REPLAYING:
+		metadataDump = "replaying changelogs " + std::to_string(dumpProgress) + "%";
+		break;
+	case LIZ_METADATA_DUMP_STORING:
+		metadataDump = "storing " + std::to_string(dumpProgress) + "%";
+		break;
+	default:
+		metadataDump = "<unknown>";
+	}
+	return MetadataserverStatus{personality, serverStatus, metadataVersion, metadataDump,
+			changesBehind, secondsBehind};
 }
@@ -27,6 +27,9 @@ struct MetadataserverStatus {
 	std::string personality;
 	std::string serverStatus;
 	uint64_t metadataVersion;
+	std::string metadataDump;
+	uint64_t changesBehind;  ///< changes received by a shadow master but not applied yet
+	uint32_t secondsBehind;  ///< age of the oldest of these changes
 };
 
 class MetadataserverStatusCommand : public LizardFsProbeCommand {
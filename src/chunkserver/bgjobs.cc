@@ -57,6 +57,7 @@ enum {
 	OP_OPEN,
 	OP_CLOSE,
 	OP_READ,
+	OP_READ_BLOCKS,
 	OP_PREFETCH,
 	OP_WRITE,
 	OP_LEGACY_REPLICATE,
@@ -91,6 +92,20 @@ struct chunk_read_args {
 	bool performHddOpen;
 };
 
+// for OP_READ_BLOCKS
+struct chunk_read_blocks_args {
+	uint64_t chunkid;
+	uint32_t version;
+	ChunkPartType chunkType;
+	uint16_t firstBlock;
+	uint16_t blockCount;
+	uint32_t maxBlocksToBeReadBehind;
+	uint32_t blocksToBeReadAhead;
+	OutputBuffer* outputBuffer;
+	uint32_t prefixSize;
+	bool performHddOpen;
+};
+
 // for OP_PREFETCH
 struct chunk_prefetch_args {
 	uint64_t chunkid;
@@ -271,6 +286,36 @@ void* job_worker(void *th_arg) {
 				}
 				break;
 			}
+			case OP_READ_BLOCKS:
+			{
+				auto rdargs = (chunk_read_blocks_args*)(jptr->args);
+				if (jstate==JSTATE_DISABLED) {
+					status = LIZARDFS_ERROR_NOTDONE;
+					break;
+				}
+				LOG_AVG_TILL_END_OF_SCOPE0("job_read_blocks");
+				if (rdargs->performHddOpen) {
+					status = hdd_open(rdargs->chunkid, rdargs->chunkType);
+					if (status != LIZARDFS_STATUS_OK) {
+						break;
+					}
+				}
+
+				status = hdd_read_blocks(rdargs->chunkid, rdargs->version, rdargs->chunkType,
+						rdargs->firstBlock, rdargs->blockCount, rdargs->maxBlocksToBeReadBehind,
+						rdargs->blocksToBeReadAhead, rdargs->outputBuffer, rdargs->prefixSize);
+
+				if (rdargs->performHddOpen && status != LIZARDFS_STATUS_OK) {
+					int ret = hdd_close(rdargs->chunkid, rdargs->chunkType);
+					if (ret != LIZARDFS_STATUS_OK) {
+						lzfs_silent_syslog(LOG_ERR,
+								"read job: cannot close chunk after read error (%s): %s",
+								lizardfs_error_string(status),
+								lizardfs_error_string(ret));
+					}
+				}
+				break;
+			}
 			case OP_PREFETCH:
 			{
 				auto prefetchArgs = (chunk_prefetch_args*)(jptr->args);
@@ -578,6 +623,29 @@ uint32_t job_read(void *jpool, void (*callback)(uint8_t status, void *extra), vo
 	return job_new(jp,OP_READ,args,callback,extra);
 }
 
+uint32_t job_read_blocks(void *jpool, void (*callback)(uint8_t status, void *extra), void *extra,
+		uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
+		uint16_t firstBlock, uint16_t blockCount, uint32_t maxBlocksToBeReadBehind,
+		uint32_t blocksToBeReadAhead, OutputBuffer *outputBuffer, uint32_t prefixSize,
+		bool performHddOpen) {
+	TRACETHIS();
+	jobpool* jp = (jobpool*)jpool;
+	chunk_read_blocks_args *args;
+	args = (chunk_read_blocks_args*) malloc(sizeof(chunk_read_blocks_args));
+	passert(args);
+	args->chunkid = chunkid;
+	args->version = version;
+	args->chunkType = chunkType;
+	args->firstBlock = firstBlock;
+	args->blockCount = blockCount;
+	args->maxBlocksToBeReadBehind = maxBlocksToBeReadBehind;
+	args->blocksToBeReadAhead = blocksToBeReadAhead;
+	args->outputBuffer = outputBuffer;
+	args->prefixSize = prefixSize;
+	args->performHddOpen = performHddOpen;
+	return job_new(jp,OP_READ_BLOCKS,args,callback,extra);
+}
+
 uint32_t job_prefetch(void *jpool, uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
 		uint32_t firstBlockToBePrefetched, uint32_t nrOfBlocksToBePrefetched) {
 	TRACETHIS();
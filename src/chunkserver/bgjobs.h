@@ -84,6 +84,12 @@ uint32_t job_read(void *jpool, void (*callback)(uint8_t status,void *extra), voi
 		uint64_t chunkid, uint32_t chunkVersion, ChunkPartType chunkType,
 		uint32_t offset, uint32_t size, uint32_t maxBlocksToBeReadBehind,
 		uint32_t blocksToBeReadAhead, OutputBuffer *outputBuffer, bool performHddOpen);
+/* outputBuffer: blockCount * ([prefixSize bytes filled by the caller] [space for CRC and data]) */
+uint32_t job_read_blocks(void *jpool, void (*callback)(uint8_t status, void *extra), void *extra,
+		uint64_t chunkid, uint32_t chunkVersion, ChunkPartType chunkType,
+		uint16_t firstBlock, uint16_t blockCount, uint32_t maxBlocksToBeReadBehind,
+		uint32_t blocksToBeReadAhead, OutputBuffer *outputBuffer, uint32_t prefixSize,
+		bool performHddOpen);
 uint32_t job_prefetch(void *jpool, uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
 		uint32_t firstBlockToBePrefetched, uint32_t nrOfBlocksToBePrefetched) ;
 uint32_t job_write(void *jpool, void (*callback)(uint8_t status, void *extra), void *extra,
@@ -47,24 +47,29 @@ Chunk::Chunk(uint64_t chunkId, ChunkPartType type, ChunkState state)
 }
 
 std::string Chunk::generateFilenameForVersion(uint32_t version, int layout_version) const {
+	return generateFilename(owner->path, chunkid, type_, chunkFormat(), version, layout_version);
+}
+
+std::string Chunk::generateFilename(const std::string &folderPath, uint64_t chunkid,
+		ChunkPartType type, ChunkFormat format, uint32_t version, int layout_version) {
 	std::stringstream ss;
 	char buffer[30];
-	ss << owner->path << Chunk::getSubfolderNameGivenChunkId(chunkid, layout_version) << "/chunk_";
-	if (slice_traits::isXor(type_)) {
-		if (slice_traits::xors::isXorParity(type_)) {
+	ss << folderPath << Chunk::getSubfolderNameGivenChunkId(chunkid, layout_version) << "/chunk_";
+	if (slice_traits::isXor(type)) {
+		if (slice_traits::xors::isXorParity(type)) {
 			ss << "xor_parity_of_";
 		} else {
-			ss << "xor_" << (unsigned)slice_traits::xors::getXorPart(type_) << "_of_";
+			ss << "xor_" << (unsigned)slice_traits::xors::getXorPart(type) << "_of_";
 		}
-		ss << (unsigned)slice_traits::xors::getXorLevel(type_) << "_";
+		ss << (unsigned)slice_traits::xors::getXorLevel(type) << "_";
 	}
-	if (slice_traits::isEC(type_)) {
-		ss << "ec2_" << (type_.getSlicePart() + 1) << "_of_"
-		   << slice_traits::ec::getNumberOfDataParts(type_) << "_"
-		   << slice_traits::ec::getNumberOfParityParts(type_) << "_";
+	if (slice_traits::isEC(type)) {
+		ss << "ec2_" << (type.getSlicePart() + 1) << "_of_"
+		   << slice_traits::ec::getNumberOfDataParts(type) << "_"
+		   << slice_traits::ec::getNumberOfParityParts(type) << "_";
 	}
 	sprintf(buffer, "%016" PRIX64 "_%08" PRIX32 ".mfs", chunkid, version);
-	if (chunkFormat() == ChunkFormat::INTERLEAVED) {
+	if (format == ChunkFormat::INTERLEAVED) {
 		memcpy(buffer + 26, "liz", 3);
 	}
 	ss << buffer;
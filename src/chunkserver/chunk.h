@@ -26,9 +26,11 @@
 #include <sys/types.h>
 
 #include <condition_variable>
+#include <memory>
 #include <thread>
 
 #include "chunkserver/chunk_format.h"
+#include "chunkserver/io_uring_queue.h"
 #include "common/chunk_part_type.h"
 #include "common/disk_info.h"
 #include "protocol/MFSCommunication.h"
@@ -96,6 +98,7 @@ struct folder {
 	double carry;
 	std::thread scanthread;
 	std::thread migratethread;
+	std::unique_ptr<IoUringQueue> ioqueue; // null when synchronous I/O is used
 	Chunk *testhead,**testtail;
 	struct folder *next;
 };
@@ -115,8 +118,12 @@ public:
 	}
 
 	std::string generateFilenameForVersion(uint32_t version, int layout_version = kCurrentDirectoryLayout) const;
+	static std::string generateFilename(const std::string &folderPath, uint64_t chunkid,
+			ChunkPartType type, ChunkFormat format, uint32_t version,
+			int layout_version = kCurrentDirectoryLayout);
 	int renameChunkFile(uint32_t new_version, int new_layout_version = kCurrentDirectoryLayout);
 	void setFilenameLayout(int layout_version) { filename_layout_ = layout_version; }
+	int filenameLayout() const { return filename_layout_; }
 
 	virtual off_t getBlockOffset(uint16_t blockNumber) const = 0;
 	virtual off_t getFileSizeFromBlockCount(uint32_t blockCount) const = 0;
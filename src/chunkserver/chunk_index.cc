@@ -0,0 +1,170 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "chunkserver/chunk_index.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+
+#include "chunkserver/chunk.h"
+#include "common/crc.h"
+#include "common/datapack.h"
+#include "common/slogger.h"
+
+static constexpr char kMagic[] = "LIZCIDX1";
+static constexpr uint32_t kMagicSize = 8;
+static constexpr uint32_t kStampSize = 8 + 4;
+static constexpr uint32_t kHeaderSize =
+		kMagicSize + Chunk::kNumberOfSubfolders * kStampSize + 8;
+static constexpr uint32_t kEntrySize = 8 + 4 + 4 + 1;
+
+/// Appends modification times of all subfolders, returns false if any of them can't be used.
+static bool chunk_index_put_stamps(const std::string &folderPath, std::vector<uint8_t> &data) {
+	struct stat st;
+	for (uint32_t i = 0; i < Chunk::kNumberOfSubfolders; ++i) {
+		if (stat((folderPath + Chunk::getSubfolderNameGivenNumber(i, 1)).c_str(), &st) == 0) {
+			// chunks of the old layout are not indexed
+			return false;
+		}
+		if (stat((folderPath + Chunk::getSubfolderNameGivenNumber(i, 0)).c_str(), &st) != 0) {
+			return false;
+		}
+		data.resize(data.size() + kStampSize);
+		uint8_t *ptr = data.data() + data.size() - kStampSize;
+		put64bit(&ptr, st.st_mtim.tv_sec);
+		put32bit(&ptr, st.st_mtim.tv_nsec);
+	}
+	return true;
+}
+
+static bool chunk_index_write_all(int fd, const uint8_t *data, size_t size) {
+	while (size > 0) {
+		ssize_t ret = ::write(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += ret;
+		size -= ret;
+	}
+	return true;
+}
+
+bool ChunkIndex::write(const std::string &folderPath, const std::vector<Entry> &entries) {
+	std::vector<uint8_t> data;
+	data.reserve(kHeaderSize + entries.size() * kEntrySize + 4);
+	data.insert(data.end(), kMagic, kMagic + kMagicSize);
+	if (!chunk_index_put_stamps(folderPath, data)) {
+		return false;
+	}
+	data.resize(kHeaderSize + entries.size() * kEntrySize);
+	uint8_t *ptr = data.data() + kHeaderSize - 8;
+	put64bit(&ptr, entries.size());
+	for (const Entry &entry : entries) {
+		put64bit(&ptr, entry.chunkId);
+		put32bit(&ptr, entry.version);
+		put32bit(&ptr, entry.type.getId());
+		put8bit(&ptr, static_cast<uint8_t>(entry.format));
+	}
+	uint32_t crc = mycrc32(0, data.data(), data.size());
+	data.resize(data.size() + 4);
+	ptr = data.data() + data.size() - 4;
+	put32bit(&ptr, crc);
+
+	std::string path = folderPath + kFilename;
+	std::string tmpPath = path + ".tmp";
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+	if (fd < 0) {
+		lzfs_pretty_errlog(LOG_WARNING, "can't create chunk index %s", tmpPath.c_str());
+		return false;
+	}
+	bool ok = chunk_index_write_all(fd, data.data(), data.size()) && fsync(fd) == 0;
+	if (close(fd) != 0) {
+		ok = false;
+	}
+	if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+		lzfs_pretty_errlog(LOG_WARNING, "can't write chunk index %s", path.c_str());
+		unlink(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool ChunkIndex::read(const std::string &folderPath,
+		const std::function<void(const Entry &)> &callback) {
+	std::string path = folderPath + kFilename;
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	std::vector<uint8_t> data;
+	bool ok = fstat(fd, &st) == 0 && st.st_size >= (off_t)(kHeaderSize + 4);
+	if (ok) {
+		data.resize(st.st_size);
+		ok = pread(fd, data.data(), data.size(), 0) == (ssize_t)data.size();
+	}
+	close(fd);
+	if (!ok) {
+		lzfs_pretty_syslog(LOG_NOTICE, "chunk index %s is truncated", path.c_str());
+		return false;
+	}
+
+	const uint8_t *ptr = data.data() + kHeaderSize - 8;
+	uint64_t count = get64bit(&ptr);
+	if (memcmp(data.data(), kMagic, kMagicSize) != 0
+			|| (data.size() - kHeaderSize - 4) / kEntrySize != count
+			|| (data.size() - kHeaderSize - 4) % kEntrySize != 0) {
+		lzfs_pretty_syslog(LOG_NOTICE, "chunk index %s is malformed", path.c_str());
+		return false;
+	}
+	ptr = data.data() + data.size() - 4;
+	if (get32bit(&ptr) != mycrc32(0, data.data(), data.size() - 4)) {
+		lzfs_pretty_syslog(LOG_NOTICE, "chunk index %s is corrupted", path.c_str());
+		return false;
+	}
+	std::vector<uint8_t> stamps;
+	if (!chunk_index_put_stamps(folderPath, stamps)
+			|| memcmp(stamps.data(), data.data() + kMagicSize, stamps.size()) != 0) {
+		lzfs_pretty_syslog(LOG_NOTICE, "chunk index %s is out of date", path.c_str());
+		return false;
+	}
+
+	ptr = data.data() + kHeaderSize;
+	Entry entry;
+	for (uint64_t i = 0; i < count; ++i) {
+		entry.chunkId = get64bit(&ptr);
+		entry.version = get32bit(&ptr);
+		entry.type = ChunkPartType(get32bit(&ptr));
+		entry.format = static_cast<ChunkFormat>(get8bit(&ptr));
+		callback(entry);
+	}
+	return true;
+}
+
+void ChunkIndex::remove(const std::string &folderPath) {
+	std::string path = folderPath + kFilename;
+	if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+		lzfs_pretty_errlog(LOG_WARNING, "can't remove chunk index %s", path.c_str());
+	}
+}
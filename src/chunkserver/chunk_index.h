@@ -0,0 +1,69 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "chunkserver/chunk_format.h"
+#include "common/chunk_part_type.h"
+
+/*
+ * Index of chunks stored in a data folder.
+ *
+ * It is written on a clean shutdown of the chunkserver, so that the next start doesn't have to
+ * read all the subfolders of the folder. The file contains:
+ *   "LIZCIDX1" stamps:(256 * (mtime_sec:64 mtime_nsec:32)) count:64
+ *   count * (chunkid:64 version:32 type:32 format:8) crc:32
+ * where stamps are modification times of the subfolders of the current layout. Creating,
+ * removing or renaming a chunk file changes the time of its subfolder, so the index is used only
+ * if all the times are unchanged and no subfolder of the old layout exists.
+ */
+class ChunkIndex {
+public:
+	struct Entry {
+		uint64_t chunkId;
+		uint32_t version;
+		ChunkPartType type;
+		ChunkFormat format;
+	};
+
+	static constexpr const char *kFilename = ".chunkindex";
+
+	/*! \brief Writes the index of the folder.
+	 *
+	 * \param folderPath path of the folder, ending with '/'
+	 * \return false on error (logged)
+	 */
+	static bool write(const std::string &folderPath, const std::vector<Entry> &entries);
+
+	/*! \brief Reads a valid index of the folder.
+	 *
+	 * \param callback called for each entry, only if the whole index is valid
+	 * \return false if there is no valid index
+	 */
+	static bool read(const std::string &folderPath, const std::function<void(const Entry &)> &callback);
+
+	/// Removes the index, so that it is not used after the folder is modified.
+	static void remove(const std::string &folderPath);
+};
@@ -0,0 +1,105 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "chunkserver/chunk_index.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "chunkserver/chunk.h"
+#include "common/slice_traits.h"
+#include "unittests/TemporaryDirectory.h"
+
+class ChunkIndexTests : public testing::Test {
+protected:
+	void SetUp() override {
+		temp_.reset(new TemporaryDirectory("/tmp",
+				testing::UnitTest::GetInstance()->current_test_info()->name()));
+		path_ = temp_->name() + "/";
+		for (uint32_t i = 0; i < Chunk::kNumberOfSubfolders; ++i) {
+			std::string subfolder = path_ + Chunk::getSubfolderNameGivenNumber(i);
+			ASSERT_EQ(0, mkdir(subfolder.c_str(), 0755));
+			// Make sure that creating a file changes the time even on coarse grained clocks
+			struct timespec times[2] = {{1, 0}, {1, 0}};
+			ASSERT_EQ(0, utimensat(AT_FDCWD, subfolder.c_str(), times, 0));
+		}
+		entries_ = {
+			{0x1234, 1, slice_traits::standard::ChunkPartType(), ChunkFormat::MOOSEFS},
+			{0x10000, 7, slice_traits::xors::ChunkPartType(3, 2), ChunkFormat::INTERLEAVED},
+			{0x20000, 3, slice_traits::ec::ChunkPartType(3, 2, 4), ChunkFormat::INTERLEAVED},
+		};
+	}
+
+	std::unique_ptr<TemporaryDirectory> temp_;
+	std::string path_;
+	std::vector<ChunkIndex::Entry> entries_;
+};
+
+TEST_F(ChunkIndexTests, WriteAndRead) {
+	ASSERT_TRUE(ChunkIndex::write(path_, entries_));
+	std::vector<ChunkIndex::Entry> read;
+	ASSERT_TRUE(ChunkIndex::read(path_, [&](const ChunkIndex::Entry &e) { read.push_back(e); }));
+	ASSERT_EQ(entries_.size(), read.size());
+	for (size_t i = 0; i < entries_.size(); ++i) {
+		EXPECT_EQ(entries_[i].chunkId, read[i].chunkId);
+		EXPECT_EQ(entries_[i].version, read[i].version);
+		EXPECT_EQ(entries_[i].type, read[i].type);
+		EXPECT_EQ(entries_[i].format, read[i].format);
+	}
+}
+
+TEST_F(ChunkIndexTests, MissingOrRemovedIndex) {
+	EXPECT_FALSE(ChunkIndex::read(path_, [](const ChunkIndex::Entry &) {}));
+	ASSERT_TRUE(ChunkIndex::write(path_, entries_));
+	ChunkIndex::remove(path_);
+	EXPECT_FALSE(ChunkIndex::read(path_, [](const ChunkIndex::Entry &) {}));
+}
+
+TEST_F(ChunkIndexTests, ModifiedFolder) {
+	ASSERT_TRUE(ChunkIndex::write(path_, entries_));
+	std::ofstream(path_ + Chunk::getSubfolderNameGivenNumber(0x17) + "/chunk_0000000000170000_00000001.mfs");
+	int calls = 0;
+	EXPECT_FALSE(ChunkIndex::read(path_, [&](const ChunkIndex::Entry &) { ++calls; }));
+	EXPECT_EQ(0, calls);
+}
+
+TEST_F(ChunkIndexTests, OldLayoutSubfolder) {
+	ASSERT_TRUE(ChunkIndex::write(path_, entries_));
+	ASSERT_EQ(0, mkdir((path_ + Chunk::getSubfolderNameGivenNumber(0, 1)).c_str(), 0755));
+	EXPECT_FALSE(ChunkIndex::read(path_, [](const ChunkIndex::Entry &) {}));
+	EXPECT_FALSE(ChunkIndex::write(path_, entries_));
+}
+
+TEST_F(ChunkIndexTests, CorruptedIndex) {
+	ASSERT_TRUE(ChunkIndex::write(path_, entries_));
+	std::string indexPath = path_ + ChunkIndex::kFilename;
+	int fd = open(indexPath.c_str(), O_WRONLY);
+	ASSERT_GE(fd, 0);
+	uint8_t byte = 0xFF;
+	ASSERT_EQ(1, pwrite(fd, &byte, 1, 8 + 256 * 12 + 8 + 2));
+	close(fd);
+	EXPECT_FALSE(ChunkIndex::read(path_, [](const ChunkIndex::Entry &) {}));
+
+	ASSERT_TRUE(ChunkIndex::write(path_, entries_));
+	ASSERT_EQ(0, truncate(indexPath.c_str(), 8 + 256 * 12 + 8 + 17));
+	EXPECT_FALSE(ChunkIndex::read(path_, [](const ChunkIndex::Entry &) {}));
+}
@@ -47,6 +47,7 @@
 #include <sys/statvfs.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
@@ -57,18 +58,23 @@
 #include <atomic>
 #include <deque>
 #include <list>
+#include <map>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include "chunkserver/chunk.h"
 #include "chunkserver/chunk_filename_parser.h"
+#include "chunkserver/chunk_index.h"
 #include "chunkserver/chunk_signature.h"
 #include "chunkserver/indexed_resource_pool.h"
+#include "chunkserver/io_uring_queue.h"
 #include "chunkserver/iostat.h"
 #include "chunkserver/open_chunk.h"
 #include "common/cfg.h"
+#include "common/chunk_set_checksum.h"
 #include "common/chunk_version_with_todel_flag.h"
 #include "common/cwrap.h"
 #include "common/crc.h"
@@ -117,6 +123,15 @@ static std::atomic<bool> PerformFsync;
 
 static bool gPunchHolesInFiles;
 
+/// Value of HDD_CHUNK_INDEX from config, read only at startup
+static bool gUseChunkIndex = true;
+
+/// Value of HDD_IO_ENGINE from config, read only at startup
+static bool gUseIoUring = false;
+
+/// Value of HDD_IO_URING_QUEUE_DEPTH from config, read only at startup
+static unsigned gIoUringQueueDepth = IoUringQueue::kDefaultQueueDepth;
+
 /* folders data */
 static folder *folderhead = NULL;
 
@@ -153,6 +168,7 @@ private:
  * std::unique_ptr on Chunk is used here as the stored objects are of Chunk's subclasses types.
  */
 using chunk_registry_t = std::unordered_map<ChunkWithType, std::unique_ptr<Chunk>, KeyOperations, KeyOperations>;
+using chunk_key_set_t = std::unordered_set<ChunkWithType, KeyOperations, KeyOperations>;
 
 /** \brief Global registry of all chunks stored on chunkserver.
  */
@@ -171,6 +187,11 @@ inline ChunkWithType chunkToKey(const Chunk &chunk) {
 static std::deque<ChunkWithType> gDamagedChunks;
 static std::deque<ChunkWithType> gLostChunks;
 static std::deque<ChunkWithVersionAndType> gNewChunks;
+/// Chunks created, removed or modified since the last registration in master
+static chunk_key_set_t gChangedChunks;
+/// If too many chunks were changed, only the full list of chunks can be registered
+static bool gChangedChunksOverflow = false;
+static constexpr std::size_t kMaxChangedChunks = 1000000;
 static std::atomic<uint32_t> errorcounter(0);
 static std::atomic_int hddspacechanged(0);
 
@@ -232,6 +253,24 @@ static const int kOpenRetryCount = 4;
 static const int kOpenRetry_ms = 5;
 static IoStat gIoStat;
 
+/// Records a chunk to be sent in the next incremental registration; needs gMasterReportsLock.
+static void hdd_add_changed_chunk(const ChunkWithType &chunk) {
+	if (gChangedChunksOverflow) {
+		return;
+	}
+	if (gChangedChunks.size() >= kMaxChangedChunks) {
+		gChangedChunksOverflow = true;
+		gChangedChunks.clear();
+		return;
+	}
+	gChangedChunks.insert(chunk);
+}
+
+static void hdd_report_changed_chunk(const Chunk *c) {
+	std::lock_guard<std::mutex> lock_guard(gMasterReportsLock);
+	hdd_add_changed_chunk(chunkToKey(*c));
+}
+
 void hdd_report_damaged_chunk(uint64_t chunkid, ChunkPartType chunk_type) {
 	TRACETHIS1(chunkid);
 	std::lock_guard<std::mutex> lock_guard(gMasterReportsLock);
@@ -250,6 +289,7 @@ void hdd_report_lost_chunk(uint64_t chunkid, ChunkPartType chunk_type) {
 	TRACETHIS1(chunkid);
 	std::lock_guard<std::mutex> lock_guard(gMasterReportsLock);
 	gLostChunks.push_back({chunkid, chunk_type});
+	hdd_add_changed_chunk(makeChunkKey(chunkid, chunk_type));
 }
 
 void hdd_get_lost_chunks(std::vector<ChunkWithType>& buffer, std::size_t limit) {
@@ -265,6 +305,7 @@ void hdd_report_new_chunk(uint64_t chunkid, uint32_t version, bool todel, ChunkP
 	uint32_t versionWithTodelFlag = common::combineVersionWithTodelFlag(version, todel);
 	std::lock_guard<std::mutex> lock_guard(gMasterReportsLock);
 	gNewChunks.push_back(ChunkWithVersionAndType(chunkid, versionWithTodelFlag, type));
+	hdd_add_changed_chunk(makeChunkKey(chunkid, type));
 }
 
 void hdd_get_new_chunks(std::vector<ChunkWithVersionAndType>& buffer, std::size_t limit) {
@@ -585,6 +626,7 @@ static inline void hdd_chunk_remove(Chunk *c) {
 		}
 		*(cp->testprev) = cp->testnext;
 	}
+	hdd_report_changed_chunk(cp);
 	gChunkRegistry.erase(chunkIter);
 }
 
@@ -688,6 +730,7 @@ static Chunk *hdd_chunk_recreate(Chunk *c, uint64_t chunkid, ChunkPartType type,
 	passert(c);
 	bool success = gChunkRegistry.insert({makeChunkKey(chunkid, type), std::unique_ptr<Chunk>(c)}).second;
 	massert(success, "Cannot insert new chunk to the registry as a chunk with its chunkId and chunkPartType already exists");
+	hdd_report_changed_chunk(c);
 
 	c->ccond = waiting;
 	if (waiting) {
@@ -1183,6 +1226,64 @@ void hdd_foreach_chunk_in_bulks(
 	handleBulkIfReady(BulkReadyWhen::NONEMPTY);
 }
 
+void hdd_reset_changed_chunks() {
+	TRACETHIS();
+	std::lock_guard<std::mutex> lock_guard(gMasterReportsLock);
+	gChangedChunks.clear();
+	gChangedChunksOverflow = false;
+}
+
+bool hdd_get_changed_chunks(std::vector<ChunkWithVersionAndType> &changedChunks,
+		std::vector<ChunkWithType> &removedChunks, uint64_t &checksum, uint32_t &chunkCount) {
+	TRACETHIS();
+	chunk_key_set_t changedKeys;
+	std::vector<ChunkWithType> recheckList;
+	changedChunks.clear();
+	removedChunks.clear();
+	checksum = 0;
+	chunkCount = 0;
+
+	auto addChunk = [&](const Chunk *chunk, bool changed) {
+		common::chunk_version_t versionWithTodelFlag = common::combineVersionWithTodelFlag(chunk->version, chunk->todel);
+		addToChecksum(checksum, chunkSetChecksumEntry(chunk->chunkid, versionWithTodelFlag, chunk->type()));
+		chunkCount++;
+		if (changed) {
+			changedChunks.push_back(ChunkWithVersionAndType(chunk->chunkid, versionWithTodelFlag, chunk->type()));
+		}
+	};
+
+	{
+		std::lock_guard<std::mutex> registryLockGuard(gChunkRegistryLock);
+		{
+			std::lock_guard<std::mutex> lock_guard(gMasterReportsLock);
+			if (gChangedChunksOverflow) {
+				gChangedChunks.clear();
+				gChangedChunksOverflow = false;
+				return false;
+			}
+			changedKeys.swap(gChangedChunks);
+		}
+		for (const auto &chunkEntry : gChunkRegistry) {
+			const Chunk *chunk = chunkEntry.second.get();
+			if (chunk->state != CH_AVAIL) {
+				recheckList.push_back(chunkEntry.first);
+				continue;
+			}
+			addChunk(chunk, changedKeys.erase(chunkEntry.first) > 0);
+		}
+	}
+
+	// as in hdd_foreach_chunk_in_bulks, wait for locked chunks to get their final versions
+	for (const auto &chunkWithType : recheckList) {
+		Chunk *chunk = hdd_chunk_find(chunkWithType.id, chunkWithType.type);
+		if (chunk) {
+			addChunk(chunk, changedKeys.erase(chunkWithType) > 0);
+			hdd_chunk_release(chunk);
+		}
+	}
+	removedChunks.assign(changedKeys.begin(), changedKeys.end());
+	return true;
+}
 
 void hdd_get_space(uint64_t *usedspace,uint64_t *totalspace,uint32_t *chunkcount,uint64_t *tdusedspace,uint64_t *tdtotalspace,uint32_t *tdchunkcount) {
 	TRACETHIS();
@@ -1225,6 +1326,95 @@ int hdd_get_load_factor() {
 	return gIoStat.getLoadFactor();
 }
 
+/* Low level disk I/O. Goes through the folder's io_uring queue if there is one. */
+
+static inline ssize_t hdd_int_pread(Chunk *c, void *buffer, size_t size, off_t offset) {
+	if (c->owner->ioqueue) {
+		return c->owner->ioqueue->pread(c->fd, buffer, size, offset);
+	}
+	return pread(c->fd, buffer, size, offset);
+}
+
+static inline ssize_t hdd_int_pwrite(Chunk *c, const void *buffer, size_t size, off_t offset) {
+	if (c->owner->ioqueue) {
+		return c->owner->ioqueue->pwrite(c->fd, buffer, size, offset);
+	}
+	return pwrite(c->fd, buffer, size, offset);
+}
+
+static inline int hdd_int_fsync(Chunk *c) {
+	if (c->owner->ioqueue) {
+		return c->owner->ioqueue->fsync(c->fd);
+	}
+	return fsync(c->fd);
+}
+
+/*
+ * Reads a contiguous region of the chunk file into many buffers with one preadv(2) (or one
+ * io_uring submission). Returns the number of bytes read, which is less than requested only
+ * at the end of file or after an error, or -1 if nothing could be read.
+ */
+static ssize_t hdd_int_preadv(Chunk *c, const struct iovec *iov, int iovcnt, off_t offset) {
+	ssize_t total = 0;
+	if (c->owner->ioqueue) {
+		std::vector<IoUringQueue::Request> requests(iovcnt);
+		off_t requestOffset = offset;
+		for (int i = 0; i < iovcnt; ++i) {
+			requests[i] = {IoUringQueue::Operation::kRead, c->fd, iov[i].iov_base,
+					(uint32_t)iov[i].iov_len, requestOffset, 0};
+			requestOffset += iov[i].iov_len;
+		}
+		c->owner->ioqueue->execute(requests.data(), requests.size());
+		for (const auto &request : requests) {
+			if (request.result < 0) {
+				errno = -request.result;
+				return total > 0 ? total : -1;
+			}
+			total += request.result;
+			if (request.result != (ssize_t)request.size) {
+				break;
+			}
+		}
+		return total;
+	}
+#ifdef LIZARDFS_HAVE_PREADV
+	std::vector<struct iovec> remaining(iov, iov + iovcnt);
+	struct iovec *first = remaining.data();
+	while (iovcnt > 0) {
+		ssize_t ret = preadv(c->fd, first, iovcnt, offset + total);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			return (ret < 0 && total == 0) ? -1 : total;
+		}
+		total += ret;
+		// Skip buffers which have been filled, a short read may leave one of them incomplete
+		while (iovcnt > 0 && (size_t)ret >= first->iov_len) {
+			ret -= first->iov_len;
+			++first;
+			--iovcnt;
+		}
+		if (iovcnt > 0) {
+			first->iov_base = (uint8_t *)first->iov_base + ret;
+			first->iov_len -= ret;
+		}
+	}
+#else
+	for (int i = 0; i < iovcnt; ++i) {
+		ssize_t ret = pread(c->fd, iov[i].iov_base, iov[i].iov_len, offset + total);
+		if (ret <= 0) {
+			return (ret < 0 && total == 0) ? -1 : total;
+		}
+		total += ret;
+		if ((size_t)ret != iov[i].iov_len) {
+			break;
+		}
+	}
+#endif
+	return total;
+}
+
 static inline int hdd_int_chunk_readcrc(MooseFSChunk *c, uint32_t chunk_version) {
 	TRACETHIS();
 	assert(c);
@@ -1268,7 +1458,7 @@ static inline int hdd_int_chunk_readcrc(MooseFSChunk *c, uint32_t chunk_version)
 	int ret;
 	{
 		FolderReadStatsUpdater updater(c->owner, c->getCrcBlockSize());
-		ret = pread(c->fd, crc_data, c->getCrcBlockSize(), c->getCrcOffset());
+		ret = hdd_int_pread(c, crc_data, c->getCrcBlockSize(), c->getCrcOffset());
 		if ((size_t)ret != c->getCrcBlockSize()) {
 			int errmem = errno;
 			lzfs_silent_errlog(LOG_WARNING,
@@ -1293,7 +1483,7 @@ static inline int chunk_writecrc(MooseFSChunk *c) {
 	uint8_t *crc_data = gOpenChunks.getResource(c->fd).crc_data();
 	{
 		FolderWriteStatsUpdater updater(c->owner, c->getCrcBlockSize());
-		ssize_t ret = pwrite(c->fd, crc_data, c->getCrcBlockSize(), c->getCrcOffset());
+		ssize_t ret = hdd_int_pwrite(c, crc_data, c->getCrcBlockSize(), c->getCrcOffset());
 		if (ret != static_cast<ssize_t>(c->getCrcBlockSize())) {
 			int errmem = errno;
 			lzfs_silent_errlog(LOG_WARNING,
@@ -1404,7 +1594,7 @@ static int hdd_io_end(Chunk *c) {
 				return LIZARDFS_ERROR_IO;
 			}
 #else
-			if (fsync(c->fd)<0) {
+			if (hdd_int_fsync(c)<0) {
 				int errmem = errno;
 				lzfs_silent_errlog(LOG_WARNING,
 						"hdd_io_end: file:%s - fsync (direct call) error", c->filename().c_str());
@@ -1522,6 +1712,20 @@ uint8_t* hdd_get_header_buffer() {
 
 #endif // LIZARDFS_HAVE_THREAD_LOCAL
 
+static ssize_t hdd_int_copy_into_buffer(Chunk *c, OutputBuffer *outputBuffer, size_t size,
+		off_t offset) {
+	if (c->owner->ioqueue) {
+		return outputBuffer->copyIntoBuffer(*c->owner->ioqueue, c->fd, size, offset);
+	}
+	return outputBuffer->copyIntoBuffer(c->fd, size, &offset);
+}
+
+/**
+ * Puts CRC and data of a block into the buffer. If the buffer allows zero copy, data of
+ * the block is not read here, but attached to the buffer as a file region. Such data
+ * is not verified by the chunkserver - clients check CRCs of all blocks they receive
+ * and damaged chunks are found by the chunk tester.
+ */
 int hdd_read_crc_and_block(Chunk* c, uint16_t blocknum, OutputBuffer* outputBuffer) {
 	LOG_AVG_TILL_END_OF_SCOPE0("hdd_read_block");
 	assert(c);
@@ -1548,10 +1752,17 @@ int hdd_read_crc_and_block(Chunk* c, uint16_t blocknum, OutputBuffer* outputBuff
 			assert(c->chunkFormat() == ChunkFormat::MOOSEFS);
 			const uint8_t *crc_data = gOpenChunks.getResource(mc->fd).crc_data() + blocknum * sizeof(uint32_t);
 			outputBuffer->copyIntoBuffer(crc_data, sizeof(uint32_t));
-			bytesRead = outputBuffer->copyIntoBuffer(c->fd, MFSBLOCKSIZE, &off);
-			if (bytesRead == toBeRead && !outputBuffer->checkCRC(bytesRead, get32bit(&crc_data))) {
-				hdd_test_chunk(ChunkWithVersionAndType{c->chunkid, c->version, c->type()});
-				return LIZARDFS_ERROR_CRC;
+			if (outputBuffer->zeroCopyAllowed()
+					&& outputBuffer->appendFileRegion(c->fd, MFSBLOCKSIZE, off)) {
+				// The block will be sent by sendfile and its CRC will be verified by the client
+				bytesRead = MFSBLOCKSIZE;
+			} else {
+				bytesRead = hdd_int_copy_into_buffer(c, outputBuffer, MFSBLOCKSIZE, off);
+				if (bytesRead == toBeRead
+						&& !outputBuffer->checkCRC(bytesRead, get32bit(&crc_data))) {
+					hdd_test_chunk(ChunkWithVersionAndType{c->chunkid, c->version, c->type()});
+					return LIZARDFS_ERROR_CRC;
+				}
 			}
 		} else do {
 			assert(c->chunkFormat() == ChunkFormat::INTERLEAVED);
@@ -1562,7 +1773,7 @@ int hdd_read_crc_and_block(Chunk* c, uint16_t blocknum, OutputBuffer* outputBuff
 			};
 			{
 				FolderReadStatsUpdater updater(c->owner, 4);
-				bytesRead = pread(c->fd, crcBuff, 4, off);
+				bytesRead = hdd_int_pread(c, crcBuff, 4, off);
 				if (bytesRead != 4) {
 					updater.markReadAsFailed();
 					break;
@@ -1573,7 +1784,7 @@ int hdd_read_crc_and_block(Chunk* c, uint16_t blocknum, OutputBuffer* outputBuff
 				// and if that's the case let's recompute the CRC
 				{
 					FolderReadStatsUpdater updater(c->owner, MFSBLOCKSIZE);
-					bytesRead = pread(c->fd, data, MFSBLOCKSIZE, off + sizeof(uint32_t));
+					bytesRead = hdd_int_pread(c, data, MFSBLOCKSIZE, off + sizeof(uint32_t));
 					if (bytesRead != MFSBLOCKSIZE) {
 						updater.markReadAsFailed();
 						break;
@@ -1585,8 +1796,23 @@ int hdd_read_crc_and_block(Chunk* c, uint16_t blocknum, OutputBuffer* outputBuff
 					memcpy(crcBuff, &emptyblockcrc, sizeof(uint32_t));
 				}
 				bytesRead = outputBuffer->copyIntoBuffer(hdd_get_block_buffer(), kHddBlockSize);
+			} else if (outputBuffer->zeroCopyAllowed()) {
+				outputBuffer->copyIntoBuffer(crcBuff, sizeof(uint32_t));
+				off += sizeof(uint32_t);
+				if (outputBuffer->appendFileRegion(c->fd, MFSBLOCKSIZE, off)) {
+					// The block will be sent by sendfile and its CRC will be verified by the client
+					bytesRead = kHddBlockSize;
+					break;
+				}
+				bytesRead = sizeof(uint32_t)
+						+ hdd_int_copy_into_buffer(c, outputBuffer, MFSBLOCKSIZE, off);
+				const uint8_t *crc = crcBuff;
+				if (bytesRead == toBeRead && !outputBuffer->checkCRC(bytesRead - 4, get32bit(&crc))) {
+					hdd_test_chunk(ChunkWithVersionAndType{c->chunkid, c->version, c->type()});
+					return LIZARDFS_ERROR_CRC;
+				}
 			} else {
-				bytesRead = outputBuffer->copyIntoBuffer(c->fd, kHddBlockSize, &off);
+				bytesRead = hdd_int_copy_into_buffer(c, outputBuffer, kHddBlockSize, off);
 				const uint8_t *crc = crcBuff;
 				if (bytesRead == toBeRead && !outputBuffer->checkCRC(bytesRead - 4, get32bit(&crc))) {
 					hdd_test_chunk(ChunkWithVersionAndType{c->chunkid, c->version, c->type()});
@@ -1607,6 +1833,83 @@ int hdd_read_crc_and_block(Chunk* c, uint16_t blocknum, OutputBuffer* outputBuff
 	return LIZARDFS_STATUS_OK;
 }
 
+/**
+ * Reads CRCs and data of blocks [firstBlock, firstBlock + count) of an open chunk. CRC and data
+ * of the i-th of them are stored in kHddBlockSize bytes at destination + i * stride.
+ * Data of all the blocks is read with a single vectored read and then all CRCs are verified.
+ */
+static int hdd_int_read_crc_and_blocks(Chunk *c, uint16_t firstBlock, uint16_t count,
+		uint8_t *destination, size_t stride) {
+	assert(c);
+	TRACETHIS3(c->chunkid, firstBlock, count);
+	if (firstBlock + count > MFSBLOCKSINCHUNK) {
+		return LIZARDFS_ERROR_BNUMTOOBIG;
+	}
+
+	uint16_t blocksInFile = c->blocks > firstBlock
+			? std::min<uint16_t>(count, c->blocks - firstBlock) : 0;
+	for (uint16_t i = blocksInFile; i < count; ++i) {
+		uint8_t *block = destination + i * stride;
+		memcpy(block, &emptyblockcrc, sizeof(uint32_t));
+		memset(block + sizeof(uint32_t), 0, MFSBLOCKSIZE);
+	}
+	if (blocksInFile == 0) {
+		return LIZARDFS_STATUS_OK;
+	}
+
+	std::vector<struct iovec> iov(blocksInFile);
+	IF_MOOSEFS_CHUNK(mc, c) {
+		// CRCs are taken from the table in memory, only data is read from the file
+		const uint8_t *crc_data = gOpenChunks.getResource(mc->fd).crc_data()
+				+ firstBlock * sizeof(uint32_t);
+		for (uint16_t i = 0; i < blocksInFile; ++i) {
+			uint8_t *block = destination + i * stride;
+			memcpy(block, crc_data + i * sizeof(uint32_t), sizeof(uint32_t));
+			iov[i].iov_base = block + sizeof(uint32_t);
+			iov[i].iov_len = MFSBLOCKSIZE;
+		}
+	} else {
+		for (uint16_t i = 0; i < blocksInFile; ++i) {
+			iov[i].iov_base = destination + i * stride;
+			iov[i].iov_len = kHddBlockSize;
+		}
+	}
+	ssize_t toBeRead = blocksInFile * iov[0].iov_len;
+	ssize_t bytesRead;
+	{
+		FolderReadStatsUpdater updater(c->owner, toBeRead);
+		bytesRead = hdd_int_preadv(c, iov.data(), iov.size(), c->getBlockOffset(firstBlock));
+		if (bytesRead != toBeRead) {
+			updater.markReadAsFailed();
+		}
+	}
+	if (bytesRead != toBeRead) {
+		hdd_error_occured(c);   // uses and preserves errno !!!
+		lzfs_silent_errlog(LOG_WARNING,
+				"read_blocks_from_chunk: file:%s - read error", c->filename().c_str());
+		hdd_report_damaged_chunk(c->chunkid, c->type());
+		return LIZARDFS_ERROR_IO;
+	}
+
+	for (uint16_t i = 0; i < blocksInFile; ++i) {
+		uint8_t *block = destination + i * stride;
+		const uint8_t *crcPtr = block;
+		uint32_t crc = get32bit(&crcPtr);
+		if (crc == 0 && c->chunkFormat() == ChunkFormat::INTERLEAVED) {
+			// Possibly an empty block of a sparse file, which has no CRC written
+			recompute_crc_if_block_empty(block + sizeof(uint32_t), crc);
+			uint8_t *crcWritePtr = block;
+			put32bit(&crcWritePtr, crc);
+			continue;
+		}
+		if (mycrc32(0, block + sizeof(uint32_t), MFSBLOCKSIZE) != crc) {
+			hdd_test_chunk(ChunkWithVersionAndType{c->chunkid, c->version, c->type()});
+			return LIZARDFS_ERROR_CRC;
+		}
+	}
+	return LIZARDFS_STATUS_OK;
+}
+
 static void hdd_prefetch(Chunk &chunk, uint16_t first_block, uint32_t block_count) {
 	if (block_count > 0) {
 		auto blockSize = chunk.chunkFormat() == ChunkFormat::MOOSEFS ?
@@ -1659,6 +1962,31 @@ int hdd_prefetch_blocks(uint64_t chunkid, ChunkPartType chunk_type, uint32_t fir
 	return status;
 }
 
+/**
+ * Asks OS for an appropriate read ahead and (if requested and needed) reads some blocks
+ * that were possibly skipped in a sequential file read.
+ */
+static void hdd_int_read_behind_and_ahead(Chunk *c, uint16_t block, uint16_t blockCount,
+		uint32_t maxBlocksToBeReadBehind, uint32_t blocksToBeReadAhead) {
+	if (c->blockExpectedToBeReadNext < block && maxBlocksToBeReadBehind > 0) {
+		// We were asked to read some possibly skipped blocks.
+		uint16_t firstBlockToRead = c->blockExpectedToBeReadNext;
+		// Try to prevent all possible overflows:
+		if (firstBlockToRead + maxBlocksToBeReadBehind < block) {
+			firstBlockToRead = block - maxBlocksToBeReadBehind;
+		}
+		sassert(firstBlockToRead < block);
+		hdd_prefetch(*c, firstBlockToRead, blocksToBeReadAhead + block - firstBlockToRead);
+		std::vector<uint8_t> buffer(kHddBlockSize * (block - firstBlockToRead));
+		hdd_int_read_crc_and_blocks(c, firstBlockToRead, block - firstBlockToRead,
+				buffer.data(), kHddBlockSize);
+	} else {
+		hdd_prefetch(*c, block, blocksToBeReadAhead);
+	}
+	c->blockExpectedToBeReadNext = std::max<uint16_t>(block + blockCount,
+			c->blockExpectedToBeReadNext);
+}
+
 int hdd_read(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
 		uint32_t offset, uint32_t size, uint32_t maxBlocksToBeReadBehind,
 		uint32_t blocksToBeReadAhead, OutputBuffer* outputBuffer) {
@@ -1679,28 +2007,7 @@ int hdd_read(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
 		return LIZARDFS_ERROR_WRONGVERSION;
 	}
 	uint16_t block = offset / MFSBLOCKSIZE;
-
-	// Ask OS for an appropriate read ahead and (if requested and needed) read some blocks
-	// that were possibly skipped in a sequential file read
-	if (c->blockExpectedToBeReadNext < block && maxBlocksToBeReadBehind > 0) {
-		// We were asked to read some possibly skipped blocks.
-		uint16_t firstBlockToRead = c->blockExpectedToBeReadNext;
-		// Try to prevent all possible overflows:
-		if (firstBlockToRead + maxBlocksToBeReadBehind < block) {
-			firstBlockToRead = block - maxBlocksToBeReadBehind;
-		}
-		sassert(firstBlockToRead < block);
-		hdd_prefetch(*c, firstBlockToRead, blocksToBeReadAhead + block - firstBlockToRead);
-		OutputBuffer buffer = OutputBuffer(
-				kHddBlockSize * (block - firstBlockToRead));
-		for (uint16_t b = firstBlockToRead; b < block; ++b) {
-			hdd_read_crc_and_block(c, b, &buffer);
-		}
-	} else {
-		hdd_prefetch(*c, block, blocksToBeReadAhead);
-	}
-	c->blockExpectedToBeReadNext = std::max<uint16_t>(block + 1, c->blockExpectedToBeReadNext);
-
+	hdd_int_read_behind_and_ahead(c, block, 1, maxBlocksToBeReadBehind, blocksToBeReadAhead);
 
 	// Put checksum of the requested data followed by data itself into buffer.
 	// If possible (in case when whole block is read) try to put data directly
@@ -1726,6 +2033,36 @@ int hdd_read(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
 	return status;
 }
 
+int hdd_read_blocks(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
+		uint16_t firstBlock, uint16_t blockCount, uint32_t maxBlocksToBeReadBehind,
+		uint32_t blocksToBeReadAhead, OutputBuffer* outputBuffer, uint32_t prefixSize) {
+	LOG_AVG_TILL_END_OF_SCOPE0("hdd_read_blocks");
+	TRACETHIS3(chunkid, firstBlock, blockCount);
+
+	const size_t stride = prefixSize + kHddBlockSize;
+	if (blockCount == 0 || outputBuffer->bytesInABuffer() != blockCount * stride) {
+		return LIZARDFS_ERROR_WRONGSIZE;
+	}
+
+	Chunk* c = hdd_chunk_find(chunkid, chunkType);
+	if (c==NULL) {
+		return LIZARDFS_ERROR_NOCHUNK;
+	}
+	if (c->version!=version && version>0) {
+		hdd_chunk_release(c);
+		return LIZARDFS_ERROR_WRONGVERSION;
+	}
+	hdd_int_read_behind_and_ahead(c, firstBlock, blockCount, maxBlocksToBeReadBehind,
+			blocksToBeReadAhead);
+
+	int status = hdd_int_read_crc_and_blocks(c, firstBlock, blockCount,
+			outputBuffer->data() + prefixSize, stride);
+
+	PRINTTHIS(status);
+	hdd_chunk_release(c);
+	return status;
+}
+
 /**
  * A way of handling sparse files. If block is filled with zeros and crcBuffer is filled with
  * zeros as well, rewrite the crcBuffer so that it stores proper CRC.
@@ -1751,7 +2088,7 @@ int hdd_int_read_block_and_crc(Chunk* c, uint8_t* blockBuffer, uint16_t blocknum
 		memcpy(blockBuffer, crc_data + blocknum * sizeof(uint32_t), sizeof(uint32_t));
 		{
 			FolderReadStatsUpdater updater(mc->owner, MFSBLOCKSIZE);
-			if (pread(mc->fd, blockBuffer + sizeof(uint32_t), MFSBLOCKSIZE, mc->getBlockOffset(blocknum))
+			if (hdd_int_pread(mc, blockBuffer + sizeof(uint32_t), MFSBLOCKSIZE, mc->getBlockOffset(blocknum))
 					!= MFSBLOCKSIZE) {
 				hdd_error_occured(mc);   // uses and preserves errno !!!
 				lzfs_silent_errlog(LOG_WARNING,
@@ -1766,7 +2103,7 @@ int hdd_int_read_block_and_crc(Chunk* c, uint8_t* blockBuffer, uint16_t blocknum
 		sassert(c->chunkFormat() == ChunkFormat::INTERLEAVED);
 		{
 			FolderReadStatsUpdater updater(c->owner, kHddBlockSize);
-			if (pread(c->fd, blockBuffer, kHddBlockSize, c->getBlockOffset(blocknum))
+			if (hdd_int_pread(c, blockBuffer, kHddBlockSize, c->getBlockOffset(blocknum))
 					!= kHddBlockSize) {
 				hdd_error_occured(c);   // uses and preserves errno !!!
 				lzfs_silent_errlog(LOG_WARNING,
@@ -1841,7 +2178,7 @@ int hdd_int_write_partial_block_and_crc(
 		sassert(c->chunkFormat() == ChunkFormat::MOOSEFS);
 		{
 			FolderWriteStatsUpdater updater(mc->owner, size);
-			auto ret = pwrite(mc->fd, buffer, size, mc->getBlockOffset(blockNum) + offset);
+			auto ret = hdd_int_pwrite(mc, buffer, size, mc->getBlockOffset(blockNum) + offset);
 			if (ret != size) {
 				hdd_error_occured(mc);   // uses and preserves errno !!!
 				lzfs_silent_errlog(LOG_WARNING,
@@ -1855,6 +2192,32 @@ int hdd_int_write_partial_block_and_crc(
 		uint8_t *crc_data = gOpenChunks.getResource(c->fd).crc_data();
 		memcpy(crc_data + blockNum * sizeof(uint32_t), crcBuff, crcSize);
 		return size;
+	} else if (c->owner->ioqueue) {
+		sassert(c->chunkFormat() == ChunkFormat::INTERLEAVED);
+		// CRC and data go to the disk's queue in a single submission
+		IoUringQueue::Request requests[2] = {
+			{IoUringQueue::Operation::kWrite, c->fd, const_cast<uint8_t *>(crcBuff),
+					(uint32_t)crcSize, c->getBlockOffset(blockNum), 0},
+			{IoUringQueue::Operation::kWrite, c->fd, const_cast<uint8_t *>(buffer),
+					size, c->getBlockOffset(blockNum) + offset + crcSize, 0}
+		};
+		{
+			FolderWriteStatsUpdater updater(c->owner, crcSize + size);
+			c->owner->ioqueue->execute(requests, 2);
+			for (const auto &request : requests) {
+				if (request.result != (ssize_t)request.size) {
+					errno = request.result < 0 ? -request.result : EIO;
+					hdd_error_occured(c);   // uses and preserves errno !!!
+					lzfs_silent_errlog(LOG_WARNING,
+							"%s: file:%s - write error", errorMsg, c->filename().c_str());
+					hdd_report_damaged_chunk(c->chunkid, c->type());
+					updater.markWriteAsFailed();
+					return -1;
+				}
+			}
+		}
+		hdd_int_punch_holes(c, buffer, c->getBlockOffset(blockNum) + offset + crcSize, size);
+		return crcSize + size;
 	} else {
 		sassert(c->chunkFormat() == ChunkFormat::INTERLEAVED);
 		{
@@ -2072,6 +2435,7 @@ static int hdd_chunk_overwrite_version(Chunk* c, uint32_t newVersion) {
 		hdd_stats_overheadwrite(buffer.size());
 	}
 	c->version = newVersion;
+	hdd_report_changed_chunk(c);
 	return LIZARDFS_STATUS_OK;
 }
 
@@ -2251,6 +2615,7 @@ static int hdd_int_duplicate(uint64_t chunkId, uint32_t chunkVersion, uint32_t c
 	sassert(c->chunkFormat() == oc->chunkFormat());
 
 	if (chunkNewVersion != chunkVersion) {
+		hdd_report_changed_chunk(c);
 		if (c->renameChunkFile(chunkNewVersion) < 0) {
 			hdd_error_occured(oc);  // uses and preserves errno !!!
 			lzfs_silent_errlog(LOG_WARNING,
@@ -2394,6 +2759,7 @@ int hdd_int_version(Chunk *chunk, uint32_t version, uint32_t newversion) {
 	if (chunk->version != version && version > 0) {
 		return LIZARDFS_ERROR_WRONGVERSION;
 	}
+	hdd_report_changed_chunk(chunk);
 	if (chunk->renameChunkFile(newversion) < 0) {
 		hdd_error_occured(chunk);  // uses and preserves errno !!!
 		lzfs_silent_errlog(LOG_WARNING, "set_chunk_version: file:%s - rename error",
@@ -2462,6 +2828,7 @@ static int hdd_int_truncate(uint64_t chunkId, ChunkPartType chunkType, uint32_t
 		hdd_chunk_release(c);
 		return LIZARDFS_ERROR_WRONGVERSION;
 	}
+	hdd_report_changed_chunk(c);
 	if (c->renameChunkFile(newVersion) < 0) {
 		hdd_error_occured(c);   // uses and preserves errno !!!
 		lzfs_silent_errlog(LOG_WARNING,
@@ -2636,6 +3003,7 @@ static int hdd_int_duptrunc(uint64_t chunkId, uint32_t chunkVersion, uint32_t ch
 	}
 
 	if (chunkNewVersion!=chunkVersion) {
+		hdd_report_changed_chunk(oc);
 		if (oc->renameChunkFile(chunkNewVersion) < 0) {
 			hdd_error_occured(oc);  // uses and preserves errno !!!
 			lzfs_silent_errlog(LOG_WARNING,
@@ -3486,8 +3854,24 @@ void *hdd_folder_scan(void *arg) {
 		}
 	}
 
-	hdd_folder_scan_layout(f, begin_time, 1);
-	hdd_folder_scan_layout(f, begin_time, 0);
+	bool indexed = false;
+	if (todel == 0 && gUseChunkIndex) {
+		indexed = ChunkIndex::read(f->path, [f](const ChunkIndex::Entry &entry) {
+			hdd_add_chunk(f, Chunk::generateFilename(f->path, entry.chunkId, entry.type,
+			                                         entry.format, entry.version),
+			              entry.chunkId, entry.format, entry.version, entry.type, f->todel,
+			              Chunk::kCurrentDirectoryLayout);
+		});
+		// The index describes the folder as it was at the moment of the last clean shutdown,
+		// it can't be used again after any chunk is modified.
+		ChunkIndex::remove(f->path);
+	}
+	if (indexed) {
+		lzfs_pretty_syslog(LOG_NOTICE, "scanning folder %s: loaded chunk index", f->path);
+	} else {
+		hdd_folder_scan_layout(f, begin_time, 1);
+		hdd_folder_scan_layout(f, begin_time, 0);
+	}
 	hdd_testshuffle(f);
 	gScansInProgress--;
 
@@ -3533,11 +3917,42 @@ void hdd_free_resources_thread() {
 	}
 }
 
+/*! \brief Writes chunk indexes of folders which were fully scanned.
+ *
+ * Must be called when no other thread uses the chunk registry.
+ */
+static void hdd_write_chunk_indexes(const std::vector<folder *> &scannedFolders) {
+	std::map<folder *, std::vector<ChunkIndex::Entry>> entries;
+	for (folder *f : scannedFolders) {
+		entries[f];
+	}
+	for (const auto &chunkEntry : gChunkRegistry) {
+		Chunk *c = chunkEntry.second.get();
+		auto it = entries.find(c->owner);
+		if (it == entries.end()) {
+			continue;
+		}
+		if (c->state != CH_AVAIL || c->filenameLayout() != Chunk::kCurrentDirectoryLayout) {
+			// such folder has to be scanned on the next start
+			entries.erase(it);
+			continue;
+		}
+		it->second.push_back({c->chunkid, c->version, c->type(), c->chunkFormat()});
+	}
+	for (const auto &folderEntries : entries) {
+		if (ChunkIndex::write(folderEntries.first->path, folderEntries.second)) {
+			lzfs_pretty_syslog(LOG_INFO, "hdd_term: written index of %zu chunks in folder %s",
+			                   folderEntries.second.size(), folderEntries.first->path);
+		}
+	}
+}
+
 void hdd_term(void) {
 	TRACETHIS();
 	uint32_t i;
 	folder *f,*fn;
 	cntcond *cc,*ccn;
+	std::vector<folder *> scannedFolders;
 
 	i = term.exchange(1); // if term is non zero here then it means that threads have not been started, so do not join with them
 	if (i==0) {
@@ -3554,6 +3969,10 @@ void hdd_term(void) {
 		std::lock_guard<std::mutex> folderlock_guard(folderlock);
 		i = 0;
 		for (f = folderhead; f; f = f->next) {
+			if (gUseChunkIndex && !f->damaged && f->todel == 0 && f->toremove == 0
+					&& (f->scanstate == SCST_WORKING || f->scanstate == SCST_SENDNEEDED)) {
+				scannedFolders.push_back(f);
+			}
 			if (f->scanstate == SCST_SCANINPROGRESS) {
 				f->scanstate = SCST_SCANTERMINATE;
 			}
@@ -3602,6 +4021,7 @@ void hdd_term(void) {
 			lzfs::log_warn("hdd_term: locked chunk !!! (chunkid: {:#04x}, chunktype: {})", c->chunkid, c->type().toString());
 		}
 	}
+	hdd_write_chunk_indexes(scannedFolders);
 	// Delete chunks even not in AVAILABLE state here, as all threads using chunk objects should already be joined
 	// (by this function and other cleanup functions of other chunkserver modules that are registered on eventloop termination)
 	// This function should always be executed after all other chunkserver modules' (that use chunk objects) cleanup functions
@@ -3876,6 +4296,15 @@ int hdd_parseline(char *hddcfgline) {
 		f->devid = sb.st_dev;
 		f->lockinode = sb.st_ino;
 	}
+	if (gUseIoUring && !damaged) {
+		try {
+			f->ioqueue.reset(new IoUringQueue(gIoUringQueueDepth));
+		} catch (const IoUringException &ex) {
+			lzfs_pretty_syslog(LOG_WARNING,
+					"hdd space manager: can't set up io_uring for folder %s, "
+					"using synchronous I/O: %s", f->path, ex.what());
+		}
+	}
 	f->testhead = NULL;
 	f->testtail = &(f->testhead);
 	f->carry = (double)(random()&0x7FFFFFFF)/(double)(0x7FFFFFFF);
@@ -4027,6 +4456,24 @@ int hdd_init(void) {
 	put32bit(&emptyblockcrc_buf, mycrc32_zeroblock(0,MFSBLOCKSIZE));
 
 	PerformFsync = cfg_getuint32("PERFORM_FSYNC", 1);
+	gUseChunkIndex = cfg_getuint32("HDD_CHUNK_INDEX", 1);
+
+	std::string ioEngine = cfg_get("HDD_IO_ENGINE", std::string("sync"));
+	if (ioEngine == "io_uring") {
+		if (IoUringQueue::isSupported()) {
+			gUseIoUring = true;
+			gIoUringQueueDepth = cfg_get_minmaxvalue<uint32_t>("HDD_IO_URING_QUEUE_DEPTH",
+					IoUringQueue::kDefaultQueueDepth, 1, 4096);
+			lzfs_pretty_syslog(LOG_INFO, "hdd space manager: using io_uring disk I/O "
+					"(queue depth %u per folder)", gIoUringQueueDepth);
+		} else {
+			lzfs_pretty_syslog(LOG_WARNING, "%s: HDD_IO_ENGINE = io_uring is not supported "
+					"by this system - using synchronous I/O", cfg_filename().c_str());
+		}
+	} else if (ioEngine != "sync") {
+		lzfs_pretty_syslog(LOG_WARNING, "%s: unknown HDD_IO_ENGINE '%s' - using synchronous I/O",
+				cfg_filename().c_str(), ioEngine.c_str());
+	}
 
 	uint64_t leaveSpaceDefaultDefaultValue = 0;
 	sassert(hdd_size_parse(gLeaveSpaceDefaultDefaultStrValue, &leaveSpaceDefaultDefaultValue) >= 0);
@@ -51,6 +51,18 @@ const std::size_t CHUNK_BULK_SIZE = 1000;
 void hdd_foreach_chunk_in_bulks(std::function<void(std::vector<ChunkWithVersionAndType>&)> chunk_bulk_callback,
 		std::size_t chunk_bulk_size = CHUNK_BULK_SIZE);
 
+/// Starts recording chunks changed since the full list of chunks was sent to master.
+void hdd_reset_changed_chunks();
+
+/** \brief Gets chunks changed since the last registration and starts recording again.
+ *
+ * Also computes the checksum (see chunkSetChecksumEntry) and the number of all chunks,
+ * which lets master verify its view after applying the changes.
+ * \return false if too many chunks changed and the full list of chunks has to be sent
+ */
+bool hdd_get_changed_chunks(std::vector<ChunkWithVersionAndType> &changedChunks,
+		std::vector<ChunkWithType> &removedChunks, uint64_t &checksum, uint32_t &chunkCount);
+
 int hdd_spacechanged(void);
 void hdd_get_space(uint64_t *usedspace,uint64_t *totalspace,uint32_t *chunkcount,uint64_t *tdusedspace,uint64_t *tdtotalspace,uint32_t *tdchunkcount);
 int hdd_get_load_factor();
@@ -64,6 +76,14 @@ int hdd_prefetch_blocks(uint64_t chunkid, ChunkPartType chunkType, uint32_t firs
 int hdd_read(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
 		uint32_t offset, uint32_t size, uint32_t maxBlocksToBeReadBehind,
 		uint32_t blocksToBeReadAhead, OutputBuffer* outputBuffer);
+/*
+ * Reads whole blocks [firstBlock, firstBlock + blockCount) with a single vectored read.
+ * The output buffer has to contain blockCount fragments, each of them made of prefixSize bytes
+ * (e.g. a packet header, filled by the caller) followed by space for CRC and data of a block.
+ */
+int hdd_read_blocks(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
+		uint16_t firstBlock, uint16_t blockCount, uint32_t maxBlocksToBeReadBehind,
+		uint32_t blocksToBeReadAhead, OutputBuffer* outputBuffer, uint32_t prefixSize);
 int hdd_write(Chunk* chunk, uint32_t version,
 		uint16_t blocknum, uint32_t offset, uint32_t size, uint32_t crc, const uint8_t* buffer);
 int hdd_write(uint64_t chunkid, uint32_t version, ChunkPartType chunkType,
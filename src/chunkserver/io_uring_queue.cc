@@ -0,0 +1,377 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "chunkserver/io_uring_queue.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "common/massert.h"
+#include "common/small_vector.h"
+
+#ifdef LIZARDFS_HAVE_LINUX_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params *params) {
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+	return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+template <typename T>
+T *ring_field(void *ring, uint32_t offset) {
+	return reinterpret_cast<T *>(static_cast<uint8_t *>(ring) + offset);
+}
+
+} // anonymous namespace
+
+struct IoUringQueue::Batch {
+	std::mutex mutex;
+	std::condition_variable completed;
+	unsigned remaining;
+};
+
+/// Passed to the kernel as user_data of each submission queue entry.
+struct IoUringQueue::PendingRequest {
+	Request *request;
+	Batch *batch;
+};
+
+IoUringQueue::IoUringQueue(unsigned queueDepth)
+		: ringFd_(-1),
+		  entries_(0),
+		  sqRing_(MAP_FAILED),
+		  sqRingSize_(0),
+		  cqRing_(MAP_FAILED),
+		  cqRingSize_(0),
+		  sqes_(MAP_FAILED),
+		  sqesSize_(0),
+		  inFlight_(0),
+		  terminate_(false) {
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ringFd_ = sys_io_uring_setup(std::max(queueDepth, 1U), &params);
+	if (ringFd_ < 0) {
+		throw IoUringException(std::string("io_uring_setup failed: ") + strerror(errno));
+	}
+	entries_ = params.sq_entries;
+
+	sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMmap) {
+		sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+	}
+	sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ringFd_, IORING_OFF_SQ_RING);
+	if (sqRing_ == MAP_FAILED) {
+		int err = errno;
+		close(ringFd_);
+		throw IoUringException(std::string("io_uring submission ring mmap failed: ") +
+				strerror(err));
+	}
+	if (singleMmap) {
+		cqRing_ = sqRing_;
+	} else {
+		cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ringFd_, IORING_OFF_CQ_RING);
+		if (cqRing_ == MAP_FAILED) {
+			int err = errno;
+			munmap(sqRing_, sqRingSize_);
+			close(ringFd_);
+			throw IoUringException(std::string("io_uring completion ring mmap failed: ") +
+					strerror(err));
+		}
+	}
+	sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+	sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ringFd_, IORING_OFF_SQES);
+	if (sqes_ == MAP_FAILED) {
+		int err = errno;
+		if (!singleMmap) {
+			munmap(cqRing_, cqRingSize_);
+		}
+		munmap(sqRing_, sqRingSize_);
+		close(ringFd_);
+		throw IoUringException(std::string("io_uring entries mmap failed: ") + strerror(err));
+	}
+
+	sqTail_ = ring_field<unsigned>(sqRing_, params.sq_off.tail);
+	sqMask_ = ring_field<unsigned>(sqRing_, params.sq_off.ring_mask);
+	sqArray_ = ring_field<unsigned>(sqRing_, params.sq_off.array);
+	cqHead_ = ring_field<unsigned>(cqRing_, params.cq_off.head);
+	cqTail_ = ring_field<unsigned>(cqRing_, params.cq_off.tail);
+	cqMask_ = ring_field<unsigned>(cqRing_, params.cq_off.ring_mask);
+	cqes_ = ring_field<io_uring_cqe>(cqRing_, params.cq_off.cqes);
+
+	completionThread_ = std::thread(&IoUringQueue::completionLoop, this);
+}
+
+IoUringQueue::~IoUringQueue() {
+	// A NOP with empty user_data wakes up the completion thread so it can notice termination
+	terminate_ = true;
+	{
+		std::unique_lock<std::mutex> lock(submitMutex_);
+		spaceAvailable_.wait(lock, [this]() { return inFlight_ < entries_; });
+		unsigned tail = *sqTail_;
+		unsigned index = tail & *sqMask_;
+		io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes_) + index;
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_NOP;
+		sqe->user_data = 0;
+		sqArray_[index] = index;
+		__atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+		++inFlight_;
+		while (sys_io_uring_enter(ringFd_, 1, 0, 0) < 0 && (errno == EINTR || errno == EAGAIN)) {
+		}
+	}
+	completionThread_.join();
+	munmap(sqes_, sqesSize_);
+	if (cqRing_ != sqRing_) {
+		munmap(cqRing_, cqRingSize_);
+	}
+	munmap(sqRing_, sqRingSize_);
+	close(ringFd_);
+}
+
+bool IoUringQueue::isSupported() {
+	static const bool supported = []() {
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		int fd = sys_io_uring_setup(1, &params);
+		if (fd < 0) {
+			return false;
+		}
+		close(fd);
+		return true;
+	}();
+	return supported;
+}
+
+void IoUringQueue::execute(Request *requests, unsigned count) {
+	if (count == 0) {
+		return;
+	}
+
+	Batch batch;
+	batch.remaining = count;
+	small_vector<PendingRequest, 8> pending(count);
+
+	// Requests that do not fit into the ring at once are submitted in ring-sized portions
+	unsigned submitted = 0;
+	while (submitted < count) {
+		std::unique_lock<std::mutex> lock(submitMutex_);
+		spaceAvailable_.wait(lock, [this]() { return inFlight_ < entries_; });
+		unsigned portion = std::min(count - submitted, entries_ - inFlight_);
+		unsigned tail = *sqTail_;
+		for (unsigned i = 0; i < portion; ++i) {
+			Request &request = requests[submitted + i];
+			pending[submitted + i] = PendingRequest{&request, &batch};
+			unsigned index = (tail + i) & *sqMask_;
+			io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes_) + index;
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->fd = request.fd;
+			switch (request.operation) {
+			case Operation::kRead:
+				sqe->opcode = IORING_OP_READ;
+				sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+				sqe->len = request.size;
+				sqe->off = request.offset;
+				break;
+			case Operation::kWrite:
+				sqe->opcode = IORING_OP_WRITE;
+				sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+				sqe->len = request.size;
+				sqe->off = request.offset;
+				break;
+			case Operation::kFsync:
+				sqe->opcode = IORING_OP_FSYNC;
+				break;
+			}
+			sqe->user_data = reinterpret_cast<uint64_t>(&pending[submitted + i]);
+			sqArray_[index] = index;
+		}
+		__atomic_store_n(sqTail_, tail + portion, __ATOMIC_RELEASE);
+
+		unsigned accepted = 0;
+		while (accepted < portion) {
+			int ret = sys_io_uring_enter(ringFd_, portion - accepted, 0, 0);
+			if (ret >= 0) {
+				accepted += ret;
+			} else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				break;
+			}
+		}
+		if (accepted < portion) {
+			// Take back entries which the kernel refused and fail them
+			int err = errno;
+			__atomic_store_n(sqTail_, tail + accepted, __ATOMIC_RELEASE);
+			for (unsigned i = accepted; i < portion; ++i) {
+				requests[submitted + i].result = -err;
+			}
+			std::lock_guard<std::mutex> batchLock(batch.mutex);
+			batch.remaining -= portion - accepted;
+		}
+		inFlight_ += accepted;
+		submitted += portion;
+	}
+
+	{
+		std::unique_lock<std::mutex> batchLock(batch.mutex);
+		batch.completed.wait(batchLock, [&batch]() { return batch.remaining == 0; });
+	}
+	retryShortTransfers(requests, count);
+}
+
+void IoUringQueue::completionLoop() {
+	for (;;) {
+		unsigned head = *cqHead_;
+		unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			sys_io_uring_enter(ringFd_, 0, 1, IORING_ENTER_GETEVENTS);
+			continue;
+		}
+		bool exitRequested = false;
+		unsigned reaped = 0;
+		for (; head != tail; ++head, ++reaped) {
+			const io_uring_cqe &cqe = static_cast<io_uring_cqe *>(cqes_)[head & *cqMask_];
+			if (cqe.user_data == 0) {
+				exitRequested = true;
+				continue;
+			}
+			PendingRequest *pending = reinterpret_cast<PendingRequest *>(cqe.user_data);
+			pending->request->result = cqe.res;
+			Batch *batch = pending->batch;
+			std::lock_guard<std::mutex> batchLock(batch->mutex);
+			if (--batch->remaining == 0) {
+				batch->completed.notify_one();
+			}
+		}
+		__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+		{
+			std::lock_guard<std::mutex> lock(submitMutex_);
+			inFlight_ -= reaped;
+		}
+		spaceAvailable_.notify_all();
+		if (exitRequested && terminate_) {
+			return;
+		}
+	}
+}
+
+#else // LIZARDFS_HAVE_LINUX_IO_URING_H
+
+struct IoUringQueue::Batch {};
+
+IoUringQueue::IoUringQueue(unsigned) {
+	throw IoUringException("io_uring is not supported on this platform");
+}
+
+IoUringQueue::~IoUringQueue() {
+}
+
+bool IoUringQueue::isSupported() {
+	return false;
+}
+
+void IoUringQueue::execute(Request *, unsigned) {
+	mabort("io_uring is not supported on this platform");
+}
+
+void IoUringQueue::completionLoop() {
+}
+
+#endif // LIZARDFS_HAVE_LINUX_IO_URING_H
+
+void IoUringQueue::retryShortTransfers(Request *requests, unsigned count) {
+	for (unsigned i = 0; i < count; ++i) {
+		Request &request = requests[i];
+		if (request.operation == Operation::kFsync) {
+			if (request.result == -EINTR || request.result == -EAGAIN) {
+				request.result = ::fsync(request.fd) < 0 ? -errno : 0;
+			}
+			continue;
+		}
+		if (request.result == -EINTR || request.result == -EAGAIN) {
+			request.result = 0;
+		} else if (request.result < 0 || request.result >= (ssize_t)request.size) {
+			continue;
+		} else if (request.result == 0 && request.operation == Operation::kRead) {
+			continue; // end of file
+		}
+		// Finish partial transfers with plain syscalls, they are rare for regular files
+		uint8_t *buffer = static_cast<uint8_t *>(request.buffer);
+		while (request.result < (ssize_t)request.size) {
+			ssize_t done = request.result;
+			ssize_t ret = request.operation == Operation::kRead
+					? ::pread(request.fd, buffer + done, request.size - done, request.offset + done)
+					: ::pwrite(request.fd, buffer + done, request.size - done, request.offset + done);
+			if (ret < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				request.result = done > 0 ? done : -errno;
+				break;
+			} else if (ret == 0) {
+				break;
+			}
+			request.result += ret;
+		}
+	}
+}
+
+ssize_t IoUringQueue::pread(int fd, void *buffer, size_t size, off_t offset) {
+	Request request{Operation::kRead, fd, buffer, static_cast<uint32_t>(size), offset, 0};
+	execute(&request, 1);
+	if (request.result < 0) {
+		errno = -request.result;
+		return -1;
+	}
+	return request.result;
+}
+
+ssize_t IoUringQueue::pwrite(int fd, const void *buffer, size_t size, off_t offset) {
+	Request request{Operation::kWrite, fd, const_cast<void *>(buffer),
+			static_cast<uint32_t>(size), offset, 0};
+	execute(&request, 1);
+	if (request.result < 0) {
+		errno = -request.result;
+		return -1;
+	}
+	return request.result;
+}
+
+int IoUringQueue::fsync(int fd) {
+	Request request{Operation::kFsync, fd, nullptr, 0, 0, 0};
+	execute(&request, 1);
+	if (request.result < 0) {
+		errno = -request.result;
+		return -1;
+	}
+	return 0;
+}
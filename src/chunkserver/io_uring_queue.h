@@ -0,0 +1,122 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "common/exception.h"
+
+LIZARDFS_CREATE_EXCEPTION_CLASS(IoUringException, Exception);
+
+/**
+ * Per-disk io_uring submission queue.
+ *
+ * Any number of threads (typically bgjobs workers) may submit requests concurrently.
+ * Requests are pushed to one shared submission ring and a single completion thread reaps
+ * them, so the number of requests in flight for a disk is bounded only by the ring size
+ * and not by the number of threads waiting for them.
+ *
+ * All public operations are synchronous from the caller's point of view: they return
+ * after every request passed to them has completed. Several requests passed in one call
+ * (e.g. CRC and data of one block) are submitted with a single io_uring_enter(2).
+ */
+class IoUringQueue {
+public:
+	enum class Operation : uint8_t {
+		kRead,
+		kWrite,
+		kFsync
+	};
+
+	struct Request {
+		Operation operation;
+		int fd;
+		void *buffer;
+		uint32_t size;
+		off_t offset;
+		/// Number of bytes transferred (or 0 for fsync) on success, -errno on failure.
+		ssize_t result;
+	};
+
+	static constexpr unsigned kDefaultQueueDepth = 64;
+
+	/// Throws IoUringException if the ring cannot be created.
+	explicit IoUringQueue(unsigned queueDepth = kDefaultQueueDepth);
+	~IoUringQueue();
+
+	IoUringQueue(const IoUringQueue &) = delete;
+	IoUringQueue &operator=(const IoUringQueue &) = delete;
+
+	/// Returns true if io_uring is available on this system.
+	static bool isSupported();
+
+	/// Submits all requests at once and waits until each of them completes.
+	void execute(Request *requests, unsigned count);
+
+	/// pread(2)-like wrapper, returns -1 and sets errno on failure.
+	ssize_t pread(int fd, void *buffer, size_t size, off_t offset);
+
+	/// pwrite(2)-like wrapper, returns -1 and sets errno on failure.
+	ssize_t pwrite(int fd, const void *buffer, size_t size, off_t offset);
+
+	/// fsync(2)-like wrapper, returns -1 and sets errno on failure.
+	int fsync(int fd);
+
+	unsigned queueDepth() const {
+		return entries_;
+	}
+
+private:
+	struct Batch;
+	struct PendingRequest;
+
+	void completionLoop();
+	void retryShortTransfers(Request *requests, unsigned count);
+
+	int ringFd_;
+	unsigned entries_;
+
+	void *sqRing_;
+	size_t sqRingSize_;
+	void *cqRing_;
+	size_t cqRingSize_;
+	void *sqes_;
+	size_t sqesSize_;
+
+	unsigned *sqTail_;
+	unsigned *sqMask_;
+	unsigned *sqArray_;
+	unsigned *cqHead_;
+	unsigned *cqTail_;
+	unsigned *cqMask_;
+	void *cqes_;
+
+	std::mutex submitMutex_;
+	std::condition_variable spaceAvailable_;
+	unsigned inFlight_;
+	std::atomic<bool> terminate_;
+	std::thread completionThread_;
+};
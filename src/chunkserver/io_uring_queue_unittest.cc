@@ -0,0 +1,99 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "chunkserver/io_uring_queue.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "unittests/TemporaryDirectory.h"
+
+TEST(IoUringQueueTests, WriteReadAndSync) {
+	if (!IoUringQueue::isSupported()) {
+		return; // io_uring is not available in this environment
+	}
+	TemporaryDirectory temp("/tmp", this->test_info_->name());
+	std::string fileName(temp.name() + "/file");
+	int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_NE(fd, -1);
+
+	IoUringQueue queue(4);
+	std::vector<uint8_t> data(65536);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = i * 7;
+	}
+	ASSERT_EQ(queue.pwrite(fd, data.data(), data.size(), 4), (ssize_t)data.size());
+	ASSERT_EQ(queue.fsync(fd), 0);
+
+	std::vector<uint8_t> readBack(data.size());
+	ASSERT_EQ(queue.pread(fd, readBack.data(), readBack.size(), 4), (ssize_t)readBack.size());
+	EXPECT_EQ(data, readBack);
+
+	// Reading past the end of the file is a short read, not an error
+	EXPECT_EQ(queue.pread(fd, readBack.data(), readBack.size(), 1024), (ssize_t)data.size() + 4 - 1024);
+	close(fd);
+}
+
+TEST(IoUringQueueTests, BatchLargerThanQueueFromManyThreads) {
+	if (!IoUringQueue::isSupported()) {
+		return; // io_uring is not available in this environment
+	}
+	TemporaryDirectory temp("/tmp", this->test_info_->name());
+	std::string fileName(temp.name() + "/file");
+	int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_NE(fd, -1);
+
+	const unsigned kBlocks = 64;
+	const unsigned kBlockSize = 4096;
+	std::vector<uint8_t> data(kBlocks * kBlockSize);
+	for (unsigned i = 0; i < kBlocks; ++i) {
+		std::fill(data.begin() + i * kBlockSize, data.begin() + (i + 1) * kBlockSize, i);
+	}
+	ASSERT_EQ(pwrite(fd, data.data(), data.size(), 0), (ssize_t)data.size());
+
+	IoUringQueue queue(8);
+	std::vector<std::thread> threads;
+	std::vector<int> failures(4, 0);
+	for (unsigned t = 0; t < failures.size(); ++t) {
+		threads.emplace_back([&, t]() {
+			std::vector<uint8_t> buffer(data.size());
+			std::vector<IoUringQueue::Request> requests;
+			for (unsigned i = 0; i < kBlocks; ++i) {
+				requests.push_back({IoUringQueue::Operation::kRead, fd,
+						buffer.data() + i * kBlockSize, kBlockSize, (off_t)i * kBlockSize, 0});
+			}
+			queue.execute(requests.data(), requests.size());
+			for (const auto &request : requests) {
+				failures[t] += request.result != kBlockSize;
+			}
+			failures[t] += buffer != data;
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	for (int failureCount : failures) {
+		EXPECT_EQ(failureCount, 0);
+	}
+	close(fd);
+}
@@ -118,6 +118,9 @@ static uint32_t stats_maxjobscnt=0;
 
 static bool gEnableLoadFactor;
 
+/// Epoch of the chunk list registered in master, 0 if the full list has to be sent
+static uint64_t gRegistrationEpoch = 0;
+
 // static FILE *logfd;
 
 void masterconn_stats(uint64_t *bin,uint64_t *bout,uint32_t *maxjobscnt) {
@@ -167,25 +170,61 @@ void masterconn_sendregisterlabel(masterconn *eptr) {
 	}
 }
 
-void masterconn_sendregister(masterconn *eptr) {
-	uint32_t myip;
-	uint16_t myport;
-	uint64_t usedspace,totalspace;
-	uint64_t tdusedspace,tdtotalspace;
-	uint32_t chunkcount,tdchunkcount;
-
-	myip = mainNetworkThreadGetListenIp();
-	myport = mainNetworkThreadGetListenPort();
-	masterconn_create_attached_packet(eptr, cstoma::registerHost::build(myip, myport, Timeout_ms, LIZARDFS_VERSHEX));
-
+void masterconn_sendregisterchunks(masterconn *eptr) {
+	hdd_reset_changed_chunks();
 	hdd_foreach_chunk_in_bulks([eptr](const std::vector<ChunkWithVersionAndType> &chunksBulk) {
 			masterconn_create_attached_packet(eptr, cstoma::registerChunks::build(chunksBulk));
 		});
+}
+
+/*! \brief Sends only chunks changed since the last registration in the same master.
+ *
+ * \return false if the full list of chunks has to be sent
+ */
+bool masterconn_sendregisterchanges(masterconn *eptr) {
+	if (gRegistrationEpoch == 0) {
+		return false;
+	}
+	std::vector<ChunkWithVersionAndType> changedChunks;
+	std::vector<ChunkWithType> removedChunks;
+	uint64_t checksum;
+	uint32_t chunkCount;
+	if (!hdd_get_changed_chunks(changedChunks, removedChunks, checksum, chunkCount)) {
+		return false;
+	}
+	masterconn_create_attached_packet(eptr, cstoma::registerChanges::build(gRegistrationEpoch,
+			checksum, chunkCount, changedChunks, removedChunks));
+	lzfs_pretty_syslog(LOG_NOTICE, "registering %zu changed and %zu removed chunks in master",
+			changedChunks.size(), removedChunks.size());
+	// Master answers with a new epoch if it accepts the changes (or with 0 if it needs
+	// the full list), so a connection lost in the meantime results in a full registration.
+	gRegistrationEpoch = 0;
+	return true;
+}
+
+void masterconn_sendregisterspace(masterconn *eptr) {
+	uint64_t usedspace,totalspace;
+	uint64_t tdusedspace,tdtotalspace;
+	uint32_t chunkcount,tdchunkcount;
 
 	hdd_get_space(&usedspace,&totalspace,&chunkcount,&tdusedspace,&tdtotalspace,&tdchunkcount);
 	auto registerSpace = cstoma::registerSpace::build(
 			usedspace, totalspace, chunkcount, tdusedspace, tdtotalspace, tdchunkcount);
 	masterconn_create_attached_packet(eptr, std::move(registerSpace));
+}
+
+void masterconn_sendregister(masterconn *eptr) {
+	uint32_t myip;
+	uint16_t myport;
+
+	myip = mainNetworkThreadGetListenIp();
+	myport = mainNetworkThreadGetListenPort();
+	masterconn_create_attached_packet(eptr, cstoma::registerHost::build(myip, myport, Timeout_ms, LIZARDFS_VERSHEX));
+
+	if (!masterconn_sendregisterchanges(eptr)) {
+		masterconn_sendregisterchunks(eptr);
+	}
+	masterconn_sendregisterspace(eptr);
 	masterconn_sendregisterlabel(eptr);
 }
 
@@ -447,6 +486,17 @@ void masterconn_legacy_replicate(masterconn *eptr,const uint8_t *data,uint32_t l
 	}
 }
 
+void masterconn_registerepoch(masterconn *eptr, const std::vector<uint8_t> &data) {
+	uint64_t epoch;
+	matocs::registerEpoch::deserialize(data, epoch);
+	if (epoch == 0) {
+		lzfs_pretty_syslog(LOG_NOTICE, "master can't use changed chunks, registering all chunks");
+		masterconn_sendregisterchunks(eptr);
+		masterconn_sendregisterspace(eptr);
+	}
+	gRegistrationEpoch = epoch;
+}
+
 void masterconn_gotpacket(masterconn *eptr, PacketHeader header, const MessageBuffer& message) try {
 	switch (header.type) {
 		case ANTOAN_NOP:
@@ -482,6 +532,9 @@ void masterconn_gotpacket(masterconn *eptr, PacketHeader header, const MessageBu
 		case LIZ_MATOCS_DUPTRUNC_CHUNK:
 			masterconn_duptrunc(eptr, message);
 			break;
+		case LIZ_MATOCS_REGISTER_EPOCH:
+			masterconn_registerepoch(eptr, message);
+			break;
 //              case MATOCS_STRUCTURE_LOG:
 //                      masterconn_structure_log(eptr, message.data(), message.size());
 //                      break;
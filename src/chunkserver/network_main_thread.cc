@@ -124,6 +124,7 @@ void mainNetworkThreadReload(void) {
 			cfg_get_maxvalue<uint32_t>("READ_AHEAD_KB", 0, MFSCHUNKSIZE / 1024));
 	gHDDReadAhead.setMaxReadBehind_kB(
 			cfg_get_maxvalue<uint32_t>("MAX_READ_BEHIND_KB", 0, MFSCHUNKSIZE / 1024));
+	gZeroCopyReads = cfg_getuint8("ZERO_COPY_READS", 0);
 
 	char *oldListenHost, *oldListenPort;
 	int newlsock;
@@ -237,6 +238,7 @@ int mainNetworkThreadInit(void) {
 			cfg_get_maxvalue<uint32_t>("READ_AHEAD_KB", 0, MFSCHUNKSIZE / 1024));
 	gHDDReadAhead.setMaxReadBehind_kB(
 			cfg_get_maxvalue<uint32_t>("MAX_READ_BEHIND_KB", 0, MFSCHUNKSIZE / 1024));
+	gZeroCopyReads = cfg_getuint8("ZERO_COPY_READS", 0);
 
 	lsock = tcpsocket();
 	if (lsock < 0) {
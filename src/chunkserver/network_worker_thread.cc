@@ -65,6 +65,11 @@
 #define CONNECT_RETRIES 10
 #define CONNECT_TIMEOUT(cnt) (((cnt)%2)?(300000*(1<<((cnt)>>1))):(200000*(1<<((cnt)>>1))))
 
+// maximal number of whole blocks read from a disk in one job (one vectored read)
+#define MAX_BLOCKS_IN_READ_JOB 16
+
+std::atomic<bool> gZeroCopyReads(false);
+
 class MessageSerializer {
 public:
 	static MessageSerializer* getSerializer(PacketHeader::Type type);
@@ -129,14 +134,14 @@ MessageSerializer* MessageSerializer::getSerializer(PacketHeader::Type type) {
 }
 
 packetstruct* worker_create_detached_packet_with_output_buffer(
-		const std::vector<uint8_t>& packetPrefix) {
+		const std::vector<uint8_t>& packetPrefix, bool allowZeroCopy = false) {
 	TRACETHIS();
 	PacketHeader header;
 	deserializePacketHeader(packetPrefix, header);
 	uint32_t sizeOfWholePacket = PacketHeader::kSize + header.length;
 	packetstruct* outPacket = new packetstruct();
 	passert(outPacket);
-	outPacket->outputBuffer.reset(new OutputBuffer(sizeOfWholePacket));
+	outPacket->outputBuffer.reset(new OutputBuffer(sizeOfWholePacket, allowZeroCopy));
 	if (outPacket->outputBuffer->copyIntoBuffer(packetPrefix) != (ssize_t)packetPrefix.size()) {
 		delete outPacket;
 		return nullptr;
@@ -330,6 +335,45 @@ void worker_send_finished(csserventry *eptr) {
 	}
 }
 
+/*
+ * Reads many whole blocks in one job. Responses for all of them (a separate READ_DATA message
+ * for each block) are put in one output buffer and sent together.
+ */
+static void worker_read_blocks(csserventry *eptr, uint16_t blockCount,
+		uint32_t maxReadBehindBlocks, uint32_t readAheadBlocks) {
+	TRACETHIS2(eptr->offset, blockCount);
+	std::vector<uint8_t> readDataPrefix;
+	eptr->messageSerializer->serializePrefixOfCstoclReadData(readDataPrefix,
+			eptr->chunkid, eptr->offset, MFSBLOCKSIZE);
+	// Prefixes differ only in offsets, so all of them have the same size
+	const uint32_t prefixSize = readDataPrefix.size();
+	const uint32_t crcAndDataSize = sizeof(uint32_t) + MFSBLOCKSIZE;
+	packetstruct* packet = new packetstruct();
+	passert(packet);
+	packet->outputBuffer.reset(new OutputBuffer(blockCount * (prefixSize + crcAndDataSize)));
+	for (uint16_t i = 0; i < blockCount; ++i) {
+		if (i > 0) {
+			readDataPrefix.clear();
+			eptr->messageSerializer->serializePrefixOfCstoclReadData(readDataPrefix,
+					eptr->chunkid, eptr->offset + i * MFSBLOCKSIZE, MFSBLOCKSIZE);
+		}
+		packet->outputBuffer->copyIntoBuffer(readDataPrefix);
+		packet->outputBuffer->appendSpace(crcAndDataSize);
+	}
+	eptr->rpacket = (void*)packet;
+	eptr->rjobid = job_read_blocks(eptr->workerJobPool, worker_read_finished, eptr,
+			eptr->chunkid, eptr->version, eptr->chunkType, eptr->offset / MFSBLOCKSIZE,
+			blockCount, maxReadBehindBlocks, readAheadBlocks,
+			packet->outputBuffer.get(), prefixSize, !eptr->chunkisopen);
+	if (eptr->rjobid == 0) {
+		eptr->state = CLOSE;
+		return;
+	}
+	eptr->todocnt++;
+	eptr->offset += blockCount * MFSBLOCKSIZE;
+	eptr->size -= blockCount * MFSBLOCKSIZE;
+}
+
 void worker_read_continue(csserventry *eptr) {
 	TRACETHIS2(eptr->offset, eptr->size);
 
@@ -354,15 +398,6 @@ void worker_read_continue(csserventry *eptr) {
 				totalRequestSize, MFSBLOCKSIZE - thisPartOffset);
 		const uint16_t totalRequestBlocks =
 				(totalRequestSize + thisPartOffset + MFSBLOCKSIZE - 1) / MFSBLOCKSIZE;
-		std::vector<uint8_t> readDataPrefix;
-		eptr->messageSerializer->serializePrefixOfCstoclReadData(readDataPrefix,
-				eptr->chunkid, eptr->offset, thisPartSize);
-		packetstruct* packet = worker_create_detached_packet_with_output_buffer(readDataPrefix);
-		if (packet == nullptr) {
-			eptr->state = CLOSE;
-			return;
-		}
-		eptr->rpacket = (void*)packet;
 		uint32_t readAheadBlocks = 0;
 		uint32_t maxReadBehindBlocks = 0;
 		if (!eptr->chunkisopen) {
@@ -373,6 +408,24 @@ void worker_read_continue(csserventry *eptr) {
 			maxReadBehindBlocks = std::min(totalRequestBlocks,
 					gHDDReadAhead.maxBlocksToBeReadBehind());
 		}
+		const uint16_t wholeBlocks = std::min<uint32_t>(
+				totalRequestSize / MFSBLOCKSIZE, MAX_BLOCKS_IN_READ_JOB);
+		if (thisPartOffset == 0 && wholeBlocks > 1 && !gZeroCopyReads) {
+			worker_read_blocks(eptr, wholeBlocks, maxReadBehindBlocks, readAheadBlocks);
+			return;
+		}
+		std::vector<uint8_t> readDataPrefix;
+		eptr->messageSerializer->serializePrefixOfCstoclReadData(readDataPrefix,
+				eptr->chunkid, eptr->offset, thisPartSize);
+		// Only whole blocks can be sent without copying, parts need a recomputed CRC
+		bool zeroCopy = thisPartSize == MFSBLOCKSIZE && gZeroCopyReads;
+		packetstruct* packet = worker_create_detached_packet_with_output_buffer(readDataPrefix,
+				zeroCopy);
+		if (packet == nullptr) {
+			eptr->state = CLOSE;
+			return;
+		}
+		eptr->rpacket = (void*)packet;
 		eptr->rjobid = job_read(eptr->workerJobPool, worker_read_finished, eptr, eptr->chunkid,
 				eptr->version, eptr->chunkType, eptr->offset, thisPartSize,
 				maxReadBehindBlocks,
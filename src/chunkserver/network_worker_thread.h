@@ -35,6 +35,9 @@
 #include "protocol/packet.h"
 #include "devtools/request_log.h"
 
+/// Send whole blocks of data with sendfile(2) instead of copying them to user space
+extern std::atomic<bool> gZeroCopyReads;
+
 //entry.mode
 enum ChunkserverEntryMode {
 	HEADER, DATA
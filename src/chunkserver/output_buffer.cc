@@ -18,6 +18,9 @@
 
 #include "common/platform.h"
 #include <fcntl.h>
+#ifdef LIZARDFS_HAVE_SYS_SENDFILE_H
+#  include <sys/sendfile.h>
+#endif
 #include <unistd.h>
 #include <cassert>
 #include <cerrno>
@@ -26,25 +29,74 @@
 #include <ios>
 #include <stdexcept>
 
+#include "chunkserver/io_uring_queue.h"
 #include "chunkserver/output_buffer.h"
 #include "common/crc.h"
 #include "common/massert.h"
 #include "devtools/request_log.h"
 
-OutputBuffer::OutputBuffer(size_t internalBufferCapacity)
+OutputBuffer::OutputBuffer(size_t internalBufferCapacity, bool allowZeroCopy)
 	: internalBufferCapacity_(internalBufferCapacity),
-	  buffer_(internalBufferCapacity, 0),
+	  allowZeroCopy_(allowZeroCopy),
+	  buffer_(allowZeroCopy ? 0 : internalBufferCapacity, 0),
 	  bufferUnflushedDataFirstIndex_(0),
-	  bufferUnflushedDataOneAfterLastIndex_(0)
+	  bufferUnflushedDataOneAfterLastIndex_(0),
+	  fileDescriptor_(-1),
+	  fileOffset_(0),
+	  fileBytesLeft_(0)
 {
 	eassert(internalBufferCapacity > 0);
-	buffer_.reserve(internalBufferCapacity_);
+	buffer_.reserve(allowZeroCopy ? 0 : internalBufferCapacity_);
+}
+
+void OutputBuffer::reserveSpace(size_t len) {
+	eassert(fileDescriptor_ == -1);
+	eassert(len + bufferUnflushedDataOneAfterLastIndex_ <= internalBufferCapacity_);
+	if (buffer_.size() < bufferUnflushedDataOneAfterLastIndex_ + len) {
+		// Only zero copy buffers are allocated lazily, typically just for a small header
+		buffer_.resize(bufferUnflushedDataOneAfterLastIndex_ + len);
+	}
+}
+
+void OutputBuffer::closeFileRegion() {
+	if (fileDescriptor_ != -1) {
+		::close(fileDescriptor_);
+		fileDescriptor_ = -1;
+	}
+	fileBytesLeft_ = 0;
+}
+
+void OutputBuffer::appendSpace(size_t len) {
+	reserveSpace(len);
+	bufferUnflushedDataOneAfterLastIndex_ += len;
+}
+
+bool OutputBuffer::appendFileRegion(int inputFileDescriptor, size_t len, off_t offset) {
+#ifdef LIZARDFS_HAVE_SYS_SENDFILE_H
+	if (!allowZeroCopy_ || fileDescriptor_ != -1) {
+		return false;
+	}
+	// The chunk may be closed before the buffer is sent, so keep our own descriptor
+	int fd = ::fcntl(inputFileDescriptor, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		return false;
+	}
+	fileDescriptor_ = fd;
+	fileOffset_ = offset;
+	fileBytesLeft_ = len;
+	return true;
+#else
+	(void)inputFileDescriptor;
+	(void)len;
+	(void)offset;
+	return false;
+#endif
 }
 
 OutputBuffer::WriteStatus OutputBuffer::writeOutToAFileDescriptor(int outputFileDescriptor) {
-	while (bytesInABuffer() > 0) {
+	while (bufferUnflushedDataOneAfterLastIndex_ > bufferUnflushedDataFirstIndex_) {
 		ssize_t ret = ::write(outputFileDescriptor, &buffer_[bufferUnflushedDataFirstIndex_],
-				bytesInABuffer());
+				bufferUnflushedDataOneAfterLastIndex_ - bufferUnflushedDataFirstIndex_);
 		if (ret <= 0) {
 			if (ret == 0 || errno == EAGAIN) {
 				return WRITE_AGAIN;
@@ -53,20 +105,39 @@ OutputBuffer::WriteStatus OutputBuffer::writeOutToAFileDescriptor(int outputFile
 		}
 		bufferUnflushedDataFirstIndex_ += ret;
 	}
+#ifdef LIZARDFS_HAVE_SYS_SENDFILE_H
+	while (fileBytesLeft_ > 0) {
+		ssize_t ret = ::sendfile(outputFileDescriptor, fileDescriptor_, &fileOffset_,
+				fileBytesLeft_);
+		if (ret < 0) {
+			if (errno == EAGAIN) {
+				return WRITE_AGAIN;
+			}
+			return WRITE_ERROR;
+		}
+		if (ret == 0) {
+			// The file was truncated in the meantime, the packet can't be completed
+			return WRITE_ERROR;
+		}
+		fileBytesLeft_ -= ret;
+	}
+#endif
+	closeFileRegion();
 	return WRITE_DONE;
 }
 
 size_t OutputBuffer::bytesInABuffer() const {
-	return bufferUnflushedDataOneAfterLastIndex_ - bufferUnflushedDataFirstIndex_;
+	return bufferUnflushedDataOneAfterLastIndex_ - bufferUnflushedDataFirstIndex_ + fileBytesLeft_;
 }
 
 void OutputBuffer::clear() {
+	closeFileRegion();
 	bufferUnflushedDataFirstIndex_ = 0;
 	bufferUnflushedDataOneAfterLastIndex_ = 0;
 }
 
 ssize_t OutputBuffer::copyIntoBuffer(int inputFileDescriptor, size_t len, off_t* offset) {
-	eassert(len + bufferUnflushedDataOneAfterLastIndex_ <= internalBufferCapacity_);
+	reserveSpace(len);
 	off_t bytes_written = 0;
 	while (len > 0) {
 		ssize_t ret = pread(inputFileDescriptor, (void*)&buffer_[bufferUnflushedDataOneAfterLastIndex_], len,
@@ -81,6 +152,18 @@ ssize_t OutputBuffer::copyIntoBuffer(int inputFileDescriptor, size_t len, off_t*
 	return bytes_written;
 }
 
+ssize_t OutputBuffer::copyIntoBuffer(IoUringQueue& queue, int inputFileDescriptor, size_t len,
+		off_t offset) {
+	reserveSpace(len);
+	ssize_t ret = queue.pread(inputFileDescriptor,
+			(void*)&buffer_[bufferUnflushedDataOneAfterLastIndex_], len, offset);
+	if (ret <= 0) {
+		return 0;
+	}
+	bufferUnflushedDataOneAfterLastIndex_ += ret;
+	return ret;
+}
+
 bool OutputBuffer::checkCRC(size_t bytes, uint32_t crc) const {
 	assert(bufferUnflushedDataOneAfterLastIndex_ - bytes > 0
 			&& bufferUnflushedDataOneAfterLastIndex_ - bytes < buffer_.size());
@@ -88,7 +171,7 @@ bool OutputBuffer::checkCRC(size_t bytes, uint32_t crc) const {
 }
 
 ssize_t OutputBuffer::copyIntoBuffer(const void *mem, size_t len) {
-	eassert(bufferUnflushedDataOneAfterLastIndex_ + len <= internalBufferCapacity_);
+	reserveSpace(len);
 	memcpy((void*)&buffer_[bufferUnflushedDataOneAfterLastIndex_], mem, len);
 	bufferUnflushedDataOneAfterLastIndex_ += len;
 
@@ -96,4 +179,5 @@ ssize_t OutputBuffer::copyIntoBuffer(const void *mem, size_t len) {
 }
 
 OutputBuffer::~OutputBuffer() {
+	closeFileRegion();
 }
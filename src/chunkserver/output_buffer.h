@@ -26,6 +26,8 @@
 #include <vector>
 #include <sys/types.h>
 
+class IoUringQueue;
+
 class OutputBuffer {
 public:
 	enum WriteStatus {
@@ -34,12 +36,40 @@ public:
 		WRITE_ERROR
 	};
 
-	OutputBuffer(size_t internalBufferCapacity);
+	/**
+	 * \param internalBufferCapacity maximal number of bytes which the buffer holds
+	 * \param allowZeroCopy if true, the memory for the buffer is allocated lazily
+	 *        and file regions may be appended with appendFileRegion()
+	 */
+	OutputBuffer(size_t internalBufferCapacity, bool allowZeroCopy = false);
 	~OutputBuffer();
 
+	OutputBuffer(const OutputBuffer&) = delete;
+	OutputBuffer& operator=(const OutputBuffer&) = delete;
+
 	ssize_t copyIntoBuffer(int inputFileDescriptor, size_t len, off_t* offset);
+	ssize_t copyIntoBuffer(IoUringQueue& queue, int inputFileDescriptor, size_t len, off_t offset);
 	ssize_t copyIntoBuffer(const void *mem, size_t len);
 
+	/**
+	 * Queues a region of a file to be sent after the data which is already in the buffer.
+	 * The data is not copied into the buffer; it is sent straight from the page cache
+	 * to the output descriptor by writeOutToAFileDescriptor(). Nothing can be added to
+	 * the buffer after a file region.
+	 * \return false if zero copy is not possible, nothing is changed in such case
+	 */
+	bool appendFileRegion(int inputFileDescriptor, size_t len, off_t offset);
+
+	/**
+	 * Extends the data in the buffer by len bytes, which are to be filled later using data().
+	 * Useful when data is read from a file in one call into many places of the buffer.
+	 */
+	void appendSpace(size_t len);
+
+	bool zeroCopyAllowed() const {
+		return allowZeroCopy_;
+	}
+
 	bool checkCRC(size_t bytes, uint32_t crc) const;
 
 	ssize_t copyIntoBuffer(const std::vector<uint8_t>& mem) {
@@ -48,15 +78,27 @@ public:
 
 	WriteStatus writeOutToAFileDescriptor(int outputFileDescriptor);
 
+	/// Number of bytes which remain to be written out (including appended file regions)
 	size_t bytesInABuffer() const;
 	const uint8_t* data() const {
 		return buffer_.data();
 	}
+	uint8_t* data() {
+		return buffer_.data();
+	}
 	void clear();
 
 private:
+	void reserveSpace(size_t len);
+	void closeFileRegion();
+
 	const size_t internalBufferCapacity_;
+	const bool allowZeroCopy_;
 	std::vector<uint8_t> buffer_;
 	size_t bufferUnflushedDataFirstIndex_;
 	size_t bufferUnflushedDataOneAfterLastIndex_;
+
+	int fileDescriptor_; // own copy of the descriptor of an appended file region or -1
+	off_t fileOffset_;
+	size_t fileBytesLeft_;
 };
@@ -18,8 +18,11 @@
 
 #include "common/platform.h"
 #include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <cstdlib>
 #include <string>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "chunkserver/output_buffer.h"
@@ -65,3 +68,62 @@ TEST(OutputBufferTests, outputBuffersTest) {
 	close(auxPipeFileDescriptors[0]);
 	close(auxPipeFileDescriptors[1]);
 }
+
+TEST(OutputBufferTests, zeroCopyFileRegion) {
+	TemporaryDirectory temp("/tmp", this->test_info_->name());
+	std::string fileName(temp.name() + "/file");
+	int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_NE(fd, -1);
+	std::vector<uint8_t> fileData(8192);
+	for (size_t i = 0; i < fileData.size(); ++i) {
+		fileData[i] = i % 251;
+	}
+	ASSERT_EQ(write(fd, fileData.data(), fileData.size()), (ssize_t)fileData.size());
+
+	const size_t kHeaderSize = 8;
+	const size_t kRegionSize = 4096;
+	const off_t kRegionOffset = 1000;
+	OutputBuffer outputBuffer(kHeaderSize + kRegionSize, true);
+	std::vector<uint8_t> header(kHeaderSize, 0xAB);
+	ASSERT_EQ(outputBuffer.copyIntoBuffer(header), (ssize_t)kHeaderSize);
+	if (!outputBuffer.appendFileRegion(fd, kRegionSize, kRegionOffset)) {
+		close(fd);
+		return; // sendfile is not available on this platform
+	}
+	// The buffer keeps its own descriptor, the file may be closed
+	close(fd);
+	ASSERT_EQ(outputBuffer.bytesInABuffer(), kHeaderSize + kRegionSize);
+
+	int sockets[2];
+	ASSERT_NE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), -1);
+	ASSERT_EQ(outputBuffer.writeOutToAFileDescriptor(sockets[0]), OutputBuffer::WRITE_DONE);
+	ASSERT_EQ(outputBuffer.bytesInABuffer(), 0U);
+
+	std::vector<uint8_t> received(kHeaderSize + kRegionSize);
+	size_t receivedBytes = 0;
+	while (receivedBytes < received.size()) {
+		ssize_t ret = read(sockets[1], received.data() + receivedBytes,
+				received.size() - receivedBytes);
+		ASSERT_GT(ret, 0) << "errno: " << errno;
+		receivedBytes += ret;
+	}
+	std::vector<uint8_t> expected(header);
+	expected.insert(expected.end(), fileData.begin() + kRegionOffset,
+			fileData.begin() + kRegionOffset + kRegionSize);
+	EXPECT_EQ(expected, received);
+	close(sockets[0]);
+	close(sockets[1]);
+}
+
+TEST(OutputBufferTests, appendSpaceFilledLater) {
+	OutputBuffer outputBuffer(16);
+	std::vector<uint8_t> header(4, 1);
+	ASSERT_EQ(outputBuffer.copyIntoBuffer(header), 4);
+	outputBuffer.appendSpace(8);
+	ASSERT_EQ(outputBuffer.copyIntoBuffer(header), 4);
+	ASSERT_EQ(outputBuffer.bytesInABuffer(), 16U);
+	memset(outputBuffer.data() + 4, 2, 8);
+
+	std::vector<uint8_t> expected{1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1};
+	EXPECT_EQ(expected, std::vector<uint8_t>(outputBuffer.data(), outputBuffer.data() + 16));
+}
@@ -20,6 +20,7 @@
 #include "common/block_xor.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 
 #include "common/massert.h"
@@ -30,6 +31,12 @@
 #  endif
 #endif
 
+// Wide variants are compiled with target attributes and chosen at runtime
+#if defined(LIZARDFS_HAVE_CPU_CHECK) && (__GNUC__ >= 6 || defined(__clang__))
+#  define LIZARDFS_BLOCK_XOR_AVX
+#  include <immintrin.h>
+#endif
+
 // We check whether dest and source are well-aligned and hope that compiler will perform XORs using
 // vector instructions. Some architectures don't support unaligned vector loads and stores, others
 // (e.g. x86) support them but aligned versions still are faster.
@@ -43,8 +50,8 @@ static inline void blockXorAligned(uint8_t* dest, const uint8_t* source, size_t
 static inline void blockXorUnaligned(uint8_t* dest, const uint8_t* source, size_t size);
 
 
-// Public interface, tries to do it as well as possible.
-void blockXor(uint8_t* dest, const uint8_t* source, size_t size) {
+// Portable variant, tries to do it as well as possible.
+static void blockXorGeneric(uint8_t* dest, const uint8_t* source, size_t size) {
 	intptr_t d = reinterpret_cast<intptr_t>(dest);
 	intptr_t s = reinterpret_cast<intptr_t>(source);
 	if (d % ALIGNMENT == s % ALIGNMENT) {
@@ -86,3 +93,95 @@ static inline void blockXorAligned(uint8_t* dest, const uint8_t* source, size_t
 	blockXorUnaligned(dest, source, size);
 #endif
 }
+
+#ifdef LIZARDFS_BLOCK_XOR_AVX
+
+// Unaligned loads and stores are as fast as aligned ones on CPUs with AVX2, so no prologue
+// is needed. Four vectors are processed per iteration to keep both load ports busy.
+__attribute__((target("avx2")))
+static void blockXorAvx2(uint8_t* dest, const uint8_t* source, size_t size) {
+	size_t i = 0;
+	for (; i + 128 <= size; i += 128) {
+		__m256i d0 = _mm256_loadu_si256((const __m256i*)(dest + i));
+		__m256i d1 = _mm256_loadu_si256((const __m256i*)(dest + i + 32));
+		__m256i d2 = _mm256_loadu_si256((const __m256i*)(dest + i + 64));
+		__m256i d3 = _mm256_loadu_si256((const __m256i*)(dest + i + 96));
+		d0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i*)(source + i)));
+		d1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i*)(source + i + 32)));
+		d2 = _mm256_xor_si256(d2, _mm256_loadu_si256((const __m256i*)(source + i + 64)));
+		d3 = _mm256_xor_si256(d3, _mm256_loadu_si256((const __m256i*)(source + i + 96)));
+		_mm256_storeu_si256((__m256i*)(dest + i), d0);
+		_mm256_storeu_si256((__m256i*)(dest + i + 32), d1);
+		_mm256_storeu_si256((__m256i*)(dest + i + 64), d2);
+		_mm256_storeu_si256((__m256i*)(dest + i + 96), d3);
+	}
+	for (; i + 32 <= size; i += 32) {
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dest + i));
+		d = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i*)(source + i)));
+		_mm256_storeu_si256((__m256i*)(dest + i), d);
+	}
+	blockXorUnaligned(dest + i, source + i, size - i);
+}
+
+__attribute__((target("avx2,avx512f")))
+static void blockXorAvx512(uint8_t* dest, const uint8_t* source, size_t size) {
+	size_t i = 0;
+	for (; i + 256 <= size; i += 256) {
+		__m512i d0 = _mm512_loadu_si512((const void*)(dest + i));
+		__m512i d1 = _mm512_loadu_si512((const void*)(dest + i + 64));
+		__m512i d2 = _mm512_loadu_si512((const void*)(dest + i + 128));
+		__m512i d3 = _mm512_loadu_si512((const void*)(dest + i + 192));
+		d0 = _mm512_xor_si512(d0, _mm512_loadu_si512((const void*)(source + i)));
+		d1 = _mm512_xor_si512(d1, _mm512_loadu_si512((const void*)(source + i + 64)));
+		d2 = _mm512_xor_si512(d2, _mm512_loadu_si512((const void*)(source + i + 128)));
+		d3 = _mm512_xor_si512(d3, _mm512_loadu_si512((const void*)(source + i + 192)));
+		_mm512_storeu_si512((void*)(dest + i), d0);
+		_mm512_storeu_si512((void*)(dest + i + 64), d1);
+		_mm512_storeu_si512((void*)(dest + i + 128), d2);
+		_mm512_storeu_si512((void*)(dest + i + 192), d3);
+	}
+	for (; i + 64 <= size; i += 64) {
+		__m512i d = _mm512_loadu_si512((const void*)(dest + i));
+		d = _mm512_xor_si512(d, _mm512_loadu_si512((const void*)(source + i)));
+		_mm512_storeu_si512((void*)(dest + i), d);
+	}
+	blockXorAvx2(dest + i, source + i, size - i);
+}
+
+#endif // LIZARDFS_BLOCK_XOR_AVX
+
+std::vector<BlockXorImplementation> blockXorImplementations() {
+	std::vector<BlockXorImplementation> implementations;
+#ifdef LIZARDFS_BLOCK_XOR_AVX
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		implementations.push_back({"avx512", blockXorAvx512});
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		implementations.push_back({"avx2", blockXorAvx2});
+	}
+#endif
+	implementations.push_back({"generic", blockXorGeneric});
+	return implementations;
+}
+
+namespace {
+
+typedef void (*BlockXorFunction)(uint8_t*, const uint8_t*, size_t);
+
+void blockXorDispatch(uint8_t* dest, const uint8_t* source, size_t size);
+
+// Resolved on the first use, so that blockXor works also during static initialization
+std::atomic<BlockXorFunction> gBlockXorFunction(blockXorDispatch);
+
+void blockXorDispatch(uint8_t* dest, const uint8_t* source, size_t size) {
+	BlockXorFunction function = blockXorImplementations().front().function;
+	gBlockXorFunction.store(function, std::memory_order_relaxed);
+	function(dest, source, size);
+}
+
+} // anonymous namespace
+
+void blockXor(uint8_t* dest, const uint8_t* source, size_t size) {
+	gBlockXorFunction.load(std::memory_order_relaxed)(dest, source, size);
+}
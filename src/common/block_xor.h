@@ -22,12 +22,23 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 /*
  * XOR dest in-place with source.
  *
- * Implementation will try to use vector instructions if dest and source
- * are well-aligned or, at least, the difference between them is divisible
- * by vector width.
+ * Uses AVX2 or AVX-512 if the CPU supports it. Otherwise implementation will
+ * try to use vector instructions if dest and source are well-aligned or,
+ * at least, the difference between them is divisible by vector width.
  */
 void blockXor(uint8_t* dest, const uint8_t* source, size_t size);
+
+struct BlockXorImplementation {
+	const char* name;
+	void (*function)(uint8_t* dest, const uint8_t* source, size_t size);
+};
+
+/*
+ * Variants of blockXor usable on this CPU, fastest first. For tests and benchmarks.
+ */
+std::vector<BlockXorImplementation> blockXorImplementations();
@@ -19,6 +19,7 @@
 #include "common/platform.h"
 #include "common/block_xor.h"
 
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(BlockXorTests, BlockXor) {
@@ -33,3 +34,25 @@ TEST(BlockXorTests, BlockXor) {
 		}
 	}
 }
+
+TEST(BlockXorTests, ImplementationsAgree) {
+	std::vector<uint8_t> source(1000), dest(source.size());
+	for (size_t i = 0; i < source.size(); ++i) {
+		source[i] = i * 7 + 1;
+		dest[i] = i * 13;
+	}
+
+	for (const auto& implementation : blockXorImplementations()) {
+		for (size_t offset : {0, 1, 3, 17}) {
+			for (size_t size : {0, 5, 31, 64, 100, 255, 256, 900}) {
+				std::vector<uint8_t> expected(dest), result(dest);
+				for (size_t i = 0; i < size; ++i) {
+					expected[offset + i] ^= source[i];
+				}
+				implementation.function(result.data() + offset, source.data(), size);
+				EXPECT_EQ(expected, result) << implementation.name << " offset=" << offset
+						<< " size=" << size;
+			}
+		}
+	}
+}
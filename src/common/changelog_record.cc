@@ -0,0 +1,294 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "common/changelog_record.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "common/crc.h"
+#include "common/datapack.h"
+
+namespace changelog_record {
+
+static uint8_t *grow(std::vector<uint8_t> &payload, uint32_t size) {
+	payload.resize(payload.size() + size);
+	return payload.data() + payload.size() - size;
+}
+
+void appendU32(std::vector<uint8_t> &payload, uint32_t value) {
+	uint8_t *ptr = grow(payload, 1 + 4);
+	put8bit(&ptr, kU32);
+	put32bit(&ptr, value);
+}
+
+void appendLiteral(std::vector<uint8_t> &payload, const char *text, uint32_t length) {
+	while (length > 0) {
+		uint16_t chunk = std::min<uint32_t>(length, UINT16_MAX);
+		uint8_t *ptr = grow(payload, 1 + 2 + chunk);
+		put8bit(&ptr, kLiteral);
+		put16bit(&ptr, chunk);
+		memcpy(ptr, text, chunk);
+		text += chunk;
+		length -= chunk;
+	}
+}
+
+static void appendU64(std::vector<uint8_t> &payload, uint64_t value) {
+	uint8_t *ptr = grow(payload, 1 + 8);
+	put8bit(&ptr, kU64);
+	put64bit(&ptr, value);
+}
+
+static void appendInt32(std::vector<uint8_t> &payload, int32_t value) {
+	uint8_t *ptr = grow(payload, 1 + 4);
+	put8bit(&ptr, kInt32);
+	put32bit(&ptr, value);
+}
+
+static void appendChar(std::vector<uint8_t> &payload, char value) {
+	uint8_t *ptr = grow(payload, 1 + 1);
+	put8bit(&ptr, kChar);
+	put8bit(&ptr, value);
+}
+
+static void appendString(std::vector<uint8_t> &payload, const char *value) {
+	uint32_t length = strlen(value);
+	uint8_t *ptr = grow(payload, 1 + 4 + length);
+	put8bit(&ptr, kString);
+	put32bit(&ptr, length);
+	memcpy(ptr, value, length);
+}
+
+bool appendTokens(std::vector<uint8_t> &payload, const char *format, va_list ap) {
+	const char *literal = format;
+	while (*format) {
+		if (*format != '%') {
+			++format;
+			continue;
+		}
+		if (format[1] == '%') {
+			// keep the first '%' in the literal, skip the second one
+			appendLiteral(payload, literal, format + 1 - literal);
+			format += 2;
+			literal = format;
+			continue;
+		}
+		appendLiteral(payload, literal, format - literal);
+		++format;
+		int shorts = 0, longs = 0;
+		for (; *format == 'h'; ++format) {
+			++shorts;
+		}
+		for (; *format == 'l'; ++format) {
+			++longs;
+		}
+		if (*format == 'z' || *format == 'j') {
+			longs = 2;
+			++format;
+		}
+		switch (*format) {
+		case 'u':
+			if (longs == 0) {
+				unsigned value = va_arg(ap, unsigned);
+				if (shorts == 1) {
+					value = (uint16_t)value;
+				} else if (shorts > 1) {
+					value = (uint8_t)value;
+				}
+				appendU32(payload, value);
+			} else if (longs == 1) {
+				appendU64(payload, va_arg(ap, unsigned long));
+			} else {
+				appendU64(payload, va_arg(ap, unsigned long long));
+			}
+			break;
+		case 'd':
+			if (longs != 0 || shorts != 0) {
+				return false;
+			}
+			appendInt32(payload, va_arg(ap, int));
+			break;
+		case 'c':
+			appendChar(payload, va_arg(ap, int));
+			break;
+		case 's':
+			appendString(payload, va_arg(ap, const char *));
+			break;
+		default:
+			return false;
+		}
+		literal = ++format;
+	}
+	appendLiteral(payload, literal, format - literal);
+	return true;
+}
+
+void frame(uint64_t version, const uint8_t *payload, uint32_t payloadSize,
+		std::vector<uint8_t> &record) {
+	record.resize(kHeaderSize + payloadSize + kTrailerSize);
+	uint8_t *ptr = record.data();
+	put8bit(&ptr, kMarker);
+	put32bit(&ptr, payloadSize);
+	put64bit(&ptr, version);
+	memcpy(ptr, payload, payloadSize);
+	ptr += payloadSize;
+	put32bit(&ptr, mycrc32(0, record.data() + 1 + 4, 8 + payloadSize));
+}
+
+bool toText(const uint8_t *payload, uint32_t payloadSize, std::string &text) {
+	const uint8_t *ptr = payload;
+	const uint8_t *end = payload + payloadSize;
+	text.clear();
+	while (ptr < end) {
+		uint8_t type = get8bit(&ptr);
+		uint32_t length;
+		switch (type) {
+		case kLiteral:
+		case kString:
+			if (end - ptr < (type == kLiteral ? 2 : 4)) {
+				return false;
+			}
+			length = (type == kLiteral) ? get16bit(&ptr) : get32bit(&ptr);
+			if ((uint64_t)(end - ptr) < length) {
+				return false;
+			}
+			text.append((const char *)ptr, length);
+			ptr += length;
+			break;
+		case kU32:
+		case kInt32:
+			if (end - ptr < 4) {
+				return false;
+			}
+			length = get32bit(&ptr);
+			text += (type == kU32) ? std::to_string(length) : std::to_string((int32_t)length);
+			break;
+		case kU64:
+			if (end - ptr < 8) {
+				return false;
+			}
+			text += std::to_string(get64bit(&ptr));
+			break;
+		case kChar:
+			if (end - ptr < 1) {
+				return false;
+			}
+			text.push_back(get8bit(&ptr));
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+ParseStatus parse(const uint8_t *data, uint64_t available, RecordView &record) {
+	if (available == 0) {
+		return ParseStatus::kIncomplete;
+	}
+	if (data[0] != kMarker) {
+		return ParseStatus::kCorrupted;
+	}
+	if (available < kHeaderSize) {
+		return ParseStatus::kIncomplete;
+	}
+	const uint8_t *ptr = data + 1;
+	uint32_t payloadSize = get32bit(&ptr);
+	if (payloadSize > kMaxPayloadSize) {
+		return ParseStatus::kCorrupted;
+	}
+	if (available < kHeaderSize + payloadSize + kTrailerSize) {
+		return ParseStatus::kIncomplete;
+	}
+	record.version = get64bit(&ptr);
+	record.payload = ptr;
+	record.payloadSize = payloadSize;
+	record.recordSize = kHeaderSize + payloadSize + kTrailerSize;
+	ptr += payloadSize;
+	if (get32bit(&ptr) != mycrc32(0, data + 1 + 4, 8 + payloadSize)) {
+		return ParseStatus::kCorrupted;
+	}
+	return ParseStatus::kOk;
+}
+
+} // namespace changelog_record
+
+ChangelogFileReader::ChangelogFileReader(const std::string &filename)
+		: fd_(fopen(filename.c_str(), "r")),
+		  line_(nullptr),
+		  lineSize_(0) {
+}
+
+ChangelogFileReader::~ChangelogFileReader() {
+	if (fd_) {
+		fclose(fd_);
+	}
+	free(line_);
+}
+
+ChangelogFileReader::Status ChangelogFileReader::next(Entry &entry) {
+	using namespace changelog_record;
+	int first = getc(fd_);
+	if (first == EOF) {
+		return Status::kEnd;
+	}
+	if (first == kMarker) {
+		record_.resize(kHeaderSize);
+		record_[0] = first;
+		if (fread(record_.data() + 1, 1, kHeaderSize - 1, fd_) != kHeaderSize - 1) {
+			return Status::kEnd;
+		}
+		const uint8_t *ptr = record_.data() + 1;
+		uint32_t payloadSize = get32bit(&ptr);
+		if (payloadSize > kMaxPayloadSize) {
+			return Status::kCorrupted;
+		}
+		uint32_t rest = payloadSize + kTrailerSize;
+		record_.resize(kHeaderSize + rest);
+		if (fread(record_.data() + kHeaderSize, 1, rest, fd_) != rest) {
+			return Status::kEnd;
+		}
+		RecordView record;
+		if (parse(record_.data(), record_.size(), record) != ParseStatus::kOk) {
+			return Status::kCorrupted;
+		}
+		entry.version = record.version;
+		entry.text = nullptr;
+		entry.payload = record.payload;
+		entry.payloadSize = record.payloadSize;
+		return Status::kEntry;
+	}
+	ungetc(first, fd_);
+	ssize_t length = getline(&line_, &lineSize_, fd_);
+	if (length <= 0 || line_[length - 1] != '\n') {
+		return Status::kEnd;
+	}
+	line_[length - 1] = '\0';
+	char *end = nullptr;
+	entry.version = strtoull(line_, &end, 10);
+	if (end == line_) {
+		return Status::kCorrupted;
+	}
+	entry.text = end;
+	entry.payload = nullptr;
+	entry.payloadSize = 0;
+	return Status::kEntry;
+}
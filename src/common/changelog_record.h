@@ -0,0 +1,140 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Binary changelog records.
+ *
+ * A record is framed as:
+ *   marker:8 length:32 version:64 payload:(length bytes) crc:32
+ * where crc is the crc32 of version and payload. Text entries ("<version>: <ts>|...") always
+ * start with a digit, so both kinds of entries can be told apart by their first byte.
+ *
+ * The payload is a sequence of typed tokens which follows the printf-like format of the text
+ * entry (without the version), so the text entry can always be recreated from it:
+ *   'L' length:16 bytes    -- literal text of the format
+ *   'U' value:32           -- %u
+ *   'D' value:32           -- %d
+ *   'Q' value:64           -- %lu, %llu
+ *   'C' value:8            -- %c
+ *   'S' length:32 bytes    -- %s
+ * Any text entry is also a valid payload when stored as a single literal token.
+ */
+namespace changelog_record {
+
+constexpr uint8_t kMarker = 0xC5;
+constexpr uint32_t kHeaderSize = 1 + 4 + 8;
+constexpr uint32_t kTrailerSize = 4;
+constexpr uint32_t kMaxPayloadSize = 16 * 1024 * 1024;
+
+constexpr uint8_t kLiteral = 'L';
+constexpr uint8_t kU32 = 'U';
+constexpr uint8_t kInt32 = 'D';
+constexpr uint8_t kU64 = 'Q';
+constexpr uint8_t kChar = 'C';
+constexpr uint8_t kString = 'S';
+
+/*! \brief Appends tokens of a text produced by vprintf(format, ap) to the payload.
+ *
+ * Supports conversions used in changelog entries: %u, %d, %c, %s and %% with optional
+ * length modifiers.
+ * \return false if the format contains an unsupported conversion.
+ */
+bool appendTokens(std::vector<uint8_t> &payload, const char *format, va_list ap);
+
+void appendU32(std::vector<uint8_t> &payload, uint32_t value);
+void appendLiteral(std::vector<uint8_t> &payload, const char *text, uint32_t length);
+
+/*! \brief Builds a framed record (a single chunk of memory which can be written as is). */
+void frame(uint64_t version, const uint8_t *payload, uint32_t payloadSize,
+		std::vector<uint8_t> &record);
+
+/*! \brief Recreates the text entry (without the version) from a payload.
+ *
+ * \return false if the payload is malformed.
+ */
+bool toText(const uint8_t *payload, uint32_t payloadSize, std::string &text);
+
+enum class ParseStatus {
+	kOk,
+	kIncomplete,  ///< more data is needed to parse the record
+	kCorrupted    ///< bad marker, length or checksum
+};
+
+struct RecordView {
+	uint64_t version;
+	const uint8_t *payload;
+	uint32_t payloadSize;
+	uint32_t recordSize;  ///< size of the whole framed record
+};
+
+/*! \brief Parses (and verifies) a framed record from the beginning of the buffer. */
+ParseStatus parse(const uint8_t *data, uint64_t available, RecordView &record);
+
+} // namespace changelog_record
+
+/*! \brief Reads consecutive entries of a changelog file, both text and binary ones.
+ *
+ * A text line without the trailing LF and an incomplete binary record are treated as the end
+ * of the file, as they are a result of an interrupted write.
+ */
+class ChangelogFileReader {
+public:
+	enum class Status {
+		kEntry,
+		kEnd,
+		kCorrupted
+	};
+
+	struct Entry {
+		uint64_t version;
+		/// Only for text entries: the rest of the line after the version, i.e. ": <ts>|..."
+		const char *text;
+		/// Only for binary entries (text == nullptr)
+		const uint8_t *payload;
+		uint32_t payloadSize;
+	};
+
+	explicit ChangelogFileReader(const std::string &filename);
+	~ChangelogFileReader();
+
+	ChangelogFileReader(const ChangelogFileReader &) = delete;
+	ChangelogFileReader &operator=(const ChangelogFileReader &) = delete;
+
+	bool isOpen() const {
+		return fd_ != nullptr;
+	}
+
+	/*! \brief Reads the next entry, valid until the next call. */
+	Status next(Entry &entry);
+
+private:
+	FILE *fd_;
+	char *line_;
+	size_t lineSize_;
+	std::vector<uint8_t> record_;
+};
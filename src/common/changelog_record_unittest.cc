@@ -0,0 +1,107 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "common/changelog_record.h"
+
+#include <inttypes.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<uint8_t> encode(const char *format, ...) __attribute__((__format__(__printf__, 1, 2)));
+std::vector<uint8_t> encode(const char *format, ...) {
+	std::vector<uint8_t> payload;
+	va_list ap;
+	va_start(ap, format);
+	EXPECT_TRUE(changelog_record::appendTokens(payload, format, ap));
+	va_end(ap);
+	return payload;
+}
+
+std::string toText(const std::vector<uint8_t> &payload) {
+	std::string text;
+	EXPECT_TRUE(changelog_record::toText(payload.data(), payload.size(), text));
+	return text;
+}
+
+} // anonymous namespace
+
+TEST(ChangelogRecordTests, TokensRecreateText) {
+	EXPECT_EQ("ACCESS(5)", toText(encode("ACCESS(%" PRIu32 ")", uint32_t(5))));
+	EXPECT_EQ("CREATE(1,a%2Cb,f,420,0,0,0):17",
+			toText(encode("CREATE(%" PRIu32 ",%s,%c,%d,%" PRIu32 ",%" PRIu32 ",%" PRIu32 "):%" PRIu32,
+			uint32_t(1), "a%2Cb", 'f', 0644, uint32_t(0), uint32_t(0), uint32_t(0), uint32_t(17))));
+	EXPECT_EQ("FLCK(1,2,0,1,18446744073709551615,3,4)",
+			toText(encode("FLCK(%" PRIu8 ",%" PRIu32 ",0,1,%" PRIu64 ",%" PRIu32 ",%" PRIu16 ")",
+			uint8_t(1), uint32_t(2), UINT64_MAX, uint32_t(3), uint16_t(4))));
+	EXPECT_EQ("SESSION():7 100%", toText(encode("SESSION():%" PRIu32 " 100%%", uint32_t(7))));
+	EXPECT_EQ("", toText(encode("%s", "")));
+}
+
+TEST(ChangelogRecordTests, FrameAndParse) {
+	std::vector<uint8_t> payload = encode("UNLOCK(%" PRIu64 ")", uint64_t(1234567890123));
+	std::vector<uint8_t> record;
+	changelog_record::frame(42, payload.data(), payload.size(), record);
+	ASSERT_EQ(changelog_record::kMarker, record[0]);
+
+	changelog_record::RecordView view;
+	ASSERT_EQ(changelog_record::ParseStatus::kOk,
+			changelog_record::parse(record.data(), record.size(), view));
+	EXPECT_EQ(42U, view.version);
+	EXPECT_EQ(record.size(), view.recordSize);
+	EXPECT_EQ(payload, std::vector<uint8_t>(view.payload, view.payload + view.payloadSize));
+
+	EXPECT_EQ(changelog_record::ParseStatus::kIncomplete,
+			changelog_record::parse(record.data(), record.size() - 1, view));
+	record[changelog_record::kHeaderSize] ^= 1;
+	EXPECT_EQ(changelog_record::ParseStatus::kCorrupted,
+			changelog_record::parse(record.data(), record.size(), view));
+}
+
+TEST(ChangelogRecordTests, FileReader) {
+	char filename[] = "/tmp/changelog_record_unittest.XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	FILE *file = fdopen(fd, "w");
+	std::vector<uint8_t> payload = encode("%" PRIu32 "|PURGE(%" PRIu32 ")", uint32_t(1000), uint32_t(5));
+	std::vector<uint8_t> record;
+	for (uint64_t version = 10; version < 13; ++version) {
+		changelog_record::frame(version, payload.data(), payload.size(), record);
+		fwrite(record.data(), 1, record.size(), file);
+	}
+	fprintf(file, "13: 1000|PURGE(6)\n");
+	// an interrupted write
+	fwrite(record.data(), 1, record.size() - 2, file);
+	fclose(file);
+
+	ChangelogFileReader reader(filename);
+	ChangelogFileReader::Entry entry;
+	for (uint64_t version = 10; version < 13; ++version) {
+		ASSERT_EQ(ChangelogFileReader::Status::kEntry, reader.next(entry));
+		EXPECT_EQ(version, entry.version);
+		EXPECT_EQ(nullptr, entry.text);
+		EXPECT_EQ(payload, std::vector<uint8_t>(entry.payload, entry.payload + entry.payloadSize));
+	}
+	ASSERT_EQ(ChangelogFileReader::Status::kEntry, reader.next(entry));
+	EXPECT_EQ(13U, entry.version);
+	EXPECT_STREQ(": 1000|PURGE(6)", entry.text);
+	EXPECT_EQ(ChangelogFileReader::Status::kEnd, reader.next(entry));
+	unlink(filename);
+}
@@ -0,0 +1,38 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <cstdint>
+
+#include "common/chunk_part_type.h"
+#include "common/hashfn.h"
+
+/*! \brief Contribution of a chunk part to the checksum of a chunkserver's set of chunks.
+ *
+ * The checksum of a set is a xor of contributions of all its elements (see addToChecksum),
+ * so the chunkserver and the master can compute it enumerating parts in any order.
+ */
+inline uint64_t chunkSetChecksumEntry(uint64_t chunkId, uint32_t versionWithTodelFlag,
+		ChunkPartType type) {
+	uint64_t seed = 0;
+	hashCombine(seed, chunkId, versionWithTodelFlag, uint32_t(type.getId()));
+	return seed;
+}
@@ -21,6 +21,7 @@
 
 #include <inttypes.h>
 #include <stdlib.h>
+#include <atomic>
 #include <cstring>
 
 #include "protocol/MFSCommunication.h"
@@ -40,195 +41,312 @@ uint32_t mycrc32_combine(uint32_t, uint32_t, uint32_t) {
 void mycrc32_init(void) {
 }
 
+std::vector<Crc32Implementation> mycrc32_implementations() {
+	return {{"disabled", mycrc32}};
+}
+
 #else // ENABLE_CRC
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  define LIZARDFS_CRC_PCLMUL
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
 /*
  * CRC implementation from crcutil supports only little endian machines.
- * For big endian we provide legacy implementation.
  */
 #ifdef HAVE_CRCUTIL
 #include <generic_crc.h>
 
 static crcutil::GenericCrc<uint64_t, uint64_t, uint64_t, 4> gCrc(CRC_POLY, 32, true);
 
-uint32_t mycrc32(uint32_t crc, const uint8_t *block, uint32_t leng) {
+static uint32_t crc32_crcutil(uint32_t crc, const uint8_t *block, uint32_t leng) {
 	return gCrc.CrcDefault(block, leng, crc);
 }
+#endif // HAVE_CRCUTIL
 
-uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
-	return gCrc.Base().Concatenate(crc1, crc2, leng2);
-}
+/*
+ * All the functions below work on CRCs in the bit-reflected domain, where bit 31 is the
+ * coefficient of x^0 (the same as the bit order of CRC_POLY). Functions working on "raw"
+ * CRCs expect and return them without the pre- and post-inversion (crc ^ 0xFFFFFFFF).
+ */
 
-void mycrc32_init(void) {
-	// This implementation does not need any initialization
-}
-
-#else // Use old code, which supports both big endian and little endian
-
-#define BYTEREV(w) (((w)>>24)+(((w)>>8)&0xff00)+(((w)&0xff00)<<8)+(((w)&0xff)<<24))
-static uint32_t crc_table[4][256];
-
-void crc_generate_main_tables(void) {
-	uint32_t c,poly,i;
-
-	poly = CRC_POLY;
-	for (i=0; i<256; i++) {
-		c=i;
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-		c = (c&1) ? (poly^(c>>1)) : (c>>1);
-#ifdef WORDS_BIGENDIAN
-		crc_table[0][i] = BYTEREV(c);
-#else /* little endian */
-		crc_table[0][i] = c;
-#endif
+namespace {
+
+/* Tables for the slicing-by-16 algorithm; table[0] is the classic byte-at-a-time table. */
+struct CrcTables {
+	uint32_t table[16][256];
+
+	constexpr CrcTables() : table() {
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; ++bit) {
+				c = (c & 1) ? (CRC_POLY ^ (c >> 1)) : (c >> 1);
+			}
+			table[0][i] = c;
+		}
+		for (int k = 1; k < 16; ++k) {
+			for (uint32_t i = 0; i < 256; ++i) {
+				table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+			}
+		}
 	}
+};
 
-	for (i=0; i<256; i++) {
-#ifdef WORDS_BIGENDIAN
-		c = crc_table[0][i];
-		c = crc_table[0][(c>>24)]^(c<<8);
-		crc_table[1][i] = c;
-		c = crc_table[0][(c>>24)]^(c<<8);
-		crc_table[2][i] = c;
-		c = crc_table[0][(c>>24)]^(c<<8);
-		crc_table[3][i] = c;
-#else /* little endian */
-		c = crc_table[0][i];
-		c = crc_table[0][c&0xff]^(c>>8);
-		crc_table[1][i] = c;
-		c = crc_table[0][c&0xff]^(c>>8);
-		crc_table[2][i] = c;
-		c = crc_table[0][c&0xff]^(c>>8);
-		crc_table[3][i] = c;
-#endif
+constexpr CrcTables gCrcTables;
+
+/* Returns a * b modulo CRC_POLY. */
+constexpr uint32_t multiply_mod_poly(uint32_t a, uint32_t b) {
+	uint32_t product = 0;
+	for (uint32_t m = 1U << 31; a != 0; m >>= 1) {
+		if (a & m) {
+			product ^= b;
+			a ^= m;
+		}
+		b = (b & 1) ? ((b >> 1) ^ CRC_POLY) : (b >> 1);
 	}
+	return product;
 }
 
-uint32_t mycrc32(uint32_t crc,const uint8_t *block,uint32_t leng) {
-	const uint32_t *block4;
-#ifdef WORDS_BIGENDIAN
-#define CRC_REORDER crc=(BYTEREV(crc))^0xFFFFFFFF
-#define CRC_ONE_BYTE crc = crc_table[0][(crc >> 24) ^ *block++] ^ (crc << 8)
-#define CRC_FOUR_BYTES crc ^= *block4++; crc = crc_table[0][crc & 0xff] ^ crc_table[1][(crc >> 8) & 0xff] ^ crc_table[2][(crc >> 16) & 0xff] ^ crc_table[3][crc >> 24]
-#else /* little endian */
-#define CRC_REORDER crc^=0xFFFFFFFF
-#define CRC_ONE_BYTE crc = crc_table[0][(crc ^ *block++) & 0xFF] ^ (crc >> 8)
-#define CRC_FOUR_BYTES crc ^= *block4++; crc = crc_table[3][crc & 0xff] ^ crc_table[2][(crc >> 8) & 0xff] ^ crc_table[1][(crc >> 16) & 0xff] ^ crc_table[0][crc >> 24]
-#endif
-	CRC_REORDER;
-	while (leng && ((unsigned long)block & 3)) {
-		CRC_ONE_BYTE;
-		leng--;
+/* powers[k] = x^(2^k) modulo CRC_POLY */
+struct CrcPowers {
+	uint32_t powers[32];
+
+	constexpr CrcPowers() : powers() {
+		uint32_t p = 1U << 30; // x^1
+		powers[0] = p;
+		for (int k = 1; k < 32; ++k) {
+			p = multiply_mod_poly(p, p);
+			powers[k] = p;
+		}
 	}
-	block4 = (const uint32_t*)block;
-	while (leng>=32) {
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		CRC_FOUR_BYTES;
-		leng-=32;
+};
+
+constexpr CrcPowers gCrcPowers;
+
+inline uint32_t load32le(const uint8_t *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+			| ((uint32_t)p[3] << 24);
+}
+
+uint32_t crc32_raw_slicing16(uint32_t crc, const uint8_t *block, uint32_t leng) {
+	const auto &t = gCrcTables.table;
+	while (leng >= 16) {
+		uint32_t one = load32le(block) ^ crc;
+		uint32_t two = load32le(block + 4);
+		uint32_t three = load32le(block + 8);
+		uint32_t four = load32le(block + 12);
+		crc = t[15][one & 0xFF] ^ t[14][(one >> 8) & 0xFF]
+				^ t[13][(one >> 16) & 0xFF] ^ t[12][one >> 24]
+				^ t[11][two & 0xFF] ^ t[10][(two >> 8) & 0xFF]
+				^ t[9][(two >> 16) & 0xFF] ^ t[8][two >> 24]
+				^ t[7][three & 0xFF] ^ t[6][(three >> 8) & 0xFF]
+				^ t[5][(three >> 16) & 0xFF] ^ t[4][three >> 24]
+				^ t[3][four & 0xFF] ^ t[2][(four >> 8) & 0xFF]
+				^ t[1][(four >> 16) & 0xFF] ^ t[0][four >> 24];
+		block += 16;
+		leng -= 16;
 	}
-	while (leng>=4) {
-		CRC_FOUR_BYTES;
-		leng-=4;
+	while (leng > 0) {
+		crc = t[0][(crc ^ *block++) & 0xFF] ^ (crc >> 8);
+		--leng;
 	}
-	block = (const uint8_t*)block4;
-	if (leng) do {
-		CRC_ONE_BYTE;
-	} while (--leng);
-	CRC_REORDER;
 	return crc;
 }
 
-/* crc_combine */
+uint32_t crc32_slicing16(uint32_t crc, const uint8_t *block, uint32_t leng) {
+	return crc32_raw_slicing16(crc ^ 0xFFFFFFFF, block, leng) ^ 0xFFFFFFFF;
+}
 
-static uint32_t crc_combine_table[32][4][256];
+#ifdef LIZARDFS_CRC_PCLMUL
 
-static void crc_matrix_square(uint32_t sqr[32], uint32_t m[32]) {
-	uint32_t i,j,s,v;
-	for (i=0; i<32; i++) {
-		for (j=0,s=0,v=m[i] ; v && j<32 ; j++, v>>=1) {
-			if (v&1) {
-				s^=m[j];
-			}
-		}
-		sqr[i] = s;
+bool cpu_has_pclmul() {
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		return false;
 	}
+	const unsigned kPclmulBit = 1U << 1;
+	const unsigned kSse41Bit = 1U << 19;
+	return (ecx & kPclmulBit) && (ecx & kSse41Bit);
 }
 
-static void crc_generate_combine_tables(void) {
-	uint32_t i,j,k,l,sum;
-	uint32_t m1[32],m2[32],*mc,*m;
-	m1[0]=CRC_POLY;
-	j=1;
-	for (i=1 ; i<32 ; i++) {
-		m1[i]=j;
-		j<<=1;
+/*
+ * Folds 64 bytes at a time with carry-less multiplication, as described in Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction" (constants for the
+ * bit-reflected CRC-32 polynomial are taken from the paper). Requires leng >= 64 and
+ * leng % 16 == 0.
+ */
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32_raw_pclmul_fold(uint32_t crc, const uint8_t *block, uint32_t leng) {
+	alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+	alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+	alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+	alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x1 = _mm_loadu_si128((const __m128i *)(block + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(block + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(block + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(block + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128((const __m128i *)k1k2);
+	block += 64;
+	leng -= 64;
+
+	// Fold four 128-bit lanes in parallel
+	while (leng >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		y5 = _mm_loadu_si128((const __m128i *)(block + 0x00));
+		y6 = _mm_loadu_si128((const __m128i *)(block + 0x10));
+		y7 = _mm_loadu_si128((const __m128i *)(block + 0x20));
+		y8 = _mm_loadu_si128((const __m128i *)(block + 0x30));
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+		block += 64;
+		leng -= 64;
+	}
+
+	// Fold the lanes into one
+	x0 = _mm_load_si128((const __m128i *)k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// Fold the remaining 16-byte blocks
+	while (leng >= 16) {
+		x2 = _mm_loadu_si128((const __m128i *)block);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		block += 16;
+		leng -= 16;
 	}
-	crc_matrix_square(m2,m1); // 1 bit -> 2 bits
-	crc_matrix_square(m1,m2); // 2 bits -> 4 bits
-
-	for (i=0 ; i<32 ; i++) {
-		if (i&1) {
-			crc_matrix_square(m1,m2);
-			mc = m1;
-		} else {
-			crc_matrix_square(m2,m1);
-			mc = m2;
-		}
-		for (j=0 ; j<4 ; j++) {
-			for (k=0 ; k<256 ; k++) {
-				sum = 0;
-				l=k;
-				m=mc+(j*8);
-				while (l) {
-					if (l&1) {
-						sum ^= *m;
-					}
-					l>>=1;
-					m++;
-				}
-				crc_combine_table[i][j][k]=sum;
-			}
-		}
+
+	// Fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+	x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x0 = _mm_load_si128((const __m128i *)poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return _mm_extract_epi32(x1, 1);
+}
+
+uint32_t crc32_pclmul(uint32_t crc, const uint8_t *block, uint32_t leng) {
+	crc ^= 0xFFFFFFFF;
+	if (leng >= 64) {
+		uint32_t folded = leng & ~15U;
+		crc = crc32_raw_pclmul_fold(crc, block, folded);
+		block += folded;
+		leng -= folded;
 	}
+	return crc32_raw_slicing16(crc, block, leng) ^ 0xFFFFFFFF;
+}
+
+/*
+ * Returns a * b modulo CRC_POLY. The 63-bit reflected product is split into its part of degree
+ * below 32, which needs no reduction, and the rest, which is multiplied by x^32 like a CRC fed
+ * with four zero bytes.
+ */
+__attribute__((target("pclmul,sse4.1")))
+uint32_t multiply_mod_poly_pclmul(uint32_t a, uint32_t b) {
+	__m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(a), _mm_cvtsi32_si128(b), 0x00);
+	uint64_t reflected = (uint64_t)_mm_cvtsi128_si64(product) << 1;
+	uint32_t low = reflected >> 32;
+	uint32_t high = (uint32_t)reflected;
+	const auto &t = gCrcTables.table;
+	return low ^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF]
+			^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+}
+
+bool use_pclmul() {
+	static const bool supported = cpu_has_pclmul();
+	return supported;
+}
+
+#endif // LIZARDFS_CRC_PCLMUL
+
+typedef uint32_t (*Crc32Function)(uint32_t, const uint8_t*, uint32_t);
+
+uint32_t crc32_dispatch(uint32_t crc, const uint8_t *block, uint32_t leng);
+
+// Resolved on the first use, so that mycrc32 works even before mycrc32_init is called
+std::atomic<Crc32Function> gCrc32Function(crc32_dispatch);
+
+uint32_t crc32_dispatch(uint32_t crc, const uint8_t *block, uint32_t leng) {
+	Crc32Function function = mycrc32_implementations().front().function;
+	gCrc32Function.store(function, std::memory_order_relaxed);
+	return function(crc, block, leng);
+}
+
+} // anonymous namespace
+
+uint32_t mycrc32(uint32_t crc, const uint8_t *block, uint32_t leng) {
+	return gCrc32Function.load(std::memory_order_relaxed)(crc, block, leng);
 }
 
 uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
-	uint8_t i;
-
-	/* add leng2 zeros to crc1 */
-	i=0;
-	while (leng2) {
-		if (leng2&1) {
-			crc1 = crc_combine_table[i][3][(crc1>>24)] \
-			     ^ crc_combine_table[i][2][(crc1>>16)&0xFF] \
-			     ^ crc_combine_table[i][1][(crc1>>8)&0xFF] \
-			     ^ crc_combine_table[i][0][crc1&0xFF];
+	// crc1 has to be multiplied by x^(8 * leng2), which is a product of some powers x^(2^k)
+	auto multiply = multiply_mod_poly;
+#ifdef LIZARDFS_CRC_PCLMUL
+	if (use_pclmul()) {
+		multiply = multiply_mod_poly_pclmul;
+	}
+#endif
+	uint32_t shift = 1U << 31; // x^0
+	for (unsigned k = 3; leng2 != 0; leng2 >>= 1, ++k) {
+		if (leng2 & 1) {
+			shift = multiply(gCrcPowers.powers[k & 31], shift);
 		}
-		i++;
-		leng2>>=1;
-	};
-	/* then combine crc1 and crc2 as output */
-	return crc1^crc2;
+	}
+	return multiply(shift, crc1) ^ crc2;
 }
 
 void mycrc32_init(void) {
-	crc_generate_main_tables();
-	crc_generate_combine_tables();
+	gCrc32Function.store(mycrc32_implementations().front().function, std::memory_order_relaxed);
 }
 
-#endif // HAVE_CRCUTIL
+std::vector<Crc32Implementation> mycrc32_implementations() {
+	std::vector<Crc32Implementation> implementations;
+#ifdef LIZARDFS_CRC_PCLMUL
+	if (use_pclmul()) {
+		implementations.push_back({"pclmul", crc32_pclmul});
+	}
+#endif
+#ifdef HAVE_CRCUTIL
+	implementations.push_back({"crcutil", crc32_crcutil});
+#endif
+	implementations.push_back({"slicing-by-16", crc32_slicing16});
+	return implementations;
+}
 
 #endif // ENABLE_CRC
 
@@ -21,6 +21,7 @@
 #include "common/platform.h"
 
 #include <inttypes.h>
+#include <vector>
 
 uint32_t mycrc32(uint32_t crc,const uint8_t *block,uint32_t leng);
 uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2);
@@ -29,6 +30,17 @@ uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2);
 #define mycrc32_xorblocks(crc,crcblock1,crcblock2,leng) ((crcblock1)^(crcblock2)^mycrc32_zeroblock(crc,leng))
 
 void mycrc32_init(void);
+
+struct Crc32Implementation {
+	const char *name;
+	uint32_t (*function)(uint32_t crc, const uint8_t *block, uint32_t leng);
+};
+
+/**
+ * Returns implementations of mycrc32 which can be used on this machine, the fastest first.
+ * mycrc32 uses the first of them. Meant for tests and benchmarks.
+ */
+std::vector<Crc32Implementation> mycrc32_implementations();
 /**
  * In the special case when the block consists only of zeros and passed crc is equal to 0 update
  * crc to be equal to mycrc32_zeroblock(0, MFSBLOCKSIZE)
@@ -20,6 +20,7 @@
 #include "common/crc.h"
 
 #include <string>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "protocol/MFSCommunication.h"
@@ -61,3 +62,39 @@ TEST(CrcTests, MyCrc32Combine) {
 		}
 	}
 }
+
+TEST(CrcTests, ImplementationsAgree) {
+	std::vector<uint8_t> data(3 * MFSBLOCKSIZE + 17);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = (i * 7919) >> 3;
+	}
+	auto implementations = mycrc32_implementations();
+	ASSERT_FALSE(implementations.empty());
+	const auto &reference = implementations.back();
+	for (const auto &implementation : implementations) {
+		SCOPED_TRACE(std::string("Implementation ") + implementation.name);
+		for (uint32_t offset : {0, 1, 3, 8, 15}) {
+			for (uint32_t length : {0, 1, 15, 16, 63, 64, 65, 100, 1000, 4096, MFSBLOCKSIZE,
+					MFSBLOCKSIZE + 13, 3 * MFSBLOCKSIZE}) {
+				SCOPED_TRACE("offset " + std::to_string(offset) + ", length " + std::to_string(length));
+				EXPECT_EQ(reference.function(0x12345678, data.data() + offset, length),
+						implementation.function(0x12345678, data.data() + offset, length));
+			}
+		}
+	}
+}
+
+TEST(CrcTests, MyCrc32CombineLongBlocks) {
+	std::vector<uint8_t> data(MFSBLOCKSIZE);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = i * 13;
+	}
+	std::vector<uint32_t> zeroCounts{1, 255, 4096, MFSBLOCKSIZE, 16 * MFSBLOCKSIZE + 12345};
+	for (uint32_t zeros : zeroCounts) {
+		SCOPED_TRACE("zeros " + std::to_string(zeros));
+		std::vector<uint8_t> withZeros(data);
+		withZeros.resize(data.size() + zeros, 0);
+		EXPECT_EQ(mycrc32(0, withZeros.data(), withZeros.size()),
+				mycrc32_zeroexpanded(0, data.data(), data.size(), zeros));
+	}
+}
@@ -16,10 +16,12 @@
    along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#pragma once
 
 #include "common/platform.h"
 
 #include <cstdint>
+#include <vector>
 
 /*! \brief Create Vandermonde encoding matrix for Reed-Solomon.
  *
@@ -86,3 +88,15 @@ void ec_init_tables(int k, int rows, uint8_t *a, uint8_t *g_tbls);
  * \param coding Array of pointers to coded output buffers.
  */
 void ec_encode_data(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest);
+
+/*! \brief Variant of ec_encode_data built for a particular instruction set. */
+struct EcEncodeImplementation {
+	const char *name;
+	void (*function)(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest);
+};
+
+/*! \brief Returns variants of ec_encode_data usable on this CPU, fastest first.
+ *
+ * The first one is used by ec_encode_data. Meant for tests and benchmarks.
+ */
+std::vector<EcEncodeImplementation> ec_encode_data_implementations();
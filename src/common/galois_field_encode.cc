@@ -17,17 +17,21 @@
  */
 
 #include "common/platform.h"
+#include "common/galois_field.h"
 
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
 #if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >=8)
 
 #if defined(LIZARDFS_HAVE_CPU_CHECK)
 
-void ec_encode_data_default(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest) {
+/* Computes bytes [begin, end) of each destination. */
+static void ec_encode_data_range(int begin, int end, int srcs, int dests, uint8_t *v,
+		uint8_t **src, uint8_t **dest) {
 	for (int l = 0; l < dests; l++) {
-		for (int i = 0; i < len; i++) {
+		for (int i = begin; i < end; i++) {
 			uint8_t s = 0;
 			uint8_t *tbl = v;
 			for (int j = 0; j < srcs; j++) {
@@ -46,6 +50,10 @@ void ec_encode_data_default(int len, int srcs, int dests, uint8_t *v, uint8_t **
 	}
 }
 
+void ec_encode_data_default(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest) {
+	ec_encode_data_range(0, len, srcs, dests, v, src, dest);
+}
+
 __attribute__((target("ssse3")))
 void ec_encode_data_ssse3(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest) {
 	typedef uint8_t v16u __attribute__((vector_size(16)));
@@ -147,79 +155,193 @@ void ec_encode_data_avx(int len, int srcs, int dests, uint8_t *v, uint8_t **src,
 
 #include "immintrin.h"
 
+/*
+ * Wide kernels below compute up to kDests destinations in one pass, so every source vector
+ * is loaded (and split into nibbles) only once for all of them. The dispatcher splits
+ * destinations into such groups.
+ */
+static const int kEcMaxDestsInPass = 4;
+
+template <int kDests>
 __attribute__((target("avx2")))
-void ec_encode_data_avx2(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest) {
-	typedef uint8_t v32u __attribute__((vector_size(32)));
-	typedef uint16_t v16ui __attribute__((vector_size(32)));
-	typedef uint8_t v32u_unaligned __attribute__((vector_size(32), aligned(1)));
-	typedef uint16_t v16ui_unaligned __attribute__((vector_size(32), aligned(1)));
+static void ec_encode_pass_avx2(int len, int srcs, uint8_t *v, uint8_t **src, uint8_t **dest) {
+	const __m256i low_mask = _mm256_set1_epi8(0x0F);
+	int i = 0;
+
+	for (; (i + 32) <= len; i += 32) {
+		__m256i s[kDests];
+		for (int d = 0; d < kDests; d++) {
+			s[d] = _mm256_setzero_si256();
+		}
+		for (int j = 0; j < srcs; j++) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(src[j] + i));
+			__m256i a_lo = _mm256_and_si256(a, low_mask);
+			__m256i a_hi = _mm256_and_si256(_mm256_srli_epi64(a, 4), low_mask);
+			for (int d = 0; d < kDests; d++) {
+				const uint8_t *tbl = v + (d * srcs + j) * 32;
+				__m256i tbl_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tbl));
+				__m256i tbl_hi =
+				    _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(tbl + 16)));
+				s[d] = _mm256_xor_si256(s[d], _mm256_xor_si256(_mm256_shuffle_epi8(tbl_lo, a_lo),
+				                                               _mm256_shuffle_epi8(tbl_hi, a_hi)));
+			}
+		}
+		for (int d = 0; d < kDests; d++) {
+			_mm256_storeu_si256((__m256i *)(dest[d] + i), s[d]);
+		}
+	}
 
-	for (int l = 0; l < dests; l++) {
-		int i = 0;
+	ec_encode_data_range(i, len, srcs, kDests, v, src, dest);
+}
 
-		for (; (i + 32) <= len; i += 32) {
-			uint8_t *tbl = v;
-			v32u s = {0};
-			for (int j = 0; j < srcs; j++) {
-				v16ui a = *(v16ui_unaligned *)(src[j] + i);
+#if __GNUC__ >= 6
 
-				v32u tbl_lo = *(v32u_unaligned *)tbl;
+template <int kDests>
+__attribute__((target("avx2,avx512f,avx512bw")))
+static void ec_encode_pass_avx512(int len, int srcs, uint8_t *v, uint8_t **src, uint8_t **dest) {
+	const __m512i low_mask = _mm512_set1_epi8(0x0F);
+	int i = 0;
 
-				v32u tbl_hi =
-				    (v32u)_mm256_permute2x128_si256((__m256i)tbl_lo, (__m256i)tbl_lo, 0x11);
-				tbl_lo = (v32u)_mm256_permute2x128_si256((__m256i)tbl_lo, (__m256i)tbl_lo, 0x00);
+	for (; (i + 64) <= len; i += 64) {
+		__m512i s[kDests];
+		for (int d = 0; d < kDests; d++) {
+			s[d] = _mm512_setzero_si512();
+		}
+		for (int j = 0; j < srcs; j++) {
+			__m512i a = _mm512_loadu_si512((const void *)(src[j] + i));
+			__m512i a_lo = _mm512_and_si512(a, low_mask);
+			__m512i a_hi = _mm512_and_si512(_mm512_srli_epi64(a, 4), low_mask);
+			for (int d = 0; d < kDests; d++) {
+				const uint8_t *tbl = v + (d * srcs + j) * 32;
+				__m512i tbl_lo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)tbl));
+				__m512i tbl_hi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)(tbl + 16)));
+				s[d] = _mm512_xor_si512(s[d], _mm512_xor_si512(_mm512_shuffle_epi8(tbl_lo, a_lo),
+				                                               _mm512_shuffle_epi8(tbl_hi, a_hi)));
+			}
+		}
+		for (int d = 0; d < kDests; d++) {
+			_mm512_storeu_si512((void *)(dest[d] + i), s[d]);
+		}
+	}
 
-				v32u mask_lo = (v32u)(a & 0xF0F);
-				v32u mask_hi = (v32u)((a >> 4) & 0xF0F);
+	ec_encode_data_range(i, len, srcs, kDests, v, src, dest);
+}
 
-				s ^= (v32u)_mm256_shuffle_epi8((__m256i)tbl_lo, (__m256i)mask_lo) ^
-				     (v32u)_mm256_shuffle_epi8((__m256i)tbl_hi, (__m256i)mask_hi);
+#endif // __GNUC__ >= 6
 
-				tbl += 32;
-			}
+#if __GNUC__ >= 9
 
-			*(v32u_unaligned *)(dest[l] + i) = s;
+/*
+ * Multiplication by a constant is a linear map over GF(2), so it can be done with a single
+ * GF2P8AFFINEQB instruction, whatever the field polynomial is. Returns the 8x8 bit matrix
+ * of that map built from the 32-byte table of the constant (see ec_init_tables): row for
+ * output bit i is stored in byte 7 - i and has bit j set if bit i of (c * x^j) is set.
+ */
+static uint64_t ec_affine_matrix(const uint8_t *tbl) {
+	uint8_t products[8];
+	for (int j = 0; j < 4; j++) {
+		products[j] = tbl[1 << j];
+		products[j + 4] = tbl[16 + (1 << j)];
+	}
+	uint64_t matrix = 0;
+	for (int i = 0; i < 8; i++) {
+		uint64_t row = 0;
+		for (int j = 0; j < 8; j++) {
+			row |= (uint64_t)((products[j] >> i) & 1) << j;
 		}
+		matrix |= row << (8 * (7 - i));
+	}
+	return matrix;
+}
 
-		for (; i < len; i++) {
-			uint8_t s = 0;
-			uint8_t *tbl = v;
-			for (int j = 0; j < srcs; j++) {
-				uint8_t a = src[j][i];
-				uint8_t *tbl_lo = tbl;
-				uint8_t *tbl_hi = tbl + 16;
-
-				s ^= tbl_lo[a & 0xF] ^ tbl_hi[a >> 4];
+template <int kDests>
+__attribute__((target("avx2,avx512f,avx512bw,gfni")))
+static void ec_encode_pass_gfni(int len, int srcs, uint8_t *v, uint8_t **src, uint8_t **dest) {
+	std::vector<uint64_t> matrices(kDests * srcs);
+	for (int k = 0; k < kDests * srcs; k++) {
+		matrices[k] = ec_affine_matrix(v + k * 32);
+	}
+	int i = 0;
 
-				tbl += 32;
+	for (; (i + 64) <= len; i += 64) {
+		__m512i s[kDests];
+		for (int d = 0; d < kDests; d++) {
+			s[d] = _mm512_setzero_si512();
+		}
+		for (int j = 0; j < srcs; j++) {
+			__m512i a = _mm512_loadu_si512((const void *)(src[j] + i));
+			for (int d = 0; d < kDests; d++) {
+				__m512i matrix = _mm512_set1_epi64(matrices[d * srcs + j]);
+				s[d] = _mm512_xor_si512(s[d], _mm512_gf2p8affine_epi64_epi8(a, matrix, 0));
 			}
-
-			dest[l][i] = s;
 		}
-		v += srcs * 32;
+		for (int d = 0; d < kDests; d++) {
+			_mm512_storeu_si512((void *)(dest[d] + i), s[d]);
+		}
 	}
+
+	ec_encode_data_range(i, len, srcs, kDests, v, src, dest);
 }
 
+#endif // __GNUC__ >= 9
+
+#define LIZARDFS_EC_ENCODE_IN_PASSES(name, pass) \
+	void name(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest) { \
+		for (; dests >= kEcMaxDestsInPass; dests -= kEcMaxDestsInPass) { \
+			pass<kEcMaxDestsInPass>(len, srcs, v, src, dest); \
+			v += kEcMaxDestsInPass * srcs * 32; \
+			dest += kEcMaxDestsInPass; \
+		} \
+		switch (dests) { \
+			case 3: pass<3>(len, srcs, v, src, dest); break; \
+			case 2: pass<2>(len, srcs, v, src, dest); break; \
+			case 1: pass<1>(len, srcs, v, src, dest); break; \
+		} \
+	}
+
+LIZARDFS_EC_ENCODE_IN_PASSES(ec_encode_data_avx2, ec_encode_pass_avx2)
+#if __GNUC__ >= 6
+LIZARDFS_EC_ENCODE_IN_PASSES(ec_encode_data_avx512, ec_encode_pass_avx512)
+#endif
+#if __GNUC__ >= 9
+LIZARDFS_EC_ENCODE_IN_PASSES(ec_encode_data_gfni, ec_encode_pass_gfni)
 #endif
 
-typedef void (*encode_function_type)(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest);
+#endif // __GNUC__ >= 5
 
-static encode_function_type ec_get_encode_function() {
+std::vector<EcEncodeImplementation> ec_encode_data_implementations() {
+	std::vector<EcEncodeImplementation> implementations;
 	__builtin_cpu_init();
 
+#if __GNUC__ >= 9
+	if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("gfni")) {
+		implementations.push_back({"gfni", ec_encode_data_gfni});
+	}
+#endif
+#if __GNUC__ >= 6
+	if (__builtin_cpu_supports("avx512bw")) {
+		implementations.push_back({"avx512", ec_encode_data_avx512});
+	}
+#endif
 #if __GNUC__ >= 5
 	if (__builtin_cpu_supports("avx2")) {
-		return ec_encode_data_avx2;
+		implementations.push_back({"avx2", ec_encode_data_avx2});
 	}
 #endif
 	if (__builtin_cpu_supports("avx")) {
-		return ec_encode_data_avx;
+		implementations.push_back({"avx", ec_encode_data_avx});
 	}
 	if (__builtin_cpu_supports("ssse3")) {
-		return ec_encode_data_ssse3;
+		implementations.push_back({"ssse3", ec_encode_data_ssse3});
 	}
+	implementations.push_back({"default", ec_encode_data_default});
+	return implementations;
+}
+
+typedef void (*encode_function_type)(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uint8_t **dest);
 
-	return ec_encode_data_default;
+static encode_function_type ec_get_encode_function() {
+	return ec_encode_data_implementations().front().function;
 }
 
 static encode_function_type gEncodeFunction = ec_get_encode_function();
@@ -278,6 +400,10 @@ void ec_encode_data(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uin
 	}
 }
 
+std::vector<EcEncodeImplementation> ec_encode_data_implementations() {
+	return {{"default", ec_encode_data}};
+}
+
 #endif
 
 #else
@@ -303,4 +429,8 @@ void ec_encode_data(int len, int srcs, int dests, uint8_t *v, uint8_t **src, uin
 	}
 }
 
+std::vector<EcEncodeImplementation> ec_encode_data_implementations() {
+	return {{"default", ec_encode_data}};
+}
+
 #endif
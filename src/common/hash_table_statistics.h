@@ -0,0 +1,30 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+#include "common/serialization_macros.h"
+
+/// memoryUsage is the memory used by the table together with its elements, 0 if not known
+LIZARDFS_DEFINE_SERIALIZABLE_CLASS(HashTableStatistics,
+		std::string, name,
+		uint64_t, elements,
+		uint32_t, buckets,
+		uint32_t, usedBuckets,
+		uint64_t, memoryUsage);
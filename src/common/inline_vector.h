@@ -0,0 +1,343 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+/*! \brief Vector keeping up to N elements inside the object.
+ *
+ * Unlike small_vector, which keeps its local buffer next to a whole std::vector, here the local
+ * buffer shares space with the pointer to the heap array. The object takes only N elements and
+ * a Size counter, which makes it suitable for keeping many short sequences in place
+ * (e.g. parts of chunks in master). Elements are kept in the local buffer whenever they fit.
+ *
+ * The heap pointer is stored byte-wise, so the alignment of the vector is the alignment of T
+ * (or Size), not of a pointer.
+ *
+ * T must be trivially destructible, Alloc must be an empty allocator.
+ */
+template <typename T, std::size_t N, typename Size = uint16_t, typename Alloc = std::allocator<T>>
+class inline_vector : private Alloc {
+	static_assert(N > 0, "inline_vector needs space for at least one element");
+	static_assert(std::is_trivially_destructible<T>::value,
+			"inline_vector requires trivially destructible elements");
+	static_assert(std::is_empty<Alloc>::value, "inline_vector requires empty Allocator type");
+	static_assert(N <= std::numeric_limits<Size>::max(), "Size is too small for N elements");
+
+	typedef std::allocator_traits<Alloc> alloc_traits;
+
+public:
+	typedef T value_type;
+	typedef Size size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+
+	inline_vector() : size_() {
+	}
+
+	inline_vector(const inline_vector &other) : Alloc(other), size_() {
+		assign(other.begin(), other.end());
+	}
+
+	inline_vector(inline_vector &&other) noexcept : Alloc(std::move(other)), size_() {
+		steal(other);
+	}
+
+	~inline_vector() {
+		release();
+	}
+
+	inline_vector &operator=(const inline_vector &other) {
+		if (this != &other) {
+			assign(other.begin(), other.end());
+		}
+		return *this;
+	}
+
+	inline_vector &operator=(inline_vector &&other) noexcept {
+		if (this != &other) {
+			release();
+			steal(other);
+		}
+		return *this;
+	}
+
+	template <typename InputIterator>
+	void assign(InputIterator first, InputIterator last) {
+		clear();
+		for (; first != last; ++first) {
+			push_back(*first);
+		}
+	}
+
+	iterator begin() {
+		return data();
+	}
+
+	const_iterator begin() const {
+		return data();
+	}
+
+	iterator end() {
+		return data() + size_;
+	}
+
+	const_iterator end() const {
+		return data() + size_;
+	}
+
+	pointer data() {
+		return is_inline() ? local() : heap_ptr();
+	}
+
+	const_pointer data() const {
+		return is_inline() ? local() : heap_ptr();
+	}
+
+	size_type size() const {
+		return size_;
+	}
+
+	bool empty() const {
+		return size_ == 0;
+	}
+
+	size_type capacity() const {
+		return is_inline() ? N : heap_capacity();
+	}
+
+	static constexpr size_type inline_capacity() {
+		return N;
+	}
+
+	constexpr size_type max_size() const {
+		return std::numeric_limits<Size>::max();
+	}
+
+	/*! \brief Is the data kept inside the object (not on the heap). */
+	bool is_inline() const {
+		return size_ <= N;
+	}
+
+	reference operator[](size_type i) {
+		assert(i < size_);
+		return data()[i];
+	}
+
+	const_reference operator[](size_type i) const {
+		assert(i < size_);
+		return data()[i];
+	}
+
+	reference front() {
+		assert(!empty());
+		return *begin();
+	}
+
+	const_reference front() const {
+		assert(!empty());
+		return *begin();
+	}
+
+	reference back() {
+		assert(!empty());
+		return *(end() - 1);
+	}
+
+	const_reference back() const {
+		assert(!empty());
+		return *(end() - 1);
+	}
+
+	void push_back(const T &value) {
+		emplace_back(value);
+	}
+
+	template <typename... Args>
+	reference emplace_back(Args &&... args) {
+		// the element is created before growing, as args may refer to elements of this vector
+		T value(std::forward<Args>(args)...);
+		if (size_ < N) {
+			::new (static_cast<void *>(local() + size_)) T(std::move(value));
+		} else {
+			if (size_ == capacity()) {
+				grow();
+			}
+			::new (static_cast<void *>(heap_ptr() + size_)) T(std::move(value));
+		}
+		++size_;
+		return back();
+	}
+
+	void pop_back() {
+		assert(!empty());
+		erase(end() - 1, end());
+	}
+
+	iterator erase(const_iterator position) {
+		return erase(position, position + 1);
+	}
+
+	iterator erase(const_iterator first, const_iterator last) {
+		iterator begin_it = begin();
+		size_type offset = first - begin_it;
+		size_type count = last - first;
+		assert(first >= begin_it && last <= end() && first <= last);
+		std::move(begin_it + offset + count, end(), begin_it + offset);
+		size_type new_size = size_ - count;
+		if (!is_inline() && new_size <= N) {
+			// move back to the local buffer, it overlaps the heap pointer so read it first
+			pointer heap = heap_ptr();
+			size_type heap_cap = heap_capacity();
+			std::uninitialized_copy(heap, heap + new_size, local());
+			alloc_traits::deallocate(allocator(), heap, heap_cap);
+		}
+		size_ = new_size;
+		return begin() + offset;
+	}
+
+	void clear() {
+		release();
+		size_ = 0;
+	}
+
+	void resize(size_type count) {
+		resize(count, T());
+	}
+
+	/*! \brief Resizes the vector, a growing heap array gets exactly \p count elements. */
+	void resize(size_type count, const T &value) {
+		if (count <= size_) {
+			erase(begin() + count, end());
+			return;
+		}
+		T fill(value);
+		if (count > N && count > capacity()) {
+			reallocate(count);
+		}
+		pointer p = count > N ? heap_ptr() : local();
+		std::uninitialized_fill(p + size_, p + count, fill);
+		size_ = count;
+	}
+
+	void swap(inline_vector &other) {
+		inline_vector tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+	}
+
+private:
+	struct heap_data {
+		unsigned char ptr[sizeof(T *)];
+		Size capacity;
+	};
+
+	Alloc &allocator() {
+		return *static_cast<Alloc *>(this);
+	}
+
+	pointer local() {
+		return reinterpret_cast<pointer>(&storage_);
+	}
+
+	const_pointer local() const {
+		return reinterpret_cast<const_pointer>(&storage_);
+	}
+
+	pointer heap_ptr() const {
+		pointer p;
+		std::memcpy(&p, storage_.heap.ptr, sizeof(p));
+		return p;
+	}
+
+	size_type heap_capacity() const {
+		return storage_.heap.capacity;
+	}
+
+	void set_heap(pointer p, size_type capacity) {
+		std::memcpy(storage_.heap.ptr, &p, sizeof(p));
+		storage_.heap.capacity = capacity;
+	}
+
+	void grow() {
+		if (size_ == max_size()) {
+			throw std::length_error("inline_vector: too many elements");
+		}
+		reallocate(std::min<std::size_t>(std::max<std::size_t>(2 * size_, 4), max_size()));
+	}
+
+	// Moves the elements to a new heap array, new_capacity has to be greater than N
+	void reallocate(size_type new_capacity) {
+		assert(new_capacity > N && new_capacity >= size_);
+		pointer p = alloc_traits::allocate(allocator(), new_capacity);
+		std::uninitialized_copy(data(), data() + size_, p);
+		if (!is_inline()) {
+			alloc_traits::deallocate(allocator(), heap_ptr(), heap_capacity());
+		}
+		set_heap(p, new_capacity);
+	}
+
+	// Frees the heap array (if any), leaves size_ unchanged
+	void release() {
+		if (!is_inline()) {
+			alloc_traits::deallocate(allocator(), heap_ptr(), heap_capacity());
+		}
+	}
+
+	void steal(inline_vector &other) {
+		if (other.is_inline()) {
+			std::uninitialized_copy(other.local(), other.local() + other.size_, local());
+		} else {
+			set_heap(other.heap_ptr(), other.heap_capacity());
+		}
+		size_ = other.size_;
+		other.size_ = 0;
+	}
+
+	union storage {
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type local[N];
+		heap_data heap;
+	} storage_;
+	Size size_;
+};
+
+template <typename T, std::size_t N, typename Size, typename Alloc>
+bool operator==(const inline_vector<T, N, Size, Alloc> &a, const inline_vector<T, N, Size, Alloc> &b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template <typename T, std::size_t N, typename Size, typename Alloc>
+bool operator!=(const inline_vector<T, N, Size, Alloc> &a, const inline_vector<T, N, Size, Alloc> &b) {
+	return !(a == b);
+}
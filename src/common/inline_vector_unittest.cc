@@ -0,0 +1,152 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "common/inline_vector.h"
+
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+
+template <typename T, std::size_t N, typename Size>
+bool operator==(const inline_vector<T, N, Size> &a, const std::vector<T> &b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+struct Part {
+	uint32_t version;
+	uint8_t type;
+	uint16_t id;
+
+	bool operator==(const Part &other) const {
+		return version == other.version && type == other.type && id == other.id;
+	}
+};
+
+TEST(InlineVectorTest, Size) {
+	// the heap pointer doesn't add its alignment
+	EXPECT_EQ(20U, sizeof(inline_vector<Part, 2>));
+	EXPECT_EQ(4U, alignof(inline_vector<Part, 2>));
+	EXPECT_EQ(10U, sizeof(inline_vector<uint8_t, 9, uint8_t>));
+}
+
+TEST(InlineVectorTest, PushBackAndErase) {
+	inline_vector<int, 3> vec;
+	std::vector<int> expected;
+	EXPECT_TRUE(vec.empty());
+	for (int i = 0; i < 100; ++i) {
+		vec.push_back(i);
+		expected.push_back(i);
+		ASSERT_TRUE(vec == expected);
+		EXPECT_EQ(vec.size() <= 3, vec.is_inline());
+	}
+
+	// erase every other element, the vector moves back to the local buffer on the way
+	while (!vec.empty()) {
+		auto it = std::remove_if(vec.begin(), vec.end(), [](int x) { return x % 2 == 0; });
+		vec.erase(it, vec.end());
+		expected.erase(std::remove_if(expected.begin(), expected.end(),
+				[](int x) { return x % 2 == 0; }), expected.end());
+		ASSERT_TRUE(vec == expected);
+		EXPECT_EQ(vec.size() <= 3, vec.is_inline());
+		for (auto &x : vec) {
+			x /= 2;
+		}
+		for (auto &x : expected) {
+			x /= 2;
+		}
+		if (vec.size() == 1) {
+			vec.pop_back();
+			expected.pop_back();
+		}
+	}
+	EXPECT_TRUE(vec == expected);
+	EXPECT_TRUE(vec.is_inline());
+}
+
+TEST(InlineVectorTest, PushBackOwnElement) {
+	inline_vector<Part, 2> vec;
+	vec.push_back({1, 2, 3});
+	vec.push_back({4, 5, 6});
+	// growing from the local buffer to the heap must not lose the pushed element
+	vec.push_back(vec[0]);
+	vec.push_back(vec[2]);
+	vec.emplace_back(vec.back());
+	EXPECT_TRUE(vec == std::vector<Part>({{1, 2, 3}, {4, 5, 6}, {1, 2, 3}, {1, 2, 3}, {1, 2, 3}}));
+}
+
+TEST(InlineVectorTest, CopyAndMove) {
+	for (int count : {0, 2, 3, 10}) {
+		inline_vector<int, 2> a;
+		for (int i = 0; i < count; ++i) {
+			a.push_back(i);
+		}
+		std::vector<int> expected(a.begin(), a.end());
+
+		inline_vector<int, 2> b(a);
+		EXPECT_TRUE(b == expected);
+		inline_vector<int, 2> c(std::move(a));
+		EXPECT_TRUE(c == expected);
+		EXPECT_TRUE(a.empty());
+
+		inline_vector<int, 2> d;
+		d.push_back(100);
+		d = c;
+		EXPECT_TRUE(d == expected);
+		d.clear();
+		EXPECT_TRUE(d.empty());
+		d = std::move(c);
+		EXPECT_TRUE(d == expected);
+
+		inline_vector<int, 2> e;
+		e.push_back(7);
+		e.swap(d);
+		EXPECT_TRUE(e == expected);
+		EXPECT_TRUE(d == std::vector<int>({7}));
+	}
+}
+
+TEST(InlineVectorTest, MaxSize) {
+	inline_vector<uint8_t, 2, uint8_t> vec;
+	for (int i = 0; i < 255; ++i) {
+		vec.push_back(i);
+	}
+	EXPECT_EQ(255U, vec.size());
+	EXPECT_THROW(vec.push_back(0), std::length_error);
+	EXPECT_EQ(255U, vec.size());
+}
+
+TEST(InlineVectorTest, Resize) {
+	inline_vector<uint64_t, 2, uint32_t> vec;
+	vec.resize(1);
+	EXPECT_TRUE(vec == std::vector<uint64_t>({0}));
+	EXPECT_TRUE(vec.is_inline());
+	vec.resize(2, 5);
+	EXPECT_TRUE(vec == std::vector<uint64_t>({0, 5}));
+	EXPECT_TRUE(vec.is_inline());
+	vec.resize(10, 7);
+	EXPECT_EQ(10U, vec.capacity());
+	EXPECT_TRUE(vec == std::vector<uint64_t>({0, 5, 7, 7, 7, 7, 7, 7, 7, 7}));
+	vec.resize(5, vec[1]);
+	EXPECT_EQ(10U, vec.capacity());
+	vec.resize(12, vec[1]);
+	EXPECT_TRUE(vec == std::vector<uint64_t>({0, 5, 7, 7, 7, 5, 5, 5, 5, 5, 5, 5}));
+	vec.resize(1);
+	EXPECT_TRUE(vec == std::vector<uint64_t>({0}));
+	EXPECT_TRUE(vec.is_inline());
+}
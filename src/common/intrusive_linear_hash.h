@@ -0,0 +1,252 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*! \brief Links elements of intrusive_linear_hash by their 'T *next' member.
+ *
+ * Other links can be used to keep smaller handles (e.g. 32-bit indices into an array of
+ * elements), they have to provide the same members. A value-initialized handle is null.
+ */
+template <typename T>
+struct intrusive_pointer_link {
+	typedef T *handle_type;
+
+	static T *get(handle_type handle) {
+		return handle;
+	}
+
+	static handle_type &next(T *element) {
+		return element->next;
+	}
+
+	static handle_type next(const T *element) {
+		return element->next;
+	}
+};
+
+/*! \brief Hash table with chaining of objects linked by their own 'next' members.
+ *
+ * The table grows using linear hashing: when there are more elements than buckets, the bucket
+ * at split_position() can be split into itself and a new bucket appended at the end of the table.
+ * This way chains stay short no matter how many elements there are, and the table never has to
+ * be rehashed as a whole. Splitting is left to the user (see split()), so that it can be
+ * postponed while an iteration is in the middle of the bucket to be split.
+ *
+ * Buckets are allocated in segments of SegmentSize, so growing doesn't move existing buckets.
+ *
+ * Elements are linked by handles defined by Link (see intrusive_pointer_link), by default
+ * T must have a 'T *next' member. KeyOf must return the key of an element. Keys are expected to
+ * be well distributed in the lowest bits (e.g. ids), as the position of an element is taken
+ * from them directly.
+ */
+template <typename T, typename KeyOf, uint32_t MinSize, uint32_t SegmentSize = 0x10000,
+		typename Link = intrusive_pointer_link<T>>
+class intrusive_linear_hash {
+	static_assert((MinSize & (MinSize - 1)) == 0, "MinSize must be a power of 2");
+	static_assert((SegmentSize & (SegmentSize - 1)) == 0, "SegmentSize must be a power of 2");
+	static_assert(MinSize % SegmentSize == 0, "MinSize must be a multiple of SegmentSize");
+
+public:
+	typedef typename Link::handle_type handle_type;
+
+	static constexpr uint32_t kMaxSize = 0x80000000U;
+
+	intrusive_linear_hash() : level_size_(MinSize), split_position_(0), size_(0), used_buckets_(0) {
+		for (uint32_t i = 0; i < MinSize; i += SegmentSize) {
+			segments_.emplace_back(new handle_type[SegmentSize]());
+		}
+	}
+
+	intrusive_linear_hash(const intrusive_linear_hash &) = delete;
+	intrusive_linear_hash &operator=(const intrusive_linear_hash &) = delete;
+
+	/*! \brief Number of elements. */
+	uint64_t size() const {
+		return size_;
+	}
+
+	/*! \brief Number of buckets, valid positions are [0, bucket_count()). */
+	uint32_t bucket_count() const {
+		return level_size_ + split_position_;
+	}
+
+	/*! \brief Number of non-empty buckets. */
+	uint32_t used_bucket_count() const {
+		return used_buckets_;
+	}
+
+	/*! \brief Number of buckets rounded up to a power of 2.
+	 *
+	 * Useful for visiting buckets in a pseudo-random order: with an odd stride modulo
+	 * loop_size() every position is visited (positions >= bucket_count() have to be skipped).
+	 */
+	uint32_t loop_size() const {
+		return split_position_ == 0 ? level_size_ : 2 * level_size_;
+	}
+
+	uint32_t bucket_position(uint64_t key) const {
+		uint32_t pos = key & (level_size_ - 1);
+		if (pos < split_position_) {
+			pos = key & (2 * level_size_ - 1);
+		}
+		return pos;
+	}
+
+	/*! \brief First element of a chain. */
+	T *bucket(uint32_t pos) const {
+		assert(pos < bucket_count());
+		return get(segments_[pos / SegmentSize][pos % SegmentSize]);
+	}
+
+	/*! \brief Element following the given one in its chain. */
+	static T *next(const T *element) {
+		return get(Link::next(element));
+	}
+
+	T *find(uint64_t key) const {
+		for (T *element = bucket(bucket_position(key)); element; element = next(element)) {
+			if (KeyOf()(element) == key) {
+				return element;
+			}
+		}
+		return nullptr;
+	}
+
+	/*! \brief Inserts an element at the front of its chain. */
+	void insert(handle_type handle) {
+		T *element = Link::get(handle);
+		handle_type &head = bucket_ref(bucket_position(KeyOf()(element)));
+		used_buckets_ += (head == handle_type());
+		Link::next(element) = head;
+		head = handle;
+		++size_;
+	}
+
+	/*! \brief Removes an element, returns false if it isn't in the table. */
+	bool erase(T *element) {
+		uint32_t pos = bucket_position(KeyOf()(element));
+		T *prev = nullptr;
+		for (T *it = bucket(pos); it; prev = it, it = next(it)) {
+			if (it == element) {
+				erase_after(pos, prev, element);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*! \brief Removes an element which follows prev (nullptr if it is the first one) in bucket pos.
+	 *
+	 * \return handle of the removed element.
+	 */
+	handle_type erase_after(uint32_t pos, T *prev, T *element) {
+		handle_type &link = prev ? Link::next(prev) : bucket_ref(pos);
+		handle_type handle = link;
+		assert(get(handle) == element);
+		link = Link::next(element);
+		if (!prev) {
+			used_buckets_ -= (link == handle_type());
+		}
+		--size_;
+		return handle;
+	}
+
+	/*! \brief Is there more elements than buckets, i.e. should the table grow? */
+	bool needs_split() const {
+		return size_ > bucket_count() && level_size_ < kMaxSize;
+	}
+
+	/*! \brief Bucket which will be split by the next call to split(). */
+	uint32_t split_position() const {
+		return split_position_;
+	}
+
+	/*! \brief Splits bucket split_position() into itself and a new bucket at bucket_count().
+	 *
+	 * Elements keep their relative order in both chains.
+	 * \param on_move called as on_move(element, old_position, new_position) for each element moved
+	 *                to the new bucket.
+	 * \return position of the split bucket.
+	 */
+	template <typename OnMove>
+	uint32_t split(OnMove on_move) {
+		assert(level_size_ < kMaxSize);
+		uint32_t oldpos = split_position_;
+		uint32_t newpos = oldpos + level_size_;
+		if (newpos % SegmentSize == 0) {
+			segments_.emplace_back(new handle_type[SegmentSize]());
+		}
+		handle_type handle = bucket_ref(oldpos);
+		handle_type *oldtail = &bucket_ref(oldpos);
+		handle_type *newtail = &bucket_ref(newpos);
+		++split_position_;
+		while (handle != handle_type()) {
+			T *element = Link::get(handle);
+			if (bucket_position(KeyOf()(element)) == oldpos) {
+				*oldtail = handle;
+				oldtail = &Link::next(element);
+			} else {
+				*newtail = handle;
+				newtail = &Link::next(element);
+				on_move(element, oldpos, newpos);
+			}
+			handle = Link::next(element);
+		}
+		*oldtail = handle_type();
+		*newtail = handle_type();
+		used_buckets_ += (bucket(oldpos) != nullptr) + (bucket(newpos) != nullptr);
+		used_buckets_ -= (bucket(oldpos) != nullptr || bucket(newpos) != nullptr);
+		if (split_position_ == level_size_) {
+			level_size_ *= 2;
+			split_position_ = 0;
+		}
+		return oldpos;
+	}
+
+	uint32_t split() {
+		return split([](T *, uint32_t, uint32_t) {});
+	}
+
+	/*! \brief Memory used by buckets (not including elements). */
+	uint64_t memory_usage() const {
+		return (uint64_t)segments_.size() * SegmentSize * sizeof(handle_type);
+	}
+
+private:
+	static T *get(handle_type handle) {
+		return handle == handle_type() ? nullptr : Link::get(handle);
+	}
+
+	handle_type &bucket_ref(uint32_t pos) {
+		return segments_[pos / SegmentSize][pos % SegmentSize];
+	}
+
+	std::vector<std::unique_ptr<handle_type[]>> segments_;
+	uint32_t level_size_;     // power of 2, number of buckets when the current round of splits began
+	uint32_t split_position_; // buckets below it use positions modulo 2 * level_size_
+	uint64_t size_;
+	uint32_t used_buckets_;
+};
@@ -0,0 +1,185 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "common/intrusive_linear_hash.h"
+
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Element {
+	uint64_t id;
+	Element *next;
+};
+
+struct IdOf {
+	uint64_t operator()(const Element *element) const {
+		return element->id;
+	}
+};
+
+typedef intrusive_linear_hash<Element, IdOf, 16, 16> Hash;
+
+void checkConsistency(const Hash &hash) {
+	uint64_t elements = 0;
+	uint32_t used = 0;
+	for (uint32_t pos = 0; pos < hash.bucket_count(); ++pos) {
+		used += (hash.bucket(pos) != nullptr);
+		for (Element *element = hash.bucket(pos); element; element = element->next) {
+			ASSERT_EQ(pos, hash.bucket_position(element->id));
+			++elements;
+		}
+	}
+	ASSERT_EQ(hash.size(), elements);
+	ASSERT_EQ(hash.used_bucket_count(), used);
+}
+
+} // anonymous namespace
+
+TEST(IntrusiveLinearHashTests, InsertFindErase) {
+	std::vector<Element> elements(100);
+	Hash hash;
+	for (uint64_t i = 0; i < elements.size(); ++i) {
+		elements[i].id = i * 16;  // all of them land in bucket 0 until it is split
+		hash.insert(&elements[i]);
+	}
+	EXPECT_EQ(100U, hash.size());
+	EXPECT_EQ(1U, hash.used_bucket_count());
+	checkConsistency(hash);
+
+	for (auto &element : elements) {
+		EXPECT_EQ(&element, hash.find(element.id));
+	}
+	EXPECT_EQ(nullptr, hash.find(1));
+
+	EXPECT_TRUE(hash.erase(&elements[50]));
+	EXPECT_FALSE(hash.erase(&elements[50]));
+	EXPECT_EQ(nullptr, hash.find(elements[50].id));
+	EXPECT_EQ(99U, hash.size());
+	checkConsistency(hash);
+}
+
+TEST(IntrusiveLinearHashTests, Split) {
+	std::vector<Element> elements(10000);
+	Hash hash;
+	uint64_t moved = 0;
+	for (uint64_t i = 0; i < elements.size(); ++i) {
+		elements[i].id = i * 7;
+		if (hash.needs_split()) {
+			uint32_t position = hash.split_position();
+			uint32_t count = hash.bucket_count();
+			EXPECT_EQ(position, hash.split([&](Element *element, uint32_t oldpos, uint32_t newpos) {
+				EXPECT_EQ(position, oldpos);
+				EXPECT_EQ(count, newpos);
+				EXPECT_EQ(newpos, hash.bucket_position(element->id));
+				++moved;
+			}));
+			EXPECT_EQ(count + 1, hash.bucket_count());
+		}
+		hash.insert(&elements[i]);
+	}
+	EXPECT_GT(moved, 0U);
+	EXPECT_GE(hash.bucket_count() + 1, hash.size());
+	EXPECT_LE(hash.loop_size(), 2 * hash.bucket_count());
+	checkConsistency(hash);
+
+	for (auto &element : elements) {
+		ASSERT_EQ(&element, hash.find(element.id));
+	}
+	for (uint64_t i = 0; i < elements.size(); i += 2) {
+		ASSERT_TRUE(hash.erase(&elements[i]));
+	}
+	checkConsistency(hash);
+	for (uint64_t i = 0; i < elements.size(); ++i) {
+		ASSERT_EQ(i % 2 ? &elements[i] : nullptr, hash.find(elements[i].id));
+	}
+}
+
+namespace {
+
+struct IndexedElement {
+	uint64_t id;
+	uint32_t next;
+};
+
+std::vector<IndexedElement> gIndexedElements;
+
+// Element i is referred to by handle i + 1, 0 is null
+struct IndexLink {
+	typedef uint32_t handle_type;
+
+	static IndexedElement *get(uint32_t handle) {
+		return &gIndexedElements[handle - 1];
+	}
+
+	static uint32_t &next(IndexedElement *element) {
+		return element->next;
+	}
+
+	static uint32_t next(const IndexedElement *element) {
+		return element->next;
+	}
+};
+
+struct IndexedIdOf {
+	uint64_t operator()(const IndexedElement *element) const {
+		return element->id;
+	}
+};
+
+} // anonymous namespace
+
+TEST(IntrusiveLinearHashTests, IndexLink) {
+	typedef intrusive_linear_hash<IndexedElement, IndexedIdOf, 16, 16, IndexLink> IndexHash;
+	gIndexedElements.assign(1000, IndexedElement());
+	IndexHash hash;
+	for (uint32_t i = 0; i < gIndexedElements.size(); ++i) {
+		gIndexedElements[i].id = i * 3;
+		if (hash.needs_split()) {
+			hash.split();
+		}
+		hash.insert(i + 1);
+	}
+	EXPECT_EQ(gIndexedElements.size(), hash.size());
+	EXPECT_EQ((hash.bucket_count() + 15) / 16 * 16 * sizeof(uint32_t), hash.memory_usage());
+
+	uint64_t elements = 0;
+	for (uint32_t pos = 0; pos < hash.bucket_count(); ++pos) {
+		for (IndexedElement *element = hash.bucket(pos); element; element = hash.next(element)) {
+			ASSERT_EQ(pos, hash.bucket_position(element->id));
+			++elements;
+		}
+	}
+	EXPECT_EQ(hash.size(), elements);
+
+	for (auto &element : gIndexedElements) {
+		ASSERT_EQ(&element, hash.find(element.id));
+	}
+	IndexedElement *element = &gIndexedElements[500];
+	uint32_t pos = hash.bucket_position(element->id);
+	IndexedElement *prev = nullptr;
+	for (IndexedElement *it = hash.bucket(pos); it != element; it = hash.next(it)) {
+		prev = it;
+	}
+	EXPECT_EQ(501U, hash.erase_after(pos, prev, element));
+	EXPECT_EQ(nullptr, hash.find(element->id));
+	EXPECT_TRUE(hash.erase(&gIndexedElements[0]));
+	EXPECT_EQ(gIndexedElements.size() - 2, hash.size());
+}
@@ -45,3 +45,6 @@ constexpr uint32_t kFirstECVersion = lizardfsVersion(3, 9, 5);
 constexpr uint32_t kACL11Version = lizardfsVersion(3, 11, 0);
 constexpr uint32_t kRichACLVersion = lizardfsVersion(3, 12, 0);
 constexpr uint32_t kEC2Version = lizardfsVersion(3, 13, 0);
+constexpr uint32_t kHashTablesInfoVersion = lizardfsVersion(3, 13, 0);
+constexpr uint32_t kBinaryChangelogVersion = lizardfsVersion(3, 13, 0);
+constexpr uint32_t kIncrementalRegistrationVersion = lizardfsVersion(3, 13, 0);
@@ -30,6 +30,7 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "common/changelog_record.h"
 #include "common/cwrap.h"
 #include "common/datapack.h"
 #include "common/mfserr.h"
@@ -130,6 +131,13 @@ uint64_t changelogGetFirstLogVersion(const std::string& fname) {
 	if (s<=0) {
 		return 0;
 	}
+	if (buff[0] == changelog_record::kMarker) {
+		if (s < (int32_t)changelog_record::kHeaderSize) {
+			return 0;
+		}
+		const uint8_t *ptr = buff + 1 + 4;
+		return get64bit(&ptr);
+	}
 	fv = 0;
 	p = 0;
 	while (p<s && buff[p]>='0' && buff[p]<='9') {
@@ -162,8 +170,30 @@ uint64_t changelogGetLastLogVersion(const std::string& fname) {
 		throw FilesystemException("mmap(" + fname + ") failed: " + errorString(errno));
 	}
 	uint64_t lastLogVersion = 0;
-	// first LF is (should be) the last byte of the file
-	if (fileSize == 0 || fileContent[fileSize - 1] != '\n') {
+	if ((uint8_t)fileContent[0] == changelog_record::kMarker) {
+		// Binary records can't be found from the end of the file, jump over all of them
+		const uint8_t *data = reinterpret_cast<const uint8_t*>(fileContent);
+		size_t pos = 0;
+		while (pos < fileSize) {
+			if (data[pos] != changelog_record::kMarker
+					|| fileSize - pos < changelog_record::kHeaderSize) {
+				munmap((void*) fileContent, fileSize);
+				throw ParseException("malformed changelog " + fname +
+						" (bad binary entry at offset " + std::to_string(pos) + ")");
+			}
+			const uint8_t *ptr = data + pos + 1;
+			uint32_t payloadSize = get32bit(&ptr);
+			uint64_t recordSize = changelog_record::kHeaderSize + payloadSize
+					+ changelog_record::kTrailerSize;
+			if (fileSize - pos < recordSize) {
+				munmap((void*) fileContent, fileSize);
+				throw ParseException("truncated changelog " + fname +
+						" (incomplete binary entry at the end)");
+			}
+			lastLogVersion = get64bit(&ptr);
+			pos += recordSize;
+		}
+	} else if (fileContent[fileSize - 1] != '\n') {
 		throw ParseException("truncated changelog " + fname +
 				" (no LF at the end of the last line)");
 	} else {
@@ -0,0 +1,94 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*! \brief Pool of memory for objects of one type.
+ *
+ * Memory is taken from the system in slabs of SlabSize objects, so there is no per-object
+ * allocation overhead and objects of the same type are kept together. Memory of released objects
+ * is reused for new objects, it isn't returned to the system until the pool is destroyed.
+ *
+ * The pool only provides memory, objects have to be constructed and destroyed by the caller.
+ * It isn't thread safe.
+ */
+template <typename T, std::size_t SlabSize = 4096>
+class object_pool {
+	static_assert(SlabSize > 0, "object_pool needs space for at least one object in a slab");
+
+public:
+	object_pool() : free_(nullptr), used_in_last_slab_(SlabSize), size_(0) {
+	}
+
+	object_pool(const object_pool &) = delete;
+	object_pool &operator=(const object_pool &) = delete;
+
+	/*! \brief Returns memory for one object of type T. */
+	void *allocate() {
+		Item *item = free_;
+		if (item != nullptr) {
+			free_ = item->next;
+		} else {
+			if (used_in_last_slab_ == SlabSize) {
+				slabs_.emplace_back(new Item[SlabSize]);
+				used_in_last_slab_ = 0;
+			}
+			item = &slabs_.back()[used_in_last_slab_++];
+		}
+		++size_;
+		return static_cast<void *>(item);
+	}
+
+	/*! \brief Gives back memory returned by allocate (the object has to be already destroyed). */
+	void deallocate(void *ptr) {
+		assert(ptr != nullptr && size_ > 0);
+		Item *item = static_cast<Item *>(ptr);
+		item->next = free_;
+		free_ = item;
+		--size_;
+	}
+
+	/*! \brief Number of objects currently allocated from the pool. */
+	std::size_t size() const {
+		return size_;
+	}
+
+	/*! \brief Memory taken from the system (including memory of released objects). */
+	uint64_t memory_usage() const {
+		return (uint64_t)slabs_.size() * SlabSize * sizeof(Item);
+	}
+
+private:
+	union Item {
+		Item *next;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+	};
+
+	std::vector<std::unique_ptr<Item[]>> slabs_;
+	Item *free_;
+	std::size_t used_in_last_slab_;
+	std::size_t size_;
+};
@@ -0,0 +1,60 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "common/object_pool.h"
+
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+
+struct PooledObject {
+	uint64_t a;
+	uint32_t b;
+};
+
+TEST(ObjectPoolTest, AllocateAndReuse) {
+	object_pool<PooledObject, 8> pool;
+	EXPECT_EQ(0U, pool.memory_usage());
+
+	std::vector<PooledObject *> objects;
+	for (int i = 0; i < 20; ++i) {
+		objects.push_back(new (pool.allocate()) PooledObject{(uint64_t)i, (uint32_t)i});
+	}
+	EXPECT_EQ(20U, pool.size());
+	EXPECT_EQ(3 * 8 * sizeof(PooledObject), pool.memory_usage());
+	EXPECT_EQ(20U, std::set<PooledObject *>(objects.begin(), objects.end()).size());
+	for (int i = 0; i < 20; ++i) {
+		EXPECT_EQ((uint64_t)i, objects[i]->a);
+		EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(objects[i]) % alignof(PooledObject));
+	}
+
+	// released memory is used again before taking a new slab
+	std::set<void *> released;
+	for (int i = 0; i < 20; i += 2) {
+		released.insert(objects[i]);
+		pool.deallocate(objects[i]);
+	}
+	EXPECT_EQ(10U, pool.size());
+	for (int i = 0; i < 10; ++i) {
+		EXPECT_EQ(1U, released.count(pool.allocate()));
+	}
+	pool.allocate();
+	EXPECT_EQ(21U, pool.size());
+	EXPECT_EQ(3 * 8 * sizeof(PooledObject), pool.memory_usage());
+}
@@ -23,6 +23,7 @@
 #include <array>
 #include <bitset>
 #include <cassert>
+#include <stdexcept>
 
 #ifdef LIZARDFS_HAVE_ISA_L_ERASURE_CODE_H
   #include <isa-l/erasure_code.h>
@@ -222,6 +222,48 @@ TEST(ReedSolomon, EncodeBenchmarkBig) {
 	benchmark_encoding(data, 4, 5);
 }
 
+#ifndef LIZARDFS_HAVE_ISA_L_ERASURE_CODE_H
+TEST(ReedSolomon, EncodeImplementationsAgree) {
+	// Odd length, so that every variant has to handle a tail shorter than its vector width
+	const int size = 4 * 1024 + 37;
+	const int max_srcs = 9, max_dests = 7;
+	std::vector<std::vector<uint8_t>> data, expected, result;
+	std::vector<uint8_t> matrix((max_srcs + max_dests) * max_srcs);
+	std::vector<uint8_t> tables(max_srcs * max_dests * 32);
+	std::vector<uint8_t *> src_ptrs, expected_ptrs, result_ptrs;
+
+	generate_random_data(data, max_srcs, size);
+	expected.assign(max_dests, std::vector<uint8_t>(size));
+	result.assign(max_dests, std::vector<uint8_t>(size));
+	for (int i = 0; i < max_srcs; ++i) {
+		src_ptrs.push_back(data[i].data());
+	}
+	for (int i = 0; i < max_dests; ++i) {
+		expected_ptrs.push_back(expected[i].data());
+		result_ptrs.push_back(result[i].data());
+	}
+
+	auto implementations = ec_encode_data_implementations();
+	ASSERT_FALSE(implementations.empty());
+	for (int srcs = 1; srcs <= max_srcs; ++srcs) {
+		for (int dests = 1; dests <= max_dests; ++dests) {
+			gf_gen_cauchy1_matrix(matrix.data(), srcs + dests, srcs);
+			ec_init_tables(srcs, dests, matrix.data() + srcs * srcs, tables.data());
+			implementations.back().function(size, srcs, dests, tables.data(), src_ptrs.data(),
+					expected_ptrs.data());
+			for (const auto &implementation : implementations) {
+				implementation.function(size, srcs, dests, tables.data(), src_ptrs.data(),
+						result_ptrs.data());
+				for (int i = 0; i < dests; ++i) {
+					EXPECT_EQ(expected[i], result[i]) << implementation.name << " K,M = " << srcs
+							<< "," << dests << " dest=" << i;
+				}
+			}
+		}
+	}
+}
+#endif
+
 template<std::size_t N>
 void select_rows(uint8_t *output_matrix, const uint8_t *input_matrix, int s1, int s2,
 	                const std::bitset<N> &required_rows) {
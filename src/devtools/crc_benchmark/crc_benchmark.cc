@@ -0,0 +1,74 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures throughput of all mycrc32 implementations available on this machine
+ * and the speed of mycrc32_combine.
+ *
+ * Usage: crc_benchmark [megabytes per measurement]
+ */
+
+#include "common/platform.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "common/crc.h"
+#include "protocol/MFSCommunication.h"
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+	uint64_t megabytes = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1024;
+	if (megabytes == 0) {
+		fprintf(stderr, "Usage: %s [megabytes per measurement]\n", argv[0]);
+		return 1;
+	}
+	mycrc32_init();
+
+	std::vector<uint8_t> block(MFSBLOCKSIZE);
+	for (size_t i = 0; i < block.size(); ++i) {
+		block[i] = rand();
+	}
+	const uint64_t iterations = megabytes * 1024 * 1024 / MFSBLOCKSIZE;
+
+	printf("%-16s %12s %12s\n", "implementation", "MiB/s", "crc");
+	for (const auto &implementation : mycrc32_implementations()) {
+		uint32_t crc = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; ++i) {
+			crc = implementation.function(crc, block.data(), block.size());
+		}
+		double elapsed = seconds_since(start);
+		printf("%-16s %12.1f   0x%08x\n", implementation.name, megabytes / elapsed, crc);
+	}
+
+	const uint32_t kCombineIterations = 1000000;
+	uint32_t crc = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < kCombineIterations; ++i) {
+		crc = mycrc32_combine(crc, i, MFSBLOCKSIZE + (i & 0xFFF));
+	}
+	double elapsed = seconds_since(start);
+	printf("mycrc32_combine: %.1f ns per call (0x%08x)\n", elapsed * 1e9 / kCombineIterations, crc);
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures throughput of blockXor (xor goals) and of erasure code encoding and recovery
+ * (ec goals) for all implementations available on this machine.
+ *
+ * Usage: ec_benchmark [data parts] [parity parts] [megabytes per measurement]
+ */
+
+#include "common/platform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "common/block_xor.h"
+#include "common/reed_solomon.h"
+#include "protocol/MFSCommunication.h"
+
+typedef ReedSolomon<32, 32> RS;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void fill_random(std::vector<std::vector<uint8_t>> &parts, int count) {
+	parts.assign(count, std::vector<uint8_t>(MFSBLOCKSIZE));
+	for (auto &part : parts) {
+		for (auto &byte : part) {
+			byte = rand();
+		}
+	}
+}
+
+static void benchmark_xor(int k, uint64_t iterations, double megabytes) {
+	std::vector<std::vector<uint8_t>> data;
+	std::vector<uint8_t> parity(MFSBLOCKSIZE);
+	fill_random(data, k);
+
+	for (const auto &implementation : blockXorImplementations()) {
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; ++i) {
+			for (int j = 0; j < k; ++j) {
+				implementation.function(parity.data(), data[j].data(), MFSBLOCKSIZE);
+			}
+		}
+		double elapsed = seconds_since(start);
+		printf("xor%-5d %-16s %12.1f\n", k, implementation.name, megabytes / elapsed);
+	}
+}
+
+static void benchmark_ec(int k, int m, uint64_t iterations, double megabytes) {
+	std::vector<std::vector<uint8_t>> data, parity;
+	fill_random(data, k);
+	fill_random(parity, m);
+
+	RS::ConstFragmentMap data_fragments{{0}};
+	RS::FragmentMap parity_fragments{{0}};
+	for (int i = 0; i < k; ++i) {
+		data_fragments[i] = data[i].data();
+	}
+	for (int i = 0; i < m; ++i) {
+		parity_fragments[i] = parity[i].data();
+	}
+
+#ifndef LIZARDFS_HAVE_ISA_L_ERASURE_CODE_H
+	// Same tables as ReedSolomon::encode uses, to compare all kernels on equal footing
+	std::vector<uint8_t> matrix((k + m) * k);
+	std::vector<uint8_t> tables(k * m * 32);
+	gf_gen_cauchy1_matrix(matrix.data(), k + m, k);
+	ec_init_tables(k, m, matrix.data() + k * k, tables.data());
+	std::vector<uint8_t *> src(k), dest(m);
+	for (int i = 0; i < k; ++i) {
+		src[i] = data[i].data();
+	}
+	for (int i = 0; i < m; ++i) {
+		dest[i] = parity[i].data();
+	}
+
+	for (const auto &implementation : ec_encode_data_implementations()) {
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; ++i) {
+			implementation.function(MFSBLOCKSIZE, k, m, tables.data(), src.data(), dest.data());
+		}
+		double elapsed = seconds_since(start);
+		printf("ec(%d,%d) %-16s %12.1f\n", k, m, implementation.name, megabytes / elapsed);
+	}
+#endif
+
+	RS rs(k, m);
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < iterations; ++i) {
+		rs.encode(data_fragments, parity_fragments, MFSBLOCKSIZE);
+	}
+	double elapsed = seconds_since(start);
+	printf("ec(%d,%d) %-16s %12.1f\n", k, m, "encode", megabytes / elapsed);
+
+	// Recover the first min(k, m) data parts from the remaining ones
+	int lost = std::min(k, m);
+	std::vector<std::vector<uint8_t>> recovered;
+	fill_random(recovered, lost);
+	RS::ConstFragmentMap input_fragments{{0}};
+	RS::FragmentMap output_fragments{{0}};
+	RS::ErasedMap erased;
+	for (int i = 0; i < k + m; ++i) {
+		if (i < lost) {
+			erased.set(i);
+			output_fragments[i] = recovered[i].data();
+		} else {
+			input_fragments[i] = i < k ? data[i].data() : parity[i - k].data();
+		}
+	}
+	start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < iterations; ++i) {
+		rs.recover(input_fragments, erased, output_fragments, MFSBLOCKSIZE);
+	}
+	elapsed = seconds_since(start);
+	printf("ec(%d,%d) %-16s %12.1f\n", k, m, "recover", megabytes / elapsed);
+	for (int i = 0; i < lost; ++i) {
+		if (recovered[i] != data[i]) {
+			fprintf(stderr, "recovered part %d differs from the original\n", i);
+			exit(1);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	int k = argc > 1 ? atoi(argv[1]) : 8;
+	int m = argc > 2 ? atoi(argv[2]) : 3;
+	uint64_t megabytes = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1024;
+	if (k < 1 || k > RS::kMaxDataCount || m < 1 || m > RS::kMaxParityCount || megabytes == 0) {
+		fprintf(stderr, "Usage: %s [data parts] [parity parts] [megabytes per measurement]\n",
+				argv[0]);
+		return 1;
+	}
+
+	// Every measurement processes the given amount of input (data parts) bytes
+	const uint64_t iterations = std::max<uint64_t>(1, megabytes * 1024 * 1024 / MFSBLOCKSIZE / k);
+	const double processed = (double)iterations * k * MFSBLOCKSIZE / (1024 * 1024);
+
+	printf("%-8s %-16s %12s\n", "goal", "implementation", "MiB/s");
+	benchmark_xor(k, iterations, processed);
+	benchmark_ec(k, m, iterations, processed);
+	return 0;
+}
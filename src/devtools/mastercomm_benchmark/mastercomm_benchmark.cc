@@ -0,0 +1,105 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures throughput of metadata operations (getattr of the root directory) sent to
+ * a running master server through the client's master connection, for a growing number
+ * of threads sharing this connection.
+ *
+ * Usage: mastercomm_benchmark <master host> <master port> [max threads] [seconds per measurement]
+ */
+
+#include "common/platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "common/crc.h"
+#include "common/mfserr.h"
+#include "common/sockets.h"
+#include "common/special_inode_defs.h"
+#include "mount/lizard_client.h"
+#include "mount/mastercomm.h"
+
+static std::atomic<bool> gStop;
+static std::atomic<bool> gFailed;
+
+static void getattr_loop(uint64_t &operations) {
+	Attributes attr;
+	while (!gStop) {
+		if (fs_getattr(SPECIAL_INODE_ROOT, 0, 0, attr) != LIZARDFS_STATUS_OK) {
+			gFailed = true;
+			return;
+		}
+		++operations;
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr,
+				"Usage: %s <master host> <master port> [max threads] [seconds per measurement]\n",
+				argv[0]);
+		return 1;
+	}
+	uint32_t maxThreads = argc > 3 ? atoi(argv[3]) : 64;
+	uint32_t seconds = argc > 4 ? atoi(argv[4]) : 5;
+	if (maxThreads == 0 || seconds == 0) {
+		fprintf(stderr, "max threads and seconds have to be positive\n");
+		return 1;
+	}
+
+	LizardClient::FsInitParams params("", argv[1], argv[2], "mastercomm_benchmark");
+	socketinit();
+	mycrc32_init();
+	if (fs_init_master_connection(params) < 0) {
+		fprintf(stderr, "can't connect to the master server at %s:%s\n", argv[1], argv[2]);
+		return 1;
+	}
+	fs_init_threads(params.io_retries);
+
+	printf("%-8s %12s\n", "threads", "ops/s");
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+		std::vector<uint64_t> operations(threads, 0);
+		std::vector<std::thread> workers;
+		gStop = false;
+		for (uint32_t i = 0; i < threads; ++i) {
+			workers.emplace_back(getattr_loop, std::ref(operations[i]));
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(seconds));
+		gStop = true;
+		uint64_t total = 0;
+		for (uint32_t i = 0; i < threads; ++i) {
+			workers[i].join();
+			total += operations[i];
+		}
+		if (gFailed) {
+			fprintf(stderr, "getattr failed\n");
+			break;
+		}
+		printf("%-8u %12.0f\n", threads, (double)total / seconds);
+	}
+
+	fs_term();
+	socketrelease();
+	return gFailed ? 1 : 0;
+}
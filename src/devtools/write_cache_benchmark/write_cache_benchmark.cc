@@ -0,0 +1,91 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how the write cache of the mount scales when many threads write to different
+ * files at the same time. No write workers are started, so the data stays in the cache
+ * and only the write_data path is measured -- no master or chunkservers are needed.
+ *
+ * Usage: write_cache_benchmark [max threads] [megabytes per thread] [write size in KiB]
+ */
+
+#include "common/platform.h"
+
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "mount/writedata.h"
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void write_file(uint32_t inode, uint64_t bytes, uint32_t writeSize) {
+	std::vector<uint8_t> buffer(writeSize, inode);
+	void *handle = write_data_new(inode);
+	for (uint64_t offset = 0; offset < bytes; offset += writeSize) {
+		if (write_data(handle, offset, writeSize, buffer.data()) != 0) {
+			fprintf(stderr, "write_data failed for inode %u\n", inode);
+			exit(1);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t maxThreads = argc > 1 ? atoi(argv[1]) : 16;
+	uint64_t megabytes = argc > 2 ? strtoull(argv[2], nullptr, 10) : 16;
+	uint32_t writeSize = (argc > 3 ? atoi(argv[3]) : 64) * 1024;
+	if (maxThreads == 0 || megabytes == 0 || writeSize == 0) {
+		fprintf(stderr, "Usage: %s [max threads] [megabytes per thread] [write size in KiB]\n",
+				argv[0]);
+		return 1;
+	}
+	const uint64_t bytesPerThread = megabytes * 1024 * 1024;
+
+	// Nothing is ever evicted from the cache, so it has to fit data of all the runs
+	uint64_t cacheMegabytes = 0;
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+		cacheMegabytes += (threads * megabytes) * 2;
+	}
+	write_data_init(cacheMegabytes, 0, 0, 15, 5000, 100);
+
+	printf("%-8s %12s %12s\n", "threads", "MiB/s", "writes/s");
+	uint32_t nextInode = 1;
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+		std::vector<std::thread> writers;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < threads; ++i) {
+			writers.emplace_back(write_file, nextInode++, bytesPerThread, writeSize);
+		}
+		for (auto &writer : writers) {
+			writer.join();
+		}
+		double elapsed = seconds_since(start);
+		double total = (double)threads * bytesPerThread;
+		printf("%-8u %12.1f %12.0f\n", threads, total / (1024 * 1024) / elapsed,
+				total / writeSize / elapsed);
+	}
+
+	// There are no workers which could flush the cache, so don't try to tear it down
+	fflush(stdout);
+	_exit(0);
+}
@@ -19,14 +19,25 @@
 #include "common/platform.h"
 #include "master/changelog.h"
 
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <syslog.h>
 #include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "common/cfg.h"
+#include "common/changelog_record.h"
 #include "common/event_loop.h"
 #include "common/main.h"
+#include "common/massert.h"
 #include "common/metadata.h"
 #include "common/rotate_files.h"
 #include "common/slogger.h"
@@ -41,11 +52,181 @@ static uint32_t gMinBackLogsNumber = 0;
 /// Maximal acceptable value of BACK_LOGS config entry.
 static uint32_t gMaxBackLogsNumber = 50;
 
+/// Format of the current changelog file, decided by its first entry.
+enum class ChangelogFormat { kUnknown, kText, kBinary };
+
 static uint32_t BackLogsNumber;
 static FILE *fd = nullptr;
+static ChangelogFormat gFormat = ChangelogFormat::kUnknown;
 static bool gFlush = true;
 
+/*
+ * Group commit.
+ *
+ * When CHANGELOG_SYNC_INTERVAL_MS is set, entries are not written by the event loop. They are
+ * appended to an in-memory buffer, which a background thread swaps with its own one and writes
+ * with a single write() followed by fdatasync(). This happens every CHANGELOG_SYNC_INTERVAL_MS
+ * milliseconds or as soon as CHANGELOG_SYNC_BYTES are waiting. Each entry gets a position
+ * (a sequence number); changelog_is_synced() tells whether it is already safe on the disk and
+ * the event loop is woken up through a pipe whenever a batch is synced.
+ */
+namespace {
+struct GroupCommit {
+	bool enabled = false;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeWriter;   ///< new data, a flush request or termination
+	std::condition_variable batchSynced;
+	std::vector<uint8_t> pending;         ///< entries waiting for the writer
+	uint64_t pendingPosition = 0;         ///< position of the last entry in pending
+	bool writerBusy = false;              ///< writer is writing a batch (without the mutex)
+	bool flushRequested = false;
+	bool terminate = false;
+	int fd = -1;                          ///< used only by the writer or with writerBusy == false
+	std::chrono::milliseconds interval{0};
+	uint32_t bytesThreshold = 0;
+	std::atomic<uint64_t> syncedPosition{0};
+	int notifyPipe[2] = {-1, -1};
+};
+} // anonymous namespace
+
+static GroupCommit gGroupCommit;
+/// Position of the last stored entry, used only by the event loop
+static uint64_t gPosition = 0;
+/// Format of the current file when group commit is used (the file is opened by the writer)
+static bool gFileKnown = false;
+
+static void changelog_writer_write(const std::vector<uint8_t> &batch) {
+	GroupCommit &gc = gGroupCommit;
+	if (gc.fd < 0) {
+		gc.fd = open(gChangelogFilename.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+		if (gc.fd < 0) {
+			lzfs_pretty_errlog(LOG_ERR, "can't open changelog, %zu bytes of metadata changes lost",
+					batch.size());
+			return;
+		}
+	}
+	const uint8_t *data = batch.data();
+	size_t size = batch.size();
+	while (size > 0) {
+		ssize_t written = write(gc.fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			lzfs_pretty_errlog(LOG_ERR, "error writing changelog");
+			return;
+		}
+		data += written;
+		size -= written;
+	}
+	if (fdatasync(gc.fd) != 0) {
+		lzfs_pretty_errlog(LOG_ERR, "error syncing changelog");
+	}
+}
+
+static void changelog_writer_thread() {
+	GroupCommit &gc = gGroupCommit;
+	std::vector<uint8_t> batch;
+	std::unique_lock<std::mutex> lock(gc.mutex);
+	while (true) {
+		gc.wakeWriter.wait_for(lock, gc.interval, [&gc]() {
+			return gc.terminate || gc.flushRequested || gc.pending.size() >= gc.bytesThreshold;
+		});
+		gc.flushRequested = false;
+		if (gc.pending.empty()) {
+			if (gc.terminate) {
+				break;
+			}
+			gc.batchSynced.notify_all();
+			continue;
+		}
+		batch.swap(gc.pending);
+		uint64_t position = gc.pendingPosition;
+		gc.writerBusy = true;
+		lock.unlock();
+
+		changelog_writer_write(batch);
+		batch.clear();
+		if (batch.capacity() > 4 * std::max<size_t>(gc.bytesThreshold, 65536)) {
+			batch.shrink_to_fit();
+		}
+
+		lock.lock();
+		gc.writerBusy = false;
+		gc.syncedPosition = position;
+		gc.batchSynced.notify_all();
+		char byte = 0;
+		if (write(gc.notifyPipe[1], &byte, 1) < 0 && errno != EAGAIN) {
+			lzfs_pretty_errlog(LOG_WARNING, "can't wake up the main loop");
+		}
+	}
+}
+
+/// Waits until everything stored so far is written and synced
+static void changelog_group_commit_drain(std::unique_lock<std::mutex> &lock) {
+	GroupCommit &gc = gGroupCommit;
+	gc.flushRequested = true;
+	gc.wakeWriter.notify_one();
+	gc.batchSynced.wait(lock, [&gc]() {
+		return gc.pending.empty() && !gc.writerBusy;
+	});
+}
+
+static void changelog_group_commit_desc(std::vector<pollfd> &pdesc) {
+	pdesc.push_back({gGroupCommit.notifyPipe[0], POLLIN, 0});
+}
+
+static void changelog_group_commit_serve(const std::vector<pollfd> &) {
+	char buffer[64];
+	while (read(gGroupCommit.notifyPipe[0], buffer, sizeof(buffer)) > 0) {
+	}
+}
+
+static void changelog_group_commit_term() {
+	GroupCommit &gc = gGroupCommit;
+	{
+		std::unique_lock<std::mutex> lock(gc.mutex);
+		gc.terminate = true;
+		gc.wakeWriter.notify_one();
+	}
+	gc.thread.join();
+	if (gc.fd >= 0) {
+		close(gc.fd);
+		gc.fd = -1;
+	}
+	close(gc.notifyPipe[0]);
+	close(gc.notifyPipe[1]);
+	gc.notifyPipe[0] = gc.notifyPipe[1] = -1;
+	// Changes made by other modules during termination (if any) are written directly
+	gc.enabled = false;
+	gFileKnown = false;
+}
+
+static void changelog_group_commit_init() {
+	GroupCommit &gc = gGroupCommit;
+	if (pipe(gc.notifyPipe) < 0) {
+		throw InitializeException("can't create a pipe for the changelog writer");
+	}
+	for (int pipeFd : gc.notifyPipe) {
+		fcntl(pipeFd, F_SETFL, fcntl(pipeFd, F_GETFL) | O_NONBLOCK);
+	}
+	gc.enabled = true;
+	gc.thread = std::thread(changelog_writer_thread);
+	eventloop_pollregister(changelog_group_commit_desc, changelog_group_commit_serve);
+	eventloop_destructregister(changelog_group_commit_term);
+}
+
 void changelog_rotate() {
+	if (gGroupCommit.enabled) {
+		std::unique_lock<std::mutex> lock(gGroupCommit.mutex);
+		changelog_group_commit_drain(lock);
+		if (gGroupCommit.fd >= 0) {
+			close(gGroupCommit.fd);
+			gGroupCommit.fd = -1;
+		}
+		gFileKnown = false;
+	}
 	if (fd) {
 		fclose(fd);
 		fd=NULL;
@@ -57,25 +238,142 @@ void changelog_rotate() {
 	}
 }
 
-void changelog(uint64_t version, const char* entry) {
-	if (fd==NULL) {
-		fd = fopen(gChangelogFilename.c_str(), "a");
-		if (!fd) {
-			lzfs_pretty_syslog(LOG_NOTICE, "lost metadata change %" PRIu64 ": %s", version, entry);
-		}
+static ChangelogFormat changelog_file_format(int fileFd) {
+	struct stat st;
+	uint8_t first;
+	if (fstat(fileFd, &st) == 0 && st.st_size > 0 && pread(fileFd, &first, 1, 0) == 1) {
+		return (first == changelog_record::kMarker) ? ChangelogFormat::kBinary
+				: ChangelogFormat::kText;
 	}
+	return ChangelogFormat::kUnknown;
+}
 
+static bool changelog_open() {
+	if (gGroupCommit.enabled) {
+		// The writer opens the file itself, only check what is already there
+		if (!gFileKnown) {
+			gFormat = ChangelogFormat::kUnknown;
+			int fileFd = open(gChangelogFilename.c_str(), O_RDONLY);
+			if (fileFd >= 0) {
+				gFormat = changelog_file_format(fileFd);
+				close(fileFd);
+			}
+			gFileKnown = true;
+		}
+		return true;
+	}
 	if (fd) {
-		fprintf(fd,"%" PRIu64 ": %s\n", version, entry);
-		if (gFlush) {
-			fflush(fd);
+		return true;
+	}
+	fd = fopen(gChangelogFilename.c_str(), "a");
+	if (!fd) {
+		return false;
+	}
+	gFormat = changelog_file_format(fileno(fd));
+	return true;
+}
+
+static void changelog_write_record(const uint8_t *record, uint32_t size) {
+	if (gGroupCommit.enabled) {
+		GroupCommit &gc = gGroupCommit;
+		std::unique_lock<std::mutex> lock(gc.mutex);
+		gc.pending.insert(gc.pending.end(), record, record + size);
+		gc.pendingPosition = ++gPosition;
+		if (gc.pending.size() >= gc.bytesThreshold) {
+			gc.wakeWriter.notify_one();
 		}
+		return;
+	}
+	if (fwrite(record, 1, size, fd) != size) {
+		lzfs_pretty_errlog(LOG_WARNING, "error writing changelog");
+	}
+	if (gFlush) {
+		fflush(fd);
+	}
+}
+
+void changelog(uint64_t version, const char* entry) {
+	if (!changelog_open()) {
+		lzfs_pretty_syslog(LOG_NOTICE, "lost metadata change %" PRIu64 ": %s", version, entry);
+		return;
+	}
+
+	if (gFormat == ChangelogFormat::kBinary) {
+		// A text entry is a valid payload consisting of one literal token
+		static std::vector<uint8_t> payload, record;
+		payload.clear();
+		changelog_record::appendLiteral(payload, entry, strlen(entry));
+		changelog_record::frame(version, payload.data(), payload.size(), record);
+		changelog_write_record(record.data(), record.size());
+		return;
+	}
+	gFormat = ChangelogFormat::kText;
+	if (gGroupCommit.enabled) {
+		static std::string line;
+		line = std::to_string(version);
+		line += ": ";
+		line += entry;
+		line += '\n';
+		changelog_write_record((const uint8_t *)line.data(), line.size());
+		return;
+	}
+	fprintf(fd,"%" PRIu64 ": %s\n", version, entry);
+	if (gFlush) {
+		fflush(fd);
+	}
+}
+
+void changelog_binary(const uint8_t *record, uint32_t size) {
+	changelog_record::RecordView view;
+	if (changelog_record::parse(record, size, view) != changelog_record::ParseStatus::kOk) {
+		lzfs_pretty_syslog(LOG_WARNING, "malformed binary changelog entry, can't store it");
+		return;
+	}
+	if (!changelog_open()) {
+		lzfs_pretty_syslog(LOG_NOTICE, "lost metadata change %" PRIu64, view.version);
+		return;
+	}
+
+	if (gFormat == ChangelogFormat::kText) {
+		// Don't mix formats in one file, convert the entry
+		static std::string entry;
+		if (changelog_record::toText(view.payload, view.payloadSize, entry)) {
+			changelog(view.version, entry.c_str());
+		} else {
+			lzfs_pretty_syslog(LOG_WARNING, "malformed binary changelog entry %" PRIu64,
+					view.version);
+		}
+		return;
+	}
+	gFormat = ChangelogFormat::kBinary;
+	changelog_write_record(record, size);
+}
+
+uint64_t changelog_position() {
+	return gPosition;
+}
+
+bool changelog_is_synced(uint64_t position) {
+	return !gGroupCommit.enabled || gGroupCommit.syncedPosition >= position;
+}
+
+static void changelog_load_group_commit_config() {
+	std::unique_lock<std::mutex> lock(gGroupCommit.mutex);
+	gGroupCommit.interval = std::chrono::milliseconds(
+			cfg_get_minmaxvalue<uint32_t>("CHANGELOG_SYNC_INTERVAL_MS", 0, 0, 10000));
+	gGroupCommit.bytesThreshold = cfg_get_minmaxvalue<uint32_t>("CHANGELOG_SYNC_BYTES",
+			1024 * 1024, 4096, 64 * 1024 * 1024);
+	if (gGroupCommit.enabled && gGroupCommit.interval.count() == 0) {
+		lzfs_pretty_syslog(LOG_WARNING, "CHANGELOG_SYNC_INTERVAL_MS can't be disabled "
+				"without a restart, using 1 ms");
+		gGroupCommit.interval = std::chrono::milliseconds(1);
 	}
 }
 
 static void changelog_reload(void) {
 	BackLogsNumber = cfg_get_minmaxvalue<uint32_t>("BACK_LOGS", 50,
 			gMinBackLogsNumber, gMaxBackLogsNumber);
+	changelog_load_group_commit_config();
 }
 
 void changelog_init(std::string changelogFilename,
@@ -92,6 +390,10 @@ void changelog_init(std::string changelogFilename,
 		throw InitializeException(cfg_filename() + ": BACK_LOGS value too low, "
 				"minimum allowed is " + std::to_string(gMinBackLogsNumber));
 	}
+	changelog_load_group_commit_config();
+	if (gGroupCommit.interval.count() > 0) {
+		changelog_group_commit_init();
+	}
 	eventloop_reloadregister(changelog_reload);
 }
 
@@ -100,6 +402,12 @@ uint32_t changelog_get_back_logs_config_value() {
 }
 
 void changelog_flush(void) {
+	if (gGroupCommit.enabled) {
+		std::unique_lock<std::mutex> lock(gGroupCommit.mutex);
+		gGroupCommit.flushRequested = true;
+		gGroupCommit.wakeWriter.notify_one();
+		return;
+	}
 	if (fd) {
 		fflush(fd);
 	}
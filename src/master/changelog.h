@@ -44,7 +44,20 @@ void changelog_rotate();
 /// Format of the entry: <ts>|<COMMAND>(arg1,arg2,...)
 void changelog(uint64_t version, const char* entry);
 
+/// Stores a new change given as a framed binary record (see common/changelog_record.h)
+/// Entries are converted if needed, so that all entries in a file have the same format as
+/// the first one.
+void changelog_binary(const uint8_t* record, uint32_t size);
+
+/// Returns the position of the last stored change (a sequence number of changes)
+uint64_t changelog_position();
+
+/// Checks if the change at the given position is already synced to the disk
+/// Always true unless group commit (CHANGELOG_SYNC_INTERVAL_MS) is enabled.
+bool changelog_is_synced(uint64_t position);
+
 /// Flushes (fflush) the current changelog
+/// With group commit it only asks the writer thread to write pending changes now.
 void changelog_flush();
 
 /// Disables flushing the current changelog after each \p changelog call
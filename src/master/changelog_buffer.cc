@@ -0,0 +1,77 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "master/changelog_buffer.h"
+
+#include <cassert>
+
+ChangelogBuffer::Slice ChangelogBuffer::append(uint64_t version, uint32_t timestamp,
+		uint32_t length) {
+	if (segments_.empty() || segments_.back()->capacity - segments_.back()->used < length) {
+		// changes bigger than a segment get a segment of their own
+		Segment *segment = new Segment(std::max(segmentSize_, length), timestamp);
+		segments_.push_back(segment);
+		size_ += segment->capacity;
+	}
+	Segment *segment = segments_.back();
+	assert(segment->entries.empty() || segment->entries.back().version <= version);
+	Slice slice{segment, segment->data.get() + segment->used, length};
+	segment->entries.push_back({version, segment->used});
+	segment->used += length;
+	return slice;
+}
+
+void ChangelogBuffer::trim(uint32_t minTimestamp, uint64_t maxSize) {
+	// the oldest segment has to stay as long as the next one doesn't cover minTimestamp
+	while (segments_.size() > 1 &&
+	       (segments_[1]->timestamp < minTimestamp || (maxSize > 0 && size_ > maxSize))) {
+		dropFront();
+	}
+}
+
+void ChangelogBuffer::clear() {
+	while (!segments_.empty()) {
+		dropFront();
+	}
+}
+
+void ChangelogBuffer::dropFront() {
+	Segment *segment = segments_.front();
+	segments_.pop_front();
+	size_ -= segment->capacity;
+	unref(segment);
+}
+
+std::pair<ChangelogBuffer::Segments::const_iterator, uint32_t> ChangelogBuffer::find(
+		uint64_t version) const {
+	// the last segment which starts with a change not newer than version
+	auto it = std::upper_bound(segments_.begin(), segments_.end(), version,
+			[](uint64_t v, const Segment *s) { return v < s->entries.front().version; });
+	if (it == segments_.begin()) {
+		return {it, 0};
+	}
+	--it;
+	const Segment *segment = *it;
+	auto entry = std::upper_bound(segment->entries.begin(), segment->entries.end(), version,
+			[](uint64_t v, const Segment::Entry &e) { return v < e.version; });
+	if (entry == segment->entries.end()) {
+		return {it + 1, 0};
+	}
+	return {it, entry->offset};
+}
@@ -0,0 +1,156 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/*! \brief Changes kept in memory for metaloggers and shadow masters.
+ *
+ * Changes are stored one after another in large segments, already framed as packets, so they
+ * can be sent to any number of connections without copying and a reconnecting peer can get
+ * whole slices of segments at once. Changes are found by version with a binary search.
+ *
+ * Segments are reference counted: a connection which still has to send a part of a segment
+ * keeps a reference to it, so dropping old changes never invalidates queued data.
+ */
+class ChangelogBuffer {
+public:
+	static constexpr uint32_t kDefaultSegmentSize = 4 << 20;
+
+	struct Segment {
+		struct Entry {
+			uint64_t version;
+			uint32_t offset;
+		};
+
+		explicit Segment(uint32_t capacity, uint32_t timestamp)
+		    : data(new uint8_t[capacity]), capacity(capacity), used(0), timestamp(timestamp),
+		      refs(1) {
+		}
+
+		std::unique_ptr<uint8_t[]> data;
+		uint32_t capacity;
+		uint32_t used;
+		uint32_t timestamp; /*!< Time of the first change in the segment. */
+		uint32_t refs;
+		std::vector<Entry> entries;
+	};
+
+	/*! \brief Contiguous part of a segment. */
+	struct Slice {
+		Segment *segment;
+		uint8_t *data;
+		uint32_t length;
+	};
+
+	explicit ChangelogBuffer(uint32_t segmentSize = kDefaultSegmentSize)
+	    : segmentSize_(segmentSize), size_(0) {
+	}
+
+	ChangelogBuffer(const ChangelogBuffer &) = delete;
+	ChangelogBuffer &operator=(const ChangelogBuffer &) = delete;
+
+	~ChangelogBuffer() {
+		clear();
+	}
+
+	/*! \brief Makes space for a change of \p length bytes, to be filled by the caller. */
+	Slice append(uint64_t version, uint32_t timestamp, uint32_t length);
+
+	/*! \brief Drops changes stored before \p minTimestamp and the oldest changes which don't fit
+	 * in \p maxSize bytes (0 means no limit).
+	 *
+	 * Changes are dropped by whole segments and the newest segment is always kept.
+	 */
+	void trim(uint32_t minTimestamp, uint64_t maxSize);
+
+	void clear();
+
+	bool empty() const {
+		return segments_.empty();
+	}
+
+	/*! \brief Version of the oldest stored change (the buffer can't be empty). */
+	uint64_t firstVersion() const {
+		return segments_.front()->entries.front().version;
+	}
+
+	/*! \brief Memory used by the segments. */
+	uint64_t size() const {
+		return size_;
+	}
+
+	/*! \brief Calls \p f for contiguous slices with all changes newer than \p version. */
+	template <typename Function>
+	void forEachSliceAfter(uint64_t version, Function f) const {
+		auto position = find(version);
+		for (auto it = position.first; it != segments_.end(); ++it) {
+			Segment *segment = *it;
+			uint32_t offset = (it == position.first) ? position.second : 0;
+			if (offset < segment->used) {
+				f(Slice{segment, segment->data.get() + offset, segment->used - offset});
+			}
+		}
+	}
+
+	/*! \brief Calls \p f for each change newer than \p version. */
+	template <typename Function>
+	void forEachChangeAfter(uint64_t version, Function f) const {
+		forEachSliceAfter(version, [&f](const Slice &slice) {
+			Segment *segment = slice.segment;
+			uint32_t offset = slice.data - segment->data.get();
+			auto entry = std::lower_bound(segment->entries.begin(), segment->entries.end(), offset,
+					[](const Segment::Entry &e, uint32_t o) { return e.offset < o; });
+			for (; entry != segment->entries.end(); ++entry) {
+				uint32_t end = (entry + 1 == segment->entries.end()) ? segment->used
+				                                                     : (entry + 1)->offset;
+				f(entry->version,
+				  Slice{segment, segment->data.get() + entry->offset, end - entry->offset});
+			}
+		});
+	}
+
+	static void ref(Segment *segment) {
+		++segment->refs;
+	}
+
+	static void unref(Segment *segment) {
+		if (--segment->refs == 0) {
+			delete segment;
+		}
+	}
+
+private:
+	typedef std::deque<Segment *> Segments;
+
+	/*! \brief Finds the first change newer than \p version (segment and offset in it). */
+	std::pair<Segments::const_iterator, uint32_t> find(uint64_t version) const;
+
+	void dropFront();
+
+	uint32_t segmentSize_;
+	uint64_t size_;
+	Segments segments_;
+};
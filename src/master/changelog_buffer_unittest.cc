@@ -0,0 +1,120 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "master/changelog_buffer.h"
+
+#include <cstring>
+#include <string>
+#include <gtest/gtest.h>
+
+static void appendChange(ChangelogBuffer &buffer, uint64_t version, uint32_t timestamp) {
+	std::string change = "change" + std::to_string(version) + ";";
+	ChangelogBuffer::Slice slice = buffer.append(version, timestamp, change.size());
+	memcpy(slice.data, change.data(), change.size());
+}
+
+static std::string slicesAfter(const ChangelogBuffer &buffer, uint64_t version, int *count) {
+	std::string result;
+	*count = 0;
+	buffer.forEachSliceAfter(version, [&](const ChangelogBuffer::Slice &slice) {
+		result.append(reinterpret_cast<const char *>(slice.data), slice.length);
+		++*count;
+	});
+	return result;
+}
+
+static std::string changesAfter(uint64_t first, uint64_t last) {
+	std::string result;
+	for (uint64_t version = first; version <= last; ++version) {
+		result += "change" + std::to_string(version) + ";";
+	}
+	return result;
+}
+
+TEST(ChangelogBufferTest, FindByVersion) {
+	ChangelogBuffer buffer(100);
+	EXPECT_TRUE(buffer.empty());
+	for (uint64_t version = 10; version < 100; ++version) {
+		appendChange(buffer, version, 0);
+	}
+	EXPECT_EQ(10U, buffer.firstVersion());
+
+	int count;
+	EXPECT_EQ(changesAfter(10, 99), slicesAfter(buffer, 0, &count));
+	EXPECT_EQ(changesAfter(10, 99), slicesAfter(buffer, 9, &count));
+	EXPECT_EQ(changesAfter(11, 99), slicesAfter(buffer, 10, &count));
+	EXPECT_EQ(changesAfter(51, 99), slicesAfter(buffer, 50, &count));
+	EXPECT_EQ(changesAfter(99, 99), slicesAfter(buffer, 98, &count));
+	EXPECT_EQ(1, count);
+	EXPECT_EQ("", slicesAfter(buffer, 99, &count));
+	EXPECT_EQ(0, count);
+
+	// each segment of 100 bytes keeps 11 changes of 9 bytes, so slices cover many of them
+	slicesAfter(buffer, 0, &count);
+	EXPECT_EQ(9, count);
+
+	std::vector<uint64_t> versions;
+	buffer.forEachChangeAfter(40, [&](uint64_t version, const ChangelogBuffer::Slice &slice) {
+		EXPECT_EQ("change" + std::to_string(version) + ";",
+				std::string(reinterpret_cast<const char *>(slice.data), slice.length));
+		versions.push_back(version);
+	});
+	ASSERT_EQ(59U, versions.size());
+	EXPECT_EQ(41U, versions.front());
+	EXPECT_EQ(99U, versions.back());
+}
+
+TEST(ChangelogBufferTest, Trim) {
+	ChangelogBuffer buffer(100);
+	for (uint64_t version = 10; version < 100; ++version) {
+		appendChange(buffer, version, version);
+	}
+	EXPECT_EQ(900U, buffer.size());
+
+	// segments start with versions 10, 21, 32, ...; the one covering timestamp 30 stays
+	buffer.trim(30, 0);
+	EXPECT_EQ(21U, buffer.firstVersion());
+	EXPECT_EQ(800U, buffer.size());
+
+	buffer.trim(0, 350);
+	EXPECT_EQ(76U, buffer.firstVersion());
+	EXPECT_EQ(300U, buffer.size());
+
+	// the newest segment is always kept
+	buffer.trim(1000, 1);
+	EXPECT_EQ(98U, buffer.firstVersion());
+	int count;
+	EXPECT_EQ(changesAfter(98, 99), slicesAfter(buffer, 0, &count));
+}
+
+TEST(ChangelogBufferTest, SegmentsOutliveBuffer) {
+	ChangelogBuffer::Slice kept;
+	{
+		ChangelogBuffer buffer(100);
+		appendChange(buffer, 1, 0);
+		kept = buffer.append(2, 0, 300);
+		memset(kept.data, 'x', kept.length);
+		EXPECT_EQ(400U, buffer.size());
+		ChangelogBuffer::ref(kept.segment);
+		buffer.trim(1, 0);
+		EXPECT_EQ(2U, buffer.firstVersion());
+	}
+	EXPECT_EQ(std::string(300, 'x'), std::string(reinterpret_cast<char *>(kept.data), kept.length));
+	ChangelogBuffer::unref(kept.segment);
+}
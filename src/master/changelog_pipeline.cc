@@ -0,0 +1,207 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "master/changelog_pipeline.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <cstdlib>
+
+#include "common/changelog_record.h"
+#include "common/datapack.h"
+#include "common/exceptions.h"
+#include "common/slogger.h"
+
+/// Timestamp of a change, i.e. the number at the beginning of its text ("<ts>|...")
+static uint32_t text_timestamp(const char *text, const char *end) {
+	uint32_t timestamp = 0;
+	for (; text < end && *text >= '0' && *text <= '9'; ++text) {
+		timestamp = timestamp * 10 + (*text - '0');
+	}
+	return timestamp;
+}
+
+/// Timestamp of a binary change, which is either its first token or a part of a literal
+static uint32_t payload_timestamp(const uint8_t *payload, uint32_t payloadSize) {
+	const uint8_t *ptr = payload;
+	if (payloadSize >= 1 + 4 && payload[0] == changelog_record::kU32) {
+		++ptr;
+		return get32bit(&ptr);
+	}
+	if (payloadSize >= 1 + 2 && payload[0] == changelog_record::kLiteral) {
+		++ptr;
+		uint16_t literalSize = get16bit(&ptr);
+		if (literalSize <= payloadSize - (1 + 2)) {
+			const char *text = reinterpret_cast<const char *>(ptr);
+			return text_timestamp(text, text + literalSize);
+		}
+	}
+	return 0;
+}
+
+ChangelogPipeline::ChangelogPipeline()
+    : workerBusy_(false), generation_(0), terminate_(false), notifyPipe_{-1, -1}, count_(0),
+      bytes_(0), lastVersion_(0) {
+	if (pipe(notifyPipe_) < 0) {
+		throw InitializeException("can't create a pipe for the changelog pipeline");
+	}
+	for (int pipeFd : notifyPipe_) {
+		fcntl(pipeFd, F_SETFL, fcntl(pipeFd, F_GETFL) | O_NONBLOCK);
+	}
+	worker_ = std::thread(&ChangelogPipeline::workerThread, this);
+}
+
+ChangelogPipeline::~ChangelogPipeline() {
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		terminate_ = true;
+		wakeWorker_.notify_one();
+	}
+	worker_.join();
+	close(notifyPipe_[0]);
+	close(notifyPipe_[1]);
+}
+
+bool ChangelogPipeline::parse(const uint8_t *data, uint32_t length, Change &change) {
+	if (length > 0 && data[0] == changelog_record::kMarker) {
+		changelog_record::RecordView record;
+		if (changelog_record::parse(data, length, record) != changelog_record::ParseStatus::kOk
+				|| record.recordSize != length) {
+			change.error = "malformed binary entry";
+			return false;
+		}
+		change.version = record.version;
+		change.timestamp = payload_timestamp(record.payload, record.payloadSize);
+		change.payload = record.payload;
+		change.payloadSize = record.payloadSize;
+		return true;
+	}
+	if (length < 10) {
+		change.error = "wrong size (" + std::to_string(length) + "/9+data)";
+		return false;
+	}
+	if (data[0] != 0xFF) {
+		change.error = "wrong packet";
+		return false;
+	}
+	if (data[length - 1] != '\0') {
+		change.error = "invalid string";
+		return false;
+	}
+	const uint8_t *ptr = data + 1;
+	change.version = get64bit(&ptr);
+	change.text = reinterpret_cast<const char *>(ptr);
+	change.timestamp = text_timestamp(change.text, reinterpret_cast<const char *>(data + length));
+	return true;
+}
+
+void ChangelogPipeline::push(const uint8_t *data, uint32_t length) {
+	Change change;
+	change.packet.assign(data, data + length);
+	// the version is known (if the packet is correct) before the change is checked
+	if (length >= changelog_record::kHeaderSize && data[0] == changelog_record::kMarker) {
+		const uint8_t *ptr = data + 1 + 4;
+		lastVersion_ = get64bit(&ptr);
+	} else if (length >= 1 + 8 && data[0] == 0xFF) {
+		const uint8_t *ptr = data + 1;
+		lastVersion_ = get64bit(&ptr);
+	}
+	++count_;
+	bytes_ += length;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	unchecked_.push_back(std::move(change));
+	wakeWorker_.notify_one();
+}
+
+bool ChangelogPipeline::pop(Change &change, bool wait) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (wait) {
+		changeChecked_.wait(lock, [this]() {
+			return !checked_.empty() || (unchecked_.empty() && !workerBusy_);
+		});
+	}
+	if (checked_.empty()) {
+		return false;
+	}
+	change = std::move(checked_.front());
+	checked_.pop_front();
+	--count_;
+	bytes_ -= change.packet.size();
+	return true;
+}
+
+void ChangelogPipeline::clear() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	unchecked_.clear();
+	checked_.clear();
+	++generation_;
+	count_ = 0;
+	bytes_ = 0;
+	lastVersion_ = 0;
+}
+
+uint32_t ChangelogPipeline::oldestTimestamp() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	return checked_.empty() ? 0 : checked_.front().timestamp;
+}
+
+void ChangelogPipeline::drainNotifications() {
+	char buffer[64];
+	while (read(notifyPipe_[0], buffer, sizeof(buffer)) > 0) {
+	}
+}
+
+void ChangelogPipeline::workerThread() {
+	std::deque<Change> batch;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		wakeWorker_.wait(lock, [this]() { return terminate_ || !unchecked_.empty(); });
+		if (terminate_) {
+			break;
+		}
+		batch.swap(unchecked_);
+		uint64_t generation = generation_;
+		workerBusy_ = true;
+		lock.unlock();
+
+		for (Change &change : batch) {
+			parse(change.packet.data(), change.packet.size(), change);
+		}
+
+		lock.lock();
+		workerBusy_ = false;
+		if (generation == generation_) {
+			bool wakeEventLoop = checked_.empty();
+			for (Change &change : batch) {
+				checked_.push_back(std::move(change));
+			}
+			if (wakeEventLoop) {
+				char byte = 0;
+				if (write(notifyPipe_[1], &byte, 1) < 0 && errno != EAGAIN) {
+					lzfs_pretty_errlog(LOG_WARNING, "can't wake up the main loop");
+				}
+			}
+		}
+		batch.clear();
+		changeChecked_.notify_all();
+	}
+}
@@ -0,0 +1,135 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/platform.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*! \brief Changes received from the master server on their way to be applied.
+ *
+ * Shadow masters get changes faster than they can apply them during bursts of metadata
+ * operations. Received changes (bodies of MATOML_METACHANGES_LOG packets) are pushed to the
+ * pipeline and a worker thread validates them (framing, checksums of binary records, version
+ * and timestamp), so the event loop only has to apply checked changes one after another.
+ * Changes always leave the pipeline in the order they were pushed.
+ *
+ * The event loop is woken up through a pipe (see notifyFd()) whenever checked changes are
+ * waiting. All methods except the constructor and the destructor may be used only by one thread.
+ */
+class ChangelogPipeline {
+public:
+	/*! \brief A change parsed from a MATOML_METACHANGES_LOG packet. */
+	struct Change {
+		Change() : version(0), timestamp(0), text(nullptr), payload(nullptr), payloadSize(0) {
+		}
+
+		Change(Change &&) = default;
+		Change &operator=(Change &&) = default;
+
+		uint64_t version;
+		uint32_t timestamp;
+		std::vector<uint8_t> packet;  ///< the whole packet (if it went through the pipeline)
+		const char *text;             ///< text entry without the version ("<ts>|...")
+		const uint8_t *payload;       ///< payload of a binary record (if text == nullptr)
+		uint32_t payloadSize;
+		std::string error;            ///< why the packet is malformed, empty if it is correct
+	};
+
+	ChangelogPipeline();
+	~ChangelogPipeline();
+
+	ChangelogPipeline(const ChangelogPipeline &) = delete;
+	ChangelogPipeline &operator=(const ChangelogPipeline &) = delete;
+
+	/*! \brief Parses and validates a packet, \p change points into \p data afterwards.
+	 *
+	 * \return false if the packet is malformed (change.error says why).
+	 */
+	static bool parse(const uint8_t *data, uint32_t length, Change &change);
+
+	/*! \brief Queues a received packet for validation. */
+	void push(const uint8_t *data, uint32_t length);
+
+	/*! \brief Takes the oldest change if it is already checked.
+	 *
+	 * \param wait wait for the worker if the oldest change isn't checked yet
+	 * \return false if no checked change is available (the pipeline is empty if wait is true)
+	 */
+	bool pop(Change &change, bool wait = false);
+
+	/*! \brief Drops all changes waiting in the pipeline. */
+	void clear();
+
+	/*! \brief Is there no change waiting in the pipeline. */
+	bool empty() const {
+		return count_ == 0;
+	}
+
+	/*! \brief Number of changes waiting in the pipeline. */
+	uint64_t size() const {
+		return count_;
+	}
+
+	/*! \brief Memory taken by the waiting packets. */
+	uint64_t bytes() const {
+		return bytes_;
+	}
+
+	/*! \brief Version of the newest pushed change (0 if it isn't known yet). */
+	uint64_t lastVersion() const {
+		return lastVersion_;
+	}
+
+	/*! \brief Timestamp of the oldest checked change, 0 if there is none. */
+	uint32_t oldestTimestamp();
+
+	/*! \brief Descriptor which becomes readable when checked changes are waiting. */
+	int notifyFd() const {
+		return notifyPipe_[0];
+	}
+
+	/*! \brief Reads all pending notifications from notifyFd(). */
+	void drainNotifications();
+
+private:
+	void workerThread();
+
+	std::mutex mutex_;
+	std::condition_variable wakeWorker_;
+	std::condition_variable changeChecked_;
+	std::deque<Change> unchecked_;  ///< waiting for the worker
+	std::deque<Change> checked_;    ///< waiting for the event loop
+	bool workerBusy_;               ///< worker is checking a change (without the mutex)
+	uint64_t generation_;           ///< incremented by clear() to drop changes held by the worker
+	bool terminate_;
+	int notifyPipe_[2];
+	std::thread worker_;
+
+	// used only by the event loop
+	uint64_t count_;
+	uint64_t bytes_;
+	uint64_t lastVersion_;
+};
@@ -0,0 +1,129 @@
+/*
+   Copyright 2023 Skytechnology sp. z o.o.
+
+   This file is part of LizardFS.
+
+   LizardFS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, version 3.
+
+   LizardFS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with LizardFS. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/platform.h"
+#include "master/changelog_pipeline.h"
+
+#include <poll.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/changelog_record.h"
+#include "common/datapack.h"
+
+static std::vector<uint8_t> textPacket(uint64_t version, const std::string &entry) {
+	std::vector<uint8_t> packet(1 + 8 + entry.size() + 1);
+	uint8_t *ptr = packet.data();
+	put8bit(&ptr, 0xFF);
+	put64bit(&ptr, version);
+	memcpy(ptr, entry.c_str(), entry.size() + 1);
+	return packet;
+}
+
+static std::vector<uint8_t> binaryPacket(uint64_t version, uint32_t ts, const std::string &rest) {
+	std::vector<uint8_t> payload, record;
+	changelog_record::appendU32(payload, ts);
+	changelog_record::appendLiteral(payload, rest.data(), rest.size());
+	changelog_record::frame(version, payload.data(), payload.size(), record);
+	return record;
+}
+
+static void push(ChangelogPipeline &pipeline, const std::vector<uint8_t> &packet) {
+	pipeline.push(packet.data(), packet.size());
+}
+
+TEST(ChangelogPipelineTest, Parse) {
+	ChangelogPipeline::Change change;
+	change.packet = textPacket(10, "1234|SESSION():5");
+	ASSERT_TRUE(ChangelogPipeline::parse(change.packet.data(), change.packet.size(), change));
+	EXPECT_EQ(10U, change.version);
+	EXPECT_EQ(1234U, change.timestamp);
+	EXPECT_STREQ("1234|SESSION():5", change.text);
+
+	change = ChangelogPipeline::Change();
+	change.packet = binaryPacket(11, 4321, "|PURGE(7)");
+	ASSERT_TRUE(ChangelogPipeline::parse(change.packet.data(), change.packet.size(), change));
+	EXPECT_EQ(11U, change.version);
+	EXPECT_EQ(4321U, change.timestamp);
+	EXPECT_EQ(nullptr, change.text);
+	std::string text;
+	ASSERT_TRUE(changelog_record::toText(change.payload, change.payloadSize, text));
+	EXPECT_EQ("4321|PURGE(7)", text);
+
+	change = ChangelogPipeline::Change();
+	change.packet = binaryPacket(12, 1, "|PURGE(7)");
+	change.packet[change.packet.size() - 1] ^= 1;
+	EXPECT_FALSE(ChangelogPipeline::parse(change.packet.data(), change.packet.size(), change));
+	EXPECT_EQ("malformed binary entry", change.error);
+
+	change = ChangelogPipeline::Change();
+	change.packet = textPacket(13, "1|PURGE(7)");
+	change.packet.back() = 'x';
+	EXPECT_FALSE(ChangelogPipeline::parse(change.packet.data(), change.packet.size(), change));
+	EXPECT_EQ("invalid string", change.error);
+
+	change = ChangelogPipeline::Change();
+	change.packet = {0xFF, 0, 0};
+	EXPECT_FALSE(ChangelogPipeline::parse(change.packet.data(), change.packet.size(), change));
+}
+
+TEST(ChangelogPipelineTest, KeepsOrder) {
+	ChangelogPipeline pipeline;
+	for (uint64_t version = 1; version <= 1000; ++version) {
+		if (version % 2) {
+			push(pipeline, textPacket(version, std::to_string(version) + "|ACCESS(1)"));
+		} else {
+			push(pipeline, binaryPacket(version, version, "|ACCESS(1)"));
+		}
+	}
+	EXPECT_EQ(1000U, pipeline.size());
+	EXPECT_EQ(1000U, pipeline.lastVersion());
+
+	pollfd pfd{pipeline.notifyFd(), POLLIN, 0};
+	ASSERT_EQ(1, poll(&pfd, 1, 10000));
+	pipeline.drainNotifications();
+
+	ChangelogPipeline::Change change;
+	for (uint64_t version = 1; version <= 1000; ++version) {
+		ASSERT_TRUE(pipeline.pop(change, true));
+		EXPECT_EQ(version, change.version);
+		EXPECT_EQ(version, change.timestamp);
+		EXPECT_TRUE(change.error.empty());
+	}
+	EXPECT_TRUE(pipeline.empty());
+	EXPECT_EQ(0U, pipeline.bytes());
+	EXPECT_FALSE(pipeline.pop(change, true));
+}
+
+TEST(ChangelogPipelineTest, Clear) {
+	ChangelogPipeline pipeline;
+	for (uint64_t version = 1; version <= 100; ++version) {
+		push(pipeline, textPacket(version, "1|ACCESS(1)"));
+	}
+	pipeline.clear();
+	EXPECT_TRUE(pipeline.empty());
+	EXPECT_EQ(0U, pipeline.lastVersion());
+
+	push(pipeline, textPacket(200, "1|ACCESS(1)"));
+	ChangelogPipeline::Change change;
+	ASSERT_TRUE(pipeline.pop(change, true));
+	EXPECT_EQ(200U, change.version);
+	EXPECT_FALSE(pipeline.pop(change, true));
+}
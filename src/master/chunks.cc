@@ -31,11 +31,14 @@
 #include <unordered_map>
 #include <algorithm>
 #include <deque>
+#include <memory>
+#include <set>
+#include <vector>
 
+#include "common/chunk_set_checksum.h"
 #include "common/chunks_availability_state.h"
 #include "common/chunk_copies_calculator.h"
 #include "common/chunk_version_with_todel_flag.h"
-#include "common/compact_vector.h"
 #include "common/counting_sort.h"
 #include "common/coroutine.h"
 #include "common/datapack.h"
@@ -44,6 +47,8 @@
 #include "common/flat_set.h"
 #include "common/goal.h"
 #include "common/hashfn.h"
+#include "common/inline_vector.h"
+#include "common/intrusive_linear_hash.h"
 #include "common/lizardfs_version.h"
 #include "common/loop_watchdog.h"
 #include "common/massert.h"
@@ -77,8 +82,8 @@
 #define MINCHUNKSLOOPCPU    10
 #define MAXCHUNKSLOOPCPU    90
 
-#define HASHSIZE 0x100000
-#define HASHPOS(chunkid) (((uint32_t)chunkid)&0xFFFFF)
+// Chunk hash starts with CHUNK_HASH_MIN_SIZE buckets and grows one bucket at a time
+#define CHUNK_HASH_MIN_SIZE 0x100000
 
 #define CHECKSUMSEED 78765491511151883ULL
 
@@ -186,6 +191,37 @@ struct ChunkPart {
 	}
 };
 
+/// Memory allocated for parts of chunks which don't fit inside Chunk
+static uint64_t gChunkPartsHeapMemory = 0;
+
+/*! \brief Allocator of parts of chunks which counts the allocated memory. */
+template <typename T>
+struct ChunkPartAllocator : std::allocator<T> {
+	template <typename U>
+	struct rebind {
+		typedef ChunkPartAllocator<U> other;
+	};
+
+	ChunkPartAllocator() = default;
+
+	template <typename U>
+	ChunkPartAllocator(const ChunkPartAllocator<U> &) {
+	}
+
+	T *allocate(std::size_t n) {
+		gChunkPartsHeapMemory += n * sizeof(T);
+		return std::allocator<T>::allocate(n);
+	}
+
+	void deallocate(T *p, std::size_t n) {
+		gChunkPartsHeapMemory -= n * sizeof(T);
+		std::allocator<T>::deallocate(p, n);
+	}
+};
+
+/*! \brief Parts of a chunk, the common case of up to 2 parts is kept inside Chunk. */
+typedef inline_vector<ChunkPart, 2, uint16_t, ChunkPartAllocator<ChunkPart>> ChunkParts;
+
 static void*                         gChunkLoopEventHandle = NULL;
 
 static uint32_t gOperationsDelayDisconnect = 3600;
@@ -227,16 +263,16 @@ public:
 
 	uint64_t chunkid;
 	uint64_t checksum;
-	Chunk *next;
-#ifndef METARESTORE
-	compact_vector<ChunkPart> parts;
-#endif
 private: // public/private sections are mixed here to make the struct as small as possible
 	ChunkGoalCounters goalCounters_;
 public:
+#ifndef METARESTORE
+	ChunkParts parts;
+#endif
 	uint32_t version;
 	uint32_t lockid;
 	uint32_t lockedto;
+	uint32_t next; // index (in ChunkStore) of the next chunk in the hash chain
 #ifndef METARESTORE
 	uint8_t inEndangeredQueue:1;
 	uint8_t needverincrease:1;
@@ -262,7 +298,7 @@ public:
 
 	void clear() {
 		goalCounters_.clear();
-		next = nullptr;
+		next = 0;
 		chunkid = 0;
 		version = 0;
 		lockid = 0;
@@ -506,19 +542,93 @@ uint64_t Chunk::count;
 uint64_t Chunk::allFullChunkCopies[CHUNK_MATRIX_SIZE][CHUNK_MATRIX_SIZE];
 #endif
 
-#define CHUNK_BUCKET_SIZE 20000
-struct chunk_bucket {
-	Chunk bucket[CHUNK_BUCKET_SIZE];
-	uint32_t firstfree;
-	chunk_bucket *next;
-};
+#if !defined(METARESTORE) && defined(NDEBUG)
+// Chunks are scanned all the time by ChunkWorker, keep each of them in a single cache line
+static_assert(sizeof(Chunk) <= 64, "Chunk should fit in a cache line");
+#endif
 
 namespace {
+/*! \brief Storage of chunks in slabs, chunks are referred to by 32-bit indices.
+ *
+ * Chunks never move, so pointers to them stay valid until they are released.
+ * Index 0 is never used, it stands for null.
+ */
+class ChunkStore {
+public:
+	static constexpr uint32_t kSlabSize = 0x4000;
+
+	ChunkStore() : used_(1), freeHead_(0) {
+	}
+
+	Chunk *get(uint32_t index) const {
+		assert(index > 0 && index < used_);
+		return &slabs_[index / kSlabSize]->chunks[index % kSlabSize];
+	}
+
+	uint32_t allocate() {
+		uint32_t index = freeHead_;
+		if (index != 0) {
+			freeHead_ = get(index)->next;
+		} else {
+			if (used_ == std::numeric_limits<uint32_t>::max()) {
+				throw std::bad_alloc();
+			}
+			if (used_ / kSlabSize == slabs_.size()) {
+				slabs_.emplace_back(new Slab);
+			}
+			index = used_++;
+		}
+		return index;
+	}
+
+	void release(uint32_t index) {
+		get(index)->next = freeHead_;
+		freeHead_ = index;
+	}
+
+	/*! \brief Memory used by chunks (including released ones). */
+	uint64_t memoryUsage() const {
+		return (uint64_t)slabs_.size() * sizeof(Slab);
+	}
+
+private:
+	struct alignas(64) Slab {
+		Chunk chunks[kSlabSize];
+	};
+
+	std::vector<std::unique_ptr<Slab>> slabs_;
+	uint32_t used_;
+	uint32_t freeHead_;
+};
+
+struct ChunkIdOf {
+	uint64_t operator()(const Chunk *chunk) const {
+		return chunk->chunkid;
+	}
+};
+
+/*! \brief Links chunks in ChunkHash by their indices in ChunkStore. */
+struct ChunkIndexLink {
+	typedef uint32_t handle_type;
+
+	static inline Chunk *get(uint32_t index);
+
+	static uint32_t &next(Chunk *chunk) {
+		return chunk->next;
+	}
+
+	static uint32_t next(const Chunk *chunk) {
+		return chunk->next;
+	}
+};
+
+typedef intrusive_linear_hash<Chunk, ChunkIdOf, CHUNK_HASH_MIN_SIZE, 0x10000, ChunkIndexLink>
+		ChunkHash;
+
 struct ChunksMetadata {
 	// chunks
-	chunk_bucket *cbhead;
-	Chunk *chfreehead;
-	Chunk *chunkhash[HASHSIZE];
+	ChunkStore store;
+	ChunkHash chunkhash;
 	uint64_t lastchunkid;
 	Chunk *lastchunkptr;
 
@@ -529,9 +639,8 @@ struct ChunksMetadata {
 	uint32_t checksumRecalculationPosition;
 
 	ChunksMetadata() :
-			cbhead{},
-			chfreehead{},
-			chunkhash{},
+			store(),
+			chunkhash(),
 			lastchunkid{},
 			lastchunkptr{},
 			nextchunkid{1},
@@ -539,25 +648,25 @@ struct ChunksMetadata {
 			chunksChecksumRecalculated{},
 			checksumRecalculationPosition{0} {
 	}
-
-	~ChunksMetadata() {
-		chunk_bucket *cbn;
-		for (chunk_bucket *cb = cbhead; cb; cb = cbn) {
-			cbn = cb->next;
-			delete cb;
-		}
-	}
 };
 } // anonymous namespace
 
 static ChunksMetadata *gChunksMetadata;
 
+inline Chunk *ChunkIndexLink::get(uint32_t index) {
+	return gChunksMetadata->store.get(index);
+}
+
 #define LOCKTIMEOUT 120
 #define UNUSED_DELETE_TIMEOUT (86400*7)
 
 #ifndef METARESTORE
 
 static Chunk *gCurrentChunkInZombieLoop = nullptr;
+static uint32_t gZombieLoopPosition = ChunkHash::kMaxSize;
+
+// Bucket which ChunkWorker is in the middle of, it must not be split until the worker leaves it
+static uint32_t gChunkWorkerBucket = ChunkHash::kMaxSize;
 
 class ReplicationDelayInfo {
 public:
@@ -662,12 +771,12 @@ static void chunk_update_checksum(Chunk *ch) {
 	if (!ch) {
 		return;
 	}
-	if (HASHPOS(ch->chunkid) < gChunksMetadata->checksumRecalculationPosition) {
+	if (gChunksMetadata->chunkhash.bucket_position(ch->chunkid) < gChunksMetadata->checksumRecalculationPosition) {
 		removeFromChecksum(gChunksMetadata->chunksChecksumRecalculated, ch->checksum);
 	}
 	removeFromChecksum(gChunksMetadata->chunksChecksum, ch->checksum);
 	ch->checksum = chunk_checksum(ch);
-	if (HASHPOS(ch->chunkid) < gChunksMetadata->checksumRecalculationPosition) {
+	if (gChunksMetadata->chunkhash.bucket_position(ch->chunkid) < gChunksMetadata->checksumRecalculationPosition) {
 		lzfs_silent_syslog(LOG_DEBUG, "master.fs.checksum.changing_recalculated_chunk");
 		addToChecksum(gChunksMetadata->chunksChecksumRecalculated, ch->checksum);
 	} else {
@@ -687,9 +796,9 @@ ChecksumRecalculationStatus chunks_update_checksum_a_bit(uint32_t speedLimit) {
 		gChunksMetadata->chunksChecksumRecalculated = CHECKSUMSEED;
 	}
 	uint32_t recalculated = 0;
-	while (gChunksMetadata->checksumRecalculationPosition < HASHSIZE) {
+	while (gChunksMetadata->checksumRecalculationPosition < gChunksMetadata->chunkhash.bucket_count()) {
 		Chunk *c;
-		for (c = gChunksMetadata->chunkhash[gChunksMetadata->checksumRecalculationPosition]; c; c=c->next) {
+		for (c = gChunksMetadata->chunkhash.bucket(gChunksMetadata->checksumRecalculationPosition); c; c = ChunkHash::next(c)) {
 			chunk_checksum_add_to_background(c);
 			++recalculated;
 		}
@@ -710,8 +819,8 @@ ChecksumRecalculationStatus chunks_update_checksum_a_bit(uint32_t speedLimit) {
 
 static void chunk_recalculate_checksum() {
 	gChunksMetadata->chunksChecksum = CHECKSUMSEED;
-	for (int i = 0; i < HASHSIZE; ++i) {
-		for (Chunk *ch = gChunksMetadata->chunkhash[i]; ch; ch = ch->next) {
+	for (uint32_t i = 0; i < gChunksMetadata->chunkhash.bucket_count(); ++i) {
+		for (Chunk *ch = gChunksMetadata->chunkhash.bucket(i); ch; ch = ChunkHash::next(ch)) {
 			ch->checksum = chunk_checksum(ch);
 			addToChecksum(gChunksMetadata->chunksChecksum, ch->checksum);
 		}
@@ -728,42 +837,53 @@ uint64_t chunk_checksum(ChecksumMode mode) {
 	return checksum;
 }
 
-static inline Chunk *chunk_malloc() {
-	chunk_bucket *cb;
-	Chunk *ret;
-	if (gChunksMetadata->chfreehead) {
-		ret = gChunksMetadata->chfreehead;
-		gChunksMetadata->chfreehead = ret->next;
-		ret->clear();
-		return ret;
-	}
-	if (gChunksMetadata->cbhead==NULL || gChunksMetadata->cbhead->firstfree==CHUNK_BUCKET_SIZE) {
-		cb = new chunk_bucket;
-		cb->next = gChunksMetadata->cbhead;
-		cb->firstfree = 0;
-		gChunksMetadata->cbhead = cb;
-	}
-	ret = (gChunksMetadata->cbhead->bucket)+(gChunksMetadata->cbhead->firstfree);
-	gChunksMetadata->cbhead->firstfree++;
-	ret->clear();
-	return ret;
+static inline uint32_t chunk_malloc() {
+	uint32_t index = gChunksMetadata->store.allocate();
+	gChunksMetadata->store.get(index)->clear();
+	return index;
 }
 
 #ifndef METARESTORE
-static inline void chunk_free(Chunk *p) {
-	p->next = gChunksMetadata->chfreehead;
-	gChunksMetadata->chfreehead = p;
-	p->inEndangeredQueue = 0;
+static inline void chunk_free(uint32_t index) {
+	gChunksMetadata->store.get(index)->inEndangeredQueue = 0;
+	gChunksMetadata->store.release(index);
 }
 #endif /* METARESTORE */
 
+static void chunk_hash_grow() {
+	ChunkHash &hash = gChunksMetadata->chunkhash;
+	// A split may be postponed because of ChunkWorker, so allow catching up
+	for (int i = 0; i < 2 && hash.needs_split(); ++i) {
+#ifndef METARESTORE
+		if (hash.split_position() == gChunkWorkerBucket) {
+			return;
+		}
+#endif
+		uint32_t pos = hash.split([](Chunk *c, uint32_t oldpos, uint32_t newpos) {
+			// Chunk is moved behind the background recalculation, which will count it again
+			if (oldpos < gChunksMetadata->checksumRecalculationPosition
+					&& newpos >= gChunksMetadata->checksumRecalculationPosition) {
+				removeFromChecksum(gChunksMetadata->chunksChecksumRecalculated, c->checksum);
+			}
+		});
+#ifndef METARESTORE
+		if (gZombieLoopPosition == pos) {
+			// Chain was rebuilt, start it again (handling disconnected copies twice is harmless)
+			gCurrentChunkInZombieLoop = hash.bucket(pos);
+		}
+#else
+		(void)pos;
+#endif
+	}
+}
+
 Chunk *chunk_new(uint64_t chunkid, uint32_t chunkversion) {
-	uint32_t chunkpos = HASHPOS(chunkid);
 	Chunk *newchunk;
-	newchunk = chunk_malloc();
-	newchunk->next = gChunksMetadata->chunkhash[chunkpos];
-	gChunksMetadata->chunkhash[chunkpos] = newchunk;
+	chunk_hash_grow();
+	uint32_t index = chunk_malloc();
+	newchunk = gChunksMetadata->store.get(index);
 	newchunk->chunkid = chunkid;
+	gChunksMetadata->chunkhash.insert(index);
 	newchunk->version = chunkversion;
 	gChunksMetadata->lastchunkid = chunkid;
 	gChunksMetadata->lastchunkptr = newchunk;
@@ -794,8 +914,17 @@ void chunk_emergency_increase_version(Chunk *c) {
 }
 
 void chunk_handle_disconnected_copies(Chunk *c) {
-	auto it = std::remove_if(c->parts.begin(), c->parts.end(), [](const ChunkPart &part) {
-		return csdb_find(part.csid)->eptr == nullptr;
+	auto it = std::remove_if(c->parts.begin(), c->parts.end(), [c](const ChunkPart &part) {
+		csdbentry *cs = csdb_find(part.csid);
+		if (cs->eptr != nullptr) {
+			return false;
+		}
+		if (cs->registrationEpoch != 0) {
+			// Remember the part, chunkserver may resume its registration after reconnecting
+			cs->detachedParts.emplace_back(c->chunkid,
+					common::combineVersionWithTodelFlag(part.version, part.is_todel()), part.type);
+		}
+		return true;
 	});
 	bool lost_copy_found = it != c->parts.end();
 
@@ -824,36 +953,34 @@ void chunk_handle_disconnected_copies(Chunk *c) {
 #endif
 
 Chunk *chunk_find(uint64_t chunkid) {
-	uint32_t chunkpos = HASHPOS(chunkid);
 	Chunk *chunkit;
 	if (gChunksMetadata->lastchunkid==chunkid) {
 		return gChunksMetadata->lastchunkptr;
 	}
-	for (chunkit = gChunksMetadata->chunkhash[chunkpos] ; chunkit ; chunkit = chunkit->next) {
-		if (chunkit->chunkid == chunkid) {
-			gChunksMetadata->lastchunkid = chunkid;
-			gChunksMetadata->lastchunkptr = chunkit;
+	chunkit = gChunksMetadata->chunkhash.find(chunkid);
+	if (chunkit) {
+		gChunksMetadata->lastchunkid = chunkid;
+		gChunksMetadata->lastchunkptr = chunkit;
 #ifndef METARESTORE
-			chunk_handle_disconnected_copies(chunkit);
+		chunk_handle_disconnected_copies(chunkit);
 #endif // METARESTORE
-			return chunkit;
-		}
 	}
-	return NULL;
+	return chunkit;
+}
+
+uint32_t chunk_count(void) {
+	return gChunksMetadata->chunkhash.size();
 }
 
 #ifndef METARESTORE
-void chunk_delete(Chunk *c) {
+void chunk_delete(uint32_t index) {
+	Chunk *c = gChunksMetadata->store.get(index);
 	if (gChunksMetadata->lastchunkptr==c) {
 		gChunksMetadata->lastchunkid=0;
 		gChunksMetadata->lastchunkptr=NULL;
 	}
 	c->freeStats();
-	chunk_free(c);
-}
-
-uint32_t chunk_count(void) {
-	return Chunk::count;
+	chunk_free(index);
 }
 
 void chunk_info(uint32_t *allchunks,uint32_t *allcopies,uint32_t *regularvalidcopies) {
@@ -869,6 +996,14 @@ void chunk_info(uint32_t *allchunks,uint32_t *allcopies,uint32_t *regularvalidco
 	}
 }
 
+HashTableStatistics chunk_hash_table_statistics() {
+	const ChunkHash &hash = gChunksMetadata->chunkhash;
+	uint64_t memory = gChunksMetadata->store.memoryUsage() + hash.memory_usage() +
+			gChunkPartsHeapMemory;
+	return HashTableStatistics("chunks", hash.size(), hash.bucket_count(),
+			hash.used_bucket_count(), memory);
+}
+
 uint32_t chunk_get_missing_count(void) {
 	uint32_t res = 0;
 	for (uint8_t goal = GoalId::kMin; goal <= GoalId::kMax; ++goal) {
@@ -1558,6 +1693,59 @@ void chunk_server_has_chunk(matocsserventry *ptr, uint64_t chunkid, uint32_t ver
 	c->updateStats();
 }
 
+bool chunk_server_resume_registration(matocsserventry *ptr, uint64_t epoch, uint64_t checksum,
+		uint32_t chunkCount, const std::vector<ChunkWithVersionAndType> &changedChunks,
+		const std::vector<ChunkWithType> &removedChunks) {
+	csdbentry *cs = matocsserv_get_csdb(ptr);
+	std::vector<ChunkWithVersionAndType> detachedParts;
+	detachedParts.swap(cs->detachedParts);
+	bool usable = epoch != 0 && epoch == cs->registrationEpoch && cs->detachedPartsComplete;
+	cs->registrationEpoch = 0;
+	cs->detachedPartsComplete = false;
+	if (!usable) {
+		return false;
+	}
+
+	auto key = [](uint64_t chunkId, ChunkPartType type) {
+		return std::make_pair(chunkId, type.getId());
+	};
+	std::set<std::pair<uint64_t, int>> changedKeys;
+	for (const auto &chunk : changedChunks) {
+		changedKeys.insert(key(chunk.id, chunk.type));
+	}
+	for (const auto &chunk : removedChunks) {
+		changedKeys.insert(key(chunk.id, chunk.type));
+	}
+
+	// Verify that the parts we remember together with the changes give the current
+	// contents of the chunkserver before trusting them.
+	uint64_t expectedChecksum = 0;
+	uint32_t expectedCount = 0;
+	for (const auto &part : detachedParts) {
+		if (changedKeys.count(key(part.id, part.type)) == 0) {
+			addToChecksum(expectedChecksum, chunkSetChecksumEntry(part.id, part.version, part.type));
+			++expectedCount;
+		}
+	}
+	for (const auto &chunk : changedChunks) {
+		addToChecksum(expectedChecksum, chunkSetChecksumEntry(chunk.id, chunk.version, chunk.type));
+		++expectedCount;
+	}
+	if (expectedChecksum != checksum || expectedCount != chunkCount) {
+		return false;
+	}
+
+	for (const auto &part : detachedParts) {
+		if (changedKeys.count(key(part.id, part.type)) == 0) {
+			chunk_server_has_chunk(ptr, part.id, part.version, part.type);
+		}
+	}
+	for (const auto &chunk : changedChunks) {
+		chunk_server_has_chunk(ptr, chunk.id, chunk.version, chunk.type);
+	}
+	return true;
+}
+
 void chunk_damaged(matocsserventry *ptr, uint64_t chunkid, ChunkPartType chunk_type) {
 	Chunk *c;
 	c = chunk_find(chunkid);
@@ -1631,30 +1819,34 @@ void chunk_server_label_changed(const MediaLabel &previousLabel, const MediaLabe
  */
 void chunk_clean_zombie_servers_a_bit() {
 	SignalLoopWatchdog watchdog;
-	static uint32_t current_position = HASHSIZE;
+	ChunkHash &hash = gChunksMetadata->chunkhash;
 
 	if (gDisconnectedCounter == 0) {
 		return;
 	}
 
 	watchdog.start();
-	while (current_position < HASHSIZE) {
-		for (; gCurrentChunkInZombieLoop; gCurrentChunkInZombieLoop = gCurrentChunkInZombieLoop->next) {
+	while (gZombieLoopPosition < hash.bucket_count()) {
+		for (; gCurrentChunkInZombieLoop;
+				gCurrentChunkInZombieLoop = ChunkHash::next(gCurrentChunkInZombieLoop)) {
 			chunk_handle_disconnected_copies(gCurrentChunkInZombieLoop);
 			if (watchdog.expired()) {
 				eventloop_make_next_poll_nonblocking();
 				return;
 			}
 		}
-		++current_position;
-		if (current_position < HASHSIZE) {
-			gCurrentChunkInZombieLoop = gChunksMetadata->chunkhash[current_position];
+		++gZombieLoopPosition;
+		if (gZombieLoopPosition < hash.bucket_count()) {
+			gCurrentChunkInZombieLoop = hash.bucket(gZombieLoopPosition);
 		}
 	}
-	if (current_position >= HASHSIZE) {
+	if (gZombieLoopPosition >= hash.bucket_count()) {
 		--gDisconnectedCounter;
-		current_position = 0;
-		gCurrentChunkInZombieLoop = gChunksMetadata->chunkhash[0];
+		if (gDisconnectedCounter == 0) {
+			csdb_mark_detached_parts_complete();
+		}
+		gZombieLoopPosition = 0;
+		gCurrentChunkInZombieLoop = hash.bucket(0);
 	}
 	eventloop_make_next_poll_nonblocking();
 }
@@ -1862,6 +2054,7 @@ ChunkWorker::ChunkWorker()
 		  deleteLoopCount_(0) {
 	memset(&inforec_,0,sizeof(loop_info));
 	stack_.current_bucket = 0;
+	gChunkWorkerBucket = ChunkHash::kMaxSize;
 }
 
 void ChunkWorker::doEveryLoopTasks() {
@@ -2493,6 +2686,11 @@ void ChunkWorker::doChunkJobs(Chunk *c, uint16_t serverCount) {
 
 }
 
+// HashSteps is computed for the initial size of the chunk hash, scale it to the current one
+static uint64_t chunk_hash_steps() {
+	return (uint64_t)HashSteps * (gChunksMetadata->chunkhash.loop_size() / CHUNK_HASH_MIN_SIZE);
+}
+
 bool ChunkWorker::deleteUnusedChunks() {
 	while (stack_.node != nullptr) {
 		chunk_handle_disconnected_copies(stack_.node);
@@ -2500,30 +2698,23 @@ bool ChunkWorker::deleteUnusedChunks() {
 			// If current chunk in zombie loop is to be deleted, it must be updated
 			// to the next chunk
 			if (stack_.node == gCurrentChunkInZombieLoop) {
-				gCurrentChunkInZombieLoop = gCurrentChunkInZombieLoop->next;
+				gCurrentChunkInZombieLoop = ChunkHash::next(gCurrentChunkInZombieLoop);
 			}
 			// Something could be inserted between prev and node (when we yielded)
 			// so we need to make prev valid.
-			while (stack_.prev && stack_.prev->next != stack_.node) {
-				stack_.prev = stack_.prev->next;
+			while (stack_.prev && ChunkHash::next(stack_.prev) != stack_.node) {
+				stack_.prev = ChunkHash::next(stack_.prev);
 			}
 
-			assert((!stack_.prev && gChunksMetadata->chunkhash[stack_.current_bucket] == stack_.node) ||
-			       (stack_.prev && stack_.prev->next == stack_.node));
+			uint32_t index = gChunksMetadata->chunkhash.erase_after(stack_.current_bucket,
+			                                                        stack_.prev, stack_.node);
 
-			if (stack_.prev) {
-				stack_.prev->next = stack_.node->next;
-			} else {
-				gChunksMetadata->chunkhash[stack_.current_bucket] =
-				        stack_.node->next;
-			}
-
-			Chunk *tmp = stack_.node->next;
-			chunk_delete(stack_.node);
+			Chunk *tmp = ChunkHash::next(stack_.node);
+			chunk_delete(index);
 			stack_.node = tmp;
 		} else {
 			stack_.prev = stack_.node;
-			stack_.node = stack_.node->next;
+			stack_.node = ChunkHash::next(stack_.node);
 		}
 
 		if (stack_.watchdog.expired()) {
@@ -2578,8 +2769,14 @@ void ChunkWorker::mainLoop() {
 			}
 		}
 
-		while (stack_.buckets_done_count < HashSteps &&
+		while (stack_.buckets_done_count < chunk_hash_steps() &&
 		       stack_.chunks_done_count < HashCPS) {
+			// Buckets past the end of the table are not split yet, their chunks are visited
+			// together with the bucket they will be split from.
+			while (stack_.current_bucket >= gChunksMetadata->chunkhash.bucket_count()) {
+				stack_.current_bucket = (stack_.current_bucket + 123) % gChunksMetadata->chunkhash.loop_size();
+			}
+
 			if (stack_.current_bucket == 0) {
 				doEveryLoopTasks();
 			}
@@ -2589,9 +2786,11 @@ void ChunkWorker::mainLoop() {
 				stack_.watchdog.start();
 			}
 
+			gChunkWorkerBucket = stack_.current_bucket;
+
 			// delete unused chunks
 			stack_.prev = nullptr;
-			stack_.node = gChunksMetadata->chunkhash[stack_.current_bucket];
+			stack_.node = gChunksMetadata->chunkhash.bucket(stack_.current_bucket);
 			while (!deleteUnusedChunks()) {
 				yield;
 				stack_.watchdog.start();
@@ -2601,11 +2800,11 @@ void ChunkWorker::mainLoop() {
 			matocsserv_usagedifference(nullptr, nullptr, &stack_.usable_server_count,
 			                           nullptr);
 
-			stack_.node = gChunksMetadata->chunkhash[stack_.current_bucket];
+			stack_.node = gChunksMetadata->chunkhash.bucket(stack_.current_bucket);
 			while (stack_.node) {
 				doChunkJobs(stack_.node, stack_.usable_server_count);
 				++stack_.chunks_done_count;
-				stack_.node = stack_.node->next;
+				stack_.node = ChunkHash::next(stack_.node);
 
 				if (stack_.watchdog.expired()) {
 					yield;
@@ -2616,10 +2815,11 @@ void ChunkWorker::mainLoop() {
 				}
 			}
 
+			gChunkWorkerBucket = ChunkHash::kMaxSize;
+
 			stack_.current_bucket +=
-			        123;  // if HASHSIZE is any power of 2 then any odd number is
-			              // good here
-			stack_.current_bucket %= HASHSIZE;
+			        123;  // loop size is a power of 2, so any odd number is good here
+			stack_.current_bucket %= gChunksMetadata->chunkhash.loop_size();
 			++stack_.buckets_done_count;
 
 			if (stack_.work_limit.expired()) {
@@ -2658,8 +2858,8 @@ void chunk_dump(void) {
 	Chunk *c;
 	uint32_t i;
 
-	for (i=0 ; i<HASHSIZE ; i++) {
-		for (c=gChunksMetadata->chunkhash[i] ; c ; c=c->next) {
+	for (i=0 ; i<gChunksMetadata->chunkhash.bucket_count() ; i++) {
+		for (c=gChunksMetadata->chunkhash.bucket(i) ; c ; c=ChunkHash::next(c)) {
 			printf("*|i:%016" PRIX64 "|v:%08" PRIX32 "|g:%" PRIu8 "|t:%10" PRIu32 "\n",c->chunkid,c->version,c->highestIdGoal(),c->lockedto);
 		}
 	}
@@ -2728,8 +2928,8 @@ void chunk_store(FILE *fd) {
 	}
 	j=0;
 	ptr = storebuff;
-	for (i=0 ; i<HASHSIZE ; i++) {
-		for (c=gChunksMetadata->chunkhash[i] ; c ; c=c->next) {
+	for (i=0 ; i<gChunksMetadata->chunkhash.bucket_count() ; i++) {
+		for (c=gChunksMetadata->chunkhash.bucket(i) ; c ; c=ChunkHash::next(c)) {
 #ifndef METARESTORE
 			chunk_handle_disconnected_copies(c);
 #endif
@@ -2850,13 +3050,13 @@ void chunk_reload(void) {
 	if (cfg_isdefined("CHUNKS_LOOP_TIME")) {
 		looptime = cfg_get_minmaxvalue<uint32_t>("CHUNKS_LOOP_TIME", 300, MINLOOPTIME, MAXLOOPTIME);
 		uint64_t scaled_looptime = std::max((uint64_t)1000 * looptime / ChunksLoopPeriod, (uint64_t)1);
-		HashSteps = 1 + ((HASHSIZE) / scaled_looptime);
+		HashSteps = 1 + ((CHUNK_HASH_MIN_SIZE) / scaled_looptime);
 		HashCPS   = 0xFFFFFFFF;
 	} else {
 		looptime = cfg_get_minmaxvalue<uint32_t>("CHUNKS_LOOP_MIN_TIME", 300, MINLOOPTIME, MAXLOOPTIME);
 		HashCPS = cfg_get_minmaxvalue<uint32_t>("CHUNKS_LOOP_MAX_CPS", 100000, MINCPS, MAXCPS);
 		uint64_t scaled_looptime = std::max((uint64_t)1000 * looptime / ChunksLoopPeriod, (uint64_t)1);
-		HashSteps = 1 + ((HASHSIZE) / scaled_looptime);
+		HashSteps = 1 + ((CHUNK_HASH_MIN_SIZE) / scaled_looptime);
 		HashCPS   = (uint64_t)ChunksLoopPeriod * HashCPS / 1000;
 	}
 	double endangeredChunksPriority = cfg_ranged_get("ENDANGERED_CHUNKS_PRIORITY", 0.0, 0.0, 1.0);
@@ -2930,13 +3130,13 @@ int chunk_strinit(void) {
 				cfg_filename().c_str());
 		looptime = cfg_get_minmaxvalue<uint32_t>("CHUNKS_LOOP_TIME", 300, MINLOOPTIME, MAXLOOPTIME);
 		uint64_t scaled_looptime = std::max((uint64_t)1000 * looptime / ChunksLoopPeriod, (uint64_t)1);
-		HashSteps = 1 + ((HASHSIZE) / scaled_looptime);
+		HashSteps = 1 + ((CHUNK_HASH_MIN_SIZE) / scaled_looptime);
 		HashCPS   = 0xFFFFFFFF;
 	} else {
 		looptime = cfg_get_minmaxvalue<uint32_t>("CHUNKS_LOOP_MIN_TIME", 300, MINLOOPTIME, MAXLOOPTIME);
 		HashCPS = cfg_get_minmaxvalue<uint32_t>("CHUNKS_LOOP_MAX_CPS", 100000, MINCPS, MAXCPS);
 		uint64_t scaled_looptime = std::max((uint64_t)1000 * looptime / ChunksLoopPeriod, (uint64_t)1);
-		HashSteps = 1 + ((HASHSIZE) / scaled_looptime);
+		HashSteps = 1 + ((CHUNK_HASH_MIN_SIZE) / scaled_looptime);
 		HashCPS   = (uint64_t)ChunksLoopPeriod * HashCPS / 1000;
 	}
 	double endangeredChunksPriority = cfg_ranged_get("ENDANGERED_CHUNKS_PRIORITY", 0.0, 0.0, 1.0);
@@ -26,7 +26,10 @@
 #include "common/chunk_part_type.h"
 #include "common/chunk_type_with_address.h"
 #include "common/chunk_with_address_and_label.h"
+#include "common/chunk_with_version_and_type.h"
 #include "common/chunks_availability_state.h"
+#include "common/hash_table_statistics.h"
+#include "protocol/chunks_with_type.h"
 #include "protocol/cltoma.h"
 #include "master/checksum.h"
 
@@ -58,10 +61,10 @@ void chunk_stats(uint32_t *del,uint32_t *repl);
 void chunk_store_info(uint8_t *buff);
 uint32_t chunk_get_missing_count(void);
 void chunk_store_chunkcounters(uint8_t *buff,uint8_t matrixid);
-uint32_t chunk_count(void);
 const ChunksReplicationState& chunk_get_replication_state();
 const ChunksAvailabilityState& chunk_get_availability_state();
 void chunk_info(uint32_t *allchunks,uint32_t *allcopies,uint32_t *regcopies);
+HashTableStatistics chunk_hash_table_statistics();
 
 /// Checks if the given chunk has only invalid copies (ie. needs to be repaired).
 bool chunk_has_only_invalid_copies(uint64_t chunkid);
@@ -75,6 +78,19 @@ int chunk_getversionandlocations(uint64_t chunkid, uint32_t currentIp, uint32_t&
 int chunk_getversionandlocations(uint64_t chunkid, uint32_t currentIp, uint32_t& version,
 		uint32_t maxNumberOfChunkCopies, std::vector<ChunkPartWithAddressAndLabel>& serversList);
 void chunk_server_has_chunk(matocsserventry *ptr, uint64_t chunkid, uint32_t versionWithTodelFlag, ChunkPartType chunkType);
+/*! \brief Register chunks of a reconnected chunkserver using parts remembered after disconnection.
+ *
+ * \param epoch Epoch of the previous registration of the chunkserver.
+ * \param checksum Checksum of all chunks of the chunkserver (see chunkSetChecksumEntry).
+ * \param chunkCount Number of all chunks of the chunkserver.
+ * \param changedChunks Chunks changed since the previous registration.
+ * \param removedChunks Chunks removed since the previous registration.
+ *
+ * \return false if the chunkserver has to register all its chunks.
+ */
+bool chunk_server_resume_registration(matocsserventry *ptr, uint64_t epoch, uint64_t checksum,
+		uint32_t chunkCount, const std::vector<ChunkWithVersionAndType> &changedChunks,
+		const std::vector<ChunkWithType> &removedChunks);
 void chunk_damaged(matocsserventry *ptr, uint64_t chunkid, ChunkPartType chunk_type);
 void chunk_lost(matocsserventry *ptr, uint64_t chunkid, ChunkPartType chunk_type);
 void chunk_server_disconnected(matocsserventry *ptr, const MediaLabel &label);
@@ -97,6 +113,7 @@ int chunk_invalidate_goal_cache();
 
 #endif
 
+uint32_t chunk_count(void);
 int chunk_load(FILE *fd, bool loadLockIds);
 void chunk_store(FILE *fd);
 void chunk_unload(void);
@@ -20,6 +20,7 @@
 #include "common/platform.h"
 #include "master/chunkserver_db.h"
 
+#include "common/event_loop.h"
 #include "common/integer_sequence.h"
 #include "common/lizardfs_version.h"
 #include "common/media_label.h"
@@ -105,7 +106,32 @@ int csdb_new_connection(uint32_t ip, uint16_t port, matocsserventry *eptr) {
 void csdb_lost_connection(uint32_t ip, uint16_t port) {
 	auto it = gCSDB.find(std::make_pair(ip, port));
 	if (it != gCSDB.end()) {
-		it->second.eptr = nullptr;
+		csdbentry &entry = it->second;
+		entry.eptr = nullptr;
+		entry.disconnectionTime = eventloop_time();
+		entry.detachedPartsComplete = false;
+		entry.detachedParts.clear();
+	}
+}
+
+void csdb_mark_detached_parts_complete() {
+	for (auto &entry : gCSDB) {
+		if (entry.second.eptr == nullptr && entry.second.registrationEpoch != 0) {
+			entry.second.detachedPartsComplete = true;
+		}
+	}
+}
+
+void csdb_remove_stale_detached_parts(uint32_t timeout) {
+	uint32_t now = eventloop_time();
+	for (auto &entry : gCSDB) {
+		csdbentry &cs = entry.second;
+		if (cs.eptr == nullptr && cs.registrationEpoch != 0
+				&& (timeout == 0 || cs.disconnectionTime + timeout < now)) {
+			cs.registrationEpoch = 0;
+			cs.detachedPartsComplete = false;
+			std::vector<ChunkWithVersionAndType>().swap(cs.detachedParts);
+		}
 	}
 }
 
@@ -21,6 +21,9 @@
 
 #include "common/platform.h"
 
+#include <vector>
+
+#include "common/chunk_with_version_and_type.h"
 #include "common/media_label.h"
 #include "protocol/chunkserver_list_entry.h"
 
@@ -37,7 +40,22 @@ struct csdbentry {
 
 	MediaLabel label;
 
-	csdbentry() : eptr(), csid(), label(MediaLabel::kWildcard) {}
+	uint64_t registrationEpoch;              /*!< Epoch of the last registration, 0 if the
+	                                            chunkserver has to send the full list of chunks. */
+	uint32_t disconnectionTime;              /*!< Time of the last disconnection. */
+	bool detachedPartsComplete;              /*!< True if all parts of a disconnected chunkserver
+	                                            were moved to \p detachedParts. */
+	std::vector<ChunkWithVersionAndType> detachedParts; /*!< Parts of chunks removed after the
+	                                                       chunkserver disconnected. */
+
+	csdbentry()
+	    : eptr(),
+	      csid(),
+	      label(MediaLabel::kWildcard),
+	      registrationEpoch(),
+	      disconnectionTime(),
+	      detachedPartsComplete() {
+	}
 };
 
 extern std::array<csdbentry *, csdbentry::kMaxIdCount> gIdToCSEntry;
@@ -61,6 +79,19 @@ int csdb_new_connection(uint32_t ip, uint16_t port, matocsserventry *eptr);
  */
 void csdb_lost_connection(uint32_t ip, uint16_t port);
 
+/*! \brief Mark that all chunks were checked for parts of disconnected chunkservers.
+ *
+ * Since now the lists of detached parts of disconnected chunkservers can be used to resume
+ * their registration.
+ */
+void csdb_mark_detached_parts_complete();
+
+/*! \brief Forget parts detached from chunkservers which are disconnected for too long.
+ *
+ * \param timeout Time (in seconds) after which chunkserver has to register all its chunks again.
+ */
+void csdb_remove_stale_detached_parts(uint32_t timeout);
+
 /*! \brief Get information about all chunkservers.
  *
  * This list includes disconnected chunkservers.
@@ -48,6 +48,7 @@ FilesystemMetadata* gMetadata = nullptr;
 static bool gAutoRecovery = false;
 bool gMagicAutoFileRepair = false;
 bool gAtimeDisabled = false;
+bool gBinaryChangelog = false;
 MetadataDumper metadataDumper(kMetadataFilename, kMetadataTmpFilename);
 
 uint32_t gTestStartTime;
@@ -109,6 +110,10 @@ static void metadataPollServe(const std::vector<pollfd> &pdesc) {
 	}
 }
 
+MetadataDumper::Progress fs_metadata_dump_progress() {
+	return metadataDumper.progress();
+}
+
 void fs_periodic_storeall() {
 	fs_storeall(MetadataDumper::kBackgroundDump); // ignore error
 }
@@ -298,6 +303,7 @@ static void fs_read_config_file() {
 	gDisableChecksumVerification = cfg_getint32("DISABLE_METADATA_CHECKSUM_VERIFICATION", 0) != 0;
 	gMagicAutoFileRepair = cfg_getint32("MAGIC_AUTO_FILE_REPAIR", 0) == 1;
 	gAtimeDisabled = cfg_getint32("NO_ATIME", 0) == 1;
+	gBinaryChangelog = cfg_getint32("BINARY_CHANGELOG", 0) == 1;
 	gStoredPreviousBackMetaCopies = cfg_get_maxvalue(
 			"BACK_META_KEEP_PREVIOUS",
 			kDefaultStoredPreviousBackMetaCopies,
@@ -309,6 +315,7 @@ static void fs_read_config_file() {
 	metadataDumper.setMetarestorePath(
 			cfg_get("MFSMETARESTORE_PATH", std::string(SBIN_PATH "/mfsmetarestore")));
 	metadataDumper.setUseMetarestore(cfg_getint32("MAGIC_PREFER_BACKGROUND_DUMP", 0));
+	metadataDumper.setUseFork(cfg_getint32("METADATA_SAVE_WITHOUT_FORK", 0) == 0);
 
 	// Set deprecated values first, then override them if newer version is found
 	gOperationsDelayInit = cfg_getuint32("REPLICATIONS_DELAY_INIT", 300);
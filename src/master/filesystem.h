@@ -29,6 +29,7 @@
 #include "common/acl_type.h"
 #include "common/exception.h"
 #include "common/goal.h"
+#include "common/hash_table_statistics.h"
 #include "common/richacl.h"
 #include "common/tape_key.h"
 #include "common/tape_copy_location_info.h"
@@ -71,6 +72,16 @@ int fs_loadall();
  */
 uint8_t fs_storeall(MetadataDumper::DumpType dumpType);
 
+/*! \brief Sets a function called while metadata is loaded from or stored to a file.
+ *
+ * Used by processes which dump metadata in the background to report their progress
+ * to the master server.
+ */
+void fs_set_metadata_progress_callback(std::function<void(uint8_t, uint8_t)> callback);
+
+/// Passes progress (\p done out of \p total) of the given LIZ_METADATA_DUMP_* stage to the callback.
+void fs_report_metadata_progress(uint8_t stage, uint64_t done, uint64_t total);
+
 // Functions which create/apply (depending on the given context) changes to the metadata.
 // Common for metarestore and master server (both personalities)
 uint8_t fs_acquire(const FsContext& context, uint32_t inode, uint32_t sessionid);
@@ -206,6 +217,7 @@ void fs_disable_checksum_verification(bool value);
 // Functions which modify metadata or return some information.
 // To be used by the master server with personality == kMaster
 void fs_info(uint64_t *totalspace,uint64_t *availspace,uint64_t *trspace,uint32_t *trnodes,uint64_t *respace,uint32_t *renodes,uint32_t *inodes,uint32_t *dnodes,uint32_t *fnodes);
+HashTableStatistics fs_node_hash_table_statistics();
 uint32_t fs_getdirpath_size(uint32_t inode);
 void fs_getdirpath_data(uint32_t inode,uint8_t *buff,uint32_t size);
 uint8_t fs_getrootinode(uint32_t *rootinode,const uint8_t *path);
@@ -260,6 +272,9 @@ std::vector<JobInfo> fs_get_current_tasks_info();
 // Disable saving metadata on exit
 void fs_disable_metadata_dump_on_exit();
 
+/// Returns progress of the metadata dump running in the background.
+MetadataDumper::Progress fs_metadata_dump_progress();
+
 /// Erases a message from metadata lockfile.
 /// This function should be called before the first operation which may change
 /// files in data dir (e.g., rotation of logs, creating new metadata file, ...)
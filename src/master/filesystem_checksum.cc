@@ -105,8 +105,8 @@ void fsnodes_update_checksum(FSNode *node) {
 static void fsnodes_recalculate_checksum() {
 	gMetadata->fsNodesChecksum = NODECHECKSUMSEED;  // arbitrary number
 	// nodes
-	for (uint32_t i = 0; i < NODEHASHSIZE; i++) {
-		for (FSNode *node = gMetadata->nodehash[i]; node; node = node->next) {
+	for (uint32_t i = 0; i < gMetadata->nodehash.bucket_count(); i++) {
+		for (FSNode *node = gMetadata->nodehash.bucket(i); node; node = node->next) {
 			node->checksum = fsnodes_checksum(node, true);
 			addToChecksum(gMetadata->fsNodesChecksum, node->checksum);
 		}
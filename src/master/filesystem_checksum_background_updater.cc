@@ -60,7 +60,7 @@ void ChecksumBackgroundUpdater::incStep() {
 	position_ = 0;
 }
 
-int32_t ChecksumBackgroundUpdater::getPosition() {
+uint32_t ChecksumBackgroundUpdater::getPosition() {
 	return position_;
 }
 
@@ -73,7 +73,8 @@ bool ChecksumBackgroundUpdater::isNodeIncluded(FSNode *node) {
 	if (step_ > ChecksumRecalculatingStep::kNodes) {
 		ret = true;
 	}
-	if (step_ == ChecksumRecalculatingStep::kNodes && NODEHASHPOS(node->id) < position_) {
+	if (step_ == ChecksumRecalculatingStep::kNodes &&
+	    gMetadata->nodehash.bucket_position(node->id) < position_) {
 		ret = true;
 	}
 	if (ret) {
@@ -84,6 +85,13 @@ bool ChecksumBackgroundUpdater::isNodeIncluded(FSNode *node) {
 	return ret;
 }
 
+void ChecksumBackgroundUpdater::nodeMoved(FSNode *node, uint32_t oldpos, uint32_t newpos) {
+	// Node leaves the part of the hash which is already included in the background checksum
+	if (step_ == ChecksumRecalculatingStep::kNodes && oldpos < position_ && newpos >= position_) {
+		removeFromChecksum(fsNodesChecksum, node->checksum);
+	}
+}
+
 bool ChecksumBackgroundUpdater::isXattrIncluded(xattr_data_entry *xde) {
 	auto ret = false;
 	if (step_ > ChecksumRecalculatingStep::kXattrs) {
@@ -70,12 +70,15 @@ public:
 	// go to next step of recalculating, resets position
 	void incStep();
 
-	int32_t getPosition();
+	uint32_t getPosition();
 	void incPosition();
 
 	// is node already included in the background checksum?
 	bool isNodeIncluded(FSNode *node);
 
+	// node was moved between buckets of the node hash
+	void nodeMoved(FSNode *node, uint32_t oldpos, uint32_t newpos);
+
 	// is xattr already included in the background checksum?
 	bool isXattrIncluded(xattr_data_entry *xde);
 
@@ -120,8 +120,8 @@ void fs_dumpnode(FSNode *f) {
 void fs_dumpnodes() {
 	uint32_t i;
 	FSNode *p;
-	for (i = 0; i < NODEHASHSIZE; i++) {
-		for (p = gMetadata->nodehash[i]; p; p = p->next) {
+	for (i = 0; i < gMetadata->nodehash.bucket_count(); i++) {
+		for (p = gMetadata->nodehash.bucket(i); p; p = p->next) {
 			fs_dumpnode(p);
 		}
 	}
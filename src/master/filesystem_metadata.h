@@ -51,7 +51,7 @@ public:
 	TrashPathContainer trash;
 	ReservedPathContainer reserved;
 	FSNodeDirectory *root;
-	FSNode *nodehash[NODEHASHSIZE];
+	FSNodeHash nodehash;
 	TaskManager task_manager;
 	FileLocks flock_locks;
 	FileLocks posix_locks;
@@ -83,7 +83,7 @@ public:
 	      trash{},
 	      reserved{},
 	      root{},
-	      nodehash{},
+	      nodehash(),
 	      task_manager{},
 	      flock_locks{},
 	      posix_locks{},
@@ -115,8 +115,8 @@ public:
 		}
 
 		// Free memory allocated in nodehash hashmap
-		for (uint32_t i = 0; i < NODEHASHSIZE; ++i) {
-			FSNode *node = nodehash[i];
+		for (uint32_t i = 0; i < nodehash.bucket_count(); ++i) {
+			FSNode *node = nodehash.bucket(i);
 			while (node != nullptr) {
 				FSNode *next = node->next;
 				FSNode::destroy(node);
@@ -159,4 +159,5 @@ extern std::map<int, Goal> gGoalDefinitions;
 extern MetadataDumper metadataDumper;
 extern bool gAtimeDisabled;
 extern bool gMagicAutoFileRepair;
+extern bool gBinaryChangelog;
 #endif
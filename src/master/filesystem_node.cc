@@ -23,10 +23,12 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
+#include <mutex>
 #include <type_traits>
 
 #include "common/attributes.h"
 #include "common/massert.h"
+#include "common/object_pool.h"
 #include "common/slice_traits.h"
 #include "master/chunks.h"
 #include "master/datacachemgr.h"
@@ -47,22 +49,54 @@
 #define MAXFNAMELENG 255
 
 
+std::atomic<uint64_t> gFSNodeHeapMemory(0);
+
+/*! \brief Memory of nodes, separate pool for each node type. */
+struct FSNodePools {
+	std::mutex mutex; // nodes are created on many threads while loading metadata
+	object_pool<FSNodeFile> files;
+	object_pool<FSNodeDirectory> directories;
+	object_pool<FSNodeSymlink> symlinks;
+	object_pool<FSNodeDevice> devices;
+	object_pool<FSNode> others;
+};
+
+static FSNodePools gFSNodePools;
+
+template <typename T, typename... Args>
+static T *fsnodes_pool_new(object_pool<T> &pool, Args &&... args) {
+	void *ptr;
+	{
+		std::lock_guard<std::mutex> lock(gFSNodePools.mutex);
+		ptr = pool.allocate();
+	}
+	return new (ptr) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+static void fsnodes_pool_delete(object_pool<T> &pool, FSNode *node) {
+	T *typed = static_cast<T *>(node);
+	typed->~T();
+	std::lock_guard<std::mutex> lock(gFSNodePools.mutex);
+	pool.deallocate(typed);
+}
+
 FSNode *FSNode::create(uint8_t type) {
 	switch (type) {
 	case kFile:
 	case kTrash:
 	case kReserved:
-		return new FSNodeFile(type);
+		return fsnodes_pool_new(gFSNodePools.files, type);
 	case kDirectory:
-		return new FSNodeDirectory();
+		return fsnodes_pool_new(gFSNodePools.directories);
 	case kSymlink:
-		return new FSNodeSymlink();
+		return fsnodes_pool_new(gFSNodePools.symlinks);
 	case kFifo:
 	case kSocket:
-		return new FSNode(type);
+		return fsnodes_pool_new(gFSNodePools.others, type);
 	case kBlockDev:
 	case kCharDev:
-		return new FSNodeDevice(type);
+		return fsnodes_pool_new(gFSNodePools.devices, type);
 	default:
 		assert(!"invalid node type");
 	}
@@ -74,27 +108,34 @@ void FSNode::destroy(FSNode *node) {
 	case kFile:
 	case kTrash:
 	case kReserved:
-		delete static_cast<FSNodeFile *>(node);
+		fsnodes_pool_delete(gFSNodePools.files, node);
 		break;
 	case kDirectory:
-		delete static_cast<FSNodeDirectory *>(node);
+		fsnodes_pool_delete(gFSNodePools.directories, node);
 		break;
 	case kSymlink:
-		delete static_cast<FSNodeSymlink *>(node);
+		fsnodes_pool_delete(gFSNodePools.symlinks, node);
 		break;
 	case kFifo:
 	case kSocket:
-		delete node;
+		fsnodes_pool_delete(gFSNodePools.others, node);
 		break;
 	case kBlockDev:
 	case kCharDev:
-		delete static_cast<FSNodeDevice *>(node);
+		fsnodes_pool_delete(gFSNodePools.devices, node);
 		break;
 	default:
 		assert(!"invalid node type");
 	}
 }
 
+uint64_t FSNode::memoryUsage() {
+	std::lock_guard<std::mutex> lock(gFSNodePools.mutex);
+	return gFSNodePools.files.memory_usage() + gFSNodePools.directories.memory_usage() +
+	       gFSNodePools.symlinks.memory_usage() + gFSNodePools.devices.memory_usage() +
+	       gFSNodePools.others.memory_usage() + gFSNodeHeapMemory.load(std::memory_order_relaxed);
+}
+
 // number of blocks in the last chunk before EOF
 static uint32_t last_chunk_blocks(FSNodeFile *node) {
 	const uint64_t last_byte = node->length - 1;
@@ -528,6 +569,16 @@ void fsnodes_link(uint32_t ts, FSNodeDirectory *parent, FSNode *child, const HSt
 	}
 }
 
+/*! \brief Adds a node to the node hash, growing the hash by a bucket if needed. */
+void fsnodes_hash_insert(FSNode *node) {
+	if (gMetadata->nodehash.needs_split()) {
+		gMetadata->nodehash.split([](FSNode *moved, uint32_t oldpos, uint32_t newpos) {
+			gChecksumBackgroundUpdater.nodeMoved(moved, oldpos, newpos);
+		});
+	}
+	gMetadata->nodehash.insert(node);
+}
+
 FSNode *fsnodes_create_node(uint32_t ts, FSNodeDirectory *parent, const HString &name,
 			uint8_t type, uint16_t mode, uint16_t umask, uint32_t uid, uint32_t gid,
 			uint8_t copysgid, AclInheritance inheritacl, uint32_t req_inode) {
@@ -581,9 +632,7 @@ FSNode *fsnodes_create_node(uint32_t ts, FSNodeDirectory *parent, const HString
 	} else {
 		node->gid = gid;
 	}
-	uint32_t nodepos = NODEHASHPOS(node->id);
-	node->next = gMetadata->nodehash[nodepos];
-	gMetadata->nodehash[nodepos] = node;
+	fsnodes_hash_insert(node);
 	fsnodes_update_checksum(node);
 	fsnodes_link(ts, parent, node, name);
 	fsnodes_quota_update(node, {{QuotaResource::kInodes, +1}});
@@ -1214,15 +1263,7 @@ static inline void fsnodes_remove_node(uint32_t ts, FSNode *toremove) {
 		return;
 	}
 	// remove from idhash
-	uint32_t nodepos = NODEHASHPOS(toremove->id);
-	FSNode **ptr = &(gMetadata->nodehash[nodepos]);
-	while (*ptr) {
-		if (*ptr == toremove) {
-			*ptr = toremove->next;
-			break;
-		}
-		ptr = &((*ptr)->next);
-	}
+	gMetadata->nodehash.erase(toremove);
 	if (gChecksumBackgroundUpdater.isNodeIncluded(toremove)) {
 		removeFromChecksum(gChecksumBackgroundUpdater.fsNodesChecksum, toremove->checksum);
 	}
@@ -36,14 +36,7 @@ inline uint32_t fsnodes_hash(uint32_t parentid, const HString &name) {
 namespace detail {
 
 inline FSNode *fsnodes_id_to_node_internal(uint32_t id) {
-	FSNode *p;
-	uint32_t nodepos = NODEHASHPOS(id);
-	for (p = gMetadata->nodehash[nodepos]; p; p = p->next) {
-		if (p->id == id) {
-			return p;
-		}
-	}
-	return nullptr;
+	return gMetadata->nodehash.find(id);
 }
 
 template<class NodeType>
@@ -145,6 +138,8 @@ void fsnodes_change_uid_gid(FSNode *p, uint32_t uid, uint32_t gid);
 int fsnodes_nameisused(FSNodeDirectory *node, const HString &name);
 bool fsnodes_inode_quota_exceeded(uint32_t uid, uint32_t gid);
 
+void fsnodes_hash_insert(FSNode *node);
+
 FSNode *fsnodes_create_node(uint32_t ts, FSNodeDirectory *node, const HString &name,
 			uint8_t type, uint16_t mode, uint16_t umask, uint32_t uid, uint32_t gid,
 			uint8_t copysgid, AclInheritance inheritacl, uint32_t req_inode=0);
@@ -22,6 +22,7 @@
 #include "common/platform.h"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <unordered_map>
 #include <memory>
@@ -31,6 +32,8 @@
 #include "common/attributes.h"
 #include "common/goal.h"
 #include "common/compact_vector.h"
+#include "common/inline_vector.h"
+#include "common/intrusive_linear_hash.h"
 
 #ifdef LIZARDFS_HAVE_64BIT_JUDY
 #  include "common/judy_map.h"
@@ -42,14 +45,10 @@
 #include "master/fs_context.h"
 #include "master/hstring_storage.h"
 
-#define NODEHASHBITS (22)
-#define NODEHASHSIZE (1 << NODEHASHBITS)
-#define NODEHASHPOS(nodeid) ((nodeid) & (NODEHASHSIZE - 1))
+// Initial number of buckets in the node hash, it grows as nodes are added
+#define NODEHASHMINSIZE (1 << 22)
 #define NODECHECKSUMSEED 12345
 
-#define EDGEHASHBITS (22)
-#define EDGEHASHSIZE (1 << EDGEHASHBITS)
-#define EDGEHASHPOS(hash) ((hash) & (EDGEHASHSIZE - 1))
 #define EDGECHECKSUMSEED 1231241261
 
 #define MAX_INDEX 0x7FFFFFFF
@@ -74,16 +73,47 @@ struct statsrecord {
 	uint64_t realsize;
 };
 
+/*! \brief Memory allocated on the heap for lists of parents and chunks which don't fit in nodes. */
+extern std::atomic<uint64_t> gFSNodeHeapMemory;
+
+/*! \brief Allocator of lists kept in nodes which counts the allocated memory. */
+template <typename T>
+struct FSNodeAllocator : std::allocator<T> {
+	template <typename U>
+	struct rebind {
+		typedef FSNodeAllocator<U> other;
+	};
+
+	FSNodeAllocator() = default;
+
+	template <typename U>
+	FSNodeAllocator(const FSNodeAllocator<U> &) {
+	}
+
+	T *allocate(std::size_t n) {
+		gFSNodeHeapMemory.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+		return std::allocator<T>::allocate(n);
+	}
+
+	void deallocate(T *p, std::size_t n) {
+		gFSNodeHeapMemory.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+		std::allocator<T>::deallocate(p, n);
+	}
+};
+
 /*! \brief Node containing common meta data for each file system object (file or directory).
  *
  * Node size = 64B
  *
- * Estimating (taking into account directory and file node size) 150B per file.
+ * Nodes are allocated from pools (one for each node type), so there is no malloc overhead.
+ * Up to 3 parents are kept inside the node.
+ *
+ * Estimating (taking into account directory and file node size) 140B per file.
  *
- * 10K files will occupy 1.5MB
- * 10M files will occupy 1.5GB
- * 1G files will occupy 150GB
- * 4G files will occupy 600GB
+ * 10K files will occupy 1.4MB
+ * 10M files will occupy 1.4GB
+ * 1G files will occupy 140GB
+ * 4G files will occupy 560GB
  */
 struct FSNode {
 	enum {
@@ -112,8 +142,8 @@ struct FSNode {
 	uint32_t gid; /*!< Group id. */
 	uint32_t trashtime; /*!< Trash time. */
 
-	compact_vector<uint32_t, uint32_t> parent; /*!< Parent nodes ids. To reduce memory usage ids
-	                                                are stored instead of pointers to FSNode. */
+	inline_vector<uint32_t, 3, uint32_t, FSNodeAllocator<uint32_t>> parent; /*!< Parent nodes ids.
+	                       To reduce memory usage ids are stored instead of pointers to FSNode. */
 
 	FSNode   *next; /*!< Next field used for storing FSNode in hash map. */
 	uint64_t checksum; /*!< Node checksum. */
@@ -136,17 +166,31 @@ struct FSNode {
 	 * \param node Pointer to node that should be erased.
 	 */
 	static void destroy(FSNode *node);
+
+	/*! \brief Memory used by all nodes (including lists of parents and chunks kept on the heap).
+	 */
+	static uint64_t memoryUsage();
 };
 
+struct FSNodeIdOf {
+	uint64_t operator()(const FSNode *node) const {
+		return node->id;
+	}
+};
+
+/*! \brief Hash map of all nodes by id. */
+typedef intrusive_linear_hash<FSNode, FSNodeIdOf, NODEHASHMINSIZE> FSNodeHash;
+
 /*! \brief Node used for storing file object.
  *
- * Node size = 64B + 40B + 8 * chunks_count + 4 * session_count
- * Avg size (assuming 1 chunk and session id) = 104 + 8 + 4 ~ 120B
+ * Node size = 64B + 40B (up to 2 chunks are kept inside the node)
+ * + 8 * chunks_count for files with more than 2 chunks + 4 * session_count
+ * Avg size (assuming 1 chunk and session id) = 104 + 4 ~ 108B
  */
 struct FSNodeFile : public FSNode {
 	uint64_t length;
 	compact_vector<uint32_t> sessionid;
-	compact_vector<uint64_t, uint32_t> chunks;
+	inline_vector<uint64_t, 2, uint32_t, FSNodeAllocator<uint64_t>> chunks;
 
 	FSNodeFile(uint8_t t) : FSNode(t), length(), sessionid(), chunks() {
 		assert(t == kFile || t == kTrash || t == kReserved);
@@ -24,6 +24,7 @@
 #include <cstdint>
 
 #include "common/attributes.h"
+#include "common/changelog_record.h"
 #include "common/event_loop.h"
 #include "master/changelog.h"
 #include "master/chunks.h"
@@ -74,6 +75,25 @@ void fs_changelog(uint32_t ts, const char *format, ...) {
 	const uint32_t kMaxEntrySize = kMaxLogLineSize - kMaxTimestampSize;
 	static char entry[kMaxLogLineSize];
 
+	if (gBinaryChangelog) {
+		// Store arguments as they are instead of formatting them (see common/changelog_record.h)
+		static std::vector<uint8_t> payload, record;
+		payload.clear();
+		changelog_record::appendU32(payload, ts);
+		changelog_record::appendLiteral(payload, "|", 1);
+		va_list ap;
+		va_start(ap, format);
+		bool encoded = changelog_record::appendTokens(payload, format, ap);
+		va_end(ap);
+		if (encoded) {
+			uint64_t version = gMetadata->metaversion++;
+			changelog_record::frame(version, payload.data(), payload.size(), record);
+			changelog_binary(record.data(), record.size());
+			matomlserv_broadcast_logrecord(version, record.data(), record.size());
+			return;
+		}
+	}
+
 	// First, put "<timestamp>|" in the buffer
 	int tsLength = snprintf(entry, kMaxTimestampSize, "%" PRIu32 "|", ts);
 
@@ -282,6 +302,12 @@ void fs_info(uint64_t *totalspace, uint64_t *availspace, uint64_t *trspace, uint
 	*fnodes = gMetadata->filenodes;
 }
 
+HashTableStatistics fs_node_hash_table_statistics() {
+	const FSNodeHash &hash = gMetadata->nodehash;
+	return HashTableStatistics("nodes", hash.size(), hash.bucket_count(),
+			hash.used_bucket_count(), FSNode::memoryUsage() + hash.memory_usage());
+}
+
 uint8_t fs_getrootinode(uint32_t *rootinode, const uint8_t *path) {
 	HString hname;
 	uint32_t nleng;
@@ -2908,8 +2934,8 @@ uint8_t fs_get_tape_copy_locations(uint32_t inode, std::vector<TapeCopyLocationI
 
 void fs_add_files_to_chunks() {
 	FSNode *f;
-	for (uint32_t i = 0; i < NODEHASHSIZE; i++) {
-		for (f = gMetadata->nodehash[i]; f; f = f->next) {
+	for (uint32_t i = 0; i < gMetadata->nodehash.bucket_count(); i++) {
+		for (f = gMetadata->nodehash.bucket(i); f; f = f->next) {
 			if (f->type == FSNode::kFile || f->type == FSNode::kTrash ||
 			    f->type == FSNode::kReserved) {
 				for (const auto &chunkid : static_cast<FSNodeFile*>(f)->chunks) {
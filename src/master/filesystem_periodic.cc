@@ -62,7 +62,7 @@ static uint32_t fsinfo_unavailreservedfiles = 0;
 static int gTasksBatchSize = 1000;
 
 static int gFileTestLoopTime = 300;
-static int gFileTestLoopIndex = 0;
+static uint32_t gFileTestLoopIndex = 0;
 static unsigned gFileTestLoopBucketLimit = 0;
 
 enum NodeErrorFlag {
@@ -271,9 +271,9 @@ void fs_background_checksum_recalculation_a_bit() {
 		return;
 	case ChecksumRecalculatingStep::kNodes:
 		// Nodes are in a hashtable, therefore they can be recalculated in multiple steps.
-		while (gChecksumBackgroundUpdater.getPosition() < NODEHASHSIZE) {
+		while (gChecksumBackgroundUpdater.getPosition() < gMetadata->nodehash.bucket_count()) {
 			for (FSNode *node =
-			             gMetadata->nodehash[gChecksumBackgroundUpdater.getPosition()];
+			             gMetadata->nodehash.bucket(gChecksumBackgroundUpdater.getPosition());
 			     node; node = node->next) {
 				fsnodes_checksum_add_to_background(node);
 				++recalculated;
@@ -283,7 +283,7 @@ void fs_background_checksum_recalculation_a_bit() {
 				break;
 			}
 		}
-		if (gChecksumBackgroundUpdater.getPosition() == NODEHASHSIZE) {
+		if (gChecksumBackgroundUpdater.getPosition() == gMetadata->nodehash.bucket_count()) {
 			gChecksumBackgroundUpdater.incStep();
 		}
 		break;
@@ -369,14 +369,15 @@ void fs_process_file_test() {
 	}
 
 	watchdog.start();
-	for (k = 0; k < gFileTestLoopBucketLimit && gFileTestLoopIndex < NODEHASHSIZE;
+	for (k = 0; k < gFileTestLoopBucketLimit &&
+	            gFileTestLoopIndex < gMetadata->nodehash.bucket_count();
 	     k++, gFileTestLoopIndex++) {
 		if (k > 0 && watchdog.expired()) {
 			gFileTestLoopBucketLimit -= k;
 			return;
 		}
 
-		for (f = gMetadata->nodehash[gFileTestLoopIndex]; f; f = f->next) {
+		for (f = gMetadata->nodehash.bucket(gFileTestLoopIndex); f; f = f->next) {
 			node_error_flag = 0;
 
 			if (f->type == FSNode::kFile || f->type == FSNode::kTrash ||
@@ -472,7 +473,7 @@ void fs_process_file_test() {
 	}
 
 	gFileTestLoopBucketLimit -= k;
-	if (gFileTestLoopIndex >= NODEHASHSIZE) {
+	if (gFileTestLoopIndex >= gMetadata->nodehash.bucket_count()) {
 		gFileTestLoopIndex = 0;
 	}
 }
@@ -484,7 +485,7 @@ void fs_periodic_file_test() {
 	}
 
 	if (gFileTestLoopBucketLimit == 0) {
-		gFileTestLoopBucketLimit = NODEHASHSIZE / gFileTestLoopTime;
+		gFileTestLoopBucketLimit = gMetadata->nodehash.bucket_count() / gFileTestLoopTime;
 		fs_process_file_test();
 	}
 }
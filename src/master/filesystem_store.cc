@@ -20,10 +20,20 @@
 #include "common/platform.h"
 #include "master/filesystem_store.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
 #include <cstdio>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "common/cfg.h"
+#include "common/changelog_record.h"
 #include "common/cwrap.h"
 #include "common/event_loop.h"
 #include "common/setup.h"
@@ -33,6 +43,7 @@
 #include "common/setup.h"
 
 #include "master/changelog.h"
+#include "master/chunks.h"
 #include "master/filesystem.h"
 #include "master/filesystem_xattr.h"
 #include "master/filesystem_metadata.h"
@@ -55,6 +66,75 @@ constexpr uint8_t kMetadataVersionWithLockIds = 0x29;
 
 char const MetadataStructureReadErrorMsg[] = "error reading metadata (structure)";
 
+/// Number of entries in a block of NODE and EDGE sections
+constexpr uint32_t kMetadataBlockEntries = 65536;
+
+static std::function<void(uint8_t, uint8_t)> gMetadataProgressCallback;
+static uint8_t gMetadataProgressStage = LIZ_METADATA_DUMP_NOT_RUNNING;
+static uint8_t gMetadataProgressPercent = 0;
+
+void fs_set_metadata_progress_callback(std::function<void(uint8_t, uint8_t)> callback) {
+	gMetadataProgressCallback = std::move(callback);
+}
+
+void fs_report_metadata_progress(uint8_t stage, uint64_t done, uint64_t total) {
+	if (!gMetadataProgressCallback) {
+		return;
+	}
+	uint8_t percent = total > 0 ? std::min<uint64_t>(done, total) * 100 / total : 100;
+	if (stage != gMetadataProgressStage || percent != gMetadataProgressPercent) {
+		gMetadataProgressStage = stage;
+		gMetadataProgressPercent = percent;
+		gMetadataProgressCallback(stage, percent);
+	}
+}
+
+/// Number of records in NODE, EDGE and CHNK sections, used to report progress of storing them
+static uint64_t gStoredRecordsTotal;
+
+static void fs_reportstoreprogress(uint64_t stored) {
+	// the number of edges is only estimated, so 100% is reported after storing all sections
+	fs_report_metadata_progress(LIZ_METADATA_DUMP_STORING,
+			std::min(stored, gStoredRecordsTotal - 1), gStoredRecordsTotal);
+}
+
+/*
+ * Block index.
+ *
+ * NODE and EDGE sections are split into blocks of kMetadataBlockEntries records. The records
+ * themselves are not changed, but offsets of blocks (relative to the beginning of section's
+ * data) are stored in the "BIDX 1.0" section, so that the blocks can be decoded independently
+ * on many threads. The section contains a list of:
+ *   name:8 (name of the indexed section) count:32 offsets:(count * 64)
+ * Readers which don't know this section (unless they ignore unknown sections) reject the file.
+ */
+namespace {
+struct MetadataBlockIndexer {
+	MetadataBlockIndexer(FILE *fd, off_t sectionData, uint64_t storedBefore = 0)
+			: fd(fd), sectionData(sectionData), entries(0), storedBefore(storedBefore) {}
+
+	/// Called before storing each entry of the section
+	void entry() {
+		if (entries++ % kMetadataBlockEntries == 0) {
+			offsets.push_back(ftello(fd) - sectionData);
+			fs_reportstoreprogress(storedBefore + entries);
+		}
+	}
+
+	FILE *fd;
+	off_t sectionData;
+	uint32_t entries;
+	uint64_t storedBefore;  ///< records of sections stored before this one
+	std::vector<uint64_t> offsets;
+};
+
+/// Location of a section's data in the metadata file
+struct MetadataSection {
+	off_t offset;
+	uint64_t length;
+};
+} // anonymous namespace
+
 void xattr_store(FILE *fd) {
 	uint8_t hdrbuff[4 + 1 + 4];
 	uint8_t *ptr;
@@ -264,43 +344,13 @@ void fs_storeedge(FSNodeDirectory* parent, FSNode* child, const std::string &nam
 	}
 }
 
-int fs_loadedge(FILE *fd, int ignoreflag) {
-	uint8_t uedgebuff[4 + 4 + 2];
-	const uint8_t *ptr;
-	uint32_t parent_id;
-	uint32_t child_id;
-	statsrecord sr;
-	static uint32_t current_parent_id;
-
-	if (fd == NULL) {
-		current_parent_id = 0;
-		return 0;
-	}
+/// Parent of the recently loaded edges, used to check if edges of each directory are contiguous
+static uint32_t gLoadedEdgesParentId;
 
-	if (fread(uedgebuff, 1, 4 + 4 + 2, fd) != 4 + 4 + 2) {
-		lzfs_pretty_errlog(LOG_ERR, "loading edge: read error");
-		return -1;
-	}
-	ptr = uedgebuff;
-	parent_id = get32bit(&ptr);
-	child_id = get32bit(&ptr);
-	if (parent_id == 0 && child_id == 0) {  // last edge
-		return 1;
-	}
-	auto nleng = get16bit(&ptr);
-	if (nleng == 0) {
-		lzfs_pretty_syslog(LOG_ERR,
-		                   "loading edge: %" PRIu32 "->%" PRIu32 " error: empty name",
-		                   parent_id, child_id);
-		return -1;
-	}
-	std::vector<char> name_buffer(nleng);
-	if (fread(name_buffer.data(), 1, nleng, fd) != nleng) {
-		lzfs_pretty_errlog(LOG_ERR, "loading edge: read error");
-		return -1;
-	}
-
-	std::string name(name_buffer.begin(), name_buffer.end());
+/// Adds a loaded edge to the filesystem
+static int fs_linkedge(uint32_t parent_id, uint32_t child_id, const std::string &name,
+		int ignoreflag) {
+	statsrecord sr;
 
 	FSNode* child = fsnodes_id_to_node(child_id);
 
@@ -391,14 +441,14 @@ int fs_loadedge(FILE *fd, int ignoreflag) {
 				return -1;
 			}
 		}
-		if (current_parent_id != parent_id) {
+		if (gLoadedEdgesParentId != parent_id) {
 			if (parent->entries.size() > 0) {
 				lzfs_pretty_syslog(LOG_ERR, "loading edge: %" PRIu32 ",%s->%" PRIu32
 				                " error: parent node sequence error",
 				       parent_id, fsnodes_escape_name(name).c_str(), child_id);
 				return -1;
 			}
-			current_parent_id = parent_id;
+			gLoadedEdgesParentId = parent_id;
 		}
 
 		auto it = parent->entries.insert({hstorage::Handle(name), child}).first;
@@ -417,6 +467,82 @@ int fs_loadedge(FILE *fd, int ignoreflag) {
 	return 0;
 }
 
+namespace {
+struct LoadedEdge {
+	uint32_t parent_id;
+	uint32_t child_id;
+	std::string name;
+};
+} // anonymous namespace
+
+/// Decodes edges stored in the buffer, stops at the end marker
+static bool fs_decodeedges(const uint8_t *ptr, const uint8_t *end, std::vector<LoadedEdge> &edges) {
+	while (end - ptr >= 4 + 4 + 2) {
+		LoadedEdge edge;
+		edge.parent_id = get32bit(&ptr);
+		edge.child_id = get32bit(&ptr);
+		uint16_t nleng = get16bit(&ptr);
+		if (edge.parent_id == 0 && edge.child_id == 0) {  // last edge
+			return ptr == end;
+		}
+		if (nleng == 0) {
+			lzfs_pretty_syslog(LOG_ERR,
+			                   "loading edge: %" PRIu32 "->%" PRIu32 " error: empty name",
+			                   edge.parent_id, edge.child_id);
+			return false;
+		}
+		if (end - ptr < nleng) {
+			break;
+		}
+		edge.name.assign((const char *)ptr, nleng);
+		ptr += nleng;
+		edges.push_back(std::move(edge));
+	}
+	if (ptr != end) {
+		lzfs_pretty_syslog(LOG_ERR, "loading edge: truncated block");
+		return false;
+	}
+	return true;
+}
+
+int fs_loadedge(FILE *fd, int ignoreflag) {
+	uint8_t uedgebuff[4 + 4 + 2];
+	const uint8_t *ptr;
+	uint32_t parent_id;
+	uint32_t child_id;
+
+	if (fd == NULL) {
+		gLoadedEdgesParentId = 0;
+		return 0;
+	}
+
+	if (fread(uedgebuff, 1, 4 + 4 + 2, fd) != 4 + 4 + 2) {
+		lzfs_pretty_errlog(LOG_ERR, "loading edge: read error");
+		return -1;
+	}
+	ptr = uedgebuff;
+	parent_id = get32bit(&ptr);
+	child_id = get32bit(&ptr);
+	if (parent_id == 0 && child_id == 0) {  // last edge
+		return 1;
+	}
+	auto nleng = get16bit(&ptr);
+	if (nleng == 0) {
+		lzfs_pretty_syslog(LOG_ERR,
+		                   "loading edge: %" PRIu32 "->%" PRIu32 " error: empty name",
+		                   parent_id, child_id);
+		return -1;
+	}
+	std::vector<char> name_buffer(nleng);
+	if (fread(name_buffer.data(), 1, nleng, fd) != nleng) {
+		lzfs_pretty_errlog(LOG_ERR, "loading edge: read error");
+		return -1;
+	}
+
+	return fs_linkedge(parent_id, child_id, std::string(name_buffer.begin(), name_buffer.end()),
+			ignoreflag);
+}
+
 void fs_storenode(FSNode *f, FILE *fd) {
 	uint8_t unodebuff[1 + 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 8 + 4 + 2 + 8 * 65536 +
 	                  4 * 65536 + 4];
@@ -527,58 +653,50 @@ void fs_storenode(FSNode *f, FILE *fd) {
 	}
 }
 
-int fs_loadnode(FILE *fd) {
-	uint8_t unodebuff[4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 8 + 4 + 2 + 8 * 65536 + 4 * 65536 +
-	                  4];
-	const uint8_t *ptr, *chptr;
-	uint8_t type;
-	uint32_t i, indx, pleng, ch, sessionids, sessionid;
-	FSNode *p;
-	uint32_t nodepos;
-	std::vector<char> name_buffer;
-
-	if (fd == NULL) {
-		return 0;
-	}
-
-	type = fgetc(fd);
-	if (type == 0) {  // last node
-		return 1;
-	}
+/// Size of a node record following its type, without the variable-length data (0 if unknown)
+static uint32_t fs_nodeheadersize(uint8_t type) {
 	switch (type) {
 	case FSNode::kDirectory:
 	case FSNode::kFifo:
 	case FSNode::kSocket:
-		if (fread(unodebuff, 1, 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4, fd) !=
-		    4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4) {
-			lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
-			return -1;
-		}
-		break;
+		return 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4;
 	case FSNode::kBlockDev:
 	case FSNode::kCharDev:
 	case FSNode::kSymlink:
-		if (fread(unodebuff, 1, 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 4, fd) !=
-		    4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 4) {
-			lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
-			return -1;
-		}
-		break;
+		return 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 4;
 	case FSNode::kFile:
 	case FSNode::kTrash:
 	case FSNode::kReserved:
-		if (fread(unodebuff, 1, 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 8 + 4 + 2, fd) !=
-		    4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 8 + 4 + 2) {
-			lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
-			return -1;
-		}
-		break;
+		return 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4 + 8 + 4 + 2;
 	default:
-		lzfs_pretty_syslog(LOG_ERR, "loading node: unrecognized node type: %c", type);
-		return -1;
+		return 0;
 	}
-	p = FSNode::create(type);
-	ptr = unodebuff;
+}
+
+/// Size of the variable-length data (symlink's path, chunks and sessions) following the header
+static uint64_t fs_nodedatasize(uint8_t type, const uint8_t *header) {
+	const uint8_t *ptr = header + 4 + 1 + 2 + 4 + 4 + 4 + 4 + 4 + 4;
+	switch (type) {
+	case FSNode::kSymlink:
+		return get32bit(&ptr);
+	case FSNode::kFile:
+	case FSNode::kTrash:
+	case FSNode::kReserved: {
+		ptr += 8;
+		uint64_t ch = get32bit(&ptr);
+		uint64_t sessionids = get16bit(&ptr);
+		return 8 * ch + 4 * sessionids;
+	}
+	default:
+		return 0;
+	}
+}
+
+/// Creates a node from its record (the header and data following the type)
+/// The node is not added to the filesystem, so this can be called on many threads.
+static FSNode *fs_decodenode(uint8_t type, const uint8_t *ptr) {
+	uint32_t i, pleng, ch, sessionids;
+	FSNode *p = FSNode::create(type);
 	p->id = get32bit(&ptr);
 	p->goal = get8bit(&ptr);
 	p->mode = get16bit(&ptr);
@@ -602,15 +720,8 @@ int fs_loadnode(FILE *fd) {
 	case FSNode::kSymlink:
 		pleng = get32bit(&ptr);
 		static_cast<FSNodeSymlink*>(p)->path_length = pleng;
-
 		if (pleng > 0) {
-			name_buffer.resize(pleng);
-			if (fread(name_buffer.data(), 1, pleng, fd) != pleng) {
-				lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
-				FSNode::destroy(p);
-				return -1;
-			}
-			static_cast<FSNodeSymlink*>(p)->path = HString(name_buffer.begin(), name_buffer.end());
+			static_cast<FSNodeSymlink*>(p)->path = HString((const char *)ptr, pleng);
 		}
 		break;
 	case FSNode::kFile:
@@ -620,103 +731,162 @@ int fs_loadnode(FILE *fd) {
 		ch = get32bit(&ptr);
 		sessionids = get16bit(&ptr);
 		node_file->chunks.resize(ch);
-
-		indx = 0;
-		while (ch > 65536) {
-			chptr = ptr;
-			if (fread((uint8_t *)ptr, 1, 8 * 65536, fd) != 8 * 65536) {
-				lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
-				FSNode::destroy(p);
-				return -1;
-			}
-			for (i = 0; i < 65536; i++) {
-				node_file->chunks[indx] = get64bit(&chptr);
-				indx++;
-			}
-			ch -= 65536;
-		}
-		if (fread((uint8_t *)ptr, 1, 8 * ch + 4 * sessionids, fd) !=
-		    8 * ch + 4 * sessionids) {
-			lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
-			FSNode::destroy(p);
-			return -1;
-		}
 		for (i = 0; i < ch; i++) {
-			node_file->chunks[indx] = get64bit(&ptr);
-			indx++;
+			node_file->chunks[i] = get64bit(&ptr);
 		}
 		while (sessionids) {
-			sessionid = get32bit(&ptr);
-			node_file->sessionid.push_back(sessionid);
+			node_file->sessionid.push_back(get32bit(&ptr));
+			sessionids--;
+		}
+	}
+	return p;
+}
+
+/// Adds a decoded node to the filesystem
+static void fs_linknode(FSNode *p) {
+	if (p->type == FSNode::kFile || p->type == FSNode::kTrash || p->type == FSNode::kReserved) {
 #ifndef METARESTORE
+		for (uint32_t sessionid : static_cast<FSNodeFile*>(p)->sessionid) {
 			matoclserv_add_open_file(sessionid, p->id);
-#endif
-			sessionids--;
 		}
+#endif
 		fsnodes_quota_update(p, {{QuotaResource::kSize, +fsnodes_get_size(p)}});
 	}
-	nodepos = NODEHASHPOS(p->id);
-	p->next = gMetadata->nodehash[nodepos];
-	gMetadata->nodehash[nodepos] = p;
+	fsnodes_hash_insert(p);
 	gMetadata->inode_pool.markAsAcquired(p->id);
 	gMetadata->nodes++;
-	if (type == FSNode::kDirectory) {
+	if (p->type == FSNode::kDirectory) {
 		gMetadata->dirnodes++;
 	}
-	if (type == FSNode::kFile || type == FSNode::kTrash || type == FSNode::kReserved) {
+	if (p->type == FSNode::kFile || p->type == FSNode::kTrash || p->type == FSNode::kReserved) {
 		gMetadata->filenodes++;
 	}
 	fsnodes_quota_update(p, {{QuotaResource::kInodes, +1}});
+}
+
+/// Decodes nodes stored in the buffer, stops at the end marker
+static bool fs_decodenodes(const uint8_t *ptr, const uint8_t *end, std::vector<FSNode*> &nodes) {
+	while (ptr < end) {
+		uint8_t type = get8bit(&ptr);
+		if (type == 0) {  // last node
+			return ptr == end;
+		}
+		uint32_t headerSize = fs_nodeheadersize(type);
+		if (headerSize == 0) {
+			lzfs_pretty_syslog(LOG_ERR, "loading node: unrecognized node type: %c", type);
+			return false;
+		}
+		if ((uint64_t)(end - ptr) < headerSize
+				|| (uint64_t)(end - ptr) - headerSize < fs_nodedatasize(type, ptr)) {
+			lzfs_pretty_syslog(LOG_ERR, "loading node: truncated block");
+			return false;
+		}
+		uint64_t size = headerSize + fs_nodedatasize(type, ptr);
+		nodes.push_back(fs_decodenode(type, ptr));
+		ptr += size;
+	}
+	return true;
+}
+
+int fs_loadnode(FILE *fd) {
+	static std::vector<uint8_t> buffer;
+	uint8_t type;
+
+	if (fd == NULL) {
+		return 0;
+	}
+
+	type = fgetc(fd);
+	if (type == 0) {  // last node
+		return 1;
+	}
+	uint32_t headerSize = fs_nodeheadersize(type);
+	if (headerSize == 0) {
+		lzfs_pretty_syslog(LOG_ERR, "loading node: unrecognized node type: %c", type);
+		return -1;
+	}
+	buffer.resize(headerSize);
+	if (fread(buffer.data(), 1, headerSize, fd) != headerSize) {
+		lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
+		return -1;
+	}
+	uint64_t dataSize = fs_nodedatasize(type, buffer.data());
+	buffer.resize(headerSize + dataSize);
+	if (fread(buffer.data() + headerSize, 1, dataSize, fd) != dataSize) {
+		lzfs_pretty_errlog(LOG_ERR, "loading node: read error");
+		return -1;
+	}
+	fs_linknode(fs_decodenode(type, buffer.data()));
 	return 0;
 }
 
-void fs_storenodes(FILE *fd) {
+static void fs_storenodes(FILE *fd, MetadataBlockIndexer &indexer) {
 	uint32_t i;
 	FSNode *p;
-	for (i = 0; i < NODEHASHSIZE; i++) {
-		for (p = gMetadata->nodehash[i]; p; p = p->next) {
+	for (i = 0; i < gMetadata->nodehash.bucket_count(); i++) {
+		for (p = gMetadata->nodehash.bucket(i); p; p = p->next) {
+			indexer.entry();
 			fs_storenode(p, fd);
 		}
 	}
 	fs_storenode(NULL, fd);  // end marker
 }
 
-void fs_storeedgelist(FSNodeDirectory *parent, FILE *fd) {
+static void fs_storeedgelist(FSNodeDirectory *parent, FILE *fd, MetadataBlockIndexer &indexer) {
 	for (const auto &entry : parent->entries) {
+		indexer.entry();
 		fs_storeedge(parent, entry.second, (std::string)entry.first, fd);
 	}
 }
 
-void fs_storeedgelist(const TrashPathContainer &data, FILE *fd) {
+static void fs_storeedgelist(const TrashPathContainer &data, FILE *fd,
+		MetadataBlockIndexer &indexer) {
 	for (const auto &entry : data) {
 		FSNode *child = fsnodes_id_to_node(entry.first.id);
+		indexer.entry();
 		fs_storeedge(nullptr, child, (std::string)entry.second, fd);
 	}
 }
 
-void fs_storeedgelist(const ReservedPathContainer &data, FILE *fd) {
+static void fs_storeedgelist(const ReservedPathContainer &data, FILE *fd,
+		MetadataBlockIndexer &indexer) {
 	for (const auto &entry : data) {
 		FSNode *child = fsnodes_id_to_node(entry.first);
+		indexer.entry();
 		fs_storeedge(nullptr, child, (std::string)entry.second, fd);
 	}
 }
 
-void fs_storeedges_rec(FSNodeDirectory *f, FILE *fd) {
-	fs_storeedgelist(f, fd);
+static void fs_storeedges_rec(FSNodeDirectory *f, FILE *fd, MetadataBlockIndexer &indexer) {
+	fs_storeedgelist(f, fd, indexer);
 	for(const auto &entry : f->entries) {
 		if (entry.second->type == FSNode::kDirectory) {
-			fs_storeedges_rec(static_cast<FSNodeDirectory*>(entry.second), fd);
+			fs_storeedges_rec(static_cast<FSNodeDirectory*>(entry.second), fd, indexer);
 		}
 	}
 }
 
-void fs_storeedges(FILE *fd) {
-	fs_storeedges_rec(gMetadata->root, fd);
-	fs_storeedgelist(gMetadata->trash, fd);
-	fs_storeedgelist(gMetadata->reserved, fd);
+static void fs_storeedges(FILE *fd, MetadataBlockIndexer &indexer) {
+	fs_storeedges_rec(gMetadata->root, fd, indexer);
+	fs_storeedgelist(gMetadata->trash, fd, indexer);
+	fs_storeedgelist(gMetadata->reserved, fd, indexer);
 	fs_storeedge(nullptr, nullptr, std::string(), fd);  // end marker
 }
 
+static void fs_storeblockindex(FILE *fd, const char *section, const MetadataBlockIndexer &indexer) {
+	std::vector<uint8_t> buffer(8 + 4 + 8 * indexer.offsets.size());
+	uint8_t *ptr = buffer.data();
+	memcpy(ptr, section, 8);
+	ptr += 8;
+	put32bit(&ptr, indexer.offsets.size());
+	for (uint64_t offset : indexer.offsets) {
+		put64bit(&ptr, offset);
+	}
+	if (fwrite(buffer.data(), 1, buffer.size(), fd) != buffer.size()) {
+		lzfs_pretty_syslog(LOG_NOTICE, "fwrite error");
+	}
+}
+
 static void fs_storequotas(FILE *fd) {
 	const std::vector<QuotaEntry> &entries = gMetadata->quota_database.getEntries();
 	fs_store_generic(fd, entries);
@@ -751,8 +921,8 @@ int fs_lostnode(FSNode *p) {
 int fs_checknodes(int ignoreflag) {
 	uint32_t i;
 	FSNode *p;
-	for (i = 0; i < NODEHASHSIZE; i++) {
-		for (p = gMetadata->nodehash[i]; p; p = p->next) {
+	for (i = 0; i < gMetadata->nodehash.bucket_count(); i++) {
+		for (p = gMetadata->nodehash.bucket(i); p; p = p->next) {
 			if (p->parent.empty() && p != gMetadata->root && (p->type != FSNode::kTrash) && (p->type != FSNode::kReserved)) {
 				lzfs_pretty_syslog(LOG_ERR, "found orphaned inode: %" PRIu32,
 				                   p->id);
@@ -912,6 +1082,230 @@ int fs_loadfree(FILE *fd, uint64_t section_size = 0) {
 	return 0;
 }
 
+/*! \brief Decodes blocks of a section on many threads.
+ *
+ * Blocks are read and decoded by \p threads workers, while the calling thread passes decoded
+ * blocks to \p link in their order (linking modifies the filesystem, so it isn't parallel).
+ * Workers stay at most a few blocks ahead of linking to keep the memory usage bounded.
+ */
+template <typename Result, typename Decode, typename Link>
+static bool fs_loadblocks(int fd, const MetadataSection &section,
+		const std::vector<uint64_t> &offsets, uint32_t threads, Decode decode, Link link) {
+	struct Block {
+		std::vector<Result> result;
+		bool done = false;
+		bool ok = false;
+	};
+	std::vector<Block> blocks(offsets.size());
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t nextBlock = 0;
+	size_t linkedBlocks = 0;
+	bool failed = false;
+	const size_t window = 4 * threads;
+
+	auto worker = [&]() {
+		std::vector<uint8_t> buffer;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			cond.wait(lock, [&]() {
+				return failed || nextBlock >= blocks.size() || nextBlock < linkedBlocks + window;
+			});
+			if (failed || nextBlock >= blocks.size()) {
+				return;
+			}
+			size_t i = nextBlock++;
+			lock.unlock();
+
+			uint64_t begin = offsets[i];
+			uint64_t end = (i + 1 < offsets.size()) ? offsets[i + 1] : section.length;
+			std::vector<Result> result;
+			bool ok = begin <= end && end <= section.length;
+			if (ok) {
+				buffer.resize(end - begin);
+				ok = pread(fd, buffer.data(), buffer.size(), section.offset + begin)
+						== (ssize_t)buffer.size();
+				if (!ok) {
+					lzfs_pretty_errlog(LOG_ERR, "error reading metadata block");
+				}
+			}
+			if (ok) {
+				ok = decode(buffer.data(), buffer.data() + buffer.size(), result);
+			}
+
+			lock.lock();
+			blocks[i].result.swap(result);
+			blocks[i].ok = ok;
+			blocks[i].done = true;
+			cond.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < threads; ++i) {
+		workers.emplace_back(worker);
+	}
+	bool ok = true;
+	for (size_t i = 0; i < blocks.size() && ok; ++i) {
+		std::vector<Result> result;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return blocks[i].done; });
+			ok = blocks[i].ok;
+			result.swap(blocks[i].result);
+			linkedBlocks = i + 1;
+			cond.notify_all();
+		}
+		if (ok) {
+			ok = link(result);
+		}
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		failed = true;  // stop workers in case of an error
+		cond.notify_all();
+	}
+	for (auto &thread : workers) {
+		thread.join();
+	}
+	return ok;
+}
+
+static int fs_loadnodes(int fd, const MetadataSection &section,
+		const std::vector<uint64_t> &offsets, uint32_t threads) {
+	bool ok = fs_loadblocks<FSNode*>(fd, section, offsets, threads, fs_decodenodes,
+			[](std::vector<FSNode*> &nodes) {
+				for (FSNode *p : nodes) {
+					fs_linknode(p);
+				}
+				return true;
+			});
+	return ok ? 0 : -1;
+}
+
+static int fs_loadedges(int fd, const MetadataSection &section,
+		const std::vector<uint64_t> &offsets, uint32_t threads, int ignoreflag) {
+	fs_loadedge(NULL, ignoreflag);  // init
+	bool ok = fs_loadblocks<LoadedEdge>(fd, section, offsets, threads, fs_decodeedges,
+			[ignoreflag](std::vector<LoadedEdge> &edges) {
+				for (const LoadedEdge &edge : edges) {
+					if (fs_linkedge(edge.parent_id, edge.child_id, edge.name, ignoreflag) < 0) {
+						return false;
+					}
+				}
+				return true;
+			});
+	return ok ? 0 : -1;
+}
+
+/// Finds all the sections, starting at the current position of the file (which is restored)
+static bool fs_scansections(FILE *fd, std::map<std::string, MetadataSection> &sections) {
+	uint8_t hdr[16];
+	off_t start = ftello(fd);
+	bool ok = false;
+	while (fread(hdr, 1, 16, fd) == 16) {
+		if (memcmp(hdr, "[MFS EOF MARKER]", 16) == 0) {
+			ok = true;
+			break;
+		}
+		const uint8_t *ptr = hdr + 8;
+		MetadataSection section;
+		section.offset = ftello(fd);
+		section.length = get64bit(&ptr);
+		sections[std::string((const char *)hdr, 8)] = section;
+		if (fseeko(fd, section.length, SEEK_CUR) != 0) {
+			break;
+		}
+	}
+	fseeko(fd, start, SEEK_SET);
+	return ok;
+}
+
+/// Reads the block index, offsets of blocks which don't fit their sections are dropped
+static void fs_loadblockindex(int fd, const std::map<std::string, MetadataSection> &sections,
+		std::map<std::string, std::vector<uint64_t>> &index) {
+	auto indexSection = sections.find("BIDX 1.0");
+	if (indexSection == sections.end()) {
+		return;
+	}
+	std::vector<uint8_t> buffer(indexSection->second.length);
+	if (pread(fd, buffer.data(), buffer.size(), indexSection->second.offset)
+			!= (ssize_t)buffer.size()) {
+		return;
+	}
+	const uint8_t *ptr = buffer.data();
+	const uint8_t *end = buffer.data() + buffer.size();
+	while (end - ptr >= 8 + 4) {
+		std::string name((const char *)ptr, 8);
+		ptr += 8;
+		uint32_t count = get32bit(&ptr);
+		if ((uint64_t)(end - ptr) < 8ULL * count) {
+			break;
+		}
+		std::vector<uint64_t> offsets(count);
+		for (uint64_t &offset : offsets) {
+			offset = get64bit(&ptr);
+		}
+		auto section = sections.find(name);
+		bool valid = section != sections.end() && !offsets.empty() && offsets.front() == 0
+				&& std::is_sorted(offsets.begin(), offsets.end())
+				&& offsets.back() < section->second.length;
+		if (valid) {
+			index[name] = std::move(offsets);
+		} else {
+			lzfs_pretty_syslog(LOG_WARNING, "ignoring invalid block index of section %s",
+					name.c_str());
+		}
+	}
+}
+
+namespace {
+/// Loads the CHNK section in a separate thread; chunks don't share any state with other sections
+class ChunkSectionLoader {
+public:
+	ChunkSectionLoader() : status_(0), end_(0) {}
+
+	~ChunkSectionLoader() {
+		wait();
+	}
+
+	void start(const std::string &fname, off_t offset, bool loadLockIds) {
+		thread_ = std::thread([this, fname, offset, loadLockIds]() {
+			cstream_t fd(fopen(fname.c_str(), "r"));
+			if (!fd || fseeko(fd.get(), offset, SEEK_SET) != 0) {
+				lzfs_pretty_errlog(LOG_ERR, "can't open metadata file %s", fname.c_str());
+				status_ = -1;
+				return;
+			}
+			status_ = chunk_load(fd.get(), loadLockIds);
+			end_ = ftello(fd.get());
+		});
+	}
+
+	bool started() const {
+		return thread_.joinable();
+	}
+
+	/// Waits for the loading to finish, returns the result of chunk_load
+	int wait() {
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+		return status_;
+	}
+
+	/// Position in the file just after the loaded section
+	off_t end() const {
+		return end_;
+	}
+
+private:
+	std::thread thread_;
+	int status_;
+	off_t end_;
+};
+} // anonymous namespace
+
 static int process_section(const char *label, uint8_t (&hdr)[16], uint8_t *&ptr,
 		off_t &offbegin, off_t &offend, FILE *&fd) {
 	offend = ftello(fd);
@@ -947,13 +1341,17 @@ void fs_store(FILE *fd, uint8_t fver) {
 	} else {
 		offbegin = 0;  // makes some old compilers happy
 	}
-	fs_storenodes(fd);
+	// each node has (usually) one edge
+	gStoredRecordsTotal = 2 * (uint64_t)gMetadata->nodes + chunk_count() + 1;
+	MetadataBlockIndexer nodeIndexer(fd, offbegin + 16);
+	fs_storenodes(fd, nodeIndexer);
 	if (fver >= kMetadataVersionWithSections) {
 		if (process_section("NODE 1.0", hdr, ptr, offbegin, offend, fd) != LIZARDFS_STATUS_OK) {
 			return;
 		}
 	}
-	fs_storeedges(fd);
+	MetadataBlockIndexer edgeIndexer(fd, offbegin + 16, nodeIndexer.entries);
+	fs_storeedges(fd, edgeIndexer);
 	if (fver >= kMetadataVersionWithSections) {
 		if (process_section("EDGE 1.0", hdr, ptr, offbegin, offend, fd) != LIZARDFS_STATUS_OK) {
 			return;
@@ -981,11 +1379,17 @@ void fs_store(FILE *fd, uint8_t fver) {
 			return;
 		}
 	}
+	fs_reportstoreprogress(nodeIndexer.entries + edgeIndexer.entries);
 	chunk_store(fd);
 	if (fver >= kMetadataVersionWithSections) {
 		if (process_section("CHNK 1.0", hdr, ptr, offbegin, offend, fd) != LIZARDFS_STATUS_OK) {
 			return;
 		}
+		fs_storeblockindex(fd, "NODE 1.0", nodeIndexer);
+		fs_storeblockindex(fd, "EDGE 1.0", edgeIndexer);
+		if (process_section("BIDX 1.0", hdr, ptr, offbegin, offend, fd) != LIZARDFS_STATUS_OK) {
+			return;
+		}
 
 		fseeko(fd, offend, SEEK_SET);
 		memcpy(hdr, "[MFS EOF MARKER]", 16);
@@ -994,6 +1398,7 @@ void fs_store(FILE *fd, uint8_t fver) {
 			return;
 		}
 	}
+	fs_report_metadata_progress(LIZ_METADATA_DUMP_STORING, gStoredRecordsTotal, gStoredRecordsTotal);
 }
 
 void fs_store_fd(FILE *fd) {
@@ -1029,11 +1434,14 @@ uint64_t fs_loadversion(FILE *fd) {
 	return fversion;
 }
 
-int fs_load(FILE *fd, int ignoreflag, uint8_t fver) {
+int fs_load(const std::string &fname, FILE *fd, int ignoreflag, uint8_t fver) {
 	uint8_t hdr[16];
 	const uint8_t *ptr;
 	off_t offbegin;
 	uint64_t sleng;
+	std::map<std::string, MetadataSection> sections;
+	std::map<std::string, std::vector<uint64_t>> blockIndex;
+	ChunkSectionLoader chunkLoader;
 
 	if (fread(hdr, 1, 16, fd) != 16) {
 		lzfs_pretty_syslog(LOG_ERR, "error loading header");
@@ -1079,6 +1487,20 @@ int fs_load(FILE *fd, int ignoreflag, uint8_t fver) {
 			return -1;
 		}
 	} else { // metadata with sections
+		struct stat metadataStat;
+		off_t metadataSize = fstat(fileno(fd), &metadataStat) == 0 ? metadataStat.st_size : 0;
+		uint32_t threads = cfg_get_minmaxvalue<uint32_t>("METADATA_LOAD_THREADS", 4, 1, 64);
+		if (threads > 1 && fs_scansections(fd, sections)) {
+			fs_loadblockindex(fileno(fd), sections, blockIndex);
+			auto chunks = sections.find("CHNK 1.0");
+			if (chunks != sections.end()) {
+				lzfs_pretty_syslog_attempt(LOG_INFO,
+				                           "loading chunks data from the metadata file "
+				                           "in the background");
+				chunkLoader.start(fname, chunks->second.offset,
+				                  fver == kMetadataVersionWithLockIds);
+			}
+		}
 		while (1) {
 			if (fread(hdr, 1, 16, fd) != 16) {
 				lzfs_pretty_syslog(LOG_ERR, "error reading section header from the metadata file");
@@ -1090,7 +1512,34 @@ int fs_load(FILE *fd, int ignoreflag, uint8_t fver) {
 			ptr = hdr + 8;
 			sleng = get64bit(&ptr);
 			offbegin = ftello(fd);
-			if (memcmp(hdr, "NODE 1.0", 8) == 0) {
+			auto blocks = blockIndex.find(std::string((const char *)hdr, 8));
+			if (blocks != blockIndex.end()) {
+				// decode blocks of the section on many threads
+				MetadataSection &section = sections[blocks->first];
+				int status;
+				if (blocks->first == "NODE 1.0") {
+					lzfs_pretty_syslog_attempt(LOG_INFO,
+					                           "loading objects (files,directories,etc.) from "
+					                           "the metadata file using %zu blocks",
+					                           blocks->second.size());
+					status = fs_loadnodes(fileno(fd), section, blocks->second,
+					                      threads);
+				} else {
+					lzfs_pretty_syslog_attempt(LOG_INFO,
+					                           "loading names from the metadata file "
+					                           "using %zu blocks", blocks->second.size());
+					status = fs_loadedges(fileno(fd), section, blocks->second, threads,
+					                      ignoreflag);
+				}
+				if (status < 0) {
+#ifndef METARESTORE
+					lzfs_pretty_syslog(LOG_ERR, "error reading metadata (%s)",
+					                   blocks->first.c_str());
+#endif
+					return -1;
+				}
+				fseeko(fd, sleng, SEEK_CUR);
+			} else if (memcmp(hdr, "NODE 1.0", 8) == 0) {
 				lzfs_pretty_syslog_attempt(LOG_INFO,
 				                           "loading objects "
 				                           "(files,directories,etc.) from the "
@@ -1187,6 +1636,17 @@ int fs_load(FILE *fd, int ignoreflag, uint8_t fver) {
 #endif
 					return -1;
 				}
+			} else if (memcmp(hdr, "CHNK 1.0", 8) == 0 && chunkLoader.started()) {
+				if (chunkLoader.wait() < 0) {
+#ifndef METARESTORE
+					lzfs_pretty_syslog(LOG_ERR, "error reading metadata (chunks)");
+#endif
+					return -1;
+				}
+				fseeko(fd, chunkLoader.end(), SEEK_SET);
+			} else if (memcmp(hdr, "BIDX 1.0", 8) == 0) {
+				// block index is used before loading other sections
+				fseeko(fd, sleng, SEEK_CUR);
 			} else if (memcmp(hdr, "CHNK 1.0", 8) == 0) {
 				lzfs_pretty_syslog_attempt(LOG_INFO, "loading chunks data from the metadata file");
 				fflush(stderr);
@@ -1218,6 +1678,7 @@ int fs_load(FILE *fd, int ignoreflag, uint8_t fver) {
 					return -1;
 				}
 			}
+			fs_report_metadata_progress(LIZ_METADATA_DUMP_LOADING, ftello(fd), metadataSize);
 		}
 	}
 
@@ -1241,7 +1702,6 @@ int fs_load(FILE *fd, int ignoreflag, uint8_t fver) {
 
 #ifndef METARESTORE
 void fs_new(void) {
-	uint32_t nodepos;
 	gMetadata->maxnodeid = SPECIAL_INODE_ROOT;
 	gMetadata->metaversion = 1;
 	gMetadata->nextsessionid = 1;
@@ -1253,9 +1713,7 @@ void fs_new(void) {
 	gMetadata->root->mode = 0777;
 	gMetadata->root->uid = 0;
 	gMetadata->root->gid = 0;
-	nodepos = NODEHASHPOS(gMetadata->root->id);
-	gMetadata->root->next = gMetadata->nodehash[nodepos];
-	gMetadata->nodehash[nodepos] = gMetadata->root;
+	fsnodes_hash_insert(gMetadata->root);
 	gMetadata->inode_pool.markAsAcquired(gMetadata->root->id);
 	chunk_newfs();
 	gMetadata->nodes = 1;
@@ -1394,17 +1852,18 @@ void fs_load_changelogs() {
  */
 void fs_load_changelog(const std::string &path) {
 	std::string fullFileName = fs::getCurrentWorkingDirectoryNoThrow() + "/" + path;
-	std::ifstream changelog(path);
-	std::string line;
-	size_t end = 0;
+	ChangelogFileReader changelog(path);
+	ChangelogFileReader::Entry entry;
+	ChangelogFileReader::Status readStatus = ChangelogFileReader::Status::kEnd;
 	sassert(gMetadata->metaversion > 0);
 
 	uint64_t first = 0;
 	uint64_t id = 0;
 	uint64_t skippedEntries = 0;
 	uint64_t appliedEntries = 0;
-	while (std::getline(changelog, line).good()) {
-		id = stoull(line, &end);
+	while (changelog.isOpen()
+			&& (readStatus = changelog.next(entry)) == ChangelogFileReader::Status::kEntry) {
+		id = entry.version;
 		if (id < fs_getversion()) {
 			++skippedEntries;
 			continue;
@@ -1412,13 +1871,19 @@ void fs_load_changelog(const std::string &path) {
 			first = id;
 		}
 		++appliedEntries;
-		uint8_t status = restore(path.c_str(), id, line.c_str() + end,
-		                         RestoreRigor::kIgnoreParseErrors);
+		uint8_t status = entry.text
+				? restore(path.c_str(), id, entry.text, RestoreRigor::kIgnoreParseErrors)
+				: restore(path.c_str(), id, entry.payload, entry.payloadSize,
+				          RestoreRigor::kIgnoreParseErrors);
 		if (status != LIZARDFS_STATUS_OK) {
 			throw MetadataConsistencyException("can't apply changelog " + fullFileName,
 			                                   status);
 		}
 	}
+	if (readStatus == ChangelogFileReader::Status::kCorrupted) {
+		lzfs_pretty_syslog(LOG_WARNING, "%s: corrupted entry after %" PRIu64 ", ignoring the rest",
+		                   fullFileName.c_str(), id);
+	}
 	if (appliedEntries > 0) {
 		lzfs_pretty_syslog_attempt(LOG_NOTICE, "%s: %" PRIu64 " changes applied (%" PRIu64
 		                                       " to %" PRIu64 "), %" PRIu64 " skipped",
@@ -1476,7 +1941,7 @@ void fs_loadall(const std::string& fname,int ignoreflag) {
 		throw MetadataConsistencyException("wrong metadata header version");
 	}
 
-	if (fs_load(fd.get(), ignoreflag, metadataVersion) < 0) {
+	if (fs_load(fname, fd.get(), ignoreflag, metadataVersion) < 0) {
 		throw MetadataConsistencyException(MetadataStructureReadErrorMsg);
 	}
 	if (ferror(fd.get())!=0) {
@@ -1571,7 +2036,7 @@ uint8_t fs_storeall(MetadataDumper::DumpType dumpType) {
 			// try to save in alternative location - just in case
 			fs_emergency_saves();
 			if (child) {
-				exit(1);
+				_exit(1);
 			}
 			fs_broadcast_metadata_saved(LIZARDFS_ERROR_IO);
 			return LIZARDFS_ERROR_IO;
@@ -1586,7 +2051,7 @@ uint8_t fs_storeall(MetadataDumper::DumpType dumpType) {
 			// try to save in alternative location - just in case
 			fs_emergency_saves();
 			if (child) {
-				exit(1);
+				_exit(1);
 			}
 			fs_broadcast_metadata_saved(LIZARDFS_ERROR_IO);
 			return LIZARDFS_ERROR_IO;
@@ -1604,7 +2069,10 @@ uint8_t fs_storeall(MetadataDumper::DumpType dumpType) {
 		}
 		if (child) {
 			printf("OK\n"); // give mfsmetarestore another chance
-			exit(0);
+			fflush(stdout);
+			// don't run destructors of objects shared with the parent's threads,
+			// e.g. a condition variable which the changelog writer waits on
+			_exit(0);
 		}
 		fs_broadcast_metadata_saved(status);
 	}
@@ -68,8 +68,8 @@ static void fs_store_acl(uint32_t id, const RichACL &acl, FILE *fd) {
 }
 
 void fs_store_acls(FILE *fd) {
-	for (uint32_t i = 0; i < NODEHASHSIZE; ++i) {
-		for (FSNode *p = gMetadata->nodehash[i]; p; p = p->next) {
+	for (uint32_t i = 0; i < gMetadata->nodehash.bucket_count(); ++i) {
+		for (FSNode *p = gMetadata->nodehash.bucket(i); p; p = p->next) {
 			const RichACL *node_acl = gMetadata->acl_storage.get(p->id);
 			if (node_acl) {
 				fs_store_acl(p->id, *node_acl, fd);
@@ -32,9 +32,11 @@
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
+#include <memory>
 #include <string>
 
 #include "common/cfg.h"
+#include "common/changelog_record.h"
 #include "common/crc.h"
 #include "common/cwrap.h"
 #include "common/datapack.h"
@@ -48,6 +50,7 @@
 #include "common/sockets.h"
 #include "common/time_utils.h"
 #include "master/changelog.h"
+#include "master/changelog_pipeline.h"
 #include "protocol/matoml.h"
 #include "protocol/MFSCommunication.h"
 #include "protocol/mltoma.h"
@@ -147,6 +150,12 @@ static void* reconnect_hook;
 static void* download_hook;
 #endif /* #ifndef METALOGGER */
 static uint64_t lastlogversion=0;
+#ifndef METALOGGER
+/// Changes received by a synchronized shadow master which are waiting to be applied
+static std::unique_ptr<ChangelogPipeline> gChangelogPipeline;
+/// Reading from the master is suspended when this much data waits in the pipeline
+static const uint64_t kMaxPipelineBytes = 64 << 20;
+#endif /* #ifndef METALOGGER */
 
 static uint32_t stats_bytesout=0;
 static uint32_t stats_bytesin=0;
@@ -332,6 +341,7 @@ void masterconn_kill_session(masterconn* eptr) {
 
 void masterconn_force_metadata_download(masterconn* eptr) {
 #ifndef METALOGGER
+	gChangelogPipeline->clear();
 	eptr->state = MasterConnectionState::kNone;
 	fs_unload();
 	restore_reset();
@@ -347,6 +357,10 @@ void masterconn_request_metadata_dump(masterconn* eptr) {
 }
 
 void masterconn_handle_changelog_apply_error(masterconn* eptr, uint8_t status) {
+#ifndef METALOGGER
+	// changes received after the broken one are useless
+	gChangelogPipeline->clear();
+#endif /* #ifndef METALOGGER */
 	if (eptr->version <= lizardfsVersion(2, 5, 0)) {
 		lzfs_pretty_syslog(LOG_NOTICE, "Dropping in-memory metadata and starting download from master");
 		masterconn_force_metadata_download(eptr);
@@ -398,35 +412,11 @@ void masterconn_registered(masterconn *eptr, const uint8_t *data, uint32_t lengt
 }
 #endif
 
-void masterconn_metachanges_log(masterconn *eptr,const uint8_t *data,uint32_t length) {
-	if ((length == 1) && (data[0] == FORCE_LOG_ROTATE)) {
-#ifdef METALOGGER
-		// In metalogger rotates are forced by the master server. Shadow masters rotate changelogs
-		// every hour -- when creating a new metadata file.
-		changelog_rotate();
-#endif /* #ifdef METALOGGER */
-		return;
-	}
-	if (length<10) {
-		lzfs_pretty_syslog(LOG_NOTICE,"MATOML_METACHANGES_LOG - wrong size (%" PRIu32 "/9+data)",length);
-		eptr->mode = KILL;
-		return;
-	}
-	if (data[0]!=0xFF) {
-		lzfs_pretty_syslog(LOG_NOTICE,"MATOML_METACHANGES_LOG - wrong packet");
-		eptr->mode = KILL;
-		return;
-	}
-	if (data[length-1]!='\0') {
-		lzfs_pretty_syslog(LOG_NOTICE,"MATOML_METACHANGES_LOG - invalid string");
-		eptr->mode = KILL;
-		return;
-	}
-
-	data++;
-	uint64_t version = get64bit(&data);
-	const char* changelogEntry = reinterpret_cast<const char*>(data);
-
+/// Checks the version of a change, applies it (if metadata is synchronized) and stores it
+/// in the changelog. \p data and \p length describe the whole MATOML_METACHANGES_LOG packet.
+static void masterconn_apply_change(masterconn *eptr, const ChangelogPipeline::Change &change,
+		const uint8_t *data, uint32_t length) {
+	uint64_t version = change.version;
 	if ((lastlogversion > 0) && (version != (lastlogversion + 1))) {
 		lzfs_pretty_syslog(LOG_WARNING, "some changes lost: [%" PRIu64 "-%" PRIu64 "], download metadata again",lastlogversion,version-1);
 		masterconn_handle_changelog_apply_error(eptr, LIZARDFS_ERROR_METADATAVERSIONMISMATCH);
@@ -435,12 +425,17 @@ void masterconn_metachanges_log(masterconn *eptr,const uint8_t *data,uint32_t le
 
 #ifndef METALOGGER
 	if (eptr->state == MasterConnectionState::kSynchronized) {
-		std::string buf(": ");
-		buf.append(changelogEntry);
 		static char const network[] = "network";
 		uint8_t status;
-		if ((status = restore(network, version, buf.c_str(),
-				RestoreRigor::kDontIgnoreAnyErrors)) != LIZARDFS_STATUS_OK) {
+		if (change.text) {
+			std::string buf(": ");
+			buf.append(change.text);
+			status = restore(network, version, buf.c_str(), RestoreRigor::kDontIgnoreAnyErrors);
+		} else {
+			status = restore(network, version, change.payload, change.payloadSize,
+					RestoreRigor::kDontIgnoreAnyErrors);
+		}
+		if (status != LIZARDFS_STATUS_OK) {
 			lzfs_pretty_syslog(LOG_WARNING, "malformed changelog sent by the master server, can't apply it. status: %s",
 					lizardfs_error_string(status));
 			masterconn_handle_changelog_apply_error(eptr, status);
@@ -448,10 +443,68 @@ void masterconn_metachanges_log(masterconn *eptr,const uint8_t *data,uint32_t le
 		}
 	}
 #endif /* #ifndef METALOGGER */
-	changelog(version, changelogEntry);
+	if (change.text) {
+		changelog(version, change.text);
+	} else {
+		changelog_binary(data, length);
+	}
 	lastlogversion = version;
 }
 
+#ifndef METALOGGER
+/*! \brief Applies changes from the pipeline which are already checked.
+ *
+ * \param all wait for the worker and apply all the changes, not only the ones which can be
+ *            applied in one loop iteration
+ */
+static void masterconn_apply_pipeline(masterconn *eptr, bool all) {
+	SignalLoopWatchdog watchdog;
+	ChangelogPipeline::Change change;
+
+	watchdog.start();
+	while (eptr->state == MasterConnectionState::kSynchronized
+			&& gChangelogPipeline->pop(change, all)) {
+		if (!change.error.empty()) {
+			lzfs_pretty_syslog(LOG_NOTICE, "MATOML_METACHANGES_LOG - %s", change.error.c_str());
+			gChangelogPipeline->clear();
+			eptr->mode = KILL;
+			return;
+		}
+		masterconn_apply_change(eptr, change, change.packet.data(), change.packet.size());
+		if (!all && watchdog.expired()) {
+			// the rest will be applied in the next loop iteration
+			eventloop_make_next_poll_nonblocking();
+			break;
+		}
+	}
+}
+#endif /* #ifndef METALOGGER */
+
+void masterconn_metachanges_log(masterconn *eptr,const uint8_t *data,uint32_t length) {
+	if ((length == 1) && (data[0] == FORCE_LOG_ROTATE)) {
+#ifdef METALOGGER
+		// In metalogger rotates are forced by the master server. Shadow masters rotate changelogs
+		// every hour -- when creating a new metadata file.
+		changelog_rotate();
+#endif /* #ifdef METALOGGER */
+		return;
+	}
+#ifndef METALOGGER
+	if (eptr->state == MasterConnectionState::kSynchronized) {
+		// changes are checked by the pipeline's worker and applied in masterconn_serve
+		gChangelogPipeline->push(data, length);
+		return;
+	}
+#endif /* #ifndef METALOGGER */
+	ChangelogPipeline::Change change;
+	if (!ChangelogPipeline::parse(data, length, change)) {
+		lzfs_pretty_syslog(LOG_NOTICE, "MATOML_METACHANGES_LOG - %s", change.error.c_str());
+		eptr->mode = KILL;
+		return;
+	}
+	masterconn_apply_change(eptr, change, data, length);
+}
+
 void masterconn_end_session(masterconn *eptr, const uint8_t* data, uint32_t length) {
 	matoml::endSession::deserialize(data, length); // verify the empty packet
 	lzfs_pretty_syslog(LOG_NOTICE, "Master server is terminating; closing the connection...");
@@ -798,6 +851,9 @@ void masterconn_term(void) {
 
 	delete masterconnsingleton;
 	masterconnsingleton = NULL;
+#ifndef METALOGGER
+	gChangelogPipeline.reset();
+#endif /* #ifndef METALOGGER */
 }
 
 void masterconn_connected(masterconn *eptr) {
@@ -1015,6 +1071,15 @@ int masterconn_canexit(void) {
 	return !masterconnsingleton || masterconnsingleton->mode == FREE;
 }
 
+/// Is reading from the master suspended until the pipeline gets shorter
+static bool masterconn_reading_suspended() {
+#ifndef METALOGGER
+	return gChangelogPipeline->bytes() > kMaxPipelineBytes;
+#else /* #ifndef METALOGGER */
+	return false;
+#endif /* #ifndef METALOGGER */
+}
+
 void masterconn_desc(std::vector<pollfd> &pdesc) {
 	if (!masterconnsingleton) {
 		return;
@@ -1022,10 +1087,15 @@ void masterconn_desc(std::vector<pollfd> &pdesc) {
 	masterconn *eptr = masterconnsingleton;
 
 	eptr->pdescpos = -1;
+#ifndef METALOGGER
+	if (!gChangelogPipeline->empty()) {
+		pdesc.push_back({gChangelogPipeline->notifyFd(),POLLIN,0});
+	}
+#endif /* #ifndef METALOGGER */
 	if (eptr->mode==FREE || eptr->sock<0) {
 		return;
 	}
-	if (eptr->mode==HEADER || eptr->mode==DATA) {
+	if ((eptr->mode==HEADER || eptr->mode==DATA) && !masterconn_reading_suspended()) {
 		pdesc.push_back({eptr->sock,POLLIN,0});
 		eptr->pdescpos = pdesc.size() - 1;
 	}
@@ -1068,6 +1138,10 @@ void masterconn_serve(const std::vector<pollfd> &pdesc) {
 				eptr->lastwrite = now;
 				masterconn_write(eptr);
 			}
+			if (masterconn_reading_suspended()) {
+				// the master is alive, its data just waits for the pipeline
+				eptr->lastread = now;
+			}
 			if ((eptr->mode==HEADER || eptr->mode==DATA) && eptr->lastread+Timeout<now) {
 				eptr->mode = KILL;
 			}
@@ -1076,6 +1150,13 @@ void masterconn_serve(const std::vector<pollfd> &pdesc) {
 			}
 		}
 	}
+#ifndef METALOGGER
+	if (!gChangelogPipeline->empty()) {
+		gChangelogPipeline->drainNotifications();
+		// everything received from the master is applied before the connection is closed
+		masterconn_apply_pipeline(eptr, eptr->mode == KILL);
+	}
+#endif /* #ifndef METALOGGER */
 	if (eptr->mode == KILL) {
 		masterconn_beforeclose(eptr);
 		tcpclose(eptr->sock);
@@ -1119,6 +1200,10 @@ void masterconn_become_master() {
 		return;
 	}
 	masterconn *eptr = masterconnsingleton;
+#ifndef METALOGGER
+	// the new master has to know all the changes made by the old one
+	masterconn_apply_pipeline(eptr, true);
+#endif /* #ifndef METALOGGER */
 	eventloop_timeunregister(eptr->sessionsdownloadinit_handle);
 	eventloop_timeunregister(eptr->metachanges_flush_handle);
 	masterconn_term();
@@ -1211,6 +1296,9 @@ int masterconn_init(void) {
 	}
 #endif /* #ifdef METALOGGER */
 
+#ifndef METALOGGER
+	gChangelogPipeline.reset(new ChangelogPipeline()); // may throw
+#endif /* #ifndef METALOGGER */
 	eptr = masterconnsingleton = new masterconn();
 	passert(eptr);
 
@@ -1252,3 +1340,21 @@ bool masterconn_is_connected() {
 			&& eptr->version > 0 // registration was successful
 	);
 }
+
+#ifndef METALOGGER
+void masterconn_replication_lag(uint64_t &changesBehind, uint32_t &secondsBehind) {
+	changesBehind = 0;
+	secondsBehind = 0;
+	if (!gChangelogPipeline || gChangelogPipeline->empty()) {
+		return;
+	}
+	if (gChangelogPipeline->lastVersion() > lastlogversion) {
+		changesBehind = gChangelogPipeline->lastVersion() - lastlogversion;
+	}
+	uint32_t oldestTimestamp = gChangelogPipeline->oldestTimestamp();
+	uint32_t now = eventloop_time();
+	if (oldestTimestamp > 0 && oldestTimestamp < now) {
+		secondsBehind = now - oldestTimestamp;
+	}
+}
+#endif /* #ifndef METALOGGER */
@@ -26,3 +26,10 @@
 int masterconn_init(void);
 
 bool masterconn_is_connected();
+
+/*! \brief How far a shadow master is behind the master server.
+ *
+ * \param changesBehind number of received changes which aren't applied yet
+ * \param secondsBehind age of the oldest change which isn't applied yet
+ */
+void masterconn_replication_lag(uint64_t &changesBehind, uint32_t &secondsBehind);
@@ -176,6 +176,7 @@ typedef struct packetstruct {
 	uint8_t *startptr;
 	uint32_t bytesleft;
 	uint8_t *packet;
+	uint64_t changelogPosition;  // the packet can't be sent until this change is synced
 } packetstruct;
 
 /** This looks to be the client type. This is set in matoclserv_serve and matoclserv_fuse_register, and there are 3 possible values:
@@ -910,6 +911,7 @@ uint8_t* matoclserv_createpacket(matoclserventry *eptr,uint32_t type,uint32_t si
 	put32bit(&ptr,type);
 	put32bit(&ptr,size);
 	outpacket->startptr = (uint8_t*)(outpacket->packet);
+	outpacket->changelogPosition = changelog_position();
 	outpacket->next = NULL;
 	*(eptr->outputtail) = outpacket;
 	eptr->outputtail = &(outpacket->next);
@@ -925,6 +927,7 @@ void matoclserv_createpacket(matoclserventry *eptr, const MessageBuffer& buffer)
 	// TODO unificate output packets and remove suboptimal memory copying
 	memcpy(outpacket->packet, buffer.data(), buffer.size());
 	outpacket->startptr = outpacket->packet;
+	outpacket->changelogPosition = changelog_position();
 	outpacket->next = NULL;
 	*(eptr->outputtail) = outpacket;
 	eptr->outputtail = &(outpacket->next);
@@ -1229,8 +1232,20 @@ void matoclserv_iolimits_status(matoclserventry* eptr, const uint8_t* data, uint
 }
 
 void matoclserv_metadataserver_status(matoclserventry* eptr, const uint8_t* data, uint32_t length) {
+	PacketVersion version;
 	uint32_t messageId;
-	cltoma::metadataserverStatus::deserialize(data, length, messageId);
+	bool dummy;
+
+	deserializePacketVersionNoHeader(data, length, version);
+	if (version == cltoma::metadataserverStatus::kStandard) {
+		cltoma::metadataserverStatus::deserialize(data, length, messageId);
+	} else if (version == cltoma::metadataserverStatus::kWithProgress) {
+		cltoma::metadataserverStatus::deserialize(data, length, messageId, dummy);
+	} else {
+		lzfs_pretty_syslog(LOG_NOTICE, "LIZ_METADATASERVER_STATUS - wrong packet version %u", version);
+		eptr->mode = KILL;
+		return;
+	}
 
 	uint64_t metadataVersion = 0;
 	try {
@@ -1243,10 +1258,25 @@ void matoclserv_metadataserver_status(matoclserventry* eptr, const uint8_t* data
 			 : LIZ_METADATASERVER_STATUS_SHADOW_DISCONNECTED);
 
 	MessageBuffer buffer;
-	matocl::metadataserverStatus::serialize(buffer,
-			messageId,
-			status,
-			metadataVersion);
+	if (version == cltoma::metadataserverStatus::kStandard) {
+		matocl::metadataserverStatus::serialize(buffer,
+				messageId,
+				status,
+				metadataVersion);
+	} else {
+		MetadataDumper::Progress progress = fs_metadata_dump_progress();
+		uint64_t changesBehind;
+		uint32_t secondsBehind;
+		masterconn_replication_lag(changesBehind, secondsBehind);
+		matocl::metadataserverStatus::serialize(buffer,
+				messageId,
+				status,
+				metadataVersion,
+				progress.stage,
+				progress.percent,
+				changesBehind,
+				secondsBehind);
+	}
 	matoclserv_createpacket(eptr, std::move(buffer));
 }
 
@@ -4231,6 +4261,12 @@ void matoclserv_list_tasks(matoclserventry *eptr) {
 	matoclserv_createpacket(eptr, matocl::listTasks::build(jobs_info));
 }
 
+void matoclserv_hash_tables_info(matoclserventry *eptr) {
+	std::vector<HashTableStatistics> tables{fs_node_hash_table_statistics(),
+			chunk_hash_table_statistics()};
+	matoclserv_createpacket(eptr, matocl::hashTablesInfo::build(tables));
+}
+
 void matoclserv_stop_task(matoclserventry *eptr, const uint8_t *data, uint32_t length) {
 	uint32_t job_id, msgid;
 	uint8_t status;
@@ -4510,7 +4546,9 @@ void matoclserv_admin_save_metadata(matoclserventry* eptr, const uint8_t* data,
 		lzfs_pretty_syslog(LOG_NOTICE, "saving metadata image requested using lizardfs-admin by %s",
 				ipToString(eptr->peerip).c_str());
 		uint8_t status = fs_storeall(MetadataDumper::DumpType::kBackgroundDump);
-		if (status != LIZARDFS_STATUS_OK || asynchronous) {
+		bool dumpedInForeground =
+				fs_metadata_dump_progress().stage == LIZ_METADATA_DUMP_NOT_RUNNING;
+		if (status != LIZARDFS_STATUS_OK || asynchronous || dumpedInForeground) {
 			matoclserv_createpacket(eptr, matocl::adminSaveMetadata::build(status));
 		} else {
 			// Mark the client; we will reply after metadata save process is finished
@@ -4788,6 +4826,9 @@ void matoclserv_gotpacket(matoclserventry *eptr,uint32_t type,const uint8_t *dat
 				case LIZ_CLTOMA_LIST_TASKS:
 					matoclserv_list_tasks(eptr);
 					break;
+				case LIZ_CLTOMA_HASH_TABLES_INFO:
+					matoclserv_hash_tables_info(eptr);
+					break;
 				case LIZ_CLTOMA_STOP_TASK:
 					matoclserv_stop_task(eptr, data, length);
 					break;
@@ -5228,7 +5269,7 @@ void matoclserv_write(matoclserventry *eptr) {
 	watchdog.start();
 	for (;;) {
 		pack = eptr->outputhead;
-		if (pack==NULL) {
+		if (pack==NULL || !changelog_is_synced(pack->changelogPosition)) {
 			return;
 		}
 		i=write(eptr->sock,pack->startptr,pack->bytesleft);
@@ -5313,7 +5354,7 @@ void matoclserv_desc(std::vector<pollfd> &pdesc) {
 		if (exiting==0) {
 			pdesc.back().events |= POLLIN;
 		}
-		if (eptr->outputhead!=NULL) {
+		if (eptr->outputhead!=NULL && changelog_is_synced(eptr->outputhead->changelogPosition)) {
 			pdesc.back().events |= POLLOUT;
 		}
 	}
@@ -69,6 +69,9 @@ enum{KILL, CONNECTED};
 
 double gLoadFactorPenalty = 0.;
 
+/// Time (in seconds) for which a disconnected chunkserver can register only its changed chunks
+static uint32_t gChunkserverResumeTimeout;
+
 struct matocsserventry {
 	matocsserventry() : inputPacket(MaxPacketSize) {}
 
@@ -1301,9 +1304,49 @@ void matocsserv_liz_register_chunks(matocsserventry *eptr, const std::vector<uin
 	}
 }
 
+void matocsserv_liz_register_changes(matocsserventry *eptr, const std::vector<uint8_t>& data) {
+	uint64_t epoch, checksum;
+	uint32_t chunkCount;
+	std::vector<ChunkWithVersionAndType> changedChunks;
+	std::vector<ChunkWithType> removedChunks;
+	cstoma::registerChanges::deserialize(data, epoch, checksum, chunkCount,
+			changedChunks, removedChunks);
+	if (eptr->csdb == nullptr) {
+		lzfs_pretty_syslog(LOG_NOTICE,"LIZ_CSTOMA_REGISTER_CHANGES - registering changes is possible for registered connections only "
+		                  "(ip: %s, port %" PRIu16 ")", eptr->servstrip, eptr->servport);
+		eptr->mode = KILL;
+		return;
+	}
+	if (chunk_server_resume_registration(eptr, epoch, checksum, chunkCount,
+			changedChunks, removedChunks)) {
+		lzfs_pretty_syslog(LOG_NOTICE, "chunkserver registration resumed - ip: %s, port: %" PRIu16
+				", changed chunks: %zu, removed chunks: %zu", eptr->servstrip, eptr->servport,
+				changedChunks.size(), removedChunks.size());
+	} else {
+		lzfs_pretty_syslog(LOG_NOTICE, "chunkserver registration can't be resumed - ip: %s, port: %"
+				PRIu16 ", asking for all chunks", eptr->servstrip, eptr->servport);
+		eptr->outputPackets.push_back(OutputPacket());
+		matocs::registerEpoch::serialize(eptr->outputPackets.back().packet, uint64_t(0));
+	}
+}
+
 void matocsserv_liz_register_space(matocsserventry *eptr, const std::vector<uint8_t>& data) {
 	cstoma::registerSpace::deserialize(data, eptr->usedspace, eptr->totalspace, eptr->chunkscount,
 			eptr->todelusedspace, eptr->todeltotalspace, eptr->todelchunkscount);
+	if (eptr->csdb != nullptr) {
+		std::vector<ChunkWithVersionAndType>().swap(eptr->csdb->detachedParts);
+		eptr->csdb->detachedPartsComplete = false;
+		eptr->csdb->registrationEpoch = 0;
+		if (gChunkserverResumeTimeout > 0 && eptr->version >= kIncrementalRegistrationVersion) {
+			uint64_t epoch;
+			do {
+				epoch = rnd<uint64_t>();
+			} while (epoch == 0);
+			eptr->csdb->registrationEpoch = epoch;
+			eptr->outputPackets.push_back(OutputPacket());
+			matocs::registerEpoch::serialize(eptr->outputPackets.back().packet, epoch);
+		}
+	}
 	return register_space(eptr);
 }
 
@@ -1547,6 +1590,9 @@ void matocsserv_gotpacket(matocsserventry *eptr, PacketHeader header, const Mess
 			case LIZ_CSTOMA_REGISTER_CHUNKS:
 				matocsserv_liz_register_chunks(eptr, data);
 				break;
+			case LIZ_CSTOMA_REGISTER_CHANGES:
+				matocsserv_liz_register_changes(eptr, data);
+				break;
 			case LIZ_CSTOMA_REGISTER_SPACE:
 				matocsserv_liz_register_space(eptr, data);
 				break;
@@ -1769,6 +1815,10 @@ void matocsserv_serve(const std::vector<pollfd> &pdesc) {
 	}
 }
 
+void matocsserv_remove_stale_detached_parts() {
+	csdb_remove_stale_detached_parts(gChunkserverResumeTimeout);
+}
+
 void matocsserv_reload(void) {
 	char *oldListenHost,*oldListenPort;
 	int newlsock;
@@ -1778,6 +1828,7 @@ void matocsserv_reload(void) {
 	ListenHost = cfg_getstr("MATOCS_LISTEN_HOST","*");
 	ListenPort = cfg_getstr("MATOCS_LISTEN_PORT","9420");
 	gLoadFactorPenalty = cfg_get_minmaxvalue<double>("LOAD_FACTOR_PENALTY", 0., 0., 0.5);
+	gChunkserverResumeTimeout = cfg_getuint32("CHUNKSERVER_RESUME_TIMEOUT", 600);
 	if (strcmp(oldListenHost,ListenHost)==0 && strcmp(oldListenPort,ListenPort)==0) {
 		free(oldListenHost);
 		free(oldListenPort);
@@ -1824,6 +1875,7 @@ int matocsserv_init(void) {
 	ListenHost = cfg_getstr("MATOCS_LISTEN_HOST","*");
 	ListenPort = cfg_getstr("MATOCS_LISTEN_PORT","9420");
 	gLoadFactorPenalty = cfg_get_minmaxvalue<double>("LOAD_FACTOR_PENALTY", 0., 0., 0.5);
+	gChunkserverResumeTimeout = cfg_getuint32("CHUNKSERVER_RESUME_TIMEOUT", 600);
 
 	lsock = tcpsocket();
 	if (lsock<0) {
@@ -1844,6 +1896,7 @@ int matocsserv_init(void) {
 
 	matocsserv_replication_init();
 	matocsservhead = NULL;
+	eventloop_timeregister(TIMEMODE_RUN_LATE, 60, 0, matocsserv_remove_stale_detached_parts);
 	eventloop_reloadregister(matocsserv_reload);
 	eventloop_destructregister(matocsserv_term);
 	eventloop_pollregister(matocsserv_desc,matocsserv_serve);
@@ -24,6 +24,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <netinet/in.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +36,7 @@
 #include <set>
 
 #include "common/cfg.h"
+#include "common/changelog_record.h"
 #include "common/crc.h"
 #include "common/datapack.h"
 #include "common/event_loop.h"
@@ -44,6 +46,7 @@
 #include "common/metadata.h"
 #include "common/slogger.h"
 #include "common/sockets.h"
+#include "master/changelog_buffer.h"
 #include "master/filesystem.h"
 #include "master/personality.h"
 #include "protocol/matoml.h"
@@ -51,7 +54,7 @@
 #include "protocol/mltoma.h"
 
 #define MaxPacketSize 1500000
-#define OLD_CHANGES_BLOCK_SIZE 5000
+#define MaxWriteIov 64
 
 // matomlserventry.mode
 enum{KILL,HEADER,DATA};
@@ -61,6 +64,7 @@ typedef struct packetstruct {
 	uint8_t *startptr;
 	uint32_t bytesleft;
 	uint8_t *packet;
+	ChangelogBuffer::Segment *segment; // set (instead of packet) for a slice of stored changes
 } packetstruct;
 
 typedef struct matomlserventry {
@@ -96,20 +100,6 @@ static uint32_t gMinMetadataSaveRequestPeriod_s;
 /// Timestamp of the last metadata save request
 static uint32_t gLastMetadataSaveRequestTimestamp = 0;
 
-typedef struct old_changes_entry {
-	uint64_t version;
-	uint32_t length;
-	uint8_t *data;
-} old_changes_entry;
-
-typedef struct old_changes_block {
-	old_changes_entry old_changes_block [OLD_CHANGES_BLOCK_SIZE];
-	uint32_t entries;
-	uint32_t mintimestamp;
-	uint64_t minversion;
-	struct old_changes_block *next;
-} old_changes_block;
-
 void matomlserv_createpacket(matomlserventry *eptr, std::vector<uint8_t> data);
 
 /*! \brief Keep queue of Shadows interested in receiving information
@@ -158,62 +148,42 @@ void matomlserv_broadcast_metadata_saved(uint8_t status) {
 	gShadowQueue.handleRequests(status);
 }
 
-static old_changes_block *old_changes_head=NULL;
-static old_changes_block *old_changes_current=NULL;
+/// Recent changes, sent to all connections and kept for the ones which reconnect
+static ChangelogBuffer gStoredChanges;
 
 // from config
 static char *ListenHost;
 static char *ListenPort;
 static uint16_t ChangelogSecondsToRemember;
+static uint32_t ChangelogMaxMBToRemember;
 
-void matomlserv_old_changes_free_block(old_changes_block *oc) {
-	uint32_t i;
-	for (i=0 ; i<oc->entries ; i++) {
-		free(oc->old_changes_block[i].data);
+/*! \brief Stores a change as a packet for metaloggers and shadow masters.
+ *
+ * Binary records are stored as they are, text entries get the version in front of them.
+ */
+static ChangelogBuffer::Slice matomlserv_store_change(uint64_t version, const uint8_t *change,
+		uint32_t length) {
+	bool binary = (change[0] == changelog_record::kMarker);
+	uint32_t size = binary ? length : 9 + length;
+	uint32_t ts = eventloop_time();
+	ChangelogBuffer::Slice slice = gStoredChanges.append(version, ts, 8 + size);
+	uint8_t *ptr = slice.data;
+	put32bit(&ptr, MATOML_METACHANGES_LOG);
+	put32bit(&ptr, size);
+	if (!binary) {
+		put8bit(&ptr, 0xFF);
+		put64bit(&ptr, version);
 	}
-	free(oc);
+	memcpy(ptr, change, length);
+	// with no changes to remember only the newest segment is kept, it's the send buffer
+	gStoredChanges.trim(ts > ChangelogSecondsToRemember ? ts - ChangelogSecondsToRemember : 0,
+			(uint64_t)ChangelogMaxMBToRemember << 20);
+	return slice;
 }
 
-void matomlserv_store_logstring(uint64_t version,uint8_t *logstr,uint32_t logstrsize) {\
-	old_changes_block *oc;
-	old_changes_entry *oce;
-	uint32_t ts;
-	if (ChangelogSecondsToRemember==0) {
-		while (old_changes_head) {
-			oc = old_changes_head->next;
-			matomlserv_old_changes_free_block(old_changes_head);
-			old_changes_head = oc;
-		}
-		return;
-	}
-	if (old_changes_current==NULL || old_changes_head==NULL || old_changes_current->entries>=OLD_CHANGES_BLOCK_SIZE) {
-		oc = (old_changes_block*) malloc(sizeof(old_changes_block));
-		passert(oc);
-		ts = eventloop_time();
-		oc->entries = 0;
-		oc->minversion = version;
-		oc->mintimestamp = ts;
-		oc->next = NULL;
-		if (old_changes_current==NULL || old_changes_head==NULL) {
-			old_changes_head = old_changes_current = oc;
-		} else {
-			old_changes_current->next = oc;
-			old_changes_current = oc;
-		}
-		while (old_changes_head && old_changes_head->next && old_changes_head->next->mintimestamp+ChangelogSecondsToRemember<ts) {
-			oc = old_changes_head->next;
-			matomlserv_old_changes_free_block(old_changes_head);
-			old_changes_head = oc;
-		}
-	}
-	oc = old_changes_current;
-	oce = oc->old_changes_block + oc->entries;
-	oce->version = version;
-	oce->length = logstrsize;
-	oce->data = (uint8_t*) malloc(logstrsize);
-	passert(oce->data);
-	memcpy(oce->data,logstr,logstrsize);
-	oc->entries++;
+/// Are the stored changes kept for connections which need older changes
+static bool matomlserv_old_changes_available() {
+	return ChangelogSecondsToRemember > 0 && !gStoredChanges.empty();
 }
 
 uint32_t matomlserv_mloglist_size(void) {
@@ -307,6 +277,7 @@ uint8_t* matomlserv_createpacket(matomlserventry *eptr,uint32_t type,uint32_t si
 	put32bit(&ptr,type);
 	put32bit(&ptr,size);
 	outpacket->startptr = (uint8_t*)(outpacket->packet);
+	outpacket->segment = NULL;
 	outpacket->next = NULL;
 	*(eptr->outputtail) = outpacket;
 	eptr->outputtail = &(outpacket->next);
@@ -321,41 +292,109 @@ void matomlserv_createpacket(matomlserventry *eptr, std::vector<uint8_t> data) {
 	memcpy(outpacket->packet, data.data(), data.size());
 	outpacket->bytesleft = data.size();
 	outpacket->startptr = outpacket->packet;
+	outpacket->segment = nullptr;
 	outpacket->next = nullptr;
 	*(eptr->outputtail) = outpacket;
 	eptr->outputtail = &(outpacket->next);
 }
 
-void matomlserv_send_old_changes(matomlserventry *eptr,uint64_t version) {
-	old_changes_block *oc;
-	old_changes_entry *oce;
+static void matomlserv_freepacket(packetstruct *pack) {
+	if (pack->packet) {
+		free(pack->packet);
+	}
+	if (pack->segment) {
+		ChangelogBuffer::unref(pack->segment);
+	}
+	free(pack);
+}
+
+/*! \brief Queues a slice of stored changes without copying it.
+ *
+ * A slice which directly follows the last queued one is merged with it, so consecutive changes
+ * are sent with a single write.
+ */
+static void matomlserv_queue_stored(matomlserventry *eptr, const ChangelogBuffer::Slice &slice) {
+	if (eptr->outputhead != nullptr) {
+		// outputtail points to the next field of the last packet
+		packetstruct *last = reinterpret_cast<packetstruct*>(
+				reinterpret_cast<uint8_t*>(eptr->outputtail) - offsetof(packetstruct, next));
+		if (last->segment == slice.segment && last->startptr + last->bytesleft == slice.data) {
+			last->bytesleft += slice.length;
+			return;
+		}
+	}
+	packetstruct *outpacket = (packetstruct*) malloc(sizeof(packetstruct));
+	passert(outpacket);
+	outpacket->packet = nullptr;
+	outpacket->segment = slice.segment;
+	ChangelogBuffer::ref(slice.segment);
+	outpacket->startptr = slice.data;
+	outpacket->bytesleft = slice.length;
+	outpacket->next = nullptr;
+	*(eptr->outputtail) = outpacket;
+	eptr->outputtail = &(outpacket->next);
+}
+
+/*! \brief Sends a change stored either as a text entry or as a framed binary record.
+ *
+ * Peers which don't understand binary records get the text entry recreated from it.
+ */
+static void matomlserv_send_change(matomlserventry *eptr, uint64_t version, const uint8_t *change,
+		uint32_t length) {
 	uint8_t *data;
-	uint8_t start=0;
-	uint32_t i;
-	if (old_changes_head==NULL) {
+	if (change[0] == changelog_record::kMarker) {
+		if (eptr->version >= kBinaryChangelogVersion) {
+			data = matomlserv_createpacket(eptr, MATOML_METACHANGES_LOG, length);
+			memcpy(data, change, length);
+			return;
+		}
+		static std::string text;
+		changelog_record::RecordView record;
+		if (changelog_record::parse(change, length, record) != changelog_record::ParseStatus::kOk
+				|| !changelog_record::toText(record.payload, record.payloadSize, text)) {
+			lzfs_pretty_syslog(LOG_ERR, "malformed binary changelog entry %" PRIu64, version);
+			return;
+		}
+		change = reinterpret_cast<const uint8_t*>(text.c_str());
+		length = text.size() + 1;
+	}
+	data = matomlserv_createpacket(eptr, MATOML_METACHANGES_LOG, 9 + length);
+	put8bit(&data, 0xFF);
+	put64bit(&data, version);
+	memcpy(data, change, length);
+}
+
+/*! \brief Sends a stored change (a packet created by matomlserv_store_change).
+ *
+ * Peers which don't understand binary records get the text entry recreated from it.
+ */
+static void matomlserv_send_stored(matomlserventry *eptr, uint64_t version,
+		const ChangelogBuffer::Slice &slice) {
+	const uint8_t *change = slice.data + 8;
+	if (change[0] == changelog_record::kMarker && eptr->version < kBinaryChangelogVersion) {
+		matomlserv_send_change(eptr, version, change, slice.length - 8);
+	} else {
+		matomlserv_queue_stored(eptr, slice);
+	}
+}
+
+void matomlserv_send_old_changes(matomlserventry *eptr,uint64_t version) {
+	if (!matomlserv_old_changes_available()) {
 		return;
 	}
-	if (old_changes_head->minversion>version) {
-		lzfs_pretty_syslog(LOG_WARNING,"meta logger wants changes since version: %" PRIu64 ", but minimal version in storage is: %" PRIu64,version,old_changes_head->minversion);
+	if (gStoredChanges.firstVersion()>version) {
+		lzfs_pretty_syslog(LOG_WARNING,"meta logger wants changes since version: %" PRIu64 ", but minimal version in storage is: %" PRIu64,version,gStoredChanges.firstVersion());
 		// TODO(msulikowski) send a special message which will cause the shadow master to unload fs
 	}
-	for (oc=old_changes_head ; oc ; oc=oc->next) {
-		if (oc->minversion>=version) {
-			start=1;
-		} else if (oc->minversion<=version && (oc->next==NULL || oc->next->minversion>version)) {
-			start=1;
-		}
-		if (start) {
-			for (i=0 ; i<oc->entries ; i++) {
-				oce = oc->old_changes_block + i;
-				if (version < oce->version) {
-					data = matomlserv_createpacket(eptr,MATOML_METACHANGES_LOG,9+oce->length);
-					put8bit(&data,0xFF);
-					put64bit(&data,oce->version);
-					memcpy(data,oce->data,oce->length);
-				}
-			}
-		}
+	if (eptr->version >= kBinaryChangelogVersion) {
+		gStoredChanges.forEachSliceAfter(version, [eptr](const ChangelogBuffer::Slice &slice) {
+			matomlserv_queue_stored(eptr, slice);
+		});
+	} else {
+		gStoredChanges.forEachChangeAfter(version,
+				[eptr](uint64_t changeVersion, const ChangelogBuffer::Slice &slice) {
+			matomlserv_send_stored(eptr, changeVersion, slice);
+		});
 	}
 }
 
@@ -433,8 +472,8 @@ void matomlserv_register_shadow(matomlserventry *eptr, const uint8_t *data, uint
 	uint64_t myMedatataVersion = fs_getversion();
 	uint64_t replyVersion;
 	if (myMedatataVersion > shadowMetadataVersion
-			&& old_changes_head != nullptr
-			&& old_changes_head->minversion <= shadowMetadataVersion) {
+			&& matomlserv_old_changes_available()
+			&& gStoredChanges.firstVersion() <= shadowMetadataVersion) {
 		// Our version is newer than shadow's, but we can cheat a bit by sending old changes
 		replyVersion = shadowMetadataVersion;
 	} else {
@@ -598,16 +637,22 @@ void matomlserv_changelog_apply_error(matomlserventry *eptr, const uint8_t *data
 
 void matomlserv_broadcast_logstring(uint64_t version,uint8_t *logstr,uint32_t logstrsize) {
 	matomlserventry *eptr;
-	uint8_t *data;
-
-	matomlserv_store_logstring(version,logstr,logstrsize);
+	ChangelogBuffer::Slice slice = matomlserv_store_change(version,logstr,logstrsize);
 
 	for (eptr = matomlservhead ; eptr ; eptr=eptr->next) {
 		if (eptr->version>0) {
-			data = matomlserv_createpacket(eptr,MATOML_METACHANGES_LOG,9+logstrsize);
-			put8bit(&data,0xFF);
-			put64bit(&data,version);
-			memcpy(data,logstr,logstrsize);
+			matomlserv_send_stored(eptr, version, slice);
+		}
+	}
+}
+
+void matomlserv_broadcast_logrecord(uint64_t version, const uint8_t *record, uint32_t size) {
+	// Stored changes keep records as they are, matomlserv_send_stored tells them from text entries
+	ChangelogBuffer::Slice slice = matomlserv_store_change(version, record, size);
+
+	for (matomlserventry *eptr = matomlservhead; eptr; eptr = eptr->next) {
+		if (eptr->version > 0) {
+			matomlserv_send_stored(eptr, version, slice);
 		}
 	}
 }
@@ -696,12 +741,9 @@ void matomlserv_term(void) {
 		}
 		pptr = eptr->outputhead;
 		while (pptr) {
-			if (pptr->packet) {
-				free(pptr->packet);
-			}
 			paptr = pptr;
 			pptr = pptr->next;
-			free(paptr);
+			matomlserv_freepacket(paptr);
 		}
 		eaptr = eptr;
 		eptr = eptr->next;
@@ -789,15 +831,25 @@ void matomlserv_read(matomlserventry *eptr) {
 void matomlserv_write(matomlserventry *eptr) {
 	SignalLoopWatchdog watchdog;
 	packetstruct *pack;
-	int32_t i;
+	struct iovec iov[MaxWriteIov];
+	ssize_t i;
+	size_t total;
+	int iovcnt;
 
 	watchdog.start();
 	for (;;) {
-		pack = eptr->outputhead;
-		if (pack==NULL) {
+		iovcnt = 0;
+		total = 0;
+		for (pack = eptr->outputhead ; pack && iovcnt<MaxWriteIov ; pack = pack->next) {
+			iov[iovcnt].iov_base = pack->startptr;
+			iov[iovcnt].iov_len = pack->bytesleft;
+			total += pack->bytesleft;
+			iovcnt++;
+		}
+		if (iovcnt==0) {
 			return;
 		}
-		i=write(eptr->sock,pack->startptr,pack->bytesleft);
+		i=writev(eptr->sock,iov,iovcnt);
 		if (i<0) {
 			if (errno!=EAGAIN) {
 				lzfs_silent_errlog(LOG_NOTICE,"write to ML(%s) error",eptr->servstrip);
@@ -805,17 +857,25 @@ void matomlserv_write(matomlserventry *eptr) {
 			}
 			return;
 		}
-		pack->startptr+=i;
-		pack->bytesleft-=i;
-		if (pack->bytesleft>0) {
+		if ((size_t)i<total) {
+			while ((size_t)i>=eptr->outputhead->bytesleft) {
+				pack = eptr->outputhead;
+				i-=pack->bytesleft;
+				eptr->outputhead = pack->next;
+				matomlserv_freepacket(pack);
+			}
+			eptr->outputhead->startptr+=i;
+			eptr->outputhead->bytesleft-=i;
 			return;
 		}
-		free(pack->packet);
-		eptr->outputhead = pack->next;
-		if (eptr->outputhead==NULL) {
-			eptr->outputtail = &(eptr->outputhead);
+		for (; iovcnt>0 ; iovcnt--) {
+			pack = eptr->outputhead;
+			eptr->outputhead = pack->next;
+			if (eptr->outputhead==NULL) {
+				eptr->outputtail = &(eptr->outputhead);
+			}
+			matomlserv_freepacket(pack);
 		}
-		free(pack);
 
 		if (watchdog.expired()) {
 			break;
@@ -915,12 +975,9 @@ void matomlserv_serve(const std::vector<pollfd> &pdesc) {
 			}
 			pptr = eptr->outputhead;
 			while (pptr) {
-				if (pptr->packet) {
-					free(pptr->packet);
-				}
 				paptr = pptr;
 				pptr = pptr->next;
-				free(paptr);
+				matomlserv_freepacket(paptr);
 			}
 			if (eptr->servstrip) {
 				free(eptr->servstrip);
@@ -956,6 +1013,12 @@ void matomlserv_become_master() {
 /// Used on init and reload.
 void matomlserv_read_config_file() {
 	gMinMetadataSaveRequestPeriod_s = cfg_getuint32("METADATA_SAVE_REQUEST_MIN_PERIOD", 1800);
+	ChangelogSecondsToRemember = cfg_getuint16("MATOML_LOG_PRESERVE_SECONDS",600);
+	if (ChangelogSecondsToRemember>3600) {
+		lzfs_pretty_syslog(LOG_WARNING,"Number of seconds of change logs to be preserved in master is too big (%" PRIu16 ") - decreasing to 3600 seconds",ChangelogSecondsToRemember);
+		ChangelogSecondsToRemember=3600;
+	}
+	ChangelogMaxMBToRemember = cfg_getuint32("MATOML_LOG_PRESERVE_MAX_MB", 0);
 }
 
 void matomlserv_reload(void) {
@@ -1005,11 +1068,6 @@ void matomlserv_reload(void) {
 	tcpclose(lsock);
 	lsock = newlsock;
 
-	ChangelogSecondsToRemember = cfg_getuint16("MATOML_LOG_PRESERVE_SECONDS",600);
-	if (ChangelogSecondsToRemember>3600) {
-		lzfs_pretty_syslog(LOG_WARNING,"Number of seconds of change logs to be preserved in master is too big (%" PRIu16 ") - decreasing to 3600 seconds",ChangelogSecondsToRemember);
-		ChangelogSecondsToRemember=3600;
-	}
 }
 
 int matomlserv_init(void) {
@@ -1036,11 +1094,6 @@ int matomlserv_init(void) {
 	lzfs_pretty_syslog(LOG_NOTICE,"master <-> metaloggers module: listen on %s:%s",ListenHost,ListenPort);
 
 	matomlservhead = NULL;
-	ChangelogSecondsToRemember = cfg_getuint16("MATOML_LOG_PRESERVE_SECONDS",600);
-	if (ChangelogSecondsToRemember>3600) {
-		lzfs_pretty_syslog(LOG_WARNING,"Number of seconds of change logs to be preserved in master is too big (%" PRIu16 ") - decreasing to 3600 seconds",ChangelogSecondsToRemember);
-		ChangelogSecondsToRemember=3600;
-	}
 	eventloop_wantexitregister(matomlserv_wantexit);
 	eventloop_canexitregister(matomlserv_canexit);
 	eventloop_reloadregister(matomlserv_reload);
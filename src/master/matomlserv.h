@@ -33,6 +33,8 @@ void matomlserv_mloglist_data(uint8_t *ptr);
 std::vector<MetadataserverListEntry> matomlserv_shadows();
 
 void matomlserv_broadcast_logstring(uint64_t version,uint8_t *logstr,uint32_t logstrsize);
+/// Sends a framed binary changelog record (see common/changelog_record.h) to all peers
+void matomlserv_broadcast_logrecord(uint64_t version, const uint8_t *record, uint32_t size);
 void matomlserv_broadcast_logrotate();
 /*! \brief Broadcast status of metadata dump process to all interested parties.
  *
@@ -19,13 +19,18 @@
 #include "common/platform.h"
 #include "master/metadata_dumper.h"
 
+#include <spawn.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
 
 #include "common/massert.h"
 #include "common/metadata.h"
 #include "master/filesystem.h"
 #include "master/personality.h"
 
+extern char **environ;
+
 static bool createPipe(int pipefds[2]) {
 	if (pipe(pipefds) != 0) {
 		lzfs_pretty_errlog(LOG_ERR, "pipe failed");
@@ -38,10 +43,12 @@ MetadataDumper::MetadataDumper(
 		const std::string& metadataFilename,
 		const std::string& metadataTmpFilename)
 		: useMetarestore_(false),
+		  useFork_(true),
 		  dumpingSucceeded_(true),
 		  dumpingProcessFd_(-1),
 		  dumpingProcessPollFdsPos_(-1),
 		  dumpingProcessOutputEmpty_(true),
+		  progress_{LIZ_METADATA_DUMP_NOT_RUNNING, 0},
 		  metadataFilename_(metadataFilename),
 		  metadataTmpFilename_(metadataTmpFilename) {
 }
@@ -55,9 +62,12 @@ bool MetadataDumper::inProgress() const {
 }
 
 bool MetadataDumper::useMetarestore() const {
-	return useMetarestore_;
+	return useMetarestore_ || !useFork_;
 }
 
+MetadataDumper::Progress MetadataDumper::progress() const {
+	return progress_;
+}
 
 void MetadataDumper::setMetarestorePath(const std::string& path) {
 	metarestorePath_ = path;
@@ -67,30 +77,38 @@ void MetadataDumper::setUseMetarestore(bool useMetarestore) {
 	useMetarestore_ = useMetarestore;
 }
 
+void MetadataDumper::setUseFork(bool useFork) {
+	useFork_ = useFork;
+}
+
 /*
  * Dumping flow:
- * Master creates a child and waits for "OK" or "ERR" message, to see if the dumping  was
+ * Master starts a process and waits for "OK" or "ERR" message, to see if the dumping  was
  * successful and if the metadata checksums (the one passed from master and the one calculated)
- * match. The child is considered dead when poll returns a 0-sized read or an error on pipe.
+ * match. The process is considered dead when poll returns a 0-sized read or an error on pipe.
+ * Before that, the process may report its progress in "PROGRESS <stage> <percent>" lines.
  *
  * Dump begins in fs_storeall(). There are 3 cases here.
  * `dumpType` is the argument for storeall.
  * 1) dumpType == kForegroundDump: foreground dump.
- *    Master calls execMetarestore(), which returns false (no fork).
- * 2) dumpType == kBackgroundDump && (!metarestoreSucceeded_ || !useMetarestore_): background
- *    dump when last metarestore failed or when we don't want to use metarestore for dumping
- *    at all.
+ *    start() returns false and doesn't start any process.
+ * 2) dumpType == kBackgroundDump && (!dumpingSucceeded_ || !useMetarestore_) && useFork_:
+ *    background dump when last metarestore failed or when we don't want to use metarestore
+ *    for dumping at all.
  *    Master tries to fork and its child, (without execing) dumps metadata.
  *    If everything went well, the child prints "OK" (mocking mfsmetarestore's behaviour),
  *    so that master tries to run metarestore the next time (or he won't - useMetarestore_
  *    isn't changed).
- *    execMetarestore() modifies dumpType to kForegroundDump for the child.
- * 3) dumpType == kBackgroundDump && metarestoreSucceeded_ && useMetarestore_: background dump
- *    when we want to use metarestore and it didn't fail last time.
- *    Master forks and executes mfsmetarestore, which checks checksums and prints "OK" or "ERR".
+ *    start() modifies dumpType to kForegroundDump for the child.
+ * 3) dumpType == kBackgroundDump && dumpingSucceeded_ && (useMetarestore_ || !useFork_):
+ *    background dump when we want to use metarestore and it didn't fail last time.
+ *    Master spawns mfsmetarestore (without copying its own address space, which for a big
+ *    master means copying gigabytes of page tables), which replays the rotated changelog
+ *    on the last metadata file, checks checksums and prints "OK" or "ERR".
  *    In case of a syscall error, last metarestore is assumed to have failed
- *    (metarestoreSucceeded_ = false), so that the master dumps its metadata itself.
- *    execMetarestore() modifies dumpType to kForegroundDump for the child.
+ *    (dumpingSucceeded_ = false), so that the master dumps its metadata itself.
+ * If the master isn't allowed to fork (!useFork_) and metarestore can't be used,
+ * it dumps metadata in the foreground.
  */
 
 bool MetadataDumper::start(MetadataDumper::DumpType& dumpType, uint64_t checksum) {
@@ -100,19 +118,29 @@ bool MetadataDumper::start(MetadataDumper::DumpType& dumpType, uint64_t checksum
 
 	int pipeFd[2] = {-1, -1}; // invalid fds
 	dumpingProcessFd_ = -1;
+	bool runMetarestore = (useMetarestore_ || !useFork_) && dumpingSucceeded_;
 	/*
 	 * Changelog files were rotated before entering this function.
 	 * Current changelog is now kChangelogFilename + ".1".
 	 */
 	std::string changelogFilename = kChangelogFilename;
 	changelogFilename += ".1";
-	if (useMetarestore_ && dumpingSucceeded_ && (access(changelogFilename.c_str(), F_OK) == -1)) {
+	if (runMetarestore && (access(changelogFilename.c_str(), F_OK) == -1)) {
 		if (errno == ENOENT || errno == EACCES) {
 			lzfs_pretty_syslog(LOG_ERR, "no current changelog, dump by master");
 		} else {
 			lzfs_pretty_errlog(LOG_ERR, "access error, dump by master");
 		}
 		dumpingSucceeded_ = false;
+		runMetarestore = false;
+	}
+
+	if (!runMetarestore && !useFork_) {
+		lzfs_pretty_syslog(LOG_NOTICE, "can't dump metadata in background without forking, "
+				"foreground dump");
+		dumpType = kForegroundDump;
+		dumpingSucceeded_ = true; // give mfsmetarestore another chance
+		return false;
 	}
 
 	// can't communicate with child? foreground dump
@@ -123,6 +151,25 @@ bool MetadataDumper::start(MetadataDumper::DumpType& dumpType, uint64_t checksum
 		return false;
 	}
 
+	if (runMetarestore) {
+		if (spawnMetarestore(pipeFd, checksum, changelogFilename)) {
+			dumpingProcessOutputEmpty_ = true;
+			dumpingProcessOutput_.clear();
+			progress_ = {LIZ_METADATA_DUMP_STARTED, 0};
+			dumpingSucceeded_ = false;
+			dumpingProcessFd_ = pipeFd[0];
+			close(pipeFd[1]);
+			return false;
+		}
+		if (!useFork_) {
+			dumpType = kForegroundDump;
+			close(pipeFd[0]); // ignore close errors
+			close(pipeFd[1]);
+			return false;
+		}
+		dumpingSucceeded_ = false;
+	}
+
 	// the child process tells the parent process "OK" or "ERR", until then parent assumes "ERR"
 	switch (fork()) {
 		case -1:
@@ -138,30 +185,8 @@ bool MetadataDumper::start(MetadataDumper::DumpType& dumpType, uint64_t checksum
 				// can't give the response
 				lzfs_pretty_errlog(LOG_ERR, "dup2 failed, dump by master");
 				dumpingSucceeded_ = false;
-			}
-			if (useMetarestore_ && dumpingSucceeded_) {
-				// exec mfsmetarestore
-				std::string checksumStringified = std::to_string(checksum);
-				std::string storedMetaCopies = std::to_string(gStoredPreviousBackMetaCopies);
-				char* metarestoreArgs[] = {
-					const_cast<char*>(metarestorePath_.c_str()),
-					const_cast<char*>("-m"),
-					const_cast<char*>(metadataFilename_.c_str()),
-					const_cast<char*>("-o"),
-					const_cast<char*>(metadataTmpFilename_.c_str()),
-					const_cast<char*>("-k"),
-					const_cast<char*>(checksumStringified.c_str()),
-					const_cast<char*>("-B"),
-					const_cast<char*>(storedMetaCopies.c_str()),
-					const_cast<char*>("-#"),
-					const_cast<char*>(changelogFilename.c_str()),
-					NULL};
-				// the default value of the commandline nice
-				if (nice(10) == -1) {
-					lzfs_pretty_errlog(LOG_WARNING, "dumping metadata: nice failed");
-				}
-				execv(metarestorePath_.c_str(), metarestoreArgs);
-				lzfs_pretty_syslog(LOG_WARNING, "exec %s failed: %s", metarestorePath_.c_str(), strerr(errno));
+			} else {
+				fs_set_metadata_progress_callback(reportProgress);
 			}
 			if (useMetarestore_ && !dumpingSucceeded_) {
 				lzfs_pretty_syslog(LOG_NOTICE, "something previously failed, dump by master");
@@ -170,6 +195,8 @@ bool MetadataDumper::start(MetadataDumper::DumpType& dumpType, uint64_t checksum
 			return true;
 		default:
 			dumpingProcessOutputEmpty_ = true;
+			dumpingProcessOutput_.clear();
+			progress_ = {LIZ_METADATA_DUMP_STARTED, 0};
 			dumpingSucceeded_ = false;
 			dumpingProcessFd_ = pipeFd[0];
 			close(pipeFd[1]);
@@ -177,6 +204,51 @@ bool MetadataDumper::start(MetadataDumper::DumpType& dumpType, uint64_t checksum
 	}
 }
 
+bool MetadataDumper::spawnMetarestore(int pipeFd[2], uint64_t checksum,
+		const std::string& changelogFilename) {
+	std::string checksumStringified = std::to_string(checksum);
+	std::string storedMetaCopies = std::to_string(gStoredPreviousBackMetaCopies);
+	char* metarestoreArgs[] = {
+		const_cast<char*>(metarestorePath_.c_str()),
+		const_cast<char*>("-m"),
+		const_cast<char*>(metadataFilename_.c_str()),
+		const_cast<char*>("-o"),
+		const_cast<char*>(metadataTmpFilename_.c_str()),
+		const_cast<char*>("-k"),
+		const_cast<char*>(checksumStringified.c_str()),
+		const_cast<char*>("-B"),
+		const_cast<char*>(storedMetaCopies.c_str()),
+		const_cast<char*>("-P"),
+		const_cast<char*>("-#"),
+		const_cast<char*>(changelogFilename.c_str()),
+		NULL};
+
+	// posix_spawn doesn't copy page tables of the master (unlike fork), so it is cheap
+	// regardless of the amount of metadata kept in memory
+	posix_spawn_file_actions_t actions;
+	if (posix_spawn_file_actions_init(&actions) != 0) {
+		lzfs_pretty_syslog(LOG_ERR, "posix_spawn_file_actions_init failed");
+		return false;
+	}
+	posix_spawn_file_actions_addclose(&actions, pipeFd[0]);
+	posix_spawn_file_actions_adddup2(&actions, pipeFd[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, pipeFd[1]);
+	pid_t pid;
+	int err = posix_spawn(&pid, metarestorePath_.c_str(), &actions, NULL, metarestoreArgs, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (err != 0) {
+		lzfs_pretty_syslog(LOG_WARNING, "exec %s failed: %s", metarestorePath_.c_str(), strerr(err));
+		return false;
+	}
+	// the default value of the commandline nice
+	errno = 0;
+	int priority = getpriority(PRIO_PROCESS, 0);
+	if (errno != 0 || setpriority(PRIO_PROCESS, pid, std::min(priority + 10, 19)) == -1) {
+		lzfs_pretty_errlog(LOG_WARNING, "dumping metadata: setpriority failed");
+	}
+	return true;
+}
+
 // for poll
 void MetadataDumper::pollDesc(std::vector<pollfd> &pdesc) {
 	if (dumpingProcessFd_ != -1) {
@@ -200,12 +272,12 @@ void MetadataDumper::pollServe(const std::vector<pollfd> &pdesc) {
 		} else if (ret == 0) {
 			dumpingFinished();
 		} else {
-			buffer[ret] = '\0';
 			dumpingProcessOutputEmpty_ = false;
-			dumpingSucceeded_ = std::string(buffer) == "OK\n";
-			if (!dumpingSucceeded_) {
-				lzfs_pretty_syslog(LOG_WARNING, "metadata dumping failed: expected 'OK', received '%s'",
-						buffer);
+			dumpingProcessOutput_.append(buffer, ret);
+			std::string::size_type endOfLine;
+			while ((endOfLine = dumpingProcessOutput_.find('\n')) != std::string::npos) {
+				processOutputLine(dumpingProcessOutput_.substr(0, endOfLine));
+				dumpingProcessOutput_.erase(0, endOfLine + 1);
 			}
 		}
 	}
@@ -216,12 +288,30 @@ void MetadataDumper::pollServe(const std::vector<pollfd> &pdesc) {
 	}
 }
 
+void MetadataDumper::processOutputLine(const std::string& line) {
+	unsigned stage, percent;
+	if (sscanf(line.c_str(), "PROGRESS %u %u", &stage, &percent) == 2) {
+		progress_ = {static_cast<uint8_t>(stage), static_cast<uint8_t>(std::min(percent, 100U))};
+		return;
+	}
+	dumpingSucceeded_ = line == "OK";
+	if (!dumpingSucceeded_) {
+		lzfs_pretty_syslog(LOG_WARNING, "metadata dumping failed: expected 'OK', received '%s'",
+				line.c_str());
+	}
+}
+
 void MetadataDumper::dumpingFinished() {
 	if (close(dumpingProcessFd_) == -1) {
 		lzfs_pretty_errlog(LOG_ERR, "pipe close failed");
 	}
+	if (!dumpingProcessOutput_.empty()) {
+		processOutputLine(dumpingProcessOutput_);
+		dumpingProcessOutput_.clear();
+	}
 	dumpingProcessFd_ = -1;
 	dumpingProcessPollFdsPos_ = -1;
+	progress_ = {LIZ_METADATA_DUMP_NOT_RUNNING, 0};
 	if (dumpingProcessOutputEmpty_) {
 		lzfs_pretty_syslog(LOG_WARNING, "the dumping process finished without producing output");
 	}
@@ -22,6 +22,7 @@
 
 #include <errno.h>
 #include <poll.h>
+#include <stdio.h>
 #include <syslog.h>
 #include <unistd.h>
 #include <string>
@@ -29,6 +30,7 @@
 
 #include "common/slogger.h"
 #include "common/time_utils.h"
+#include "protocol/MFSCommunication.h"
 
 class MetadataDumper {
 public:
@@ -37,6 +39,12 @@ public:
 		kBackgroundDump
 	};
 
+	/// Progress of a background dump as reported by the dumping process
+	struct Progress {
+		uint8_t stage;   ///< one of LIZ_METADATA_DUMP_* values
+		uint8_t percent; ///< progress of the current stage
+	};
+
 	MetadataDumper(
 			const std::string& metadataFilename,
 			const std::string& metadataTmpFilename);
@@ -44,10 +52,20 @@ public:
 	bool dumpSucceeded() const;
 	bool inProgress() const;
 	bool useMetarestore() const;
+	Progress progress() const;
 
 	void setMetarestorePath(const std::string& path);
 	void setUseMetarestore(bool val);
 
+	/// if false, background dumps never fork the master (see start())
+	void setUseFork(bool val);
+
+	/// used by the dumping process to report its progress on the standard output
+	static void reportProgress(uint8_t stage, uint8_t percent) {
+		printf("PROGRESS %u %u\n", stage, percent);
+		fflush(stdout);
+	}
+
 	/// returns true and modifies dumpType (to FOREGROUND_DUMP) if we return as a child
 	bool start(DumpType& dumpType, uint64_t checksum);
 
@@ -64,12 +82,21 @@ public:
 protected:
 	void dumpingFinished();
 
+	/// starts mfsmetarestore with its stdout connected to pipeFd[1], returns false on error
+	bool spawnMetarestore(int pipeFd[2], uint64_t checksum, const std::string& changelogFilename);
+
+	/// handles a single line of the output of the dumping process
+	void processOutputLine(const std::string& line);
+
 	/// how long can the decimal representation of a(n) (u)int64 be
 	static const uint32_t kInt64MaxDecimalLength = 21;
 
 	/// should the metarestore be used at all
 	bool useMetarestore_;
 
+	/// may the master fork to dump metadata
+	bool useFork_;
+
 	/// if last dump was unsuccessful, now dump by master
 	bool dumpingSucceeded_;
 
@@ -82,6 +109,11 @@ protected:
 	/// the dumping process has written something
 	bool dumpingProcessOutputEmpty_;
 
+	/// the last, incomplete line of the output of the dumping process
+	std::string dumpingProcessOutput_;
+
+	Progress progress_;
+
 	std::string metarestorePath_;
 	std::string metadataFilename_;
 	std::string metadataTmpFilename_;
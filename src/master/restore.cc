@@ -23,175 +23,263 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 
 #include "protocol/MFSCommunication.h"
+#include "common/changelog_record.h"
+#include "common/datapack.h"
 #include "common/lizardfs_error_codes.h"
 #include "common/slogger.h"
 #include "master/filesystem.h"
 #include "master/filesystem_snapshot.h"
 #include "master/filesystem_operations.h"
 
+namespace {
+
+/*! \brief Position in a changelog entry being restored.
+ *
+ * Works both on text entries and on payloads of binary records (see common/changelog_record.h).
+ * Literal tokens of a payload are read character by character, exactly like a text entry,
+ * while numbers and strings stored in their own tokens are returned without any parsing.
+ * A text entry is handled as a payload consisting of a single literal.
+ */
+class RestoreCursor {
+public:
+	explicit RestoreCursor(const char *text)
+			: literal_(text), literalEnd_(text + strlen(text)), ptr_(nullptr), end_(nullptr),
+			  text_(text), payload_(nullptr), payloadSize_(0) {
+	}
+
+	RestoreCursor(const uint8_t *payload, uint32_t payloadSize)
+			: literal_(nullptr), literalEnd_(nullptr), ptr_(payload), end_(payload + payloadSize),
+			  text_(nullptr), payload_(payload), payloadSize_(payloadSize) {
+		nextLiteral();
+	}
+
+	bool isBinary() const {
+		return payload_ != nullptr;
+	}
+
+	/*! \brief Current character or '\0' at the end of the entry or in front of a typed token. */
+	char peek() const {
+		return literal_ < literalEnd_ ? *literal_ : '\0';
+	}
+
+	bool eat(char c) {
+		if (peek() != c) {
+			return false;
+		}
+		advance(1);
+		return true;
+	}
+
+	bool startsWith(const char *prefix, uint32_t length) const {
+		return (uint32_t)(literalEnd_ - literal_) >= length && memcmp(literal_, prefix, length) == 0;
+	}
+
+	RestoreCursor &skip(uint32_t length) {
+		advance(length);
+		return *this;
+	}
+
+	/*! \brief Reads a number; returns 0 and doesn't move if there is no number. */
+	uint64_t getNumber() {
+		if (literal_ == literalEnd_ && ptr_ < end_) {
+			uint8_t type = *ptr_;
+			uint32_t size = (type == changelog_record::kU64) ? 8 : 4;
+			if ((type == changelog_record::kU32 || type == changelog_record::kInt32
+					|| type == changelog_record::kU64) && end_ - ptr_ > size) {
+				const uint8_t *data = ptr_ + 1;
+				uint64_t value = (size == 8) ? get64bit(&data) : get32bit(&data);
+				ptr_ = data;
+				nextLiteral();
+				return value;
+			}
+			return 0;
+		}
+		uint64_t value = 0;
+		while (peek() >= '0' && peek() <= '9') {
+			value = value * 10 + (peek() - '0');
+			advance(1);
+		}
+		return value;
+	}
+
+	/*! \brief Reads a single character (from a char token or from the text). */
+	bool getChar(char &c) {
+		if (literal_ == literalEnd_ && ptr_ < end_) {
+			if (*ptr_ == changelog_record::kChar && end_ - ptr_ > 1) {
+				c = ptr_[1];
+				ptr_ += 2;
+				nextLiteral();
+				return true;
+			}
+			return false;
+		}
+		if (peek() == '\0') {
+			return false;
+		}
+		c = peek();
+		advance(1);
+		return true;
+	}
+
+	/*! \brief Reads an escaped (see fsnodes_escape_name) string and unescapes it.
+	 *
+	 * The string is either a string token or text up to \p terminator (not consumed).
+	 * \return false if there is an invalid escape sequence
+	 */
+	template <typename Output>
+	bool getEscaped(Output &output, char terminator) {
+		if (literal_ == literalEnd_ && ptr_ < end_) {
+			if (*ptr_ != changelog_record::kString || end_ - ptr_ < 1 + 4) {
+				return true;
+			}
+			const uint8_t *data = ptr_ + 1;
+			uint32_t length = get32bit(&data);
+			if ((uint64_t)(end_ - data) < length) {
+				return false;
+			}
+			const char *str = reinterpret_cast<const char *>(data);
+			ptr_ = data + length;
+			nextLiteral();
+			return unescape(str, str + length, output);
+		}
+		const char *begin = literal_;
+		const char *end = static_cast<const char *>(memchr(begin, terminator, literalEnd_ - begin));
+		if (end == nullptr) {
+			end = literalEnd_;
+		}
+		advance(end - begin);
+		return unescape(begin, end, output);
+	}
+
+	/*! \brief Text of the whole entry, for messages. */
+	std::string entryText() const {
+		if (!isBinary()) {
+			return text_;
+		}
+		std::string text;
+		if (!changelog_record::toText(payload_, payloadSize_, text)) {
+			text = "(malformed binary entry)";
+		}
+		return text;
+	}
+
+	/*! \brief Appends up to kMaxLength characters to a fixed size buffer. */
+	struct NameOutput {
+		static constexpr uint32_t kMaxLength = 255;
+		NameOutput(uint8_t *name) : name(name), length(0) {}
+		void push_back(char c) {
+			if (length < kMaxLength) {
+				name[length++] = c;
+			}
+		}
+		uint8_t *name;
+		uint32_t length;
+	};
+
+private:
+	template <typename Output>
+	static bool unescape(const char *str, const char *end, Output &output) {
+		for (; str < end; ++str) {
+			if (*str != '%') {
+				output.push_back(*str);
+				continue;
+			}
+			if (end - str < 3) {
+				return false;
+			}
+			int high = hexValue(str[1]);
+			int low = hexValue(str[2]);
+			if (high < 0 || low < 0) {
+				return false;
+			}
+			output.push_back(high * 16 + low);
+			str += 2;
+		}
+		return true;
+	}
+
+	static int hexValue(char c) {
+		if (c >= '0' && c <= '9') {
+			return c - '0';
+		} else if (c >= 'A' && c <= 'F') {
+			return c - 'A' + 10;
+		}
+		return -1;
+	}
+
+	void advance(uint32_t length) {
+		literal_ += length;
+		if (literal_ == literalEnd_) {
+			nextLiteral();
+		}
+	}
+
+	/*! \brief If the current literal is finished and a literal token follows, starts reading it. */
+	void nextLiteral() {
+		while (literal_ == literalEnd_ && end_ - ptr_ >= 1 + 2 && *ptr_ == changelog_record::kLiteral) {
+			const uint8_t *data = ptr_ + 1;
+			uint16_t length = get16bit(&data);
+			if (end_ - data < length) {
+				ptr_ = end_;
+				return;
+			}
+			literal_ = reinterpret_cast<const char *>(data);
+			literalEnd_ = literal_ + length;
+			ptr_ = data + length;
+		}
+	}
+
+	const char *literal_;     // current position in the current literal
+	const char *literalEnd_;
+	const uint8_t *ptr_;      // the next token of a payload
+	const uint8_t *end_;
+	const char *text_;
+	const uint8_t *payload_;
+	uint32_t payloadSize_;
+};
+
+} // anonymous namespace
+
 #define EAT(clptr,fn,vno,c) { \
-	if (*(clptr)!=(c)) { \
+	if (!(clptr).eat(c)) { \
 		lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": '%c' expected", (fn), (vno), (c)); \
 		return -1; \
 	} \
-	(clptr)++; \
 }
 
 #define GETNAME(name,clptr,fn,vno,c) { \
-	uint32_t _tmp_i; \
-	char _tmp_c,_tmp_h1,_tmp_h2; \
-	memset((void*)(name),0,256); \
-	_tmp_i = 0; \
-	while ((_tmp_c=*((clptr)++))!=c && _tmp_i<255) { \
-		if (_tmp_c=='%') { \
-			_tmp_h1 = *((clptr)++); \
-			_tmp_h2 = *((clptr)++); \
-			if (_tmp_h1>='0' && _tmp_h1<='9') { \
-				_tmp_h1-='0'; \
-			} else if (_tmp_h1>='A' && _tmp_h1<='F') { \
-				_tmp_h1-=('A'-10); \
-			} else { \
-				lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
-				return -1; \
-			} \
-			if (_tmp_h2>='0' && _tmp_h2<='9') { \
-				_tmp_h2-='0'; \
-			} else if (_tmp_h2>='A' && _tmp_h2<='F') { \
-				_tmp_h2-=('A'-10); \
-			} else { \
-				lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
-				return -1; \
-			} \
-			_tmp_c = _tmp_h1*16+_tmp_h2; \
-		} \
-		name[_tmp_i++] = _tmp_c; \
+	RestoreCursor::NameOutput _tmp_output(name); \
+	if (!(clptr).getEscaped(_tmp_output, (c))) { \
+		lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
+		return -1; \
 	} \
-	(clptr)--; \
-	name[_tmp_i]=0; \
+	(name)[_tmp_output.length] = 0; \
 }
 
-#define GETPATH(path,size,clptr,fn,vno,c) { \
-	uint32_t _tmp_i; \
-	char _tmp_c,_tmp_h1,_tmp_h2; \
-	_tmp_i = 0; \
-	while ((_tmp_c=*((clptr)++))!=c) { \
-		if (_tmp_c=='%') { \
-			_tmp_h1 = *((clptr)++); \
-			_tmp_h2 = *((clptr)++); \
-			if (_tmp_h1>='0' && _tmp_h1<='9') { \
-				_tmp_h1-='0'; \
-			} else if (_tmp_h1>='A' && _tmp_h1<='F') { \
-				_tmp_h1-=('A'-10); \
-			} else { \
-				lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
-				return -1; \
-			} \
-			if (_tmp_h2>='0' && _tmp_h2<='9') { \
-				_tmp_h2-='0'; \
-			} else if (_tmp_h2>='A' && _tmp_h2<='F') { \
-				_tmp_h2-=('A'-10); \
-			} else { \
-				lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
-				return -1; \
-			} \
-			_tmp_c = _tmp_h1*16+_tmp_h2; \
-		} \
-		if ((_tmp_i)>=(size)) { \
-			(size) = _tmp_i+1000; \
-			if ((path)==NULL) { \
-				(path) = (uint8_t*)malloc(size); \
-			} else { \
-				uint8_t *_tmp_path = (path); \
-				(path) = (uint8_t*)realloc((path),(size)); \
-				if ((path)==NULL) { \
-					free(_tmp_path); \
-				} \
-			} \
-			if ((path)==NULL) { \
-				lzfs_pretty_syslog(LOG_ERR, "out of memory"); \
-				exit(1); \
-			} \
-		} \
-		(path)[_tmp_i++]=_tmp_c; \
-	} \
-	if ((_tmp_i)>=(size)) { \
-		(size) = _tmp_i+1000; \
-		if ((path)==NULL) { \
-			(path) = (uint8_t*)malloc(size); \
-		} else { \
-			uint8_t *_tmp_path = (path); \
-			(path) = (uint8_t*)realloc((path),(size)); \
-			if ((path)==NULL) { \
-				free(_tmp_path); \
-			} \
-		} \
-		if ((path)==NULL) { \
-			lzfs_pretty_syslog(LOG_ERR, "out of memory"); \
-			exit(1); \
-		} \
+#define GETDATA(data,clptr,fn,vno,c) { \
+	(data).clear(); \
+	if (!(clptr).getEscaped((data), (c))) { \
+		lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
+		return -1; \
 	} \
-	(clptr)--; \
-	(path)[_tmp_i]=0; \
 }
 
-#define GETDATA(buff,leng,size,clptr,fn,vno,c) { \
-	char _tmp_c,_tmp_h1,_tmp_h2; \
-	(leng) = 0; \
-	while ((_tmp_c=*((clptr)++))!=c) { \
-		if (_tmp_c=='%') { \
-			_tmp_h1 = *((clptr)++); \
-			_tmp_h2 = *((clptr)++); \
-			if (_tmp_h1>='0' && _tmp_h1<='9') { \
-				_tmp_h1-='0'; \
-			} else if (_tmp_h1>='A' && _tmp_h1<='F') { \
-				_tmp_h1-=('A'-10); \
-			} else { \
-				lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
-				return -1; \
-			} \
-			if (_tmp_h2>='0' && _tmp_h2<='9') { \
-				_tmp_h2-='0'; \
-			} else if (_tmp_h2>='A' && _tmp_h2<='F') { \
-				_tmp_h2-=('A'-10); \
-			} else { \
-				lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": hex expected", (fn), (vno)); \
-				return -1; \
-			} \
-			_tmp_c = _tmp_h1*16+_tmp_h2; \
-		} \
-		if ((leng)>=(size)) { \
-			(size) = (leng)+1000; \
-			if ((buff)==NULL) { \
-				(buff) = (uint8_t*)malloc(size); \
-			} else { \
-				uint8_t *_tmp_buff = (buff); \
-				(buff) = (uint8_t*)realloc((buff),(size)); \
-				if ((buff)==NULL) { \
-					free(_tmp_buff); \
-				} \
-			} \
-			if ((buff)==NULL) { \
-				lzfs_pretty_syslog(LOG_ERR, "out of memory"); \
-				exit(1); \
-			} \
-		} \
-		(buff)[(leng)++]=_tmp_c; \
-	} \
-	(clptr)--; \
-}
+#define GETPATH(path,clptr,fn,vno,c) GETDATA(path,clptr,fn,vno,c)
 
 #define GETCHAR(data,clptr) { \
-	if (*(clptr)) { \
-		(data) = *((clptr)++); \
+	char _tmp_c; \
+	if ((clptr).getChar(_tmp_c)) { \
+		(data) = _tmp_c; \
 	} \
 }
 
-#define GETU32(data,clptr) do { char* end_ = NULL; (data)=strtoul(clptr,&end_,10); clptr = end_; } while (0)
-#define GETU64(data,clptr) do { char* end_ = NULL; (data)=strtoull(clptr,&end_,10); clptr = end_; } while (0)
+#define GETU32(data,clptr) do { (data) = (clptr).getNumber(); } while (0)
+#define GETU64(data,clptr) do { (data) = (clptr).getNumber(); } while (0)
 
-int do_access(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_access(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -199,7 +287,7 @@ int do_access(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 	return fs_apply_access(ts,inode);
 }
 
-int do_append(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_append(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,inode_src;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -209,7 +297,7 @@ int do_append(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 	return fs_append(FsContext::getForRestore(ts), inode, inode_src);
 }
 
-int do_acquire(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_acquire(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,cuid;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -219,7 +307,7 @@ int do_acquire(const char *filename, uint64_t lv, uint32_t ts, const char *ptr)
 	return fs_acquire(FsContext::getForRestore(ts), inode, cuid);
 }
 
-int do_attr(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_attr(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,mode,uid,gid,atime,mtime;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -237,7 +325,7 @@ int do_attr(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 	return fs_apply_attr(ts,inode,mode,uid,gid,atime,mtime);
 }
 
-int do_checksum(const char *filename, uint64_t lv, uint32_t, const char *ptr) {
+int do_checksum(const char *filename, uint64_t lv, uint32_t, RestoreCursor &ptr) {
 	uint8_t version[256];
 	uint64_t checksum;
 	EAT(ptr,filename,lv,'(');
@@ -248,7 +336,7 @@ int do_checksum(const char *filename, uint64_t lv, uint32_t, const char *ptr) {
 	return fs_apply_checksum((char*)&version, checksum);
 }
 
-int do_create(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_create(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t parent,mode,uid,gid,rdev,inode;
 	uint8_t type,name[256];
 	EAT(ptr,filename,lv,'(');
@@ -256,8 +344,7 @@ int do_create(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 	EAT(ptr,filename,lv,',');
 	GETNAME(name,ptr,filename,lv,',');
 	EAT(ptr,filename,lv,',');
-	type = *ptr;
-	ptr++;
+	GETCHAR(type,ptr);
 	EAT(ptr,filename,lv,',');
 	GETU32(mode,ptr);
 	EAT(ptr,filename,lv,',');
@@ -272,7 +359,7 @@ int do_create(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 	return fs_apply_create(ts, parent, HString((const char*)name), type, mode, uid, gid, rdev, inode);
 }
 
-int do_session(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_session(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t cuid;
 	(void)ts;
 	EAT(ptr,filename,lv,'(');
@@ -282,7 +369,7 @@ int do_session(const char *filename, uint64_t lv, uint32_t ts, const char *ptr)
 	return fs_apply_session(cuid);
 }
 
-int do_emptytrash_deprecated(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_emptytrash_deprecated(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t reservedinodes,freeinodes;
 	EAT(ptr,filename,lv,'(');
 	EAT(ptr,filename,lv,')');
@@ -293,7 +380,7 @@ int do_emptytrash_deprecated(const char *filename, uint64_t lv, uint32_t ts, con
 	return fs_apply_emptytrash_deprecated(ts,freeinodes,reservedinodes);
 }
 
-int do_emptyreserved_deprecated(const char *filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_emptyreserved_deprecated(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t freeinodes;
 	EAT(ptr,filename,lv,'(');
 	EAT(ptr,filename,lv,')');
@@ -302,7 +389,7 @@ int do_emptyreserved_deprecated(const char *filename, uint64_t lv, uint32_t ts,
 	return fs_apply_emptyreserved_deprecated(ts,freeinodes);
 }
 
-int do_freeinodes(const char *filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_freeinodes(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t freeinodes;
 	EAT(ptr,filename,lv,'(');
 	EAT(ptr,filename,lv,')');
@@ -311,7 +398,7 @@ int do_freeinodes(const char *filename, uint64_t lv, uint32_t ts, const char* pt
 	return fs_apply_freeinodes(ts,freeinodes);
 }
 
-int do_incversion(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_incversion(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint64_t chunkid;
 	(void)ts;
 	EAT(ptr,filename,lv,'(');
@@ -320,7 +407,7 @@ int do_incversion(const char *filename, uint64_t lv, uint32_t ts, const char *pt
 	return fs_apply_incversion(chunkid);
 }
 
-int do_link(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_link(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,parent;
 	uint8_t name[256];
 	EAT(ptr,filename,lv,'(');
@@ -334,7 +421,7 @@ int do_link(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 			nullptr, nullptr);
 }
 
-int do_length(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_length(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
 	uint64_t length;
 	EAT(ptr,filename,lv,'(');
@@ -345,7 +432,7 @@ int do_length(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
 	return fs_apply_length(ts,inode,length);
 }
 
-int do_move(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_move(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,parent_src,parent_dst;
 	uint8_t name_src[256],name_dst[256];
 	EAT(ptr,filename,lv,'(');
@@ -365,7 +452,7 @@ int do_move(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 			&inode, nullptr);
 }
 
-int do_lock_op(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_lock_op(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t lock_type, inode, sessionid;
 	uint64_t start, end;
 	uint64_t owner;
@@ -410,7 +497,7 @@ int do_lock_op(const char *filename, uint64_t lv, uint32_t ts, const char *ptr)
 	return status;
 }
 
-int do_remove_pending_op(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_remove_pending_op(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t lock_type;
 	uint64_t ownerid;
 	uint32_t sessionid;
@@ -433,7 +520,7 @@ int do_remove_pending_op(const char *filename, uint64_t lv, uint32_t ts, const c
 		inode, reqid);
 }
 
-int do_lock_clear_session(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_lock_clear_session(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t lock_type, inode, sessionid;
 	std::vector<FileLocks::Owner> applied;
 
@@ -448,7 +535,7 @@ int do_lock_clear_session(const char *filename, uint64_t lv, uint32_t ts, const
 	return fs_locks_clear_session(FsContext::getForRestore(ts), lock_type, inode, sessionid, applied);
 }
 
-int do_lock_unlock_inode(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_lock_unlock_inode(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t lock_type, inode;
 	std::vector<FileLocks::Owner> applied;
 
@@ -461,7 +548,7 @@ int do_lock_unlock_inode(const char *filename, uint64_t lv, uint32_t ts, const c
 	return fs_locks_unlock_inode(FsContext::getForRestore(ts), lock_type, inode, applied);
 }
 
-int do_purge(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_purge(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -469,7 +556,7 @@ int do_purge(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_purge(FsContext::getForRestore(ts), inode);
 }
 
-int do_release(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_release(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,cuid;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -479,7 +566,7 @@ int do_release(const char* filename, uint64_t lv, uint32_t ts, const char* ptr)
 	return fs_release(FsContext::getForRestore(ts), inode, cuid);
 }
 
-int do_repair(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_repair(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,indx;
 	uint32_t version;
 	EAT(ptr,filename,lv,'(');
@@ -492,7 +579,7 @@ int do_repair(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_apply_repair(ts,inode,indx,version);
 }
 
-int do_seteattr(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_seteattr(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,uid,ci,nci,npi;
 	uint8_t eattr,smode;
 	EAT(ptr,filename,lv,'(');
@@ -513,7 +600,7 @@ int do_seteattr(const char* filename, uint64_t lv, uint32_t ts, const char* ptr)
 	return fs_seteattr(FsContext::getForRestoreWithUidGid(ts, uid, 0), inode, eattr, smode, &ci, &nci, &npi);
 }
 
-int do_setgoal(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_setgoal(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode, uid, ci, nci, npi;
 	uint8_t goal, smode;
 	EAT(ptr, filename, lv, '(');
@@ -525,10 +612,10 @@ int do_setgoal(const char *filename, uint64_t lv, uint32_t ts, const char *ptr)
 	EAT(ptr, filename, lv, ',');
 	GETU32(smode, ptr);
 	EAT(ptr, filename, lv, ')');
-	if (*(ptr) == ':') {
+	if (ptr.peek() == ':') {
 		EAT(ptr, filename, lv, ':');
 		GETU32(ci, ptr);
-		if (*(ptr) == ',') {
+		if (ptr.peek() == ',') {
 			EAT(ptr, filename, lv, ',');
 			GETU32(nci, ptr);
 			EAT(ptr, filename, lv, ',');
@@ -545,19 +632,18 @@ int do_setgoal(const char *filename, uint64_t lv, uint32_t ts, const char *ptr)
 	}
 }
 
-int do_setpath(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_setpath(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
-	static uint8_t *path = NULL;
-	static uint32_t pathsize = 0;
+	static std::string path;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
 	EAT(ptr,filename,lv,',');
-	GETPATH(path,pathsize,ptr,filename,lv,')');
+	GETPATH(path,ptr,filename,lv,')');
 	EAT(ptr,filename,lv,')');
-	return fs_settrashpath(FsContext::getForRestore(ts), inode, std::string((const char*)path));
+	return fs_settrashpath(FsContext::getForRestore(ts), inode, std::string(path.c_str()));
 }
 
-int do_settrashtime(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_settrashtime(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode, uid, ci, nci, npi;
 	uint32_t trashtime;
 	uint8_t smode;
@@ -570,10 +656,10 @@ int do_settrashtime(const char *filename, uint64_t lv, uint32_t ts, const char *
 	EAT(ptr, filename, lv, ',');
 	GETU32(smode, ptr);
 	EAT(ptr, filename, lv, ')');
-	if ((*ptr) == ':') {
+	if (ptr.peek() == ':') {
 		EAT(ptr, filename, lv, ':');
 		GETU32(ci, ptr);
-		if ((*ptr) == ',') {
+		if (ptr.peek() == ',') {
 			EAT(ptr, filename, lv, ',');
 			GETU32(nci, ptr);
 			EAT(ptr, filename, lv, ',');
@@ -591,24 +677,24 @@ int do_settrashtime(const char *filename, uint64_t lv, uint32_t ts, const char *
 	}
 }
 
-int do_setxattr(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
-	uint32_t inode,valueleng,mode;
+int do_setxattr(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
+	uint32_t inode,mode;
 	uint8_t name[256];
-	static uint8_t *value = NULL;
-	static uint32_t valuesize = 0;
+	static std::string value;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
 	EAT(ptr,filename,lv,',');
 	GETNAME(name,ptr,filename,lv,',');
 	EAT(ptr,filename,lv,',');
-	GETDATA(value,valueleng,valuesize,ptr,filename,lv,',');
+	GETDATA(value,ptr,filename,lv,',');
 	EAT(ptr,filename,lv,',');
 	GETU32(mode,ptr);
 	EAT(ptr,filename,lv,')');
-	return fs_apply_setxattr(ts,inode,strlen((char*)name),name,valueleng,value,mode);
+	return fs_apply_setxattr(ts,inode,strlen((char*)name),name,value.size(),
+			(const uint8_t*)value.data(),mode);
 }
 
-int do_deleteacl(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_deleteacl(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
 	char aclTypeRaw = '\0';
 
@@ -631,38 +717,36 @@ int do_deleteacl(const char *filename, uint64_t lv, uint32_t ts, const char *ptr
 	return fs_deleteacl(FsContext::getForRestore(ts), inode, aclType);
 }
 
-int do_setacl(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_setacl(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
 	char aclType = '\0';
-	static uint8_t *aclString = NULL;
-	static uint32_t aclSize = 0;
+	static std::string aclString;
 
 	EAT(ptr, filename, lv, '(');
 	GETU32(inode, ptr);
 	EAT(ptr, filename, lv, ',');
 	GETCHAR(aclType, ptr);
 	EAT(ptr, filename, lv, ',');
-	GETPATH(aclString, aclSize, ptr, filename, lv, ')');
+	GETPATH(aclString, ptr, filename, lv, ')');
 	EAT(ptr, filename, lv, ')');
 
-	return fs_apply_setacl(ts, inode, aclType, reinterpret_cast<const char*>(aclString));
+	return fs_apply_setacl(ts, inode, aclType, aclString.c_str());
 }
 
-int do_setrichacl(const char *filename, uint64_t lv, uint32_t ts, const char *ptr) {
+int do_setrichacl(const char *filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
-	static uint8_t *acl_string = NULL;
-	static uint32_t acl_size = 0;
+	static std::string acl_string;
 
 	EAT(ptr, filename, lv, '(');
 	GETU32(inode, ptr);
 	EAT(ptr, filename, lv, ',');
-	GETPATH(acl_string, acl_size, ptr, filename, lv, ')');
+	GETPATH(acl_string, ptr, filename, lv, ')');
 	EAT(ptr, filename, lv, ')');
 
-	return fs_apply_setrichacl(ts, inode, reinterpret_cast<const char*>(acl_string));
+	return fs_apply_setrichacl(ts, inode, acl_string.c_str());
 }
 
-int do_setquota(const char *filename, uint64_t lv, uint32_t, const char *ptr) {
+int do_setquota(const char *filename, uint64_t lv, uint32_t, RestoreCursor &ptr) {
 	char rigor = '\0', resource = '\0', ownerType = '\0';
 	uint32_t ownerId;
 	uint64_t limit;
@@ -682,12 +766,12 @@ int do_setquota(const char *filename, uint64_t lv, uint32_t, const char *ptr) {
 	return fs_apply_setquota(rigor, resource, ownerType, ownerId, limit);
 }
 
-int do_snapshot(const char* /*filename*/, uint64_t /*lv*/, uint32_t /*ts*/, const char* /*ptr*/) {
+int do_snapshot(const char* /*filename*/, uint64_t /*lv*/, uint32_t /*ts*/, RestoreCursor & /*ptr*/) {
 	lzfs_pretty_syslog(LOG_ERR, "Trying to execute deprecated do_snapshot");
 	return -1;
 }
 
-int do_clone_node(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_clone_node(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t src_inode, dst_parent, dst_inode, can_overwrite;
 	uint8_t name[256];
 	EAT(ptr,filename,lv,'(');
@@ -705,17 +789,16 @@ int do_clone_node(const char* filename, uint64_t lv, uint32_t ts, const char* pt
 				HString((const char*)name), can_overwrite);
 }
 
-int do_symlink(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_symlink(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t parent,uid,gid,inode;
 	uint8_t name[256];
-	static uint8_t *path = NULL;
-	static uint32_t pathsize = 0;
+	static std::string path;
 	EAT(ptr,filename,lv,'(');
 	GETU32(parent,ptr);
 	EAT(ptr,filename,lv,',');
 	GETNAME(name,ptr,filename,lv,',');
 	EAT(ptr,filename,lv,',');
-	GETPATH(path,pathsize,ptr,filename,lv,',');
+	GETPATH(path,ptr,filename,lv,',');
 	EAT(ptr,filename,lv,',');
 	GETU32(uid,ptr);
 	EAT(ptr,filename,lv,',');
@@ -724,10 +807,10 @@ int do_symlink(const char* filename, uint64_t lv, uint32_t ts, const char* ptr)
 	EAT(ptr,filename,lv,':');
 	GETU32(inode,ptr);
 	return fs_symlink(FsContext::getForRestoreWithUidGid(ts, uid, gid),
-			parent, HString((char*)name), std::string((char*)path), &inode, nullptr);
+			parent, HString((char*)name), std::string(path.c_str()), &inode, nullptr);
 }
 
-int do_undel(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_undel(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
@@ -735,7 +818,7 @@ int do_undel(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_undel(FsContext::getForRestore(ts), inode);
 }
 
-int do_unlink(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_unlink(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,parent;
 	uint8_t name[256];
 	EAT(ptr,filename,lv,'(');
@@ -748,7 +831,7 @@ int do_unlink(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_apply_unlink(ts, parent, HString((char*)name), inode);
 }
 
-int do_unlock(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_unlock(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint64_t chunkid;
 	(void)ts;
 	EAT(ptr,filename,lv,'(');
@@ -757,7 +840,7 @@ int do_unlock(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_apply_unlock(chunkid);
 }
 
-int do_nextchunkid(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_nextchunkid(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint64_t nextChunkId;
 	EAT(ptr, filename, lv, '(');
 	GETU64(nextChunkId, ptr);
@@ -766,14 +849,14 @@ int do_nextchunkid(const char* filename, uint64_t lv, uint32_t ts, const char* p
 }
 
 
-int do_trunc(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_trunc(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,indx,lockid;
 	uint64_t chunkid;
 	EAT(ptr,filename,lv,'(');
 	GETU32(inode,ptr);
 	EAT(ptr,filename,lv,',');
 	GETU32(indx,ptr);
-	if (*ptr==',') {
+	if (ptr.peek()==',') {
 		EAT(ptr,filename,lv,',');
 		GETU32(lockid,ptr);
 	} else {
@@ -785,7 +868,7 @@ int do_trunc(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_apply_trunc(ts,inode,indx,chunkid,lockid);
 }
 
-int do_write(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
+int do_write(const char* filename, uint64_t lv, uint32_t ts, RestoreCursor &ptr) {
 	uint32_t inode,indx;
 	uint64_t chunkid;
 	uint32_t lockid;
@@ -794,13 +877,13 @@ int do_write(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	GETU32(inode,ptr);
 	EAT(ptr,filename,lv,',');
 	GETU32(indx,ptr);
-	if (*ptr==',') {
+	if (ptr.peek()==',') {
 		EAT(ptr,filename,lv,',');
 		GETU32(opflag,ptr);
 	} else {
 		opflag=1;
 	}
-	if (*ptr==',') {
+	if (ptr.peek()==',') {
 		EAT(ptr,filename,lv,',');
 		GETU32(lockid,ptr);
 	} else {
@@ -812,143 +895,143 @@ int do_write(const char* filename, uint64_t lv, uint32_t ts, const char* ptr) {
 	return fs_writechunk(FsContext::getForRestore(ts), inode, indx, false, &lockid, &chunkid, &opflag, nullptr);
 }
 
-int restore_line(const char* filename, uint64_t lv, const char* line) {
+int restore_line(const char* filename, uint64_t lv, RestoreCursor &ptr) {
 	uint32_t ts;
 	int status;
 
 	status = LIZARDFS_ERROR_MAX;
-	const char* ptr = line;
-
-	EAT(ptr,filename,lv,':');
-	EAT(ptr,filename,lv,' ');
+	if (!ptr.isBinary()) {
+		EAT(ptr,filename,lv,':');
+		EAT(ptr,filename,lv,' ');
+	}
 	GETU32(ts,ptr);
 	EAT(ptr,filename,lv,'|');
-	switch (*ptr) {
+	switch (ptr.peek()) {
 		case 'A':
-			if (strncmp(ptr,"ACCESS",6)==0) {
-				status = do_access(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"ATTR",4)==0) {
-				status = do_attr(filename,lv,ts,ptr+4);
-			} else if (strncmp(ptr,"APPEND",6)==0) {
-				status = do_append(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"ACQUIRE",7)==0) {
-				status = do_acquire(filename,lv,ts,ptr+7);
-			} else if (strncmp(ptr,"AQUIRE",6)==0) {
-				status = do_acquire(filename,lv,ts,ptr+6);
+			if (ptr.startsWith("ACCESS",6)) {
+				status = do_access(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("ATTR",4)) {
+				status = do_attr(filename,lv,ts,ptr.skip(4));
+			} else if (ptr.startsWith("APPEND",6)) {
+				status = do_append(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("ACQUIRE",7)) {
+				status = do_acquire(filename,lv,ts,ptr.skip(7));
+			} else if (ptr.startsWith("AQUIRE",6)) {
+				status = do_acquire(filename,lv,ts,ptr.skip(6));
 			}
 			break;
 		case 'C':
-			if (strncmp(ptr,"CHECKSUM",8)==0) {
-				status = do_checksum(filename,lv,ts,ptr+8);
-			} else if (strncmp(ptr,"CLONE",5)==0) {
-				status = do_clone_node(filename,lv,ts,ptr+5);
-			} else if (strncmp(ptr,"CREATE",6)==0) {
-				status = do_create(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"CUSTOMER",8)==0) {      // deprecated
-				status = do_session(filename,lv,ts,ptr+8);
-			} else if (strncmp(ptr,"CLRLCK",6)==0) {
-				status = do_lock_clear_session(filename,lv,ts,ptr+6);
+			if (ptr.startsWith("CHECKSUM",8)) {
+				status = do_checksum(filename,lv,ts,ptr.skip(8));
+			} else if (ptr.startsWith("CLONE",5)) {
+				status = do_clone_node(filename,lv,ts,ptr.skip(5));
+			} else if (ptr.startsWith("CREATE",6)) {
+				status = do_create(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("CUSTOMER",8)) {      // deprecated
+				status = do_session(filename,lv,ts,ptr.skip(8));
+			} else if (ptr.startsWith("CLRLCK",6)) {
+				status = do_lock_clear_session(filename,lv,ts,ptr.skip(6));
 			}
 			break;
 		case 'D':
-			if (strncmp(ptr,"DELETEACL",9)==0) {
-				status = do_deleteacl(filename,lv,ts,ptr+9);
+			if (ptr.startsWith("DELETEACL",9)) {
+				status = do_deleteacl(filename,lv,ts,ptr.skip(9));
 			}
 			break;
 		case 'E':
-			if (strncmp(ptr,"EMPTYTRASH",10)==0) {
-				status = do_emptytrash_deprecated(filename,lv,ts,ptr+10);
-			} else if (strncmp(ptr,"EMPTYRESERVED",13)==0) {
-				status = do_emptyreserved_deprecated(filename,lv,ts,ptr+13);
+			if (ptr.startsWith("EMPTYTRASH",10)) {
+				status = do_emptytrash_deprecated(filename,lv,ts,ptr.skip(10));
+			} else if (ptr.startsWith("EMPTYRESERVED",13)) {
+				status = do_emptyreserved_deprecated(filename,lv,ts,ptr.skip(13));
 			}
 			break;
 		case 'F':
-			if (strncmp(ptr,"FLCKINODE",9)==0) {
-				status = do_lock_unlock_inode(filename,lv,ts,ptr+9);
-			} else if (strncmp(ptr, "FLCK", 4) == 0) {
-				status = do_lock_op(filename,lv,ts,ptr+4);
-			} else if (strncmp(ptr, "FREEINODES", 10) == 0) {
-				status = do_freeinodes(filename,lv,ts,ptr+10);
+			if (ptr.startsWith("FLCKINODE",9)) {
+				status = do_lock_unlock_inode(filename,lv,ts,ptr.skip(9));
+			} else if (ptr.startsWith("FLCK",4)) {
+				status = do_lock_op(filename,lv,ts,ptr.skip(4));
+			} else if (ptr.startsWith("FREEINODES",10)) {
+				status = do_freeinodes(filename,lv,ts,ptr.skip(10));
 			}
 			break;
 		case 'I':
-			if (strncmp(ptr,"INCVERSION",10)==0) {
-				status = do_incversion(filename,lv,ts,ptr+10);
+			if (ptr.startsWith("INCVERSION",10)) {
+				status = do_incversion(filename,lv,ts,ptr.skip(10));
 			}
 			break;
 		case 'L':
-			if (strncmp(ptr,"LENGTH",6)==0) {
-				status = do_length(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"LINK",4)==0) {
-				status = do_link(filename,lv,ts,ptr+4);
+			if (ptr.startsWith("LENGTH",6)) {
+				status = do_length(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("LINK",4)) {
+				status = do_link(filename,lv,ts,ptr.skip(4));
 			}
 			break;
 		case 'M':
-			if (strncmp(ptr,"MOVE",4)==0) {
-				status = do_move(filename,lv,ts,ptr+4);
+			if (ptr.startsWith("MOVE",4)) {
+				status = do_move(filename,lv,ts,ptr.skip(4));
 			}
 			break;
 		case 'N':
-			if (strncmp(ptr, "NEXTCHUNKID", 11) == 0) {
-				status = do_nextchunkid(filename,lv,ts,ptr + 11);
+			if (ptr.startsWith("NEXTCHUNKID",11)) {
+				status = do_nextchunkid(filename,lv,ts,ptr.skip(11));
 			}
 			break;
 		case 'P':
-			if (strncmp(ptr,"PURGE",5)==0) {
-				status = do_purge(filename,lv,ts,ptr+5);
+			if (ptr.startsWith("PURGE",5)) {
+				status = do_purge(filename,lv,ts,ptr.skip(5));
 			}
 			break;
 		case 'R':
-			if (strncmp(ptr,"RELEASE",7)==0) {
-				status = do_release(filename,lv,ts,ptr+7);
-			} else if (strncmp(ptr,"REPAIR",6)==0) {
-				status = do_repair(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"RMPLOCK",7)==0) {
-				status = do_remove_pending_op(filename,lv,ts,ptr+7);
+			if (ptr.startsWith("RELEASE",7)) {
+				status = do_release(filename,lv,ts,ptr.skip(7));
+			} else if (ptr.startsWith("REPAIR",6)) {
+				status = do_repair(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("RMPLOCK",7)) {
+				status = do_remove_pending_op(filename,lv,ts,ptr.skip(7));
 			}
 			break;
 		case 'S':
-			if (strncmp(ptr,"SESSION",7)==0) {
-				status = do_session(filename,lv,ts,ptr+7);
-			} else if (strncmp(ptr,"SETACL",6)==0) {
-				status = do_setacl(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"SETEATTR",8)==0) {
-				status = do_seteattr(filename,lv,ts,ptr+8);
-			} else if (strncmp(ptr,"SETGOAL",7)==0) {
-				status = do_setgoal(filename,lv,ts,ptr+7);
-			} else if (strncmp(ptr,"SETPATH",7)==0) {
-				status = do_setpath(filename,lv,ts,ptr+7);
-			} else if (strncmp(ptr,"SETQUOTA",8)==0) {
-				status = do_setquota(filename,lv,ts,ptr+8);
-			} else if (strncmp(ptr,"SETTRASHTIME",12)==0) {
-				status = do_settrashtime(filename,lv,ts,ptr+12);
-			} else if (strncmp(ptr,"SETXATTR",8)==0) {
-				status = do_setxattr(filename,lv,ts,ptr+8);
-			} else if (strncmp(ptr,"SNAPSHOT",8)==0) {    // deprecated
-				status = do_snapshot(filename,lv,ts,ptr+8);
-			} else if (strncmp(ptr,"SYMLINK",7)==0) {
-				status = do_symlink(filename,lv,ts,ptr+7);
-			} else if (strncmp(ptr,"SETRICHACL",10)==0) {
-				status = do_setrichacl(filename,lv,ts,ptr+10);
+			if (ptr.startsWith("SESSION",7)) {
+				status = do_session(filename,lv,ts,ptr.skip(7));
+			} else if (ptr.startsWith("SETACL",6)) {
+				status = do_setacl(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("SETEATTR",8)) {
+				status = do_seteattr(filename,lv,ts,ptr.skip(8));
+			} else if (ptr.startsWith("SETGOAL",7)) {
+				status = do_setgoal(filename,lv,ts,ptr.skip(7));
+			} else if (ptr.startsWith("SETPATH",7)) {
+				status = do_setpath(filename,lv,ts,ptr.skip(7));
+			} else if (ptr.startsWith("SETQUOTA",8)) {
+				status = do_setquota(filename,lv,ts,ptr.skip(8));
+			} else if (ptr.startsWith("SETTRASHTIME",12)) {
+				status = do_settrashtime(filename,lv,ts,ptr.skip(12));
+			} else if (ptr.startsWith("SETXATTR",8)) {
+				status = do_setxattr(filename,lv,ts,ptr.skip(8));
+			} else if (ptr.startsWith("SNAPSHOT",8)) {    // deprecated
+				status = do_snapshot(filename,lv,ts,ptr.skip(8));
+			} else if (ptr.startsWith("SYMLINK",7)) {
+				status = do_symlink(filename,lv,ts,ptr.skip(7));
+			} else if (ptr.startsWith("SETRICHACL",10)) {
+				status = do_setrichacl(filename,lv,ts,ptr.skip(10));
 			}
 			break;
 		case 'T':
-			if (strncmp(ptr,"TRUNC",5)==0) {
-				status = do_trunc(filename,lv,ts,ptr+5);
+			if (ptr.startsWith("TRUNC",5)) {
+				status = do_trunc(filename,lv,ts,ptr.skip(5));
 			}
 			break;
 		case 'U':
-			if (strncmp(ptr,"UNLINK",6)==0) {
-				status = do_unlink(filename,lv,ts,ptr+6);
-			} else if (strncmp(ptr,"UNDEL",5)==0) {
-				status = do_undel(filename,lv,ts,ptr+5);
-			} else if (strncmp(ptr,"UNLOCK",6)==0) {
-				status = do_unlock(filename,lv,ts,ptr+6);
+			if (ptr.startsWith("UNLINK",6)) {
+				status = do_unlink(filename,lv,ts,ptr.skip(6));
+			} else if (ptr.startsWith("UNDEL",5)) {
+				status = do_undel(filename,lv,ts,ptr.skip(5));
+			} else if (ptr.startsWith("UNLOCK",6)) {
+				status = do_unlock(filename,lv,ts,ptr.skip(6));
 			}
 			break;
 		case 'W':
-			if (strncmp(ptr,"WRITE",5)==0) {
-				status = do_write(filename,lv,ts,ptr+5);
+			if (ptr.startsWith("WRITE",5)) {
+				status = do_write(filename,lv,ts,ptr.skip(5));
 			}
 			break;
 		default:
@@ -958,13 +1041,14 @@ int restore_line(const char* filename, uint64_t lv, const char* line) {
 	if (status == LIZARDFS_ERROR_MAX) {
 #ifndef METARESTORE
 		lzfs_silent_syslog(LOG_DEBUG, "master.mismatch File %s, %" PRIu64 ", %s -- unknown entry",
-			   filename, lv, line);
+			   filename, lv, ptr.entryText().c_str());
 #endif
-		lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": unknown entry '%s'", filename, lv, ptr);
+		lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": unknown entry '%s'", filename, lv,
+				ptr.entryText().c_str());
 	} else if (status != LIZARDFS_STATUS_OK) {
 #ifndef METARESTORE
 		lzfs_silent_syslog(LOG_DEBUG, "master.mismatch File %s, %" PRIu64 ", %s -- %s",
-			   filename, lv, line, lizardfs_error_string(status));
+			   filename, lv, ptr.entryText().c_str(), lizardfs_error_string(status));
 #endif
 		lzfs_pretty_syslog(LOG_ERR, "%s:%" PRIu64 ": error: %d (%s)", filename, lv, status,
 			lizardfs_error_string(status));
@@ -993,7 +1077,8 @@ void restore_reset() {
 	lastfn = NULL;
 }
 
-uint8_t restore(const char* filename, uint64_t newLogVersion, const char *ptr, RestoreRigor rigor) {
+static uint8_t restore_entry(const char* filename, uint64_t newLogVersion, RestoreCursor &ptr,
+		RestoreRigor rigor) {
 	if (currentFsVersion == 0 || nextFsVersion == 0) {
 		/*
 		 * This is first call to restore().
@@ -1005,7 +1090,8 @@ uint8_t restore(const char* filename, uint64_t newLogVersion, const char *ptr, R
 	if (verbosity > 1) {
 		lzfs_pretty_syslog(LOG_NOTICE, "filename: %s ; current meta version: %" PRIu64 " ; previous changeid: %"
 				PRIu64 " ; current changeid: %" PRIu64 " ; change data%s",
-				filename, nextFsVersion, currentFsVersion, newLogVersion, ptr);
+				filename, nextFsVersion, currentFsVersion, newLogVersion,
+				ptr.entryText().c_str());
 	}
 	if (newLogVersion < currentFsVersion) {
 		lzfs_pretty_syslog(LOG_ERR,
@@ -1025,7 +1111,8 @@ uint8_t restore(const char* filename, uint64_t newLogVersion, const char *ptr, R
 			return LIZARDFS_ERROR_CHANGELOGINCONSISTENT;
 		} else {
 			if (verbosity > 0) {
-				lzfs_pretty_syslog(LOG_NOTICE, "%s: change %s", filename, ptr);
+				lzfs_pretty_syslog(LOG_NOTICE, "%s: change %s", filename,
+						ptr.entryText().c_str());
 			}
 			int status = restore_line(filename,newLogVersion,ptr);
 			if (status<0) { // parse error - stop processing if requested
@@ -1049,6 +1136,17 @@ uint8_t restore(const char* filename, uint64_t newLogVersion, const char *ptr, R
 	return LIZARDFS_STATUS_OK;
 }
 
+uint8_t restore(const char* filename, uint64_t lv, const char *ptr, RestoreRigor rigor) {
+	RestoreCursor cursor(ptr);
+	return restore_entry(filename, lv, cursor, rigor);
+}
+
+uint8_t restore(const char* filename, uint64_t lv, const uint8_t *payload, uint32_t payloadSize,
+		RestoreRigor rigor) {
+	RestoreCursor cursor(payload, payloadSize);
+	return restore_entry(filename, lv, cursor, rigor);
+}
+
 void restore_setverblevel(uint8_t _vlevel) {
 	verbosity = _vlevel;
 }
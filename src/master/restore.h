@@ -26,4 +26,7 @@ enum class RestoreRigor { kIgnoreParseErrors, kDontIgnoreAnyErrors };
 
 void restore_reset();
 uint8_t restore(const char* filename, uint64_t lv, const char* ptr, RestoreRigor rigor);
+/// Applies a binary changelog entry, i.e. the payload of a record (see common/changelog_record.h)
+uint8_t restore(const char* filename, uint64_t lv, const uint8_t* payload, uint32_t payloadSize,
+		RestoreRigor rigor);
 void restore_setverblevel(uint8_t _vlevel);
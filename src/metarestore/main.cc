@@ -27,12 +27,14 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "common/cfg.h"
+#include "common/changelog_record.h"
 #include "common/metadata.h"
 #include "common/mfserr.h"
 #include "common/rotate_files.h"
@@ -42,6 +44,7 @@
 #include "master/filesystem.h"
 #include "master/hstring_memstorage.h"
 #include "master/hstring_storage.h"
+#include "master/metadata_dumper.h"
 #include "master/restore.h"
 #include "metarestore/merger.h"
 
@@ -108,6 +111,8 @@ void usage(const char* appname) {
 			"\t%s [-f] [-z] [-b] [-i] [-x [-x]] [-B n] -a [-d <data path>]\n"
 			"print version of metadata that can be read from disk by a master server in auto recovery mode:\n"
 			"\t%s -g -d <data path>\n"
+			"print change log files in the text format:\n"
+			"\t%s -t <change log file> [ <change log file> [ .... ]]\n"
 			"print version:\n"
 			"\t%s -v\n"
 			"\n"
@@ -119,7 +124,8 @@ void usage(const char* appname) {
 			"-xx  - even more verbose output\n"
 			"-b   - if there is any error in change logs then save the best possible metadata file\n"
 			"-i   - ignore some metadata structure errors (attach orphans to root, ignore names without inode, etc.)\n"
-			"-f   - force loading all changelogs\n", appname, appname, appname, appname, appname);
+			"-f   - force loading all changelogs\n"
+			"-P   - print progress on the standard output (used by the master server)\n", appname, appname, appname, appname, appname, appname);
 }
 
 /*! \brief Prints version of metadata that can be read from disk
@@ -179,11 +185,41 @@ void meta_version_on_disk(std::string path) {
 	printf("%" PRIu64 "\n", metadata_version);
 }
 
+/*! \brief Prints changelog files in the text format, converting binary entries. */
+int print_changelogs_as_text(int argc, char **argv) {
+	std::string text;
+	for (int i = 0; i < argc; ++i) {
+		ChangelogFileReader reader(argv[i]);
+		if (!reader.isOpen()) {
+			lzfs_pretty_errlog(LOG_ERR, "can't open changelog file: %s", argv[i]);
+			return 1;
+		}
+		ChangelogFileReader::Entry entry;
+		ChangelogFileReader::Status status;
+		while ((status = reader.next(entry)) == ChangelogFileReader::Status::kEntry) {
+			if (entry.text) {
+				printf("%" PRIu64 "%s\n", entry.version, entry.text);
+			} else if (changelog_record::toText(entry.payload, entry.payloadSize, text)) {
+				printf("%" PRIu64 ": %s\n", entry.version, text.c_str());
+			} else {
+				status = ChangelogFileReader::Status::kCorrupted;
+				break;
+			}
+		}
+		if (status == ChangelogFileReader::Status::kCorrupted) {
+			lzfs_pretty_syslog(LOG_ERR, "%s: corrupted entry", argv[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
 int main(int argc,char **argv) {
 	int ch;
 	uint8_t vl=0;
 	bool autorestore = false;
 	bool versionRecovery = false;
+	bool printText = false;
 	int savebest = 0;
 	int ignoreflag = 0;
 	int forcealllogs = 0;
@@ -192,6 +228,7 @@ int main(int argc,char **argv) {
 	std::string metaout, metadata, datapath;
 	char *appname = argv[0];
 	uint64_t firstlv,lastlv;
+	uint64_t lastVersion = 0;
 	std::unique_ptr<uint64_t> expectedChecksum;
 	int storedPreviousBackMetaCopies = kMaxStoredPreviousBackMetaCopies;
 	bool noLock = false;
@@ -201,7 +238,7 @@ int main(int argc,char **argv) {
 	prepareEnvironment();
 	openlog(nullptr, LOG_PID | LOG_NDELAY, LOG_USER);
 
-	while ((ch = getopt(argc, argv, "gfck:vm:o:d:abB:xih:z#?")) != -1) {
+	while ((ch = getopt(argc, argv, "gfck:vm:o:d:abB:xih:tzP#?")) != -1) {
 		switch (ch) {
 			case 'g':
 				versionRecovery = true;
@@ -253,9 +290,15 @@ int main(int argc,char **argv) {
 					return 1;
 				}
 				break;
+			case 't':
+				printText = true;
+				break;
 			case 'z':
 				fs_disable_checksum_verification(true);
 				break;
+			case 'P':
+				fs_set_metadata_progress_callback(MetadataDumper::reportProgress);
+				break;
 			case '#':
 				noLock = true;
 				break;
@@ -268,6 +311,14 @@ int main(int argc,char **argv) {
 	argc -= optind;
 	argv += optind;
 
+	if (printText) {
+		if (argc == 0) {
+			usage(appname);
+			return 1;
+		}
+		return print_changelogs_as_text(argc, argv);
+	}
+
 	// bad usage of -m
 	if (versionRecovery && datapath.empty()) {
 		usage(appname);
@@ -394,6 +445,8 @@ int main(int argc,char **argv) {
 				}
 				if (skip) {
 					filenames.pop_back();
+				} else {
+					lastVersion = std::max(lastVersion, lastlv);
 				}
 			}
 		}
@@ -443,12 +496,13 @@ int main(int argc,char **argv) {
 			}
 			if (skip==0) {
 				filenames.push_back(argv[pos]);
+				lastVersion = std::max(lastVersion, lastlv);
 			}
 		}
 		merger_start(filenames, MAXIDHOLE);
 	}
 
-	uint8_t status = merger_loop();
+	uint8_t status = merger_loop(lastVersion);
 
 	if (status != LIZARDFS_STATUS_OK && savebest==0) {
 		return 1;
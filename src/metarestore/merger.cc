@@ -26,17 +26,16 @@
 #include <syslog.h>
 
 #include "protocol/MFSCommunication.h"
+#include "common/changelog_record.h"
 #include "common/lizardfs_error_codes.h"
 #include "common/slogger.h"
+#include "master/filesystem.h"
 #include "master/restore.h"
 
-#define BSIZE 200000
-
 typedef struct _hentry {
-	FILE *fd;
+	ChangelogFileReader *reader;
 	char *filename;
-	char *buff;
-	char *ptr;
+	ChangelogFileReader::Entry entry;
 	uint64_t nextid;
 } hentry;
 
@@ -89,8 +88,9 @@ void merger_heap_sort_up(void) {
 
 
 void merger_nextentry(uint32_t pos) {
-	if (fgets(heap[pos].buff,BSIZE,heap[pos].fd)) {
-		uint64_t nextid = strtoull(heap[pos].buff,&(heap[pos].ptr),10);
+	ChangelogFileReader::Status status = heap[pos].reader->next(heap[pos].entry);
+	if (status == ChangelogFileReader::Status::kEntry) {
+		uint64_t nextid = heap[pos].entry.version;
 		if (heap[pos].nextid==0 || (nextid>heap[pos].nextid && nextid<heap[pos].nextid+maxidhole)) {
 			heap[pos].nextid = nextid;
 		} else {
@@ -99,35 +99,31 @@ void merger_nextentry(uint32_t pos) {
 			heap[pos].nextid = 0;
 		}
 	} else {
+		if (status == ChangelogFileReader::Status::kCorrupted) {
+			lzfs_pretty_syslog(LOG_ERR, "found corrupted entry in file: %s (last correct id: %" PRIu64 ")",
+					heap[pos].filename, heap[pos].nextid);
+		}
 		heap[pos].nextid = 0;
 	}
 }
 
 void merger_delete_entry(void) {
-	if (heap[heapsize].fd) {
-		fclose(heap[heapsize].fd);
-	}
+	delete heap[heapsize].reader;
 	if (heap[heapsize].filename) {
 		free(heap[heapsize].filename);
 	}
-	if (heap[heapsize].buff) {
-		free(heap[heapsize].buff);
-	}
 }
 
 void merger_new_entry(const char *filename) {
 	// printf("add file: %s\n",filename);
-	if ((heap[heapsize].fd = fopen(filename,"r"))!=NULL) {
+	heap[heapsize].reader = new ChangelogFileReader(filename);
+	if (heap[heapsize].reader->isOpen()) {
 		heap[heapsize].filename = strdup(filename);
-		heap[heapsize].buff = (char*) malloc(BSIZE);
-		heap[heapsize].ptr = NULL;
 		heap[heapsize].nextid = 0;
 		merger_nextentry(heapsize);
 	} else {
 		lzfs_pretty_syslog(LOG_ERR, "can't open changelog file: %s", filename);
 		heap[heapsize].filename = NULL;
-		heap[heapsize].buff = NULL;
-		heap[heapsize].ptr = NULL;
 		heap[heapsize].nextid = 0;
 	}
 }
@@ -151,14 +147,25 @@ int merger_start(const std::vector<std::string>& filenames, uint64_t maxhole) {
 	return 0;
 }
 
-uint8_t merger_loop(void) {
+uint8_t merger_loop(uint64_t lastVersion) {
 	uint8_t status;
 	hentry h;
+	uint64_t firstVersion = heapsize ? heap[0].nextid : 0;
 
 	while (heapsize) {
-//              lzfs_pretty_syslog(LOG_DEBUG, "current id: %" PRIu64 " / %s",heap[0].nextid,heap[0].ptr);
-		if ((status=restore(heap[0].filename, heap[0].nextid, heap[0].ptr,
-				RestoreRigor::kIgnoreParseErrors)) != LIZARDFS_STATUS_OK) {
+		if (lastVersion > firstVersion) {
+			fs_report_metadata_progress(LIZ_METADATA_DUMP_REPLAYING,
+					heap[0].nextid - firstVersion, lastVersion - firstVersion);
+		}
+		const ChangelogFileReader::Entry &entry = heap[0].entry;
+		if (entry.text) {
+			status = restore(heap[0].filename, heap[0].nextid, entry.text,
+					RestoreRigor::kIgnoreParseErrors);
+		} else {
+			status = restore(heap[0].filename, heap[0].nextid, entry.payload, entry.payloadSize,
+					RestoreRigor::kIgnoreParseErrors);
+		}
+		if (status != LIZARDFS_STATUS_OK) {
 			while (heapsize) {
 				heapsize--;
 				merger_delete_entry();
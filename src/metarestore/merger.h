@@ -25,4 +25,10 @@
 #include <vector>
 
 int merger_start(const std::vector<std::string>& filenames, uint64_t maxhole);
-uint8_t merger_loop(void);
+
+/*! \brief Applies changes from all files.
+ *
+ * \param lastVersion - the last version found in the files (or 0 if unknown), used only
+ *                      to report progress.
+ */
+uint8_t merger_loop(uint64_t lastVersion);
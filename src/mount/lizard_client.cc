@@ -2126,6 +2126,11 @@ ReadCache::Result read(Context &ctx,
 	// end of reader critical section
 	flushlock.unlock();
 
+	// Reads of one file handle can run in parallel, the record is kept alive by read_data_acquire
+	void *readData = fileinfo->data;
+	read_data_acquire(readData);
+	lock.unlock();
+
 	write_data_flush_inode(ino);
 
 	uint64_t firstBlockToRead = off / MFSBLOCKSIZE;
@@ -2135,7 +2140,8 @@ ReadCache::Result read(Context &ctx,
 
 	uint32_t ssize = alignedSize;
 
-	err = read_data(fileinfo->data, off, size, alignedOffset, ssize, ret);
+	err = read_data(readData, off, size, alignedOffset, ssize, ret);
+	read_data_release(readData);
 	ssize = ret.requestSize(alignedOffset, ssize);
 	if (err != LIZARDFS_STATUS_OK) {
 		oplog_printf(ctx, "read (%lu,%" PRIu64 ",%" PRIu64 "): %s",
@@ -99,6 +99,34 @@ static uint32_t maxretries;
 static pthread_t rpthid,npthid;
 static std::mutex fdMutex, recMutex, acquiredFileMutex;
 
+// Records indexed by packetId (packet ids are consecutive, starting from 1) -- recMutex
+static std::vector<threc*> threcById(1, nullptr);
+// Records of threads which have exited, reused by new threads -- recMutex
+static std::vector<threc*> threcFree;
+// Incremented by fs_term, which frees all records, so that threads don't use their cached ones
+static std::atomic<uint32_t> threcGeneration(0);
+
+namespace {
+
+// The record of the current thread, which is given back for reuse when the thread exits
+struct ThreadThrec {
+	threc *rec = nullptr;
+	uint32_t generation = 0;
+
+	~ThreadThrec() {
+		if (rec != nullptr) {
+			std::unique_lock<std::mutex> recLock(recMutex);
+			if (generation == threcGeneration) {
+				threcFree.push_back(rec);
+			}
+		}
+	}
+};
+
+thread_local ThreadThrec myThrec;
+
+} // anonymous namespace
+
 static uint32_t sessionid;
 static uint32_t masterversion;
 
@@ -239,38 +267,37 @@ void fs_dec_acnt(uint32_t inode) {
 }
 
 threc* fs_get_my_threc() {
-	pthread_t mythid = pthread_self();
+	if (myThrec.rec != nullptr && myThrec.generation == threcGeneration) {
+		return myThrec.rec;
+	}
 	threc *rec;
 	std::unique_lock<std::mutex> recLock(recMutex);
-	for (rec = threchead ; rec ; rec = rec->next) {
-		if (pthread_equal(rec->thid, mythid)) {
-			return rec;
-		}
+	if (!threcFree.empty()) {
+		rec = threcFree.back();
+		threcFree.pop_back();
+	} else {
+		rec = new threc;
+		rec->packetId = threcById.size();
+		threcById.push_back(rec);
+		rec->next = threchead;
+		threchead = rec;
 	}
-	rec = new threc;
-	rec->thid = mythid;
+	std::unique_lock<std::mutex> lock(rec->mutex);
+	rec->thid = pthread_self();
 	rec->sent = false;
 	rec->status = 0;
 	rec->received = false;
 	rec->waiting = 0;
 	rec->receivedType = 0;
-	if (threchead==NULL) {
-		rec->packetId = 1;
-	} else {
-		rec->packetId = threchead->packetId + 1;
-	}
-	rec->next = threchead;
-	threchead = rec;
+	myThrec.rec = rec;
+	myThrec.generation = threcGeneration;
 	return rec;
 }
 
 threc* fs_get_threc_by_id(uint32_t packetId) {
-	threc *rec;
 	std::unique_lock<std::mutex> recLock(recMutex);
-	for (rec = threchead ; rec ; rec=rec->next) {
-		if (rec->packetId==packetId) {
-			return rec;
-		}
+	if (packetId < threcById.size()) {
+		return threcById[packetId];
 	}
 	return NULL;
 }
@@ -1280,6 +1307,9 @@ void fs_term(void) {
 		delete tr;
 	}
 	threchead = nullptr;
+	threcById.assign(1, nullptr);
+	threcFree.clear();
+	threcGeneration++;
 	rec_lock.unlock();
 	std::unique_lock<std::mutex> af_lock(acquiredFileMutex);
 	for (af = afhead ; af ; af = afn) {
@@ -29,6 +29,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include <atomic>
 #include <condition_variable>
 #include <map>
 #include <mutex>
@@ -51,18 +52,28 @@
 
 #define USECTICK 333333
 #define REFRESHTICKS 15
+#define READRECHASHSIZE 256
+#define READRECHASH(inode) (((inode)*0xB239FB71)%READRECHASHSIZE)
 
 static std::atomic<uint32_t> gReadaheadMaxWindowSize;
 static std::atomic<uint32_t> gCacheExpirationTime_ms;
 
+/*
+ * Reads of one record may run in parallel: cache and readahead_adviser are guarded by
+ * cacheMutex, which is held only for cache lookups, while reader is guarded by readerMutex,
+ * held while talking to chunkservers. Data is never read straight into a cache entry,
+ * so that concurrent lookups can inspect the entry meanwhile.
+ */
 struct readrec {
-	ChunkReader reader;
-	ReadCache cache;
-	ReadaheadAdviser readahead_adviser;
-	std::vector<uint8_t> read_buffer;
+	ChunkReader reader;             // readerMutex
+	ReadCache cache;                // cacheMutex
+	ReadaheadAdviser readahead_adviser; // cacheMutex
 	uint32_t inode;
-	uint8_t refreshCounter;         // gMutex
-	bool expired;                   // gMutex
+	std::atomic<uint8_t> refreshCounter;
+	std::atomic<bool> expired;
+	std::atomic<uint32_t> activeReads; // readers which don't hold the lock of the file handle
+	std::mutex cacheMutex;
+	std::mutex readerMutex;
 
 	readrec(uint32_t inode, ChunkConnector& connector, double bandwidth_overuse)
 			: reader(connector, bandwidth_overuse),
@@ -70,23 +81,30 @@ struct readrec {
 			  readahead_adviser(gCacheExpirationTime_ms, gReadaheadMaxWindowSize),
 			  inode(inode),
 			  refreshCounter(0),
-			  expired(false) {
+			  expired(false),
+			  activeReads(0) {
 	}
 };
 
 typedef std::unordered_multimap<uint32_t, readrec*> ReadRecords;
 typedef std::pair<ReadRecords::iterator, ReadRecords::iterator> ReadRecordRange;
 
+// Records are spread over buckets with separate locks, so that opening, closing and
+// invalidating different inodes don't contend
+struct alignas(64) ReadRecordBucket {
+	std::mutex mutex;
+	ReadRecords records;
+};
+
 static ConnectionPool gReadConnectionPool;
 static ChunkConnectorUsingPool gChunkConnector(gReadConnectionPool);
-static std::mutex gMutex;
-static ReadRecords gActiveReadRecords;
+static ReadRecordBucket gActiveReadRecords[READRECHASHSIZE];
+static std::atomic<bool> readDataTerminate;
 static pthread_t delayedOpsThread;
 static std::atomic<uint32_t> gChunkserverConnectTimeout_ms;
 static std::atomic<uint32_t> gChunkserverWaveReadTimeout_ms;
 static std::atomic<uint32_t> gChunkserverTotalReadTimeout_ms;
 static std::atomic<bool> gPrefetchXorStripes;
-static bool readDataTerminate;
 static std::atomic<uint32_t> maxRetries;
 static double gBandwidthOveruse;
 
@@ -115,46 +133,54 @@ bool read_data_get_prefetchxorstripes() {
 
 inline void clear_active_read_records()
 {
-	std::unique_lock<std::mutex> lock(gMutex);
+	for (ReadRecordBucket& bucket : gActiveReadRecords) {
+		std::unique_lock<std::mutex> lock(bucket.mutex);
 
-	for (ReadRecords::value_type& readRecord : gActiveReadRecords) {
-		delete readRecord.second;
-	}
+		for (ReadRecords::value_type& readRecord : bucket.records) {
+			delete readRecord.second;
+		}
 
-	gActiveReadRecords.clear();
+		bucket.records.clear();
+	}
 }
 
 void* read_data_delayed_ops(void *arg) {
 	(void)arg;
 	for (;;) {
 		gReadConnectionPool.cleanup();
-		std::unique_lock<std::mutex> lock(gMutex);
 		if (readDataTerminate) {
 			return NULL;
 		}
-		ReadRecords::iterator readRecordIt = gActiveReadRecords.begin();
-		while (readRecordIt != gActiveReadRecords.end()) {
-			if (readRecordIt->second->refreshCounter < REFRESHTICKS) {
-				++(readRecordIt->second->refreshCounter);
-			}
-
-			if (readRecordIt->second->expired) {
-				delete readRecordIt->second;
-				readRecordIt = gActiveReadRecords.erase(readRecordIt);
-			} else {
-				++readRecordIt;
+		for (ReadRecordBucket& bucket : gActiveReadRecords) {
+			std::unique_lock<std::mutex> lock(bucket.mutex);
+			ReadRecords::iterator readRecordIt = bucket.records.begin();
+			while (readRecordIt != bucket.records.end()) {
+				readrec *rrec = readRecordIt->second;
+				uint8_t refreshCounter = rrec->refreshCounter;
+				if (refreshCounter < REFRESHTICKS) {
+					// Don't overwrite REFRESHTICKS set by read_inode_ops in the meantime
+					rrec->refreshCounter.compare_exchange_strong(refreshCounter,
+							refreshCounter + 1);
+				}
+
+				if (rrec->expired && rrec->activeReads == 0) {
+					delete rrec;
+					readRecordIt = bucket.records.erase(readRecordIt);
+				} else {
+					++readRecordIt;
+				}
 			}
 		}
-		lock.unlock();
 		usleep(USECTICK);
 	}
 }
 
 void* read_data_new(uint32_t inode) {
 	readrec *rrec = new readrec(inode, gChunkConnector, gBandwidthOveruse);
-	std::unique_lock<std::mutex> lock(gMutex);
+	ReadRecordBucket& bucket = gActiveReadRecords[READRECHASH(inode)];
+	std::unique_lock<std::mutex> lock(bucket.mutex);
 
-	gActiveReadRecords.emplace(inode, rrec);
+	bucket.records.emplace(inode, rrec);
 
 	return rrec;
 }
@@ -162,10 +188,21 @@ void* read_data_new(uint32_t inode) {
 void read_data_end(void* rr) {
 	readrec *rrec = (readrec*)rr;
 
-	std::unique_lock<std::mutex> lock(gMutex);
 	rrec->expired = true;
 }
 
+void read_data_acquire(void *rr) {
+	readrec *rrec = (readrec*)rr;
+
+	rrec->activeReads++;
+}
+
+void read_data_release(void *rr) {
+	readrec *rrec = (readrec*)rr;
+
+	rrec->activeReads--;
+}
+
 void read_data_init(uint32_t retries,
 		uint32_t chunkserverRoundTripTime_ms,
 		uint32_t chunkserverConnectTimeout_ms,
@@ -210,10 +247,7 @@ void read_data_init(uint32_t retries,
 }
 
 void read_data_term(void) {
-	{
-		std::unique_lock<std::mutex> lock(gMutex);
-		readDataTerminate = true;
-	}
+	readDataTerminate = true;
 
 	pthread_join(delayedOpsThread,NULL);
 
@@ -221,9 +255,10 @@ void read_data_term(void) {
 }
 
 void read_inode_ops(uint32_t inode) { // attributes of inode have been changed - force reconnect and clear cache
-	std::unique_lock<std::mutex> lock(gMutex);
+	ReadRecordBucket& bucket = gActiveReadRecords[READRECHASH(inode)];
+	std::unique_lock<std::mutex> lock(bucket.mutex);
 
-	ReadRecordRange range = gActiveReadRecords.equal_range(inode);
+	ReadRecordRange range = bucket.records.equal_range(inode);
 
 	for (ReadRecords::iterator it = range.first; it != range.second; ++it) {
 		it->second->refreshCounter = REFRESHTICKS; // force reconnect on forthcoming access
@@ -262,9 +297,7 @@ static int read_to_buffer(readrec *rrec, uint64_t current_offset, uint64_t bytes
 	// forced sleep between retries caused by recoverable failures
 	uint32_t sleep_time_ms = 0;
 
-	std::unique_lock<std::mutex> lock(gMutex);
 	bool force_prepare = (rrec->refreshCounter == REFRESHTICKS);
-	lock.unlock();
 
 	while (bytes_to_read > 0) {
 		Timeout sleep_timeout = Timeout(std::chrono::milliseconds(sleep_time_ms));
@@ -280,9 +313,7 @@ static int read_to_buffer(readrec *rrec, uint64_t current_offset, uint64_t bytes
 				prepared_chunk_id = chunk_id;
 				prepared_inode = rrec->inode;
 				force_prepare = false;
-				lock.lock();
 				rrec->refreshCounter = 0;
-				lock.unlock();
 			}
 
 			uint64_t offset_of_chunk = static_cast<uint64_t>(chunk_id) * MFSCHUNKSIZE;
@@ -338,6 +369,7 @@ int read_data(void *rr, off_t fuseOffset, size_t fuseSize,
 		return LIZARDFS_STATUS_OK;
 	}
 
+	std::unique_lock<std::mutex> cacheLock(rrec->cacheMutex);
 	// Feed the adviser with original FUSE offset and size (before alignment)
 	rrec->readahead_adviser.feed(fuseOffset, fuseSize);
 
@@ -350,15 +382,22 @@ int read_data(void *rr, off_t fuseOffset, size_t fuseSize,
 	uint64_t request_offset = result.remainingOffset();
 	uint64_t bytes_to_read_left = std::max<uint64_t>(size, rrec->readahead_adviser.window()) - (request_offset - offset);
 	bytes_to_read_left = (bytes_to_read_left + MFSBLOCKSIZE - 1) / MFSBLOCKSIZE * MFSBLOCKSIZE;
+	cacheLock.unlock();
 
+	std::vector<uint8_t> read_buffer;
 	uint64_t bytes_read = 0;
-	int err = read_to_buffer(rrec, request_offset, bytes_to_read_left, result.inputBuffer(), &bytes_read);
+	std::unique_lock<std::mutex> readerLock(rrec->readerMutex);
+	int err = read_to_buffer(rrec, request_offset, bytes_to_read_left, read_buffer, &bytes_read);
+	readerLock.unlock();
 	if (err) {
-		// paranoia check - discard any leftover bytes from incorrect read
-		result.inputBuffer().clear();
+		// the entry stays empty, so it will be discarded by the next query
 		return err;
 	}
+
+	cacheLock.lock();
+	result.inputBuffer().swap(read_buffer);
 	result.entries.back()->reset_timer();
+	cacheLock.unlock();
 
 	ret = std::move(result);
 	return LIZARDFS_STATUS_OK;
@@ -33,6 +33,10 @@ bool read_data_get_prefetchxorstripes();
 void read_inode_ops(uint32_t inode);
 void* read_data_new(uint32_t inode);
 void read_data_end(void *rr);
+/// Keep the record alive after read_data_end until read_data_release is called, so that
+/// read_data can be called without holding the lock of the file handle.
+void read_data_acquire(void *rr);
+void read_data_release(void *rr);
 int read_data(void *rr, off_t fuseOffset, size_t fuseSize,
 		uint64_t offset, uint32_t size, ReadCache::Result &ret);
 void read_data_freebuff(void *rr);
@@ -30,6 +30,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <vector>
@@ -202,16 +203,27 @@ struct DelayedQueueEntry {
 	}
 };
 
+/*
+ * Inodes are spread over IDHASHSIZE buckets, each one guarded by its own mutex, so that writes
+ * to different files don't contend on a single lock. All fields of inodedata are guarded by the
+ * mutex of the bucket the inode belongs to ("glock" in comments below).
+ */
+struct alignas(64) InodeBucket {
+	std::mutex mutex;
+	inodedata *head = nullptr;
+};
+
 } // anonymous namespace
 
 static std::atomic<uint32_t> maxretries;
-static std::mutex gMutex;
+static InodeBucket idhash[IDHASHSIZE];
 typedef std::unique_lock<std::mutex> Glock;
 
+// Free cache blocks are counted atomically, fcbmutex is needed only to wait for them
+static std::mutex fcbmutex;
 static std::condition_variable fcbcond;
-static uint32_t fcbwaiting = 0;
-static int64_t freecacheblocks;
-static inodedata **idhash;
+static std::atomic<uint32_t> fcbwaiting(0);
+static std::atomic<int64_t> freecacheblocks;
 
 static uint32_t gWriteWindowSize;
 static uint32_t gChunkserverTimeout_ms;
@@ -223,41 +235,66 @@ static pthread_t delayed_queue_worker_th;
 static std::vector<pthread_t> write_worker_th;
 
 static void* jqueue;
+static std::mutex gDelayedQueueMutex; // may be locked while holding glock, never the other way
 static std::list<DelayedQueueEntry> delayedQueue;
 
 static ConnectionPool gChunkserverConnectionPool;
 static ChunkConnectorUsingPool gChunkConnector(gChunkserverConnectionPool);
 
-void write_cb_release_blocks(uint32_t count, Glock&) {
-	freecacheblocks += count;
-	if (fcbwaiting > 0 && freecacheblocks > 0) {
+static std::mutex& write_inode_mutex(uint32_t inode) {
+	return idhash[IDHASH(inode)].mutex;
+}
+
+static std::mutex& write_inode_mutex(const inodedata* id) {
+	return write_inode_mutex(id->inode);
+}
+
+/* glock: UNUSED */
+void write_cb_release_blocks(uint32_t count) {
+	if (freecacheblocks.fetch_add(count) + count > 0 && fcbwaiting > 0) {
+		std::lock_guard<std::mutex> fcblock(fcbmutex);
 		fcbcond.notify_all();
 	}
 }
 
-void write_cb_acquire_blocks(uint32_t count, Glock&) {
+/* glock: UNUSED */
+void write_cb_acquire_blocks(uint32_t count) {
 	freecacheblocks -= count;
 }
 
+static bool write_cb_must_wait(uint64_t dataChainSize) {
+	int64_t freeBlocks = freecacheblocks;
+	return freeBlocks <= 0
+			// dataChainSize / (dataChainSize + freeBlocks) > gCachePerInodePercentage / 100
+			// really means "0 > 0"
+			|| dataChainSize * 100 > (dataChainSize + freeBlocks) * gCachePerInodePercentage;
+}
+
+/* glock: LOCKED, released while waiting */
 void write_cb_wait_for_block(inodedata* id, Glock& glock) {
 	LOG_AVG_TILL_END_OF_SCOPE0("write_cb_wait_for_block");
-	fcbwaiting++;
 	uint64_t dataChainSize = id->dataChain.size();
-	while (freecacheblocks <= 0
-			// dataChainSize / (dataChainSize + freecacheblocks) > gCachePerInodePercentage / 100
-			// really means "0 > 0"
-			|| dataChainSize * 100 > (dataChainSize + freecacheblocks) * gCachePerInodePercentage)
+	if (!write_cb_must_wait(dataChainSize)) {
+		return;
+	}
+	// Blocks are released by workers which need glock of their inodes, so don't hold ours
+	glock.unlock();
 	{
-		fcbcond.wait(glock);
+		std::unique_lock<std::mutex> fcblock(fcbmutex);
+		fcbwaiting++;
+		while (write_cb_must_wait(dataChainSize)) {
+			fcbcond.wait(fcblock);
+		}
+		fcbwaiting--;
 	}
-	fcbwaiting--;
+	glock.lock();
 }
 
 /* inode */
 
 inodedata* write_find_inodedata(uint32_t inode, Glock&) {
 	uint32_t idh = IDHASH(inode);
-	for (inodedata* id = idhash[idh]; id; id = id->next) {
+	for (inodedata* id = idhash[idh].head; id; id = id->next) {
 		if (id->inode == inode) {
 			return id;
 		}
@@ -268,21 +305,21 @@ inodedata* write_find_inodedata(uint32_t inode, Glock&) {
 inodedata* write_get_inodedata(uint32_t inode, Glock&) {
 	uint32_t idh = IDHASH(inode);
 	inodedata* id;
-	for (inodedata* id = idhash[idh]; id; id = id->next) {
+	for (inodedata* id = idhash[idh].head; id; id = id->next) {
 		if (id->inode == inode) {
 			return id;
 		}
 	}
 	id = new inodedata(inode);
-	id->next = idhash[idh];
-	idhash[idh] = id;
+	id->next = idhash[idh].head;
+	idhash[idh].head = id;
 	return id;
 }
 
 void write_free_inodedata(inodedata* fid, Glock&) {
 	uint32_t idh = IDHASH(fid->inode);
 	inodedata *id, **idp;
-	idp = &(idhash[idh]);
+	idp = &(idhash[idh].head);
 	while ((id = *idp)) {
 		if (id == fid) {
 			*idp = id->next;
@@ -295,11 +332,13 @@ void write_free_inodedata(inodedata* fid, Glock&) {
 
 /* delayed queue */
 
-static void delayed_queue_put(inodedata* id, uint32_t seconds, Glock&) {
+static void delayed_queue_put(inodedata* id, uint32_t seconds) {
+	std::lock_guard<std::mutex> queueLock(gDelayedQueueMutex);
 	delayedQueue.push_back(DelayedQueueEntry(id, seconds * DelayedQueueEntry::kTicksPerSecond));
 }
 
-static bool delayed_queue_remove(inodedata* id, Glock&) {
+static bool delayed_queue_remove(inodedata* id) {
+	std::lock_guard<std::mutex> queueLock(gDelayedQueueMutex);
 	for (auto it = delayedQueue.begin(); it != delayedQueue.end(); ++it) {
 		if (it->inodeData == id) {
 			delayedQueue.erase(it);
@@ -312,7 +351,7 @@ static bool delayed_queue_remove(inodedata* id, Glock&) {
 void* delayed_queue_worker(void*) {
 	for (;;) {
 		Timeout timeout(std::chrono::microseconds(1000000 / DelayedQueueEntry::kTicksPerSecond));
-		Glock lock(gMutex);
+		std::unique_lock<std::mutex> lock(gDelayedQueueMutex);
 		auto it = delayedQueue.begin();
 		while (it != delayedQueue.end()) {
 			if (it->inodeData == NULL) {
@@ -333,9 +372,9 @@ void* delayed_queue_worker(void*) {
 
 /* queues */
 
-void write_delayed_enqueue(inodedata* id, uint32_t seconds, Glock& lock) {
+void write_delayed_enqueue(inodedata* id, uint32_t seconds, Glock&) {
 	if (seconds > 0) {
-		delayed_queue_put(id, seconds, lock);
+		delayed_queue_put(id, seconds);
 	} else {
 		queue_put(jqueue, 0, 0, (uint8_t*) id, 0);
 	}
@@ -363,7 +402,7 @@ void write_job_delayed_end(inodedata* id, int status, int seconds, Glock &lock)
 		write_delayed_enqueue(id, seconds, lock);
 	} else {        // no more work or error occurred
 		// if this is an error then release all data blocks
-		write_cb_release_blocks(id->dataChain.size(), lock);
+		write_cb_release_blocks(id->dataChain.size());
 		id->dataChain.clear();
 		id->inqueue = false;
 		id->maxfleng = 0; // proper file length is now on the master server, remove our length cache
@@ -403,7 +442,7 @@ void InodeChunkWriter::processJob(inodedata* inodeData) {
 	inodeData_ = inodeData;
 
 	// First, choose index of some chunk to write
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(inodeData_));
 	int status = inodeData_->status;
 	bool haveDataToWrite;
 	if (inodeData_->locator) {
@@ -446,13 +485,13 @@ void InodeChunkWriter::processJob(inodedata* inodeData) {
 				processDataChain(writer);
 				writer.finish(kTimeToFinishOperations * 1000);
 
-				Glock lock(gMutex);
+				Glock lock(write_inode_mutex(inodeData_));
 				returnJournalToDataChain(writer.releaseJournal(), lock);
 			}
 			locator->unlockChunk();
 			read_inode_ops(inodeData_->inode);
 
-			Glock lock(gMutex);
+			Glock lock(write_inode_mutex(inodeData_));
 			inodeData_->minimumBlocksToWrite = writer.getMinimumBlockCountWorthWriting();
 			bool canWait = !inodeData_->requiresFlushing();
 			if (!haveAnyBlockInCurrentChunk(lock)) {
@@ -468,7 +507,7 @@ void InodeChunkWriter::processJob(inodedata* inodeData) {
 			write_job_delayed_end(inodeData_, LIZARDFS_STATUS_OK, (canWait ? 1 : 0), lock);
 		} catch (Exception& e) {
 			std::string errorString = e.what();
-			Glock lock(gMutex);
+			Glock lock(write_inode_mutex(inodeData_));
 			if (e.status() != LIZARDFS_ERROR_LOCKED) {
 				inodeData_->trycnt++;
 				errorString += " (try counter: " + std::to_string(inodeData->trycnt) + ")";
@@ -495,7 +534,7 @@ void InodeChunkWriter::processJob(inodedata* inodeData) {
 			}
 		}
 	} catch (UnrecoverableWriteException& e) {
-		Glock lock(gMutex);
+		Glock lock(write_inode_mutex(inodeData_));
 		if (e.status() == LIZARDFS_ERROR_ENOENT) {
 			write_job_end(inodeData_, LIZARDFS_ERROR_EBADF, lock);
 		} else if (e.status() == LIZARDFS_ERROR_QUOTA) {
@@ -506,7 +545,7 @@ void InodeChunkWriter::processJob(inodedata* inodeData) {
 			write_job_end(inodeData_, LIZARDFS_ERROR_IO, lock);
 		}
 	} catch (Exception& e) {
-		Glock lock(gMutex);
+		Glock lock(write_inode_mutex(inodeData_));
 		int waitTime = 1;
 		if (inodeData_->trycnt > 10) {
 			waitTime = std::min<int>(10, inodeData_->trycnt - 9);
@@ -539,13 +578,13 @@ void InodeChunkWriter::processDataChain(ChunkWriter& writer) {
 		bool can_expect_next_block = true;
 		if (wholeOperationTimer.elapsed_s() + kTimeToFinishOperations < maximumTime
 				&& writer.acceptsNewOperations()) {
-			Glock lock(gMutex);
+			Glock lock(write_inode_mutex(inodeData_));
 			// While there is any block worth sending, we add new write operation
 			while (haveBlockWorthWriting(writer.getUnfinishedOperationsCount(), lock)) {
 				// Remove block from cache and pass it to the writer
 				writer.addOperation(std::move(inodeData_->dataChain.front()));
 				inodeData_->popFromChain();
-				write_cb_release_blocks(1, lock);
+				write_cb_release_blocks(1);
 			}
 			if (inodeData_->requiresFlushing() && !haveAnyBlockInCurrentChunk(lock)) {
 				// No more data and some flushing is needed or required, so flush everything
@@ -557,7 +596,7 @@ void InodeChunkWriter::processDataChain(ChunkWriter& writer) {
 			can_expect_next_block = haveAnyBlockInCurrentChunk(lock);
 		} else if (writer.acceptsNewOperations()) {
 			// We are running out of time...
-			Glock lock(gMutex);
+			Glock lock(write_inode_mutex(inodeData_));
 			if (!inodeData_->requiresFlushing()) {
 				// Nobody is waiting for the data to be flushed and the data in write chain
 				// isn't too old. Let's postpone any operations
@@ -571,7 +610,7 @@ void InodeChunkWriter::processDataChain(ChunkWriter& writer) {
 		}
 
 		if (writer.startNewOperations(can_expect_next_block) > 0) {
-			Glock lock(gMutex);
+			Glock lock(write_inode_mutex(inodeData_));
 			inodeData_->lastWriteToChunkservers.reset();
 		}
 		if (writer.getPendingOperationsCount() == 0) {
@@ -587,9 +626,9 @@ void InodeChunkWriter::processDataChain(ChunkWriter& writer) {
 	}
 }
 
-void InodeChunkWriter::returnJournalToDataChain(std::list<WriteCacheBlock> &&journal, Glock &lock) {
+void InodeChunkWriter::returnJournalToDataChain(std::list<WriteCacheBlock> &&journal, Glock&) {
 	if (!journal.empty()) {
-		write_cb_acquire_blocks(journal.size(), lock);
+		write_cb_acquire_blocks(journal.size());
 		uint64_t prev_id = journal.front().chunkIndex;
 		int alterations = (!inodeData_->dataChain.empty()
 				&& journal.back().chunkIndex != inodeData_->dataChain.front().chunkIndex) ? 1 : 0;
@@ -668,7 +707,6 @@ void write_data_init(uint32_t cachesize, uint32_t retries, uint32_t workers,
 		uint32_t writewindowsize, uint32_t chunkserverTimeout_ms, uint32_t cachePerInodePercentage) {
 	uint64_t cachebytecount = uint64_t(cachesize) * 1024 * 1024;
 	uint64_t cacheblockcount = (cachebytecount / MFSBLOCKSIZE);
-	uint32_t i;
 	pthread_attr_t thattr;
 
 	gChunkConnector.setSourceIp(fs_getsrcip());
@@ -682,11 +720,6 @@ void write_data_init(uint32_t cachesize, uint32_t retries, uint32_t workers,
 	freecacheblocks = cacheblockcount;
 	gCachePerInodePercentage = cachePerInodePercentage;
 
-	idhash = (inodedata**) malloc(sizeof(inodedata*) * IDHASHSIZE);
-	for (i = 0; i < IDHASHSIZE; i++) {
-		idhash[i] = NULL;
-	}
-
 	jqueue = queue_new(0);
 
 	pthread_attr_init(&thattr);
@@ -705,10 +738,7 @@ void write_data_term(void) {
 	uint32_t i;
 	inodedata *id, *idn;
 
-	{
-		Glock lock(gMutex);
-		delayed_queue_put(nullptr, 0, lock);
-	}
+	delayed_queue_put(nullptr, 0);
 	for (i = 0; i < write_worker_th.size(); i++) {
 		queue_put(jqueue, 0, 0, NULL, 0);
 	}
@@ -718,17 +748,17 @@ void write_data_term(void) {
 	pthread_join(delayed_queue_worker_th, NULL);
 	queue_delete(jqueue, queue_deleter_delete<inodedata>);
 	for (i = 0; i < IDHASHSIZE; i++) {
-		for (id = idhash[i]; id; id = idn) {
+		for (id = idhash[i].head; id; id = idn) {
 			idn = id->next;
 			delete id;
 		}
+		idhash[i].head = nullptr;
 	}
-	free(idhash);
 }
 
 /* glock: UNLOCKED */
 int write_block(inodedata *id, uint32_t chindx, uint16_t pos, uint32_t from, uint32_t to, const uint8_t *data) {
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(id));
 	id->lastWriteToDataChain.reset();
 
 	// Try to expand the last block
@@ -745,7 +775,7 @@ int write_block(inodedata *id, uint32_t chindx, uint16_t pos, uint32_t from, uin
 
 	// Didn't manage to expand an existing block, so allocate a new one
 	write_cb_wait_for_block(id, lock);
-	write_cb_acquire_blocks(1, lock);
+	write_cb_acquire_blocks(1);
 	id->pushToChain(WriteCacheBlock(chindx, pos, WriteCacheBlock::kWritableBlock));
 	sassert(id->dataChain.back().expand(from, to, data));
 	if (id->inqueue) {
@@ -754,7 +784,7 @@ int write_block(inodedata *id, uint32_t chindx, uint16_t pos, uint32_t from, uin
 		// - there are at least two chunks in the write chain
 		if (id->trycnt == 0 && (id->dataChain.size() > id->minimumBlocksToWrite
 			|| id->dataChain.front().chunkIndex != id->dataChain.back().chunkIndex)) {
-			if (delayed_queue_remove(id, lock)) {
+			if (delayed_queue_remove(id)) {
 				write_enqueue(id, lock);
 			}
 		}
@@ -803,7 +833,7 @@ int write_data(void *vid, uint64_t offset, uint32_t size, const uint8_t* data) {
 		return LIZARDFS_ERROR_IO;
 	}
 
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(id));
 	status = id->status;
 	if (status == LIZARDFS_STATUS_OK) {
 		if (offset + size > id->maxfleng) {     // move fleng
@@ -848,7 +878,7 @@ static void write_data_lcnt_decrease(inodedata *id, Glock& lock) {
 
 void* write_data_new(uint32_t inode) {
 	inodedata* id;
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(inode));
 	id = write_get_inodedata(inode, lock);
 	if (id == NULL) {
 		return NULL;
@@ -865,7 +895,7 @@ static int write_data_flush(void* vid, Glock& lock) {
 
 	write_data_flushwaiting_increase(id, lock);
 	// If there are no errors (trycnt==0) and inode is waiting in the delayed queue, speed it up
-	if (id->trycnt == 0 && delayed_queue_remove(id, lock)) {
+	if (id->trycnt == 0 && delayed_queue_remove(id)) {
 		write_enqueue(id, lock);
 	}
 	// Wait for the data to be flushed
@@ -877,14 +907,17 @@ static int write_data_flush(void* vid, Glock& lock) {
 }
 
 int write_data_flush(void* vid) {
-	Glock lock(gMutex);
+	if (vid == NULL) {
+		return LIZARDFS_ERROR_IO;
+	}
+	Glock lock(write_inode_mutex((inodedata*) vid));
 	return write_data_flush(vid, lock);
 }
 
 uint64_t write_data_getmaxfleng(uint32_t inode) {
 	uint64_t maxfleng;
 	inodedata* id;
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(inode));
 	id = write_find_inodedata(inode, lock);
 	if (id) {
 		maxfleng = id->maxfleng;
@@ -895,7 +928,7 @@ uint64_t write_data_getmaxfleng(uint32_t inode) {
 }
 
 int write_data_flush_inode(uint32_t inode) {
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(inode));
 	inodedata* id = write_find_inodedata(inode, lock);
 	if (id == NULL) {
 		return 0;
@@ -905,7 +938,7 @@ int write_data_flush_inode(uint32_t inode) {
 
 int write_data_truncate(uint32_t inode, bool opened, uint32_t uid, uint32_t gid, uint64_t length,
 		Attributes& attr) {
-	Glock lock(gMutex);
+	Glock lock(write_inode_mutex(inode));
 
 	// 1. Flush writes but don't finish it completely - it'll be done at the end of truncate
 	inodedata* id = write_get_inodedata(inode, lock);
@@ -998,6 +1031,7 @@ int write_data_truncate(uint32_t inode, bool opened, uint32_t uid, uint32_t gid,
 	// Now we can tell the master server to finish the truncate operation and then unblock the inode
 	lock.unlock();
 	status = fs_truncateend(inode, uid, gid, length, lockId, attr);
+	lock.lock();
 	write_data_flushwaiting_decrease(id, lock);
 	write_data_lcnt_decrease(id, lock);
 
@@ -1009,11 +1043,11 @@ int write_data_truncate(uint32_t inode, bool opened, uint32_t uid, uint32_t gid,
 }
 
 int write_data_end(void* vid) {
-	Glock lock(gMutex);
 	inodedata* id = (inodedata*) vid;
 	if (id == NULL) {
 		return LIZARDFS_ERROR_IO;
 	}
+	Glock lock(write_inode_mutex(id));
 	int status = write_data_flush(id, lock);
 	write_data_lcnt_decrease(id, lock);
 	return status;
@@ -256,6 +256,13 @@ enum class SugidClearMode {
 #define LIZ_METADATASERVER_STATUS_SHADOW_CONNECTED 2
 #define LIZ_METADATASERVER_STATUS_SHADOW_DISCONNECTED 3
 
+/// field values: metadata dump stage
+#define LIZ_METADATA_DUMP_NOT_RUNNING 0
+#define LIZ_METADATA_DUMP_STARTED 1
+#define LIZ_METADATA_DUMP_LOADING 2
+#define LIZ_METADATA_DUMP_REPLAYING 3
+#define LIZ_METADATA_DUMP_STORING 4
+
 // Metalogger specific messages.
 
 /// field values: filenum
@@ -427,6 +434,15 @@ enum class SugidClearMode {
 /// version==0 chunks:(N * [chunkid:64 chunkversion:32 chunktype:8])
 /// version==1 chunks:(N * [chunkid:64 chunkversion:32 chunktype:16])
 
+// 0x0454
+#define LIZ_CSTOMA_REGISTER_CHANGES (1000U + 108U)
+/// epoch:64 checksum:64 chunkcount:32
+/// changed:(N * [chunkid:64 chunkversion:32 chunktype:16]) removed:(N * [chunkid:64 chunktype:16])
+
+// 0x0455
+#define LIZ_MATOCS_REGISTER_EPOCH (1000U + 109U)
+/// epoch:64 (0 - the master needs the full list of chunks)
+
 // 0x006E
 #define MATOCS_CREATE (PROTO_BASE+110)
 /// chunkid:64 chunkversion:32
@@ -1751,6 +1767,14 @@ enum class SugidClearMode {
 #define LIZ_MATOCL_FUSE_GETTRASH (1000U + 602U)
 /// msgid:32 entries:(vector<NamedInodeEntry>)
 
+// 0x643
+#define LIZ_CLTOMA_HASH_TABLES_INFO (1000U + 603U)
+/// dummy:8
+
+// 0x644
+#define LIZ_MATOCL_HASH_TABLES_INFO (1000U + 604U)
+/// tables:(vector<HashTableStatistics>)
+
 // CHUNKSERVER STATS
 
 // 0x0258
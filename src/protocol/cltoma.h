@@ -154,9 +154,15 @@ LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		uint32_t, messageId)
 
 // LIZ_CLTOMA_METADATASERVER_STATUS
+LIZARDFS_DEFINE_PACKET_VERSION(cltoma, metadataserverStatus, kStandard, 0)
+LIZARDFS_DEFINE_PACKET_VERSION(cltoma, metadataserverStatus, kWithProgress, 1)
 LIZARDFS_DEFINE_PACKET_SERIALIZATION(
-		cltoma, metadataserverStatus, LIZ_CLTOMA_METADATASERVER_STATUS, 0,
+		cltoma, metadataserverStatus, LIZ_CLTOMA_METADATASERVER_STATUS, kStandard,
 		uint32_t, messageId)
+LIZARDFS_DEFINE_PACKET_SERIALIZATION(
+		cltoma, metadataserverStatus, LIZ_CLTOMA_METADATASERVER_STATUS, kWithProgress,
+		uint32_t, messageId,
+		bool, dummy)
 
 // LIZ_CLTOMA_METADATASERVERS_LIST
 LIZARDFS_DEFINE_PACKET_SERIALIZATION(
@@ -394,6 +400,10 @@ LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		cltoma, listTasks, LIZ_CLTOMA_LIST_TASKS, 0,
 		bool, dummy)
 
+LIZARDFS_DEFINE_PACKET_SERIALIZATION(
+		cltoma, hashTablesInfo, LIZ_CLTOMA_HASH_TABLES_INFO, 0,
+		bool, dummy)
+
 LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		cltoma, stopTask, LIZ_CLTOMA_STOP_TASK, 0,
 		uint32_t, msgid,
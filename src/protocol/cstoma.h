@@ -81,6 +81,14 @@ LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		cstoma, registerLabel, LIZ_CSTOMA_REGISTER_LABEL, 0,
 		std::string, label)
 
+LIZARDFS_DEFINE_PACKET_SERIALIZATION(
+		cstoma, registerChanges, LIZ_CSTOMA_REGISTER_CHANGES, 0,
+		uint64_t, epoch,
+		uint64_t, checksum,
+		uint32_t, chunkCount,
+		std::vector<ChunkWithVersionAndType>, changedChunks,
+		std::vector<ChunkWithType>, removedChunks)
+
 LIZARDFS_DEFINE_PACKET_VERSION(cstoma, setVersion, kStandardAndXorChunks, 0)
 LIZARDFS_DEFINE_PACKET_VERSION(cstoma, setVersion, kECChunks, 1)
 LIZARDFS_DEFINE_PACKET_SERIALIZATION(
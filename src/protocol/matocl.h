@@ -26,6 +26,7 @@
 #include "common/chunk_with_address_and_label.h"
 #include "common/chunks_availability_state.h"
 #include "common/defective_file_info.h"
+#include "common/hash_table_statistics.h"
 #include "common/io_limits_database.h"
 #include "common/job_info.h"
 #include "common/legacy_acl.h"
@@ -171,11 +172,22 @@ LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		std::vector<IoGroupAndLimit>, groupsAndLimits)
 
 // LIZ_MATOCL_METADATASERVER_STATUS
+LIZARDFS_DEFINE_PACKET_VERSION(matocl, metadataserverStatus, kStandard, 0)
+LIZARDFS_DEFINE_PACKET_VERSION(matocl, metadataserverStatus, kWithProgress, 1)
 LIZARDFS_DEFINE_PACKET_SERIALIZATION(
-		matocl, metadataserverStatus, LIZ_MATOCL_METADATASERVER_STATUS, 0,
+		matocl, metadataserverStatus, LIZ_MATOCL_METADATASERVER_STATUS, kStandard,
 		uint32_t, messageId,
 		uint8_t, status,
 		uint64_t, metadataVersion)
+LIZARDFS_DEFINE_PACKET_SERIALIZATION(
+		matocl, metadataserverStatus, LIZ_MATOCL_METADATASERVER_STATUS, kWithProgress,
+		uint32_t, messageId,
+		uint8_t, status,
+		uint64_t, metadataVersion,
+		uint8_t, dumpStage,
+		uint8_t, dumpProgress,
+		uint64_t, changesBehind,
+		uint32_t, secondsBehind)
 
 // LIZ_MATOCL_FUSE_GETGOAL
 LIZARDFS_DEFINE_PACKET_VERSION(matocl, fuseGetGoal, kStatusPacketVersion, 0)
@@ -454,6 +466,10 @@ LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		matocl, listTasks, LIZ_MATOCL_LIST_TASKS, 0,
 		std::vector<JobInfo>, jobs_info)
 
+LIZARDFS_DEFINE_PACKET_SERIALIZATION(
+		matocl, hashTablesInfo, LIZ_MATOCL_HASH_TABLES_INFO, 0,
+		std::vector<HashTableStatistics>, tables)
+
 LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		matocl, stopTask, LIZ_MATOCL_STOP_TASK, 0,
 		uint32_t, msgid,
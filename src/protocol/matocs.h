@@ -133,6 +133,10 @@ LIZARDFS_DEFINE_PACKET_SERIALIZATION(
 		ChunkPartType, chunkType,
 		std::vector<ChunkTypeWithAddress>, sources)
 
+LIZARDFS_DEFINE_PACKET_SERIALIZATION(
+		matocs, registerEpoch, LIZ_MATOCS_REGISTER_EPOCH, 0,
+		uint64_t, epoch)
+
 namespace matocs {
 namespace replicateChunk {
 
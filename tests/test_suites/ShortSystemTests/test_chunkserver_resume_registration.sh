@@ -0,0 +1,45 @@
+CHUNKSERVERS=1 \
+	USE_RAMDISK=YES \
+	CHUNKSERVER_EXTRA_CONFIG="MASTER_TIMEOUT = 1" \
+	MOUNT_EXTRA_CONFIG="mfscachemode=NEVER" \
+	setup_local_empty_lizardfs info
+
+list_chunks() {
+	lizardfs_admin_master list-chunkservers --porcelain | awk '{print $3}'
+}
+
+# Make the chunkserver hang until master disconnects it, then let it reconnect.
+# It registers only chunks changed since its previous registration.
+hang_chunkserver() {
+	local pid=$(lizardfs_chunkserver_daemon 0 test 2>&1 | sed 's/.*pid: //')
+	kill -STOP $pid
+	assert_eventually_prints 0 'lizardfs_ready_chunkservers_count'
+	sleep 2
+	kill -CONT $pid
+	lizardfs_wait_for_all_ready_chunkservers
+}
+
+cd "${info[mount0]}"
+for i in {1..20}; do
+	FILE_SIZE=1K file-generate file_$i
+done
+assert_eventually_prints 20 'list_chunks'
+
+hang_chunkserver
+assert_eventually_prints 20 'list_chunks'
+for i in {1..20}; do
+	assert_success file-validate file_$i
+done
+
+# Chunks created and removed between registrations are taken into account
+for i in {21..25}; do
+	FILE_SIZE=1K file-generate file_$i
+done
+rm file_{1..5}
+assert_eventually_prints 20 'list_chunks'
+hang_chunkserver
+assert_eventually_prints 20 'list_chunks'
+for i in {6..25}; do
+	assert_success file-validate file_$i
+done
+assert_eventually_prints 20 'find_chunkserver_chunks 0 | wc -l'
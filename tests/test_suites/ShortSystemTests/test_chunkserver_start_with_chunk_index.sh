@@ -0,0 +1,39 @@
+CHUNKSERVERS=1 \
+	DISK_PER_CHUNKSERVER=2 \
+	USE_RAMDISK=YES \
+	MOUNT_EXTRA_CONFIG="mfscachemode=NEVER" \
+	setup_local_empty_lizardfs info
+
+list_chunks() {
+	lizardfs_admin_master list-chunkservers --porcelain | awk '{print $3}'
+}
+
+hdds=$(cat "${info[chunkserver0_hdd]}")
+cd "${info[mount0]}"
+for i in {1..20}; do
+	FILE_SIZE=1K file-generate file_$i
+done
+assert_eventually_prints 20 'list_chunks'
+
+# A clean shutdown writes an index of every disk, the next start uses and removes it
+assert_success lizardfs_chunkserver_daemon 0 stop
+for hdd in $hdds; do
+	assert_file_exists "$hdd/.chunkindex"
+done
+assert_success lizardfs_chunkserver_daemon 0 start
+lizardfs_wait_for_all_ready_chunkservers
+assert_eventually_prints 20 'list_chunks'
+for hdd in $hdds; do
+	assert_file_not_exists "$hdd/.chunkindex"
+done
+for i in {1..20}; do
+	assert_success file-validate file_$i
+done
+
+# An index of a disk modified while the chunkserver was down is ignored
+assert_success lizardfs_chunkserver_daemon 0 stop
+assert_success rm "$(find_chunkserver_chunks 0 | head -n 1)"
+assert_success lizardfs_chunkserver_daemon 0 start
+lizardfs_wait_for_all_ready_chunkservers
+assert_eventually_prints 19 'list_chunks'
+assert_equals 19 $(find_chunkserver_chunks 0 | wc -l)
@@ -0,0 +1,54 @@
+timeout_set 90 seconds
+
+master_cfg="MFSMETARESTORE_PATH = $TEMP_DIR/metarestore.sh"
+master_cfg+="|METADATA_SAVE_WITHOUT_FORK = 1"
+master_cfg+="|MAGIC_DISABLE_METADATA_DUMPS = 1"
+
+CHUNKSERVERS=1 \
+	USE_RAMDISK="YES" \
+	MASTER_EXTRA_CONFIG="$master_cfg" \
+	setup_local_empty_lizardfs info
+
+# A wrapper which slows down mfsmetarestore, so that the progress of the dump can be observed
+cat > "$TEMP_DIR/metarestore.sh" << END
+#!/usr/bin/env bash
+echo "PROGRESS 2 50"
+touch "$TEMP_DIR/dump_started"
+sleep 4
+mfsmetarestore "\$@"
+END
+chmod +x "$TEMP_DIR/metarestore.sh"
+
+dump_status() {
+	lizardfs_probe_master metadataserver-status | cut -f4
+}
+
+assert_equals "idle" "$(dump_status)"
+touch "${info[mount0]}"/file{1..10}
+assert_success lizardfs_admin_master save-metadata --async
+assert_eventually_prints "loading 50%" 'dump_status'
+assert_eventually_prints "idle" 'dump_status'
+
+# The metadata was dumped by mfsmetarestore
+last_change=$(tail -1 "${info[master_data_path]}/changelog.mfs.1" | cut -d : -f 1)
+assert_equals $((last_change + 1)) \
+		"$(mfsmetadump "${info[master_data_path]}/metadata.mfs" | awk 'NR==2{print $6}')"
+
+# If mfsmetarestore fails, the master dumps metadata in the foreground instead of forking
+rm -f "$TEMP_DIR/dump_started"
+cat > "$TEMP_DIR/metarestore.sh" << END
+#!/usr/bin/env bash
+touch "$TEMP_DIR/dump_started"
+echo "ERR"
+exit 1
+END
+touch "${info[mount0]}"/file{11..20}
+assert_failure lizardfs_admin_master save-metadata
+assert_file_exists "$TEMP_DIR/dump_started"
+rm -f "$TEMP_DIR/dump_started"
+touch "${info[mount0]}"/file{21..30}
+assert_success lizardfs_admin_master save-metadata
+assert_file_not_exists "$TEMP_DIR/dump_started"
+last_change=$(tail -1 "${info[master_data_path]}/changelog.mfs.1" | cut -d : -f 1)
+assert_equals $((last_change + 1)) \
+		"$(mfsmetadump "${info[master_data_path]}/metadata.mfs" | awk 'NR==2{print $6}')"